@@ -0,0 +1,402 @@
+// micro-benchmarks for packing and unpacking every message type and for encoding and decoding with every codec, on synthetic
+// Kinect-shaped frames (see SyntheticFrameSource); progress goes to stderr and the results to stdout (or --output) as JSON:
+//
+//   { "benchmark": "bench_messages", "min_time_s": <s>, "results": [ { "name", "operation", "message", "codec", "level", "iterations",
+//     "seconds", "ns_per_op", "messages_per_s", "mb_per_s", "raw_bytes", "packed_bytes", "allocations_per_op" }, ... ] }
+//
+// names are <format>/<message>[/level_<n>]/<operation>: png, wav, or message (plain serialization) for pack and unpack, and binary or gzip
+// for encode and decode, which the codecs do to messages already packed (images at PNG level 2, as the pipeline sends them)
+//
+// raw_bytes is the message as held in memory (the image or audio samples; for everything else, the message packed without compression)
+// and packed_bytes what the operation produced or consumed, so mb_per_s (in 10^6 bytes) compares the same work across levels and codecs.
+// allocations are counted through operator new, so they leave out whatever libpng, zlib, and libsndfile malloc() for themselves
+//
+// audio is only packed; a WAVAudioMessage can't be unpacked from a binary stream yet
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+
+#include <Poco/MemoryStream.h>
+
+#include <atomics/binary_stream.h>
+
+#include <messages/kinect_messages.h>
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+#include <messages/container_messages.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+
+#include <kinect_common/synthetic_frame_source.h>
+
+typedef std::chrono::steady_clock _Clock;
+
+typedef SyntheticFrameSource::_ColorImageMessage _ColorImageMsg;
+typedef SyntheticFrameSource::_DepthImageMessage _DepthImageMsg;
+typedef SyntheticFrameSource::_InfraredImageMessage _InfraredImageMsg;
+typedef SyntheticFrameSource::_AudioMessage _AudioMsg;
+typedef SyntheticFrameSource::_BodiesMessage _BodiesMsg;
+typedef SyntheticFrameSource::_SpeechMessage _SpeechMsg;
+typedef VectorMessage<KinectJointMessage> _JointsMsg;
+typedef TupleMessage<_BodiesMsg, _SpeechMsg> _TupleMsg;
+
+typedef CodecInterface<CodedMessage<> > _Codec;
+
+// ####################################################################################################
+// every allocation made through operator new (and so by every standard container) in this process
+std::atomic<uint64_t> num_allocations_( 0 );
+
+void * operator new( size_t size )
+{
+    num_allocations_.fetch_add( 1, std::memory_order_relaxed );
+    void * ptr = std::malloc( size > 0 ? size : 1 );
+    if( !ptr ) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete( void * ptr ) noexcept
+{
+    std::free( ptr );
+}
+
+// ####################################################################################################
+struct BenchmarkResult
+{
+    std::string name_;
+    std::string operation_;
+    std::string message_;
+    std::string codec_;
+    int level_;
+
+    uint64_t num_iterations_;
+    double seconds_;
+    uint64_t raw_bytes_;
+    uint64_t packed_bytes_;
+    uint64_t num_allocations_;
+
+    double nsPerOp() const
+    {
+        return seconds_ * 1e9 / num_iterations_;
+    }
+
+    double messagesPerSecond() const
+    {
+        return num_iterations_ / seconds_;
+    }
+
+    double mbPerSecond() const
+    {
+        return raw_bytes_ * messagesPerSecond() / 1e6;
+    }
+
+    double allocationsPerOp() const
+    {
+        return static_cast<double>( num_allocations_ ) / num_iterations_;
+    }
+};
+
+// ####################################################################################################
+class BenchmarkRunner
+{
+public:
+    // runs one operation; returns the packed size it produced or consumed
+    typedef std::function<uint64_t()> _Operation;
+
+protected:
+    double min_time_;
+    uint64_t min_iterations_;
+    std::string filter_;
+    std::vector<BenchmarkResult> results_;
+
+public:
+    BenchmarkRunner( double min_time, uint64_t min_iterations, std::string const & filter )
+    :
+        min_time_( min_time ),
+        min_iterations_( min_iterations ),
+        filter_( filter )
+    {
+        //
+    }
+
+    // repeat the operation for at least min_time seconds and min_iterations times, after one untimed run to warm up
+    void run( std::string const & operation, std::string const & message, std::string const & codec, int level, uint64_t raw_bytes, _Operation const & fn )
+    {
+        std::string name = codec + "/" + message;
+        if( level >= 0 ) name += "/level_" + std::to_string( level );
+        name += "/" + operation;
+
+        if( !filter_.empty() && name.find( filter_ ) == std::string::npos ) return;
+
+        BenchmarkResult result;
+        result.name_ = name;
+        result.operation_ = operation;
+        result.message_ = message;
+        result.codec_ = codec;
+        result.level_ = level;
+        result.raw_bytes_ = raw_bytes;
+        result.packed_bytes_ = fn();
+
+        uint64_t const start_allocations = num_allocations_.load();
+        auto const start_time = _Clock::now();
+
+        double elapsed = 0;
+        uint64_t num_iterations = 0;
+        while( elapsed < min_time_ || num_iterations < min_iterations_ )
+        {
+            fn();
+            ++num_iterations;
+            elapsed = std::chrono::duration<double>( _Clock::now() - start_time ).count();
+        }
+
+        result.num_allocations_ = num_allocations_.load() - start_allocations;
+        result.num_iterations_ = num_iterations;
+        result.seconds_ = elapsed;
+
+        std::cerr << std::setw( 40 ) << std::left << name << std::right << std::fixed << std::setprecision( 1 )
+            << std::setw( 12 ) << result.nsPerOp() / 1000 << " us" << std::setw( 10 ) << result.mbPerSecond() << " MB/s"
+            << std::setw( 10 ) << result.allocationsPerOp() << " allocs" << std::endl;
+
+        results_.push_back( result );
+    }
+
+    void writeJSON( std::ostream & out ) const
+    {
+        out << "{\n  \"benchmark\": \"bench_messages\",\n  \"min_time_s\": " << min_time_ << ",\n  \"results\": [";
+
+        for( auto result_it = results_.begin(); result_it != results_.end(); ++result_it )
+        {
+            out << ( result_it == results_.begin() ? "\n" : ",\n" )
+                << "    { \"name\": \"" << result_it->name_ << "\", \"operation\": \"" << result_it->operation_ << "\", \"message\": \"" << result_it->message_
+                << "\", \"codec\": \"" << result_it->codec_ << "\", \"level\": " << result_it->level_
+                << ", \"iterations\": " << result_it->num_iterations_ << ", \"seconds\": " << result_it->seconds_
+                << ", \"ns_per_op\": " << result_it->nsPerOp() << ", \"messages_per_s\": " << result_it->messagesPerSecond()
+                << ", \"mb_per_s\": " << result_it->mbPerSecond() << ", \"raw_bytes\": " << result_it->raw_bytes_
+                << ", \"packed_bytes\": " << result_it->packed_bytes_ << ", \"allocations_per_op\": " << result_it->allocationsPerOp() << " }";
+        }
+
+        out << "\n  ]\n}\n";
+    }
+};
+
+// ####################################################################################################
+// the same archives MessageCoder uses
+template<class __Message>
+uint64_t pack( __Message & message, std::stringstream & archive )
+{
+    archive.str( std::string() );
+    atomics::BinaryOutputStream writer( archive, atomics::BinaryOutputStream::NETWORK_BYTE_ORDER );
+    message.pack( writer );
+    writer.flush();
+    return static_cast<uint64_t>( archive.tellp() );
+}
+
+template<class __Message>
+std::string pack( __Message & message )
+{
+    std::stringstream archive;
+    pack( message, archive );
+    return archive.str();
+}
+
+template<class __Message>
+uint64_t unpack( __Message & message, std::string const & bytes )
+{
+    Poco::MemoryInputStream archive( bytes.data(), bytes.size() );
+    atomics::BinaryInputStream reader( archive, atomics::BinaryInputStream::NETWORK_BYTE_ORDER );
+    message.unpack( reader );
+    return bytes.size();
+}
+
+// pack and unpack a message that can do both
+template<class __Message>
+void benchmarkMessage( BenchmarkRunner & runner, std::string const & message_name, std::string const & codec_name, int level, uint64_t raw_bytes, __Message & message )
+{
+    std::stringstream archive;
+    runner.run( "pack", message_name, codec_name, level, raw_bytes, [&](){ return pack( message, archive ); } );
+
+    std::string const bytes = pack( message );
+    __Message unpacked_message;
+    runner.run( "unpack", message_name, codec_name, level, raw_bytes, [&](){ return unpack( unpacked_message, bytes ); } );
+}
+
+// an image at every PNG compression level
+template<class __Message>
+void benchmarkImage( BenchmarkRunner & runner, std::string const & message_name, __Message & message )
+{
+    uint64_t const raw_bytes = message.payload_.size_;
+
+    for( int level = 0; level <= 9; ++level )
+    {
+        message.compression_level_ = static_cast<uint8_t>( level );
+        benchmarkMessage( runner, message_name, "png", level, raw_bytes, message );
+    }
+
+    // back to the default the pipeline uses, for the codec benchmarks
+    message.compression_level_ = 2;
+}
+
+// encode and decode a packed message
+void benchmarkCodec( BenchmarkRunner & runner, std::string const & message_name, std::string const & codec_name, int level, _Codec & codec, uint32_t message_id, std::string const & bytes )
+{
+    BinaryMessage<> const binary_message( bytes.data(), static_cast<uint32_t>( bytes.size() ) );
+
+    runner.run( "encode", message_name, codec_name, level, bytes.size(), [&](){ return codec.encode( message_id, binary_message ).payload_.size_; } );
+
+    CodedMessage<> const coded_message = codec.encode( message_id, binary_message );
+    runner.run( "decode", message_name, codec_name, level, bytes.size(), [&](){ codec.decode( coded_message ); return static_cast<uint64_t>( coded_message.payload_.size_ ); } );
+}
+
+// ####################################################################################################
+int main( int argc, char ** argv )
+{
+    double min_time( 0.5 );
+    uint64_t min_iterations( 1 );
+    std::string filter;
+    std::string output_filename;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            std::cout << "usage: bench_messages [options]" << std::endl;
+            std::cout << "options: " << std::endl;
+            std::cout << "  --min-time <seconds> (time each benchmark for at least this long; default: 0.5)" << std::endl;
+            std::cout << "  --min-iterations <count> (and at least this many times; default: 1)" << std::endl;
+            std::cout << "  --filter <text> (only run benchmarks whose name contains this, eg: gzip, png/color, /unpack)" << std::endl;
+            std::cout << "  --output <json file> (default: stdout)" << std::endl;
+            return 0;
+        }
+        else if( arg == "--min-time" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> min_time;
+        }
+        else if( arg == "--min-iterations" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> min_iterations;
+        }
+        else if( arg == "--filter" && i + 1 < argc )
+        {
+            filter = argv[++i];
+        }
+        else if( arg == "--output" && i + 1 < argc )
+        {
+            output_filename = argv[++i];
+        }
+        else
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // one frame of each stream, at the sensor's sizes
+    SyntheticFrameSource source;
+    source.initialize();
+
+    _ColorImageMsg color_message;
+    _DepthImageMsg depth_message;
+    _InfraredImageMsg infrared_message;
+    _AudioMsg audio_message;
+    _BodiesMsg bodies_message;
+    _SpeechMsg speech_message;
+
+    source.pullColorImage( color_message );
+    source.pullDepthImage( depth_message );
+    source.pullInfraredImage( infrared_message );
+    source.pullAudio( audio_message );
+    source.pullBodies( bodies_message );
+    source.pullSpeech( speech_message );
+
+    // every joint of every body, as one flat vector
+    _JointsMsg joints_message;
+    for( size_t body_idx = 0; body_idx < bodies_message.payload_.size(); ++body_idx )
+    {
+        auto const & joints = bodies_message.payload_[body_idx].joints_;
+        for( auto joint_it = joints.begin(); joint_it != joints.end(); ++joint_it )
+        {
+            joints_message.push_back( KinectJointMessage( *joint_it ) );
+        }
+    }
+
+    _TupleMsg tuple_message( bodies_message, speech_message );
+
+    BenchmarkRunner runner( min_time, min_iterations, filter );
+
+    try
+    {
+        benchmarkImage( runner, "color", color_message );
+        benchmarkImage( runner, "depth", depth_message );
+        benchmarkImage( runner, "infrared", infrared_message );
+
+        std::stringstream archive;
+        runner.run( "pack", "audio", "wav", -1, audio_message.payload_.size_, [&](){ return pack( audio_message, archive ); } );
+
+        benchmarkMessage( runner, "bodies", "message", -1, pack( bodies_message ).size(), bodies_message );
+        benchmarkMessage( runner, "speech", "message", -1, pack( speech_message ).size(), speech_message );
+        benchmarkMessage( runner, "joints_vector", "message", -1, pack( joints_message ).size(), joints_message );
+        benchmarkMessage( runner, "bodies_speech_tuple", "message", -1, pack( tuple_message ).size(), tuple_message );
+
+        // the codecs see messages already packed, as the pipeline hands them over
+        std::vector<std::pair<std::string, std::pair<uint32_t, std::string> > > const packed_messages
+        {
+            { "color", { _ColorImageMsg::ID(), pack( color_message ) } },
+            { "depth", { _DepthImageMsg::ID(), pack( depth_message ) } },
+            { "infrared", { _InfraredImageMsg::ID(), pack( infrared_message ) } },
+            { "audio", { _AudioMsg::ID(), pack( audio_message ) } },
+            { "bodies", { _BodiesMsg::ID(), pack( bodies_message ) } },
+            { "speech", { _SpeechMsg::ID(), pack( speech_message ) } }
+        };
+
+        BinaryCodec<> binary_codec;
+        for( auto packed_it = packed_messages.begin(); packed_it != packed_messages.end(); ++packed_it )
+        {
+            benchmarkCodec( runner, packed_it->first, "binary", -1, binary_codec, packed_it->second.first, packed_it->second.second );
+        }
+
+        for( int level : { 1, 2, 6, 9 } )
+        {
+            GZipCodec<> gzip_codec( static_cast<uint8_t>( level ) );
+            for( auto packed_it = packed_messages.begin(); packed_it != packed_messages.end(); ++packed_it )
+            {
+                benchmarkCodec( runner, packed_it->first, "gzip", level, gzip_codec, packed_it->second.first, packed_it->second.second );
+            }
+        }
+    }
+    catch( std::exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if( output_filename.empty() )
+    {
+        runner.writeJSON( std::cout );
+        return 0;
+    }
+
+    std::ofstream output( output_filename.c_str() );
+    runner.writeJSON( output );
+    if( !output )
+    {
+        std::cerr << "failed to write " << output_filename << std::endl;
+        return 1;
+    }
+
+    std::cerr << "wrote " << output_filename << std::endl;
+    return 0;
+}
@@ -0,0 +1,449 @@
+// end-to-end throughput and latency of OutputTCPDevice -> InputTCPDevice over loopback, in one process with no sensor: a sender thread
+// pushes a mix of pre-encoded messages, each with a LatencyTraceMessage extension stamped just before the push (as kinect_server does
+// with --trace-latency), and the receiving thread pulls them (as kinect_client does) and stamps them on arrival. both ends read the same
+// steady clock, so the difference is the one-way latency through the devices, the codec framing, and the kernel
+//
+// the mix is a comma-separated list of <kind>[:<weight>], sent round-robin in proportion to the weights, where kind is one of the
+// sensor's streams (color, depth, infrared, audio, bodies, speech; synthetic frames encoded the way the pipeline encodes them) or a size
+// in bytes (eg: 512, 64k, 4m) for an incompressible payload of that size
+//
+// progress goes to stderr and the results to stdout (or --output) as JSON:
+//
+//   { "benchmark": "bench_tcp_loopback", "mix", "rate", "warmup_s", "duration_s", "messages_sent", "messages_received",
+//     "results": [ { "name", "messages", "bytes", "seconds", "messages_per_s", "mb_per_s",
+//                    "latency_us": { "mean", "p50", "p90", "p99", "p999", "max" } }, ... ] }
+//
+// with one result per kind in the mix, then "all". only messages sent after the warm-up are counted; bytes are the encoded payloads (as
+// in kinect_stream_encoded_bytes_total) and mb_per_s is in 10^6 bytes. with --rate 0 the sender pushes as fast as the socket takes
+// messages, which measures peak throughput but leaves latency dominated by the socket buffers; give a rate for latency under a set load
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <cstdint>
+
+#include <atomics/histogram.h>
+
+#include <messages/kinect_messages.h>
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+#include <messages/message_coder.h>
+#include <messages/message_extensions.h>
+#include <messages/latency_trace_message.h>
+#include <messages/output_tcp_device.h>
+#include <messages/input_tcp_device.h>
+
+#include <kinect_common/synthetic_frame_source.h>
+
+typedef std::chrono::steady_clock _Clock;
+typedef LatencyTraceMessage::Stage _Stage;
+
+typedef SyntheticFrameSource::_ColorImageMessage _ColorImageMsg;
+typedef SyntheticFrameSource::_DepthImageMessage _DepthImageMsg;
+typedef SyntheticFrameSource::_InfraredImageMessage _InfraredImageMsg;
+typedef SyntheticFrameSource::_AudioMessage _AudioMsg;
+typedef SyntheticFrameSource::_BodiesMessage _BodiesMsg;
+typedef SyntheticFrameSource::_SpeechMessage _SpeechMsg;
+
+typedef CodedMessage<> _CodedMsg;
+
+// ####################################################################################################
+// one kind of message in the mix, and what the receiver saw of it after the warm-up
+struct MixEntry
+{
+    std::string name_;
+    uint32_t weight_;
+    _CodedMsg message_;
+
+    uint64_t num_messages_;
+    uint64_t bytes_;
+    // one-way latency, in nanoseconds
+    atomics::Histogram latency_;
+
+    MixEntry( std::string const & name, uint32_t weight, _CodedMsg && message )
+    :
+        name_( name ),
+        weight_( weight ),
+        message_( std::move( message ) ),
+        num_messages_( 0 ),
+        bytes_( 0 )
+    {
+        //
+    }
+
+    void record( uint64_t bytes, uint64_t latency )
+    {
+        ++num_messages_;
+        bytes_ += bytes;
+        latency_.record( latency );
+    }
+};
+
+typedef std::vector<std::unique_ptr<MixEntry> > _Mix;
+
+// ####################################################################################################
+// a size in bytes, with an optional k or m suffix (powers of 1024); 0 if the text isn't one
+uint64_t parseSize( std::string const & text )
+{
+    std::stringstream ss( text );
+    uint64_t size = 0;
+    if( !( ss >> size ) ) return 0;
+
+    std::string suffix;
+    ss >> suffix;
+    if( suffix == "k" || suffix == "K" ) size *= 1024;
+    else if( suffix == "m" || suffix == "M" ) size *= 1024 * 1024;
+    else if( !suffix.empty() ) return 0;
+
+    return size;
+}
+
+// the sensor's streams, encoded as buildKinectPipeline() encodes them: images as PNG at level 1, audio gzipped at level 1, the rest as is
+_CodedMsg encodeStream( std::string const & stream_name, SyntheticFrameSource & source )
+{
+    MessageCoder<BinaryCodec<> > binary_coder;
+    MessageCoder<GZipCodec<> > gzip_coder( 1 );
+
+    if( stream_name == "color" )
+    {
+        _ColorImageMsg message;
+        source.pullColorImage( message );
+        message.compression_level_ = 1;
+        return binary_coder.encode( message );
+    }
+    if( stream_name == "depth" )
+    {
+        _DepthImageMsg message;
+        source.pullDepthImage( message );
+        message.compression_level_ = 1;
+        return binary_coder.encode( message );
+    }
+    if( stream_name == "infrared" )
+    {
+        _InfraredImageMsg message;
+        source.pullInfraredImage( message );
+        message.compression_level_ = 1;
+        return binary_coder.encode( message );
+    }
+    if( stream_name == "audio" )
+    {
+        _AudioMsg message;
+        source.pullAudio( message );
+        return gzip_coder.encode( message );
+    }
+    if( stream_name == "bodies" )
+    {
+        _BodiesMsg message;
+        source.pullBodies( message );
+        return binary_coder.encode( message );
+    }
+    if( stream_name == "speech" )
+    {
+        _SpeechMsg message;
+        source.pullSpeech( message );
+        return binary_coder.encode( message );
+    }
+
+    throw std::invalid_argument( "unknown message kind: " + stream_name );
+}
+
+// throws std::invalid_argument for a kind that's neither a stream nor a size, a bad weight, or a kind listed twice
+_Mix parseMix( std::string const & mix_spec, SyntheticFrameSource & source )
+{
+    _Mix mix;
+    std::mt19937 random_engine( 0 );
+
+    std::stringstream ss( mix_spec );
+    std::string item;
+    while( std::getline( ss, item, ',' ) )
+    {
+        if( item.empty() ) continue;
+
+        std::string kind = item;
+        uint32_t weight = 1;
+
+        size_t const colon_pos = item.find( ':' );
+        if( colon_pos != std::string::npos )
+        {
+            kind = item.substr( 0, colon_pos );
+            std::stringstream weight_ss( item.substr( colon_pos + 1 ) );
+            if( !( weight_ss >> weight ) || weight == 0 ) throw std::invalid_argument( "bad weight in mix: " + item );
+        }
+
+        for( auto entry_it = mix.begin(); entry_it != mix.end(); ++entry_it )
+        {
+            if( ( *entry_it )->name_ == kind ) throw std::invalid_argument( "listed twice in mix: " + kind );
+        }
+
+        uint64_t const size = parseSize( kind );
+        if( size == 0 )
+        {
+            mix.emplace_back( new MixEntry( kind, weight, encodeStream( kind, source ) ) );
+            continue;
+        }
+
+        // random bytes, so a transport that compresses can't make them smaller; the receiver tells sizes apart by payload id, and small
+        // numbers never collide with a message's hashed ID()
+        std::string bytes( static_cast<size_t>( size ), '\0' );
+        for( auto byte_it = bytes.begin(); byte_it != bytes.end(); ++byte_it )
+        {
+            *byte_it = static_cast<char>( random_engine() );
+        }
+
+        BinaryCodec<> binary_codec;
+        uint32_t const payload_id = static_cast<uint32_t>( mix.size() + 1 );
+        mix.emplace_back( new MixEntry( kind, weight, binary_codec.encode( payload_id, BinaryMessage<>( bytes.data(), static_cast<uint32_t>( bytes.size() ) ) ) ) );
+    }
+
+    if( mix.empty() ) throw std::invalid_argument( "empty mix" );
+
+    return mix;
+}
+
+// ####################################################################################################
+void writeResult( std::ostream & out, std::string const & name, uint64_t num_messages, uint64_t bytes, double seconds, atomics::Histogram const & latency )
+{
+    double const messages_per_s = seconds > 0 ? num_messages / seconds : 0;
+    double const mb_per_s = seconds > 0 ? bytes / seconds / 1e6 : 0;
+
+    out << "    { \"name\": \"" << name << "\", \"messages\": " << num_messages << ", \"bytes\": " << bytes << ", \"seconds\": " << seconds
+        << ", \"messages_per_s\": " << messages_per_s << ", \"mb_per_s\": " << mb_per_s
+        << ", \"latency_us\": { \"mean\": " << latency.mean() / 1000 << ", \"p50\": " << latency.percentile( 0.5 ) / 1000.0
+        << ", \"p90\": " << latency.percentile( 0.9 ) / 1000.0 << ", \"p99\": " << latency.percentile( 0.99 ) / 1000.0
+        << ", \"p999\": " << latency.percentile( 0.999 ) / 1000.0 << ", \"max\": " << latency.max() / 1000.0 << " } }";
+
+    std::cerr << std::setw( 12 ) << std::left << name << std::right << std::fixed << std::setprecision( 1 )
+        << std::setw( 12 ) << messages_per_s << " msg/s" << std::setw( 10 ) << mb_per_s << " MB/s"
+        << "  latency us p50: " << latency.percentile( 0.5 ) / 1000.0 << " p99: " << latency.percentile( 0.99 ) / 1000.0
+        << " p999: " << latency.percentile( 0.999 ) / 1000.0 << " max: " << latency.max() / 1000.0 << std::endl;
+}
+
+// ####################################################################################################
+int main( int argc, char ** argv )
+{
+    std::string mix_spec( "color,depth,infrared,audio,bodies" );
+    double rate( 0 );
+    double warmup( 1 );
+    double duration( 5 );
+    uint16_t port( 0 );
+    std::string output_filename;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            std::cout << "usage: bench_tcp_loopback [options]" << std::endl;
+            std::cout << "options: " << std::endl;
+            std::cout << "  --mix <kind[:weight],...> (streams: color, depth, infrared, audio, bodies, speech; or sizes, eg: 512, 64k, 4m; default: color,depth,infrared,audio,bodies)" << std::endl;
+            std::cout << "  --rate <messages/s> (over the whole mix; 0 sends as fast as possible; default: 0)" << std::endl;
+            std::cout << "  --warmup <seconds> (sent but not counted; default: 1)" << std::endl;
+            std::cout << "  --duration <seconds> (counted; default: 5)" << std::endl;
+            std::cout << "  --port <port> (on 127.0.0.1; default: any free port)" << std::endl;
+            std::cout << "  --output <json file> (default: stdout)" << std::endl;
+            return 0;
+        }
+        else if( arg == "--mix" && i + 1 < argc )
+        {
+            mix_spec = argv[++i];
+        }
+        else if( arg == "--rate" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> rate;
+        }
+        else if( arg == "--warmup" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> warmup;
+        }
+        else if( arg == "--duration" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> duration;
+        }
+        else if( arg == "--port" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> port;
+        }
+        else if( arg == "--output" && i + 1 < argc )
+        {
+            output_filename = argv[++i];
+        }
+        else
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    SyntheticFrameSource source;
+    source.initialize();
+
+    _Mix mix;
+    try
+    {
+        mix = parseMix( mix_spec, source );
+    }
+    catch( std::exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::map<uint32_t, MixEntry *> entries_by_id;
+    std::vector<MixEntry *> schedule;
+    for( auto entry_it = mix.begin(); entry_it != mix.end(); ++entry_it )
+    {
+        entries_by_id[( *entry_it )->message_.header_.payload_id_] = entry_it->get();
+        schedule.insert( schedule.end(), ( *entry_it )->weight_, entry_it->get() );
+    }
+
+    // the devices report their connections on stdout; keep that out of the results
+    std::streambuf * const stdout_buf = std::cout.rdbuf( std::cerr.rdbuf() );
+
+    uint64_t num_sent = 0;
+    uint64_t num_received = 0;
+    double seconds = 0;
+    atomics::Histogram all_latency;
+
+    try
+    {
+        std::string const address( "127.0.0.1" );
+        OutputTCPDevice output_device( address, port );
+        port = output_device.server_socket_.address().port();
+
+        auto const start_time = _Clock::now();
+        auto const warmup_end_time = start_time + std::chrono::duration_cast<_Clock::duration>( std::chrono::duration<double>( warmup ) );
+        auto const end_time = warmup_end_time + std::chrono::duration_cast<_Clock::duration>( std::chrono::duration<double>( duration ) );
+        uint64_t const warmup_end = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( warmup_end_time.time_since_epoch() ).count() );
+
+        std::atomic<uint64_t> last_receive( 0 );
+
+        // pull until the sender's empty end message, counting whatever was sent after the warm-up
+        std::thread receive_thread(
+            [&]()
+            {
+                try
+                {
+                    InputTCPDevice input_device( address, port );
+
+                    while( true )
+                    {
+                        ExtendedMessage<_CodedMsg> message;
+                        input_device.pull( message );
+
+                        LatencyTraceMessage trace;
+                        bool const traced = message.extensions_.get( trace );
+                        trace.mark( _Stage::RECEIVE );
+
+                        if( message.header_.payload_id_ == 0 ) break;
+
+                        ++num_received;
+                        if( !traced || trace.stamp( _Stage::SEND ) < warmup_end ) continue;
+
+                        auto const entry_it = entries_by_id.find( message.header_.payload_id_ );
+                        if( entry_it == entries_by_id.end() ) continue;
+
+                        uint64_t const latency = static_cast<uint64_t>( trace.elapsed( _Stage::SEND, _Stage::RECEIVE ) );
+                        entry_it->second->record( message.payload_.size_, latency );
+                        all_latency.record( latency );
+                        last_receive = trace.stamp( _Stage::RECEIVE );
+                    }
+                }
+                catch( std::exception & e )
+                {
+                    std::cerr << "receiver: " << e.what() << std::endl;
+                }
+            }
+        );
+
+        std::cerr << "sending over 127.0.0.1:" << port << " for " << warmup << " + " << duration << " s" << std::endl;
+
+        MessageExtensions extensions;
+        LatencyTraceMessage trace;
+        while( _Clock::now() < end_time )
+        {
+            if( rate > 0 ) std::this_thread::sleep_until( start_time + std::chrono::duration_cast<_Clock::duration>( std::chrono::duration<double>( num_sent / rate ) ) );
+
+            MixEntry & entry = *schedule[num_sent % schedule.size()];
+
+            trace.mark( _Stage::SEND );
+            extensions.set( trace );
+            output_device.push( entry.message_, extensions );
+
+            ++num_sent;
+        }
+
+        _CodedMsg end_message;
+        output_device.push( end_message );
+
+        receive_thread.join();
+
+        seconds = last_receive > warmup_end ? ( last_receive - warmup_end ) / 1e9 : 0;
+    }
+    catch( std::exception & e )
+    {
+        std::cout.rdbuf( stdout_buf );
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout.rdbuf( stdout_buf );
+
+    std::stringstream results;
+    results << "{\n  \"benchmark\": \"bench_tcp_loopback\",\n  \"mix\": \"" << mix_spec << "\",\n  \"rate\": " << rate << ",\n  \"warmup_s\": " << warmup
+        << ",\n  \"duration_s\": " << duration << ",\n  \"messages_sent\": " << num_sent << ",\n  \"messages_received\": " << num_received
+        << ",\n  \"results\": [\n";
+
+    uint64_t all_messages = 0;
+    uint64_t all_bytes = 0;
+    for( auto entry_it = mix.begin(); entry_it != mix.end(); ++entry_it )
+    {
+        MixEntry const & entry = **entry_it;
+        writeResult( results, entry.name_, entry.num_messages_, entry.bytes_, seconds, entry.latency_ );
+        results << ",\n";
+
+        all_messages += entry.num_messages_;
+        all_bytes += entry.bytes_;
+    }
+    writeResult( results, "all", all_messages, all_bytes, seconds, all_latency );
+    results << "\n  ]\n}\n";
+
+    if( rate > 0 && num_sent < 0.95 * rate * ( warmup + duration ) ) std::cerr << "warning: the sender couldn't keep up with " << rate << " messages/s" << std::endl;
+    if( num_received != num_sent ) std::cerr << "warning: sent " << num_sent << " messages but received " << num_received << std::endl;
+
+    if( output_filename.empty() )
+    {
+        std::cout << results.str();
+        return 0;
+    }
+
+    std::ofstream output( output_filename.c_str() );
+    output << results.str();
+    if( !output )
+    {
+        std::cerr << "failed to write " << output_filename << std::endl;
+        return 1;
+    }
+
+    std::cerr << "wrote " << output_filename << std::endl;
+    return 0;
+}
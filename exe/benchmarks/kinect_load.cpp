@@ -0,0 +1,496 @@
+// load generator for kinect_server: opens any number of client connections, each an InputTCPDevice pulling messages the way kinect_client
+// does, but reading at its own pace, and reports what each one got. groups of clients are given with --clients <count>[:<setting>...]:
+//
+//   read=<bytes/s>           read no faster than this (eg: 500k, 2m), so the socket fills up and the server has to wait on us
+//   pause=<seconds>/<every>  stop reading for the given time out of every period, staggered across the group
+//   stall                    connect, but never read
+//   churn=<seconds>          hang up and reconnect after this long connected
+//
+// eg: --clients 4 --clients 1:read=1m --clients 1:pause=2/10 --clients 2:churn=5
+//
+// progress goes to stderr every --report seconds and the results to stdout (or --output) as JSON:
+//
+//   { "tool": "kinect_load", "server", "duration_s", "clients": [ { "client", "profile", "connects", "connect_failures", "disconnects",
+//     "connected_s", "messages", "bytes", "messages_per_s", "mb_per_s", "dropped", "drop_ratio",
+//     "latency_us": { "count", "mean", "p50", "p99", "p999", "max" } }, ... ], "total": { ... } }
+//
+// rates are over the whole run and bytes are the encoded payloads, in 10^6 bytes for mb_per_s. latency and drops need the server run
+// with --trace: latency is capture to receive, so only means something with the server on this machine, and dropped counts the gaps in
+// each stream's sequence numbers while connected, whether the server dropped those messages for us or for some other client
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include <Poco/Timespan.h>
+
+#include <atomics/histogram.h>
+
+#include <messages/codec.h>
+#include <messages/message_extensions.h>
+#include <messages/latency_trace_message.h>
+#include <messages/stream_sequence_message.h>
+#include <messages/input_tcp_device.h>
+
+typedef std::chrono::steady_clock _Clock;
+typedef LatencyTraceMessage::Stage _Stage;
+
+// ####################################################################################################
+// how one group of clients reads
+struct ClientProfile
+{
+    std::string spec_;
+    uint32_t num_clients_;
+    // bytes per second; 0 for as fast as the server sends
+    double read_rate_;
+    double pause_;
+    double pause_period_;
+    bool stall_;
+    double churn_;
+
+    ClientProfile()
+    :
+        num_clients_( 1 ),
+        read_rate_( 0 ),
+        pause_( 0 ),
+        pause_period_( 0 ),
+        stall_( false ),
+        churn_( 0 )
+    {
+        //
+    }
+
+    // whether a client pausing at the given phase (0 to 1, through each period) is paused after this long connected
+    bool paused( double connected_seconds, double phase ) const
+    {
+        if( stall_ ) return true;
+        if( pause_ <= 0 || pause_period_ <= 0 ) return false;
+
+        double const offset = connected_seconds + phase * pause_period_;
+        return offset - pause_period_ * static_cast<uint64_t>( offset / pause_period_ ) >= pause_period_ - pause_;
+    }
+};
+
+// bytes per second, with an optional k or m suffix (powers of 1024)
+double parseRate( std::string const & text )
+{
+    std::stringstream ss( text );
+    double rate = 0;
+    if( !( ss >> rate ) || rate <= 0 ) throw std::invalid_argument( "bad read rate: " + text );
+
+    std::string suffix;
+    ss >> suffix;
+    if( suffix == "k" || suffix == "K" ) rate *= 1024;
+    else if( suffix == "m" || suffix == "M" ) rate *= 1024 * 1024;
+    else if( !suffix.empty() ) throw std::invalid_argument( "bad read rate: " + text );
+
+    return rate;
+}
+
+// <count>[:<setting>...]; throws std::invalid_argument for anything else
+ClientProfile parseProfile( std::string const & spec )
+{
+    ClientProfile profile;
+
+    std::stringstream ss( spec );
+    std::string item;
+    std::getline( ss, item, ':' );
+
+    std::stringstream count_ss( item );
+    if( !( count_ss >> profile.num_clients_ ) || profile.num_clients_ == 0 ) throw std::invalid_argument( "bad client count: " + spec );
+
+    while( std::getline( ss, item, ':' ) )
+    {
+        size_t const equals_pos = item.find( '=' );
+        std::string const setting = item.substr( 0, equals_pos );
+        std::string const value = equals_pos != std::string::npos ? item.substr( equals_pos + 1 ) : "";
+
+        if( setting == "read" ) profile.read_rate_ = parseRate( value );
+        else if( setting == "stall" ) profile.stall_ = true;
+        else if( setting == "pause" )
+        {
+            std::stringstream pause_ss( value );
+            char separator = 0;
+            if( !( pause_ss >> profile.pause_ >> separator >> profile.pause_period_ ) || separator != '/' || profile.pause_ <= 0 || profile.pause_period_ <= profile.pause_ )
+            {
+                throw std::invalid_argument( "bad pause (want <seconds>/<every seconds>): " + value );
+            }
+        }
+        else if( setting == "churn" )
+        {
+            std::stringstream churn_ss( value );
+            if( !( churn_ss >> profile.churn_ ) || profile.churn_ <= 0 ) throw std::invalid_argument( "bad churn: " + value );
+        }
+        else throw std::invalid_argument( "unknown client setting: " + item );
+    }
+
+    size_t const colon_pos = spec.find( ':' );
+    profile.spec_ = colon_pos != std::string::npos ? spec.substr( colon_pos + 1 ) : "";
+
+    return profile;
+}
+
+// ####################################################################################################
+// one connection to the server, pulling on its own thread until stopped; counters may be read from any thread meanwhile
+class LoadClient
+{
+protected:
+    uint32_t id_;
+    ClientProfile profile_;
+    // where in each pause period this client starts, so a group doesn't pause in lockstep
+    double phase_;
+
+    std::atomic<uint64_t> num_connects_;
+    std::atomic<uint64_t> num_connect_failures_;
+    std::atomic<uint64_t> num_disconnects_;
+    std::atomic<uint64_t> num_messages_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> num_dropped_;
+    std::atomic<uint64_t> connected_time_;
+    std::atomic<bool> connected_;
+
+    // capture to receive, in nanoseconds
+    atomics::Histogram latency_;
+
+    // the sequence number we expect next from each stream (payload id) on the current connection
+    std::map<uint32_t, uint64_t> next_sequence_;
+
+public:
+    LoadClient( uint32_t id, ClientProfile const & profile, double phase )
+    :
+        id_( id ),
+        profile_( profile ),
+        phase_( phase ),
+        num_connects_( 0 ),
+        num_connect_failures_( 0 ),
+        num_disconnects_( 0 ),
+        num_messages_( 0 ),
+        bytes_( 0 ),
+        num_dropped_( 0 ),
+        connected_time_( 0 ),
+        connected_( false )
+    {
+        //
+    }
+
+    void run( std::string const & host, uint16_t port, std::atomic<bool> const & running )
+    {
+        InputTCPDevice input_device;
+
+        while( running )
+        {
+            try
+            {
+                input_device.openInput( host, port );
+            }
+            catch( std::exception & )
+            {
+                ++num_connect_failures_;
+                std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+                continue;
+            }
+
+            ++num_connects_;
+            connected_ = true;
+            next_sequence_.clear();
+
+            auto const connect_time = _Clock::now();
+            double connection_bytes = 0;
+            bool hung_up = false;
+
+            while( running )
+            {
+                double const connected_seconds = std::chrono::duration<double>( _Clock::now() - connect_time ).count();
+                if( profile_.churn_ > 0 && connected_seconds >= profile_.churn_ ) break;
+
+                if( profile_.paused( connected_seconds, phase_ ) )
+                {
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                    continue;
+                }
+
+                // whole messages at a time, so wait until we're under budget again
+                if( profile_.read_rate_ > 0 && connection_bytes > profile_.read_rate_ * connected_seconds )
+                {
+                    std::this_thread::sleep_for( std::chrono::duration<double>( std::min( connection_bytes / profile_.read_rate_ - connected_seconds, 0.01 ) ) );
+                    continue;
+                }
+
+                try
+                {
+                    // don't block in pull() unless something's coming, so we still notice when to stop
+                    if( !input_device.input_socket_.poll( Poco::Timespan( 100 * 1000 ), Poco::Net::Socket::SELECT_READ ) ) continue;
+
+                    ExtendedMessage<CodedMessage<> > message;
+                    input_device.pull( message );
+
+                    connection_bytes += message.payload_.size_;
+                    record( message );
+                }
+                catch( std::exception & )
+                {
+                    // the server hung up (pull() closes the input when it does, and the next read throws) or the connection broke
+                    hung_up = true;
+                    break;
+                }
+            }
+
+            connected_time_ += static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now() - connect_time ).count() );
+            connected_ = false;
+            if( hung_up ) ++num_disconnects_;
+
+            input_device.closeInput();
+        }
+    }
+
+    uint32_t id() const { return id_; }
+    ClientProfile const & profile() const { return profile_; }
+    uint64_t numConnects() const { return num_connects_; }
+    uint64_t numConnectFailures() const { return num_connect_failures_; }
+    uint64_t numDisconnects() const { return num_disconnects_; }
+    uint64_t numMessages() const { return num_messages_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t numDropped() const { return num_dropped_; }
+    double connectedSeconds() const { return connected_time_ / 1e9; }
+    bool connected() const { return connected_; }
+    atomics::Histogram const & latency() const { return latency_; }
+
+protected:
+    void record( ExtendedMessage<CodedMessage<> > const & message )
+    {
+        LatencyTraceMessage trace;
+        if( message.extensions_.get( trace ) )
+        {
+            trace.mark( _Stage::RECEIVE );
+            int64_t const latency = trace.elapsed( _Stage::CAPTURE, _Stage::RECEIVE );
+            if( latency >= 0 ) latency_.record( static_cast<uint64_t>( latency ) );
+        }
+
+        StreamSequenceMessage sequence_message;
+        if( message.extensions_.get( sequence_message ) )
+        {
+            uint64_t const sequence = sequence_message.sequence_;
+            auto const next_it = next_sequence_.find( message.header_.payload_id_ );
+
+            // a sequence number going backwards means the server restarted (or the replay looped); start counting again from there
+            if( next_it != next_sequence_.end() && sequence > next_it->second ) num_dropped_ += sequence - next_it->second;
+            next_sequence_[message.header_.payload_id_] = sequence + 1;
+        }
+
+        ++num_messages_;
+        bytes_ += message.payload_.size_;
+    }
+};
+
+// ####################################################################################################
+void writeClient( std::ostream & out, std::string const & name, std::string const & profile, uint64_t connects, uint64_t connect_failures, uint64_t disconnects,
+    double connected_seconds, uint64_t num_messages, uint64_t bytes, uint64_t dropped, double seconds, atomics::Histogram const & latency )
+{
+    out << name << ", \"profile\": \"" << profile << "\", \"connects\": " << connects << ", \"connect_failures\": " << connect_failures
+        << ", \"disconnects\": " << disconnects << ", \"connected_s\": " << connected_seconds << ", \"messages\": " << num_messages << ", \"bytes\": " << bytes
+        << ", \"messages_per_s\": " << ( seconds > 0 ? num_messages / seconds : 0 ) << ", \"mb_per_s\": " << ( seconds > 0 ? bytes / seconds / 1e6 : 0 )
+        << ", \"dropped\": " << dropped << ", \"drop_ratio\": " << ( num_messages + dropped > 0 ? static_cast<double>( dropped ) / ( num_messages + dropped ) : 0 )
+        << ", \"latency_us\": { \"count\": " << latency.count() << ", \"mean\": " << latency.mean() / 1000 << ", \"p50\": " << latency.percentile( 0.5 ) / 1000.0
+        << ", \"p99\": " << latency.percentile( 0.99 ) / 1000.0 << ", \"p999\": " << latency.percentile( 0.999 ) / 1000.0 << ", \"max\": " << latency.max() / 1000.0 << " } }";
+}
+
+// ####################################################################################################
+int main( int argc, char ** argv )
+{
+    std::string host( "localhost" );
+    uint16_t port( 5903 );
+    std::vector<ClientProfile> profiles;
+    double duration( 30 );
+    double report_interval( 5 );
+    bool verbose( false );
+    std::string output_filename;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            std::cout << "usage: kinect_load [options]" << std::endl;
+            std::cout << "options: " << std::endl;
+            std::cout << "  --host <hostname or ip> (default: localhost)" << std::endl;
+            std::cout << "  --port <port number> (default: 5903)" << std::endl;
+            std::cout << "  --clients <count>[:read=<bytes/s>][:pause=<seconds>/<every seconds>][:stall][:churn=<seconds>] (repeat for more groups; default: 1)" << std::endl;
+            std::cout << "  --duration <seconds> (default: 30)" << std::endl;
+            std::cout << "  --report <seconds> (between progress reports; default: 5, 0 for none)" << std::endl;
+            std::cout << "  --verbose (show the connections' own logging)" << std::endl;
+            std::cout << "  --output <json file> (default: stdout)" << std::endl;
+            return 0;
+        }
+        else if( arg == "--host" && i + 1 < argc )
+        {
+            host = argv[++i];
+        }
+        else if( arg == "--port" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> port;
+        }
+        else if( arg == "--clients" && i + 1 < argc )
+        {
+            try
+            {
+                profiles.push_back( parseProfile( argv[++i] ) );
+            }
+            catch( std::exception & e )
+            {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if( arg == "--duration" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> duration;
+        }
+        else if( arg == "--report" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> report_interval;
+        }
+        else if( arg == "--verbose" )
+        {
+            verbose = true;
+        }
+        else if( arg == "--output" && i + 1 < argc )
+        {
+            output_filename = argv[++i];
+        }
+        else
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if( profiles.empty() ) profiles.push_back( ClientProfile() );
+
+    std::vector<std::unique_ptr<LoadClient> > clients;
+    for( auto profile_it = profiles.begin(); profile_it != profiles.end(); ++profile_it )
+    {
+        for( uint32_t client_idx = 0; client_idx < profile_it->num_clients_; ++client_idx )
+        {
+            clients.emplace_back( new LoadClient( static_cast<uint32_t>( clients.size() ), *profile_it, static_cast<double>( client_idx ) / profile_it->num_clients_ ) );
+        }
+    }
+
+    // every connection logs its comings and goings to stdout; keep that out of the results, and unless asked for, out of the way
+    std::streambuf * const stdout_buf = std::cout.rdbuf( verbose ? std::cerr.rdbuf() : NULL );
+
+    std::cerr << "running " << clients.size() << " clients against " << host << ":" << port << " for " << duration << " s" << std::endl;
+
+    std::atomic<bool> running( true );
+    std::vector<std::thread> client_threads;
+    for( auto client_it = clients.begin(); client_it != clients.end(); ++client_it )
+    {
+        LoadClient * const client_ptr = client_it->get();
+        client_threads.emplace_back( [client_ptr, &host, port, &running](){ client_ptr->run( host, port, running ); } );
+    }
+
+    auto const start_time = _Clock::now();
+    auto const end_time = start_time + std::chrono::duration_cast<_Clock::duration>( std::chrono::duration<double>( duration ) );
+    auto last_report_time = start_time;
+    std::vector<std::pair<uint64_t, uint64_t> > last_counts( clients.size(), std::make_pair( 0, 0 ) );
+
+    while( _Clock::now() < end_time )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        if( report_interval <= 0 ) continue;
+
+        auto const now = _Clock::now();
+        double const elapsed = std::chrono::duration<double>( now - last_report_time ).count();
+        if( elapsed < report_interval ) continue;
+        last_report_time = now;
+
+        std::cerr << "after " << std::fixed << std::setprecision( 1 ) << std::chrono::duration<double>( now - start_time ).count() << " s:" << std::endl;
+        for( size_t client_idx = 0; client_idx < clients.size(); ++client_idx )
+        {
+            LoadClient const & client = *clients[client_idx];
+            uint64_t const num_messages = client.numMessages();
+            uint64_t const bytes = client.bytes();
+
+            std::cerr << "  client " << std::setw( 3 ) << client.id() << std::setw( 14 ) << ( client.connected() ? "connected" : "disconnected" )
+                << std::setw( 10 ) << ( num_messages - last_counts[client_idx].first ) / elapsed << " msg/s" << std::setw( 10 ) << ( bytes - last_counts[client_idx].second ) / elapsed / 1e6 << " MB/s"
+                << std::setw( 8 ) << client.numDropped() << " dropped" << "  p99 us: " << client.latency().percentile( 0.99 ) / 1000.0
+                << "  " << client.profile().spec_ << std::endl;
+
+            last_counts[client_idx] = std::make_pair( num_messages, bytes );
+        }
+    }
+
+    running = false;
+    for( auto thread_it = client_threads.begin(); thread_it != client_threads.end(); ++thread_it )
+    {
+        thread_it->join();
+    }
+
+    std::cout.rdbuf( stdout_buf );
+
+    double const seconds = std::chrono::duration<double>( _Clock::now() - start_time ).count();
+
+    std::stringstream results;
+    results << "{\n  \"tool\": \"kinect_load\",\n  \"server\": \"" << host << ":" << port << "\",\n  \"duration_s\": " << seconds << ",\n  \"clients\": [";
+
+    uint64_t num_connects = 0, num_connect_failures = 0, num_disconnects = 0, num_messages = 0, bytes = 0, num_dropped = 0;
+    double connected_seconds = 0;
+    atomics::Histogram latency;
+
+    for( auto client_it = clients.begin(); client_it != clients.end(); ++client_it )
+    {
+        LoadClient const & client = **client_it;
+
+        results << ( client_it == clients.begin() ? "\n" : ",\n" );
+        writeClient( results, "    { \"client\": " + std::to_string( client.id() ), client.profile().spec_, client.numConnects(), client.numConnectFailures(), client.numDisconnects(),
+            client.connectedSeconds(), client.numMessages(), client.bytes(), client.numDropped(), seconds, client.latency() );
+
+        num_connects += client.numConnects();
+        num_connect_failures += client.numConnectFailures();
+        num_disconnects += client.numDisconnects();
+        connected_seconds += client.connectedSeconds();
+        num_messages += client.numMessages();
+        bytes += client.bytes();
+        num_dropped += client.numDropped();
+
+        latency.merge( client.latency() );
+    }
+
+    results << "\n  ],\n";
+    writeClient( results, "  \"total\": { \"clients\": " + std::to_string( clients.size() ), "", num_connects, num_connect_failures, num_disconnects,
+        connected_seconds, num_messages, bytes, num_dropped, seconds, latency );
+    results << "\n}\n";
+
+    if( output_filename.empty() )
+    {
+        std::cout << results.str();
+        return 0;
+    }
+
+    std::ofstream output( output_filename.c_str() );
+    output << results.str();
+    if( !output )
+    {
+        std::cerr << "failed to write " << output_filename << std::endl;
+        return 1;
+    }
+
+    std::cerr << "wrote " << output_filename << std::endl;
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <thread>
 #include <chrono>
+#include <map>
 
 #include <Poco/Net/SocketAddress.h>
 #include <Poco/Net/StreamSocket.h>
@@ -13,6 +14,10 @@
 #include <messages/kinect_messages.h>
 #include <messages/binary_codec.h>
 #include <messages/message_coder.h>
+#include <messages/message_extensions.h>
+#include <messages/latency_trace_message.h>
+#include <messages/frame_bundle_message.h>
+#include <messages/subscription_message.h>
 
 #include <messages/input_tcp_device.h>
 
@@ -39,6 +44,10 @@ public:
     ros::Publisher kinect_bodies_pub_;
 
     InputTCPDevice kinect_bridge_client_;
+    // whether the server knows which streams we want over the current connection
+    bool subscribed_;
+    // bodies per second to ask the server for; 0 for every frame
+    float max_bodies_rate_;
 
     uint32_t message_count_;
 
@@ -46,17 +55,31 @@ public:
 
     tf::TransformBroadcaster transform_broadcaster_;
 
+    // per-stream latency of the messages the server sent with a trace (kinect_server --trace)
+    LatencyTraceStats latency_stats_;
+    std::map<uint32_t, std::string> stream_names_;
+
     KinectBridge2Client( ros::NodeHandle & nh_rel )
     :
         nh_rel_( nh_rel ),
         kinect_speech_pub_( nh_rel_.advertise<_KinectSpeechMsg>( "speech", 10 ) ),
         kinect_bodies_pub_( nh_rel_.advertise<_KinectBodiesMsg>( "bodies", 10 ) ),
         kinect_bridge_client_( getParam<std::string>( nh_rel_, "server_ip", "localhost" ), getParam<int>( nh_rel_, "server_port", 5903 ) ),
-        message_count_( 0 )
+        subscribed_( false ),
+        max_bodies_rate_( getParam<double>( nh_rel_, "max_bodies_rate", 0 ) ),
+        message_count_( 0 ),
+        // stamps taken across the network only compare if the server shares our clock
+        latency_stats_( getParam<bool>( nh_rel_, "same_host", isLocalHost( getParam<std::string>( nh_rel_, "server_ip", "localhost" ) ) ) ),
+        stream_names_{ { KinectSpeechMessage::ID(), "speech" }, { KinectBodiesMessage::ID(), "bodies" } }
     {
         //
     }
 
+    static bool isLocalHost( std::string const & address )
+    {
+        return address == "localhost" || address.compare( 0, 4, "127." ) == 0 || address == "::1";
+    }
+
     template<class __Data>
     static __Data getParam( ros::NodeHandle & nh, std::string const & param_name, __Data const & default_value )
     {
@@ -68,6 +91,7 @@ public:
     void spin()
     {
         auto last_update = std::chrono::high_resolution_clock::now();
+        auto last_latency_update = last_update;
         while( ros::ok() )
         {
             auto now = std::chrono::high_resolution_clock::now();
@@ -78,19 +102,46 @@ public:
                 std::cout << "processed " << message_count_ << " messages" << std::endl;
             }
 
+            if( std::chrono::duration_cast<std::chrono::milliseconds>( now - last_latency_update ).count() >= 10000 )
+            {
+                last_latency_update = now;
+                if( !latency_stats_.empty() )
+                {
+                    std::cout << "latency over the last 10 s:" << std::endl;
+                    latency_stats_.print( std::cout, stream_names_ );
+                    latency_stats_.reset();
+                }
+            }
+
             try
             {
                 if( !kinect_bridge_client_.input_socket_.impl()->initialized() )
                 {
                     std::cout << "no server connection" << std::endl;
                     std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+                    subscribed_ = false;
                     kinect_bridge_client_.openInput();
                     continue;
                 }
 
-                CodedMessage<> binary_coded_message;
+                // the server sends a new client everything it has until told otherwise
+                if( !subscribed_ )
+                {
+                    subscribe();
+                    subscribed_ = true;
+                }
+
+                ExtendedMessage<CodedMessage<> > binary_coded_message;
                 kinect_bridge_client_.pull( binary_coded_message );
-                processKinectMessage( binary_coded_message );
+
+                // the server only sends a trace when asked to
+                LatencyTraceMessage trace;
+                bool const traced = binary_coded_message.extensions_.get( trace );
+                trace.mark( LatencyTraceMessage::Stage::RECEIVE );
+
+                processKinectMessage( binary_coded_message, trace );
+                if( traced ) latency_stats_.record( binary_coded_message.header_.payload_id_, trace );
+
                 message_count_ ++;
  //               std::cout << "message processed" << std::endl;
             }
@@ -109,14 +160,38 @@ public:
         }
     }
 
-    void processKinectMessage( CodedMessage<> & coded_message )
+    // we only publish speech and bodies (bodies may also come bundled with other streams; see pipeline.sync.streams)
+    void subscribe()
+    {
+        SubscriptionMessage subscription;
+        subscription.subscribe( KinectSpeechMessage::ID() );
+        subscription.subscribe( KinectBodiesMessage::ID(), max_bodies_rate_ );
+        subscription.subscribe( FrameBundleMessage::ID(), max_bodies_rate_ );
+
+        auto coded_subscription = binary_message_coder_.encode( subscription );
+        kinect_bridge_client_.push( coded_subscription );
+    }
+
+    // marks the trace's DECODE_END once the message has been decoded (before it's published)
+    void processKinectMessage( CodedMessage<> & coded_message, LatencyTraceMessage & trace )
     {
         auto & coded_header = coded_message.header_;
 //        std::cout << "processing message type: " << coded_message.header_.payload_type_ << std::endl;
 
-        if( coded_header.payload_id_ == KinectSpeechMessage::ID() )
+        // frames the server bundled by capture time (see pipeline.sync.streams) are handled one by one, same as if they'd come separately
+        if( coded_header.payload_id_ == FrameBundleMessage::ID() )
+        {
+            auto bundle_msg = binary_message_coder_.decode<FrameBundleMessage>( coded_message );
+
+            for( auto frame_it = bundle_msg.frames_.begin(); frame_it != bundle_msg.frames_.end(); ++frame_it )
+            {
+                processKinectMessage( *frame_it, trace );
+            }
+        }
+        else if( coded_header.payload_id_ == KinectSpeechMessage::ID() )
         {
             auto kinect_speech_message = binary_message_coder_.decode<KinectSpeechMessage>( coded_message );
+            trace.mark( LatencyTraceMessage::Stage::DECODE_END );
 
             auto & header = kinect_speech_message.header_;
             auto & payload = kinect_speech_message.payload_;
@@ -136,6 +211,7 @@ public:
         else if( coded_header.payload_id_ == KinectBodiesMessage::ID() )
         {
             auto bodies_msg = binary_message_coder_.decode<KinectBodiesMessage>( coded_message );
+            trace.mark( LatencyTraceMessage::Stage::DECODE_END );
 
             auto const & header = bodies_msg.header_;
             auto const & payload = bodies_msg.payload_;
@@ -0,0 +1,346 @@
+// relays any number of kinect_servers through one endpoint, so consumers open one connection instead of one per sensor and the sensors'
+// servers only ever have the hub as a client
+//
+// the hub connects to every --server as a client, tags each message with the sensor it came from (a SensorTagMessage extension; sensor
+// ids are the servers' positions on the command line, from 0), and passes it on as is to all of its own clients (see FanOutTCPDevice).
+// messages are never decoded: images stay compressed, and whatever extensions the server sent (eg: with --trace) go along unchanged.
+// servers that go away are reconnected to. clients may subscribe to only some streams, at reduced rates, just as with a server; the
+// subscription applies to those streams from every sensor
+//
+// with --align, each sensor's stamps are also mapped onto the hub's clock (see SensorClock) and sent as the tag's aligned_stamp_, so a
+// consumer can match up frames from different sensors without knowing anything about their clocks. every stream of every sensor gets a
+// clock of its own: a sensor doesn't stamp all its streams on the same clock (speech carries wall-clock time, frames the sensor's own)
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+
+#include <Poco/Timespan.h>
+
+#include <messages/codec.h>
+#include <messages/message_extensions.h>
+#include <messages/latency_trace_message.h>
+#include <messages/sensor_tag_message.h>
+#include <messages/peek_time_stamp.h>
+#include <messages/input_tcp_device.h>
+#include <messages/fan_out_tcp_device.h>
+
+#include "sensor_clock.h"
+
+bool running_ = true;
+
+#ifdef _WIN32
+// ctrl-c detection for windows
+BOOL WINAPI sigkillHandler( DWORD signal )
+{
+    if( signal == CTRL_C_EVENT )
+    {
+        running_ = false;
+    }
+
+    return TRUE;
+}
+#else
+void sigintHandler( int )
+{
+    running_ = false;
+}
+#endif
+
+// ####################################################################################################
+// the connection to one sensor's server, relaying on its own thread until stopped; counters may be read from any thread meanwhile
+class SensorLink
+{
+protected:
+    uint32_t sensor_id_;
+    std::string host_;
+    uint16_t port_;
+
+    // one per stream, by payload id, with how many stamps it's aligned
+    struct StreamClock
+    {
+        SensorClock clock_;
+        uint64_t num_aligned_;
+
+        StreamClock()
+        :
+            num_aligned_( 0 )
+        {
+            //
+        }
+    };
+
+    std::map<uint32_t, StreamClock> clocks_;
+
+    std::atomic<bool> connected_;
+    std::atomic<uint64_t> num_connects_;
+    std::atomic<uint64_t> num_messages_;
+    std::atomic<uint64_t> bytes_;
+    // SensorClock::offset() of the stream with the most stamps aligned, in ticks, for reporting
+    std::atomic<int64_t> clock_offset_;
+
+public:
+    SensorLink( uint32_t sensor_id, std::string const & host, uint16_t port )
+    :
+        sensor_id_( sensor_id ),
+        host_( host ),
+        port_( port ),
+        connected_( false ),
+        num_connects_( 0 ),
+        num_messages_( 0 ),
+        bytes_( 0 ),
+        clock_offset_( 0 )
+    {
+        //
+    }
+
+    void run( FanOutTCPDevice & output_device, bool align )
+    {
+        InputTCPDevice input_device;
+
+        while( running_ )
+        {
+            try
+            {
+                input_device.openInput( host_, port_ );
+            }
+            catch( std::exception & )
+            {
+                // not up (yet); keep trying
+                std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+                continue;
+            }
+
+            std::cout << "connected to sensor " << sensor_id_ << " at " << host_ << ":" << port_ << std::endl;
+
+            ++num_connects_;
+            connected_ = true;
+
+            // the server may have restarted, and its sensor's clocks with it
+            clocks_.clear();
+
+            while( running_ )
+            {
+                try
+                {
+                    // don't block in pull() unless something's coming, so we still notice when to stop
+                    if( !input_device.input_socket_.poll( Poco::Timespan( 100 * 1000 ), Poco::Net::Socket::SELECT_READ ) ) continue;
+
+                    ExtendedMessage<CodedMessage<> > message;
+                    input_device.pull( message );
+
+                    SensorTagMessage tag( sensor_id_ );
+                    if( align ) tag.aligned_stamp_ = alignStamp( message.header_.payload_id_, peekTimeStamp( message ), LatencyTraceMessage::now() / 100 );
+                    message.extensions_.set( tag );
+
+                    output_device.push( message, message.header_.payload_id_ );
+
+                    ++num_messages_;
+                    bytes_ += message.payload_.size_;
+                }
+                catch( std::exception & e )
+                {
+                    // the server hung up (pull() closes the input when it does, and the next read throws) or the connection broke
+                    std::cout << "lost sensor " << sensor_id_ << ": " << e.what() << std::endl;
+                    break;
+                }
+            }
+
+            connected_ = false;
+            input_device.closeInput();
+        }
+    }
+
+    // the stamp on the hub's clock, going by the stream's own clock
+    uint64_t alignStamp( uint32_t payload_id, uint64_t stamp, uint64_t arrival )
+    {
+        if( stamp == 0 ) return 0;
+
+        StreamClock & stream_clock = clocks_[payload_id];
+        uint64_t const aligned_stamp = stream_clock.clock_.align( stamp, arrival );
+        ++stream_clock.num_aligned_;
+
+        // report the busiest stream's clock; it's the one a consumer is most likely matching frames by
+        bool busiest = true;
+        for( auto clock_it = clocks_.begin(); clock_it != clocks_.end() && busiest; ++clock_it )
+        {
+            busiest = clock_it->second.num_aligned_ <= stream_clock.num_aligned_;
+        }
+        if( busiest ) clock_offset_ = stream_clock.clock_.offset();
+
+        return aligned_stamp;
+    }
+
+    uint32_t sensorId() const { return sensor_id_; }
+    std::string address() const { return host_ + ":" + std::to_string( port_ ); }
+    bool connected() const { return connected_; }
+    uint64_t numConnects() const { return num_connects_; }
+    uint64_t numMessages() const { return num_messages_; }
+    uint64_t bytes() const { return bytes_; }
+    int64_t clockOffset() const { return clock_offset_; }
+};
+
+int main( int argc, char ** argv )
+{
+#ifdef _WIN32
+    // ctrl-c detection for windows
+    SetConsoleCtrlHandler( sigkillHandler, TRUE );
+#else
+    std::signal( SIGINT, sigintHandler );
+#endif
+
+    // parse command-line opts
+    std::string listen_ip( "localhost" );
+    uint32_t listen_port( 5910 );
+    std::vector<std::pair<std::string, uint16_t> > servers;
+    bool align( false );
+    uint32_t max_queued( 64 );
+    double report_interval( 5 );
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            std::cout << "options: " << std::endl;
+            std::cout << "  --server <hostname or ip>[:<port number>] (a kinect_server to relay; may be repeated; default port: 5903)" << std::endl;
+            std::cout << "  --listen-ip <hostname or ip>" << std::endl;
+            std::cout << "  --listen-port <port number> (default: 5910)" << std::endl;
+            std::cout << "  --align (map every sensor's stamps onto the hub's clock)" << std::endl;
+            std::cout << "  --max-queued <messages> (per client, before its oldest are dropped; default: 64)" << std::endl;
+            std::cout << "  --report <seconds> (between status reports; default: 5, 0 for none)" << std::endl;
+            return 0;
+        }
+        else if( arg == "--server" && i + 1 < argc )
+        {
+            std::string const server = argv[++i];
+            size_t const colon_pos = server.rfind( ':' );
+
+            uint32_t port = 5903;
+            if( colon_pos != std::string::npos )
+            {
+                std::stringstream ss;
+                ss << server.substr( colon_pos + 1 );
+                ss >> port;
+            }
+
+            servers.push_back( std::make_pair( server.substr( 0, colon_pos ), static_cast<uint16_t>( port ) ) );
+        }
+        else if( arg == "--listen-ip" && i + 1 < argc )
+        {
+            listen_ip = argv[++i];
+        }
+        else if( arg == "--listen-port" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> listen_port;
+        }
+        else if( arg == "--align" )
+        {
+            align = true;
+        }
+        else if( arg == "--max-queued" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> max_queued;
+        }
+        else if( arg == "--report" && i + 1 < argc )
+        {
+            std::stringstream ss;
+            ss << argv[++i];
+            ss >> report_interval;
+        }
+    }
+
+    if( servers.empty() )
+    {
+        std::cout << "no servers to relay; give at least one --server" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<FanOutTCPDevice> output_device_ptr;
+    try
+    {
+        output_device_ptr.reset( new FanOutTCPDevice( listen_ip, static_cast<uint16_t>( listen_port ), std::max<uint32_t>( max_queued, 1 ) ) );
+    }
+    catch( std::exception & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<SensorLink> > links;
+    for( auto server_it = servers.begin(); server_it != servers.end(); ++server_it )
+    {
+        links.emplace_back( new SensorLink( static_cast<uint32_t>( links.size() ), server_it->first, server_it->second ) );
+        std::cout << "sensor " << links.back()->sensorId() << ": " << links.back()->address() << std::endl;
+    }
+
+    std::vector<std::thread> link_threads;
+    for( auto link_it = links.begin(); link_it != links.end(); ++link_it )
+    {
+        SensorLink * const link_ptr = link_it->get();
+        FanOutTCPDevice * const output_device = output_device_ptr.get();
+        link_threads.emplace_back( [link_ptr, output_device, align](){ link_ptr->run( *output_device, align ); } );
+    }
+
+    auto last_report_time = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, uint64_t> > last_counts( links.size(), std::make_pair( 0, 0 ) );
+
+    while( running_ )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        if( report_interval <= 0 ) continue;
+
+        auto const now = std::chrono::steady_clock::now();
+        double const elapsed = std::chrono::duration<double>( now - last_report_time ).count();
+        if( elapsed < report_interval ) continue;
+        last_report_time = now;
+
+        for( size_t link_idx = 0; link_idx < links.size(); ++link_idx )
+        {
+            SensorLink const & link = *links[link_idx];
+            uint64_t const num_messages = link.numMessages();
+            uint64_t const bytes = link.bytes();
+
+            std::cout << "sensor " << std::setw( 2 ) << link.sensorId() << std::setw( 14 ) << ( link.connected() ? "connected" : "disconnected" )
+                << std::fixed << std::setprecision( 1 ) << std::setw( 10 ) << ( num_messages - last_counts[link_idx].first ) / elapsed << " msg/s"
+                << std::setprecision( 2 ) << std::setw( 10 ) << ( bytes - last_counts[link_idx].second ) / elapsed / 1e6 << " MB/s";
+            if( align ) std::cout << "  clock offset: " << std::setprecision( 1 ) << link.clockOffset() / 1e4 << " ms";
+            std::cout << "  " << link.address() << std::endl;
+
+            last_counts[link_idx] = std::make_pair( num_messages, bytes );
+        }
+
+        std::cout << "clients: " << output_device_ptr->numClients() << "  dropped: " << output_device_ptr->numDropped() << std::endl;
+    }
+
+    std::cout << "stopping" << std::endl;
+
+    for( auto thread_it = link_threads.begin(); thread_it != link_threads.end(); ++thread_it )
+    {
+        thread_it->join();
+    }
+
+    output_device_ptr->closeOutput();
+
+    for( auto link_it = links.begin(); link_it != links.end(); ++link_it )
+    {
+        std::cout << "sensor " << ( *link_it )->sensorId() << ": " << ( *link_it )->numMessages() << " messages relayed over " << ( *link_it )->numConnects() << " connections" << std::endl;
+    }
+    std::cout << output_device_ptr->numClientsAccepted() << " clients served; " << output_device_ptr->numDropped() << " messages dropped for slow clients" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef _KINECT_HUB_SENSOR_CLOCK_H_
+#define _KINECT_HUB_SENSOR_CLOCK_H_
+
+#include <cstdint>
+#include <algorithm>
+
+// ####################################################################################################
+// maps one sensor's stamps onto our own clock, from nothing but when its messages arrive (all in 100 ns ticks)
+//
+// a message can't arrive before it was captured, so arrival - stamp is the offset between the two clocks plus that message's time in
+// transit. the smallest difference seen lately is the best estimate we have: off only by the quickest transit, which is much the same for
+// every sensor on the same network, so aligned stamps from different sensors compare fairly. the minimum is kept over the current and the
+// previous window, so the estimate follows slow drift without jumping about; a sensor that reconnects (and may have restarted, resetting its
+// clock) has to be reset(). all the stamps fed to one SensorClock must come from the same clock, so streams stamped differently each need
+// their own
+class SensorClock
+{
+protected:
+    uint64_t window_;
+
+    bool valid_;
+    bool has_previous_;
+    uint64_t window_start_;
+    int64_t current_min_;
+    int64_t previous_min_;
+
+public:
+    SensorClock( uint64_t window = 5 * 10000000ull )
+    :
+        window_( window )
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        valid_ = false;
+        has_previous_ = false;
+        window_start_ = 0;
+        current_min_ = 0;
+        previous_min_ = 0;
+    }
+
+    // the stamp on our clock, given when its message arrived; 0 for a message without a stamp
+    uint64_t align( uint64_t stamp, uint64_t arrival )
+    {
+        if( stamp == 0 ) return 0;
+
+        int64_t const sample = static_cast<int64_t>( arrival ) - static_cast<int64_t>( stamp );
+
+        if( !valid_ )
+        {
+            valid_ = true;
+            window_start_ = arrival;
+            current_min_ = sample;
+        }
+        else if( arrival - window_start_ >= window_ )
+        {
+            has_previous_ = true;
+            previous_min_ = current_min_;
+            window_start_ = arrival;
+            current_min_ = sample;
+        }
+        else current_min_ = std::min( current_min_, sample );
+
+        return static_cast<uint64_t>( static_cast<int64_t>( stamp ) + offset() );
+    }
+
+    bool valid() const
+    {
+        return valid_;
+    }
+
+    // what to add to the sensor's stamps to put them on our clock
+    int64_t offset() const
+    {
+        return has_previous_ ? std::min( current_min_, previous_min_ ) : current_min_;
+    }
+};
+
+#endif // _KINECT_HUB_SENSOR_CLOCK_H_
@@ -0,0 +1,173 @@
+#ifndef _KINECT_SERVER_KINECT_METRICS_H_
+#define _KINECT_SERVER_KINECT_METRICS_H_
+
+// what kinect_server exposes on its metrics endpoint (see metrics_http_server.h), besides the pipeline's own stage, fifo, budget, and pool
+// metrics (see Pipeline::writeMetrics()):
+//
+//   kinect_stream_messages_total{stream}           messages sent
+//   kinect_stream_encoded_bytes_total{stream}      bytes sent, as encoded
+//   kinect_stream_decoded_bytes_total{stream}      the same messages' size before encoding
+//   kinect_stream_fps{stream}                      messages sent per second, over the last update interval
+//   kinect_stream_compression_ratio{stream}        decoded / encoded bytes, over everything sent so far
+//   kinect_stream_encode_us{stream}                time to encode a message
+//   kinect_stream_send_us{stream}                  time to hand a message to the socket
+//   kinect_stream_server_latency_us{stream}        capture (or, when replaying, release) to send
+//   kinect_send_failures_total                     messages the socket wouldn't take
+//   kinect_send_backlog_messages, _bytes           messages waiting for the socket (write_fifo)
+//   kinect_bytes_in_flight                         bytes held in every fifo, captured or encoded but not yet sent
+//   kinect_sync_bundles_total                      frame bundles sent, if any streams are synced (see pipeline.sync.streams)
+//   kinect_sync_incomplete_bundles_total           those of them missing at least one stream's frame
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <atomics/metrics.h>
+#include <atomics/pipeline.h>
+
+#include "kinect_pipeline.h"
+
+// ####################################################################################################
+class KinectServerMetrics
+{
+public:
+    typedef LatencyTraceMessage::Stage _Stage;
+
+protected:
+    struct StreamMetrics
+    {
+        atomics::MetricsCounter & num_messages_;
+        atomics::MetricsCounter & encoded_bytes_;
+        atomics::MetricsCounter & decoded_bytes_;
+        atomics::MetricsGauge & fps_;
+        atomics::MetricsGauge & compression_ratio_;
+        atomics::Histogram & encode_time_;
+        atomics::Histogram & send_time_;
+        atomics::Histogram & server_latency_;
+
+        // num_messages_ at the last updateRates()
+        uint64_t last_num_messages_;
+
+        StreamMetrics( atomics::MetricsRegistry & registry, std::string const & stream_name )
+        :
+            num_messages_( registry.counter( "kinect_stream_messages_total", "messages sent", label( stream_name ) ) ),
+            encoded_bytes_( registry.counter( "kinect_stream_encoded_bytes_total", "bytes sent, as encoded", label( stream_name ) ) ),
+            decoded_bytes_( registry.counter( "kinect_stream_decoded_bytes_total", "size of the sent messages before encoding", label( stream_name ) ) ),
+            fps_( registry.gauge( "kinect_stream_fps", "messages sent per second", label( stream_name ) ) ),
+            compression_ratio_( registry.gauge( "kinect_stream_compression_ratio", "decoded / encoded bytes sent", label( stream_name ) ) ),
+            encode_time_( registry.histogram( "kinect_stream_encode_us", "time to encode a message, in microseconds", label( stream_name ) ) ),
+            send_time_( registry.histogram( "kinect_stream_send_us", "time to hand a message to the socket, in microseconds", label( stream_name ) ) ),
+            server_latency_( registry.histogram( "kinect_stream_server_latency_us", "capture to send, in microseconds", label( stream_name ) ) ),
+            last_num_messages_( 0 )
+        {
+            //
+        }
+
+        static std::string label( std::string const & stream_name )
+        {
+            return atomics::MetricsWriter::label( "stream", stream_name );
+        }
+    };
+
+    atomics::MetricsRegistry & registry_;
+
+    // filled in up front, so the writer thread can look streams up without a lock
+    std::map<uint32_t, std::unique_ptr<StreamMetrics> > streams_;
+
+    atomics::MetricsCounter & num_send_failures_;
+
+public:
+    // the pipeline is sampled whenever the registry is written, so it must outlive the registry's last write
+    KinectServerMetrics( atomics::MetricsRegistry & registry, atomics::Pipeline const & pipeline )
+    :
+        registry_( registry ),
+        num_send_failures_( registry.counter( "kinect_send_failures_total", "messages the socket wouldn't take" ) )
+    {
+        addStream( _ColorImageMsg::ID(), "color" );
+        addStream( _DepthImageMsg::ID(), "depth" );
+        addStream( _InfraredImageMsg::ID(), "infrared" );
+        addStream( _AudioMsg::ID(), "audio" );
+        addStream( _BodiesMsg::ID(), "bodies" );
+        addStream( _SpeechMsg::ID(), "speech" );
+        addStream( FrameBundleMessage::ID(), "bundle" );
+
+        atomics::Pipeline const * pipeline_ptr = &pipeline;
+        registry_.addCollector(
+            [pipeline_ptr]( atomics::MetricsWriter & writer )
+            {
+                size_t bytes_in_flight = 0;
+                for( auto fifo_it = pipeline_ptr->fifos().begin(); fifo_it != pipeline_ptr->fifos().end(); ++fifo_it )
+                {
+                    bytes_in_flight += fifo_it->second->bytes();
+                }
+
+                auto const write_fifo_ptr = pipeline_ptr->getFifo( "write_fifo" );
+                if( write_fifo_ptr )
+                {
+                    writer.gauge( "kinect_send_backlog_messages", "messages waiting for the socket", write_fifo_ptr->size() );
+                    writer.gauge( "kinect_send_backlog_bytes", "bytes waiting for the socket", write_fifo_ptr->bytes() );
+                }
+
+                writer.gauge( "kinect_bytes_in_flight", "bytes held in the pipeline's fifos", bytes_in_flight );
+
+                auto const sync_stage_ptr = std::dynamic_pointer_cast<_SyncStage>( pipeline_ptr->getStage( "sync" ) );
+                if( sync_stage_ptr )
+                {
+                    writer.counter( "kinect_sync_bundles_total", "frame bundles sent", sync_stage_ptr->numBundles() );
+                    writer.counter( "kinect_sync_incomplete_bundles_total", "frame bundles missing at least one stream's frame", sync_stage_ptr->numIncomplete() );
+                }
+
+                pipeline_ptr->writeMetrics( writer );
+            }
+        );
+    }
+
+    // a message was sent (or, if !sent, failed to send) in the given number of microseconds; called from the writer thread
+    void count( _CodedMsg const & message, uint64_t send_time, bool sent = true )
+    {
+        if( !sent )
+        {
+            num_send_failures_.increment();
+            return;
+        }
+
+        auto const stream_it = streams_.find( message.header_.payload_id_ );
+        if( stream_it == streams_.end() ) return;
+
+        StreamMetrics & stream = *stream_it->second;
+        stream.num_messages_.increment();
+        stream.encoded_bytes_.increment( message.payload_.size_ );
+        stream.decoded_bytes_.increment( message.header_.decoded_size_ );
+        stream.send_time_.record( send_time );
+
+        int64_t const encode_time = message.trace_.elapsed( _Stage::ENCODE_START, _Stage::ENCODE_END );
+        if( encode_time >= 0 ) stream.encode_time_.record( static_cast<uint64_t>( encode_time / 1000 ) );
+
+        int64_t const server_latency = message.trace_.elapsed( _Stage::CAPTURE, _Stage::SEND );
+        if( server_latency >= 0 ) stream.server_latency_.record( static_cast<uint64_t>( server_latency / 1000 ) );
+    }
+
+    // recompute the per-stream rates; call periodically from a single thread, with the time since the last call
+    void updateRates( double elapsed_seconds )
+    {
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            StreamMetrics & stream = *stream_it->second;
+
+            uint64_t const num_messages = stream.num_messages_.value();
+            if( elapsed_seconds > 0 ) stream.fps_.set( ( num_messages - stream.last_num_messages_ ) / elapsed_seconds );
+            stream.last_num_messages_ = num_messages;
+
+            uint64_t const encoded_bytes = stream.encoded_bytes_.value();
+            if( encoded_bytes > 0 ) stream.compression_ratio_.set( static_cast<double>( stream.decoded_bytes_.value() ) / encoded_bytes );
+        }
+    }
+
+protected:
+    void addStream( uint32_t payload_id, std::string const & stream_name )
+    {
+        streams_[payload_id].reset( new StreamMetrics( registry_, stream_name ) );
+    }
+};
+
+#endif // _KINECT_SERVER_KINECT_METRICS_H_
@@ -0,0 +1,836 @@
+#ifndef _KINECT_SERVER_KINECT_PIPELINE_H_
+#define _KINECT_SERVER_KINECT_PIPELINE_H_
+
+// capture -> compress -> output pipeline shared by kinect_server and kinect_logger
+//
+// every stream gets a source stage reading from the sensor into <stream>_read_fifo and a stage compressing those messages into the shared
+// compress_fifo. since compression runs in parallel, messages are numbered per stream at capture and put back in that order by the reorder
+// stage before they reach write_fifo; the caller supplies the sink that consumes write_fifo. all stage and fifo names below are valid
+// configuration keys:
+//   pipeline.<stream>_read.workers       0 disables capture of that stream entirely
+//   pipeline.compress_pool.workers       defaults to the number of hardware threads
+//   pipeline.<stream>_compress.priority
+//   pipeline.<stream>_compress.min_share
+//   pipeline.<stream>_read_fifo.capacity
+//   pipeline.<stream>_read_fifo.overflow block (default), drop_oldest to keep only the newest frames, or drop_newest
+//   pipeline.<stream>_read_fifo.max_kb   memory limit for that stream's captured frames
+//   pipeline.capture_budget.max_kb       memory limit for the captured frames of all streams together
+//   pipeline.compress_fifo.capacity
+//   pipeline.compress_fifo.overflow
+//   pipeline.compress_fifo.max_kb
+//   pipeline.reorder.max_wait_ms         how long to hold back a stream waiting for a slow frame before skipping it
+//   pipeline.reorder.max_pending         how many frames per stream to hold back at most
+//   pipeline.sync.streams                which streams to bundle by capture time (eg: depth,bodies); none by default
+//   pipeline.sync.tolerance_ms           how far apart two frames' capture times may be for them to share a bundle
+//   pipeline.sync.max_wait_ms            how long to wait for the rest of a bundle before sending it incomplete
+//   pipeline.sync.max_pending            how many bundles to keep open at most
+//   pipeline.sync_fifo.capacity
+//   pipeline.sync_fifo.overflow
+//   pipeline.sync_fifo.max_kb
+//   pipeline.write_fifo.capacity
+//   pipeline.write_fifo.overflow
+//   pipeline.write_fifo.max_kb
+//   pipeline.write.workers
+//
+// frames dropped by a fifo's overflow policy before the reorder stage are reported to it, so it doesn't hold their stream back waiting
+//
+// if any streams are synced, the reorder stage feeds sync_fifo instead, and the sync stage replaces those streams' frames with
+// FrameBundleMessages (one per capture time) on their way to write_fifo; every other stream passes straight through
+//
+// streams may also be gated (see KinectStreamGates): kinect_server closes the gates of the streams none of its clients subscribed to
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+// we have to include this before any Poco code (or any code that includes Poco code) otherwise windows speech API will go full retard
+#ifdef _WIN32
+#include <kinect_common/kinect_device.h>
+#endif
+
+#include <kinect_common/kinect_frame_source.h>
+#include <kinect_common/synthetic_frame_source.h>
+
+#include <atomics/pipeline.h>
+#include <atomics/reorder_buffer.h>
+#include <atomics/sync_buffer.h>
+
+#include <messages/message_coder.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+#include <messages/tracked_message.h>
+#include <messages/frame_bundle_message.h>
+#include <messages/peek_time_stamp.h>
+
+typedef TrackedMessage<KinectColorImageMessage<PNGImageMessage<> > > _ColorImageMsg;
+typedef std::shared_ptr<_ColorImageMsg> _ColorImageMsgPtr;
+
+typedef TrackedMessage<KinectDepthImageMessage<PNGImageMessage<> > > _DepthImageMsg;
+typedef std::shared_ptr<_DepthImageMsg> _DepthImageMsgPtr;
+
+typedef TrackedMessage<KinectInfraredImageMessage<PNGImageMessage<> > > _InfraredImageMsg;
+typedef std::shared_ptr<_InfraredImageMsg> _InfraredImageMsgPtr;
+
+typedef TrackedMessage<KinectAudioMessage<WAVAudioMessage<> > > _AudioMsg;
+typedef std::shared_ptr<_AudioMsg> _AudioMsgPtr;
+
+typedef TrackedMessage<KinectBodiesMessage> _BodiesMsg;
+typedef std::shared_ptr<_BodiesMsg> _BodiesMsgPtr;
+
+typedef TrackedMessage<KinectSpeechMessage> _SpeechMsg;
+typedef std::shared_ptr<_SpeechMsg> _SpeechMsgPtr;
+
+typedef TrackedMessage<CodedMessage<> > _CodedMsg;
+typedef std::shared_ptr<_CodedMsg> _CodedMsgPtr;
+
+// how long a read stage sleeps on the sensor before re-checking whether it's been stopped
+static uint32_t const KINECT_READ_TIMEOUT_MS = 100;
+
+// ####################################################################################################
+// roughly how much memory a queued message holds, for byte-bounded fifos
+struct MessageByteSize
+{
+    // images, audio, and coded messages all keep their data in a BinaryMessage payload
+    template<class __Message>
+    size_t operator()( std::shared_ptr<__Message> const & message_ptr ) const
+    {
+        return sizeof( __Message ) + message_ptr->payload_.size_;
+    }
+
+    size_t operator()( _BodiesMsgPtr const & message_ptr ) const
+    {
+        size_t bytes = sizeof( _BodiesMsg );
+        for( auto body_it = message_ptr->payload_.begin(); body_it != message_ptr->payload_.end(); ++body_it )
+        {
+            bytes += sizeof( KinectBodyMessage ) + body_it->joints_.size() * sizeof( KinectJointMessage );
+        }
+        return bytes;
+    }
+
+    size_t operator()( _SpeechMsgPtr const & message_ptr ) const
+    {
+        size_t bytes = sizeof( _SpeechMsg );
+        for( auto phrase_it = message_ptr->payload_.begin(); phrase_it != message_ptr->payload_.end(); ++phrase_it )
+        {
+            bytes += sizeof( KinectSpeechPhraseMessage ) + phrase_it->tag_.size();
+        }
+        return bytes;
+    }
+};
+
+// ####################################################################################################
+// which streams are captured when the configuration doesn't say otherwise
+struct KinectStreams
+{
+    bool color_;
+    bool depth_;
+    bool infrared_;
+    bool audio_;
+    bool bodies_;
+    bool speech_;
+
+    KinectStreams( bool color = true, bool depth = true, bool infrared = true, bool audio = true, bool bodies = true, bool speech = true )
+    :
+        color_( color ),
+        depth_( depth ),
+        infrared_( infrared ),
+        audio_( audio ),
+        bodies_( bodies ),
+        speech_( speech )
+    {
+        //
+    }
+};
+
+// ####################################################################################################
+// which streams anyone is listening to right now; frames of a closed stream are thrown away as soon as they're read, so nothing is spent
+// queueing or compressing them. the sensor is still read, so the first frame after a stream opens again is a fresh one. all start open
+struct KinectStreamGates
+{
+    std::atomic<bool> color_;
+    std::atomic<bool> depth_;
+    std::atomic<bool> infrared_;
+    std::atomic<bool> audio_;
+    std::atomic<bool> bodies_;
+    std::atomic<bool> speech_;
+
+    KinectStreamGates()
+    :
+        color_( true ),
+        depth_( true ),
+        infrared_( true ),
+        audio_( true ),
+        bodies_( true ),
+        speech_( true )
+    {
+        //
+    }
+
+    void set( KinectStreams const & open )
+    {
+        color_ = open.color_;
+        depth_ = open.depth_;
+        infrared_ = open.infrared_;
+        audio_ = open.audio_;
+        bodies_ = open.bodies_;
+        speech_ = open.speech_;
+    }
+};
+
+// ####################################################################################################
+// per-stream count of messages that made it to the sink
+struct KinectStreamCounters
+{
+    std::atomic<uint32_t> num_color_;
+    std::atomic<uint32_t> num_depth_;
+    std::atomic<uint32_t> num_infrared_;
+    std::atomic<uint32_t> num_audio_;
+    std::atomic<uint32_t> num_bodies_;
+    std::atomic<uint32_t> num_speech_;
+
+    KinectStreamCounters()
+    :
+        num_color_( 0 ),
+        num_depth_( 0 ),
+        num_infrared_( 0 ),
+        num_audio_( 0 ),
+        num_bodies_( 0 ),
+        num_speech_( 0 )
+    {
+        //
+    }
+
+    void count( _CodedMsg const & message )
+    {
+        if( message.header_.payload_id_ == _ColorImageMsg::ID() ) num_color_ ++;
+        else if( message.header_.payload_id_ == _DepthImageMsg::ID() ) num_depth_ ++;
+        else if( message.header_.payload_id_ == _InfraredImageMsg::ID() ) num_infrared_ ++;
+        else if( message.header_.payload_id_ == _AudioMsg::ID() ) num_audio_ ++;
+        else if( message.header_.payload_id_ == _BodiesMsg::ID() ) num_bodies_ ++;
+        else if( message.header_.payload_id_ == _SpeechMsg::ID() ) num_speech_ ++;
+    }
+
+    void print( std::ostream & out ) const
+    {
+        out << num_color_ << " | " << num_depth_ << " | " << num_infrared_ << " | " << num_audio_ << " | " << num_bodies_ << " | " << num_speech_ << std::endl;
+    }
+};
+
+// ####################################################################################################
+// pulls RGBA frames and crops them down to the RGB region we care about
+struct ColorImageReader
+{
+    KinectFrameSource * frame_source_;
+    _ColorImageMsgPtr message_ptr_;
+
+    ColorImageReader( KinectFrameSource & frame_source )
+    :
+        frame_source_( &frame_source )
+    {
+        //
+    }
+
+    bool operator()( _ColorImageMsgPtr & cropped_message_ptr )
+    {
+        // sleep until the sensor signals a new frame; time out periodically so we notice when we've been stopped
+        if( !frame_source_->waitForColorImage( KINECT_READ_TIMEOUT_MS ) ) return false;
+
+        try
+        {
+            frame_source_->pullColorImage( message_ptr_ );
+        }
+        catch( KinectException & e )
+        {
+            // the frame we were signalled about is already gone; wait for the next one
+            return false;
+        }
+
+        message_ptr_->header_.num_channels_ = 3;
+
+        // the cropped message is handed off to the compression stage, so it can't be reused for the next frame
+        cropped_message_ptr = std::make_shared<_ColorImageMsg>();
+
+        uint16_t const crop_x = message_ptr_->header_.width_ * 0.4f;
+        uint16_t const crop_y = message_ptr_->header_.height_ * 0.25f;
+        uint16_t const crop_w = message_ptr_->header_.width_ - ( 2.0f * crop_x );
+        uint16_t const crop_h = message_ptr_->header_.height_ - ( crop_y + 0.8f*crop_y );
+
+        cropped_message_ptr->header_ = message_ptr_->header_;
+        cropped_message_ptr->header_.width_ = crop_w;
+        cropped_message_ptr->header_.height_ = crop_h;
+        cropped_message_ptr->header_.encoding_ = "rgb";
+
+        cropped_message_ptr->payload_.allocate( cropped_message_ptr->header_.width_ * cropped_message_ptr->header_.height_ * cropped_message_ptr->header_.num_channels_ * cropped_message_ptr->header_.pixel_depth_ / 8 );
+
+        auto & input_bytes = message_ptr_->payload_.payload_;
+        auto & output_bytes = cropped_message_ptr->payload_.payload_;
+
+        for( size_t row = crop_y; row < crop_y + crop_h; ++row )
+        {
+            for( size_t col = crop_x; col < crop_x + crop_w; ++col )
+            {
+                // only copy relevant data
+                size_t const input_idx = row * message_ptr_->header_.width_ + col;
+                size_t const output_idx = ( row - crop_y ) * crop_w + ( col - crop_x );
+                // only copy RGB (we ignore A anyway)
+                std::memcpy( output_bytes + 3 * output_idx, input_bytes + 4 * input_idx, 3 );
+            }
+        }
+
+        return true;
+    }
+};
+
+// ####################################################################################################
+struct DepthImageReader
+{
+    KinectFrameSource * frame_source_;
+
+    DepthImageReader( KinectFrameSource & frame_source )
+    :
+        frame_source_( &frame_source )
+    {
+        //
+    }
+
+    bool operator()( _DepthImageMsgPtr & message_ptr )
+    {
+        if( !frame_source_->waitForDepthImage( KINECT_READ_TIMEOUT_MS ) ) return false;
+
+        try
+        {
+            frame_source_->pullDepthImage( message_ptr );
+        }
+        catch( KinectException & e )
+        {
+            return false;
+        }
+
+        return true;
+    }
+};
+
+// ####################################################################################################
+struct InfraredImageReader
+{
+    KinectFrameSource * frame_source_;
+
+    InfraredImageReader( KinectFrameSource & frame_source )
+    :
+        frame_source_( &frame_source )
+    {
+        //
+    }
+
+    bool operator()( _InfraredImageMsgPtr & message_ptr )
+    {
+        if( !frame_source_->waitForInfraredImage( KINECT_READ_TIMEOUT_MS ) ) return false;
+
+        try
+        {
+            frame_source_->pullInfraredImage( message_ptr );
+        }
+        catch( KinectException & e )
+        {
+            return false;
+        }
+
+        return true;
+    }
+};
+
+// ####################################################################################################
+// the sensor produces 256-sample audio frames; we accumulate at least 2048 samples into each outgoing message
+struct AudioReader
+{
+    KinectFrameSource * frame_source_;
+    _AudioMsgPtr message_ptr_;
+    std::vector<_AudioMsgPtr> frame_ptrs_;
+
+    AudioReader( KinectFrameSource & frame_source )
+    :
+        frame_source_( &frame_source )
+    {
+        //
+    }
+
+    bool operator()( _AudioMsgPtr & output_message_ptr )
+    {
+        if( !frame_source_->waitForAudio( KINECT_READ_TIMEOUT_MS ) ) return false;
+
+        if( !message_ptr_ ) message_ptr_ = std::make_shared<_AudioMsg>();
+
+        try
+        {
+            _AudioMsgPtr frame_ptr;
+            frame_source_->pullAudio( frame_ptr );
+
+            message_ptr_->payload_.size_ += frame_ptr->payload_.size_;
+            message_ptr_->header_.num_samples_ += frame_ptr->header_.num_samples_;
+            message_ptr_->beam_angle_ += frame_ptr->beam_angle_;
+            message_ptr_->beam_angle_confidence_ += frame_ptr->beam_angle_confidence_;
+
+            frame_ptrs_.push_back( frame_ptr );
+        }
+        catch( KinectException & e )
+        {
+            return false;
+        }
+
+        if( message_ptr_->header_.num_samples_ < 2048 ) return false;
+
+        // combine all frames into one message
+        message_ptr_->header_.num_channels_ = frame_ptrs_.front()->header_.num_channels_;
+        message_ptr_->header_.sample_depth_ = frame_ptrs_.front()->header_.sample_depth_;
+        message_ptr_->header_.sample_rate_ = frame_ptrs_.front()->header_.sample_rate_;
+        message_ptr_->header_.encoding_ = frame_ptrs_.front()->header_.encoding_;
+
+        // there are 256 samples in each frame; we need to normalize beam angle stuff on a per-frame basis
+        message_ptr_->beam_angle_ /= ( message_ptr_->header_.num_samples_ / 256 );
+        message_ptr_->beam_angle_confidence_ /= ( message_ptr_->header_.num_samples_ / 256 );
+
+        message_ptr_->payload_.allocate();
+
+        uint32_t payload_offset = 0;
+        for( auto frame_ptrs_it = frame_ptrs_.cbegin(); frame_ptrs_it != frame_ptrs_.cend(); ++frame_ptrs_it )
+        {
+            auto & frame_ptr = *frame_ptrs_it;
+
+            std::memcpy( message_ptr_->payload_.data_ + payload_offset, frame_ptr->payload_.data_, frame_ptr->payload_.size_ );
+
+            payload_offset += frame_ptr->payload_.size_;
+        }
+
+        output_message_ptr = message_ptr_;
+        message_ptr_.reset();
+        frame_ptrs_.clear();
+
+        return true;
+    }
+};
+
+// ####################################################################################################
+struct BodiesReader
+{
+    KinectFrameSource * frame_source_;
+
+    BodiesReader( KinectFrameSource & frame_source )
+    :
+        frame_source_( &frame_source )
+    {
+        //
+    }
+
+    bool operator()( _BodiesMsgPtr & message_ptr )
+    {
+        if( !frame_source_->waitForBodies( KINECT_READ_TIMEOUT_MS ) ) return false;
+
+        try
+        {
+            frame_source_->pullBodies( message_ptr );
+        }
+        catch( KinectException & e )
+        {
+            return false;
+        }
+
+        return true;
+    }
+};
+
+// ####################################################################################################
+struct SpeechReader
+{
+    KinectFrameSource * frame_source_;
+
+    SpeechReader( KinectFrameSource & frame_source )
+    :
+        frame_source_( &frame_source )
+    {
+        //
+    }
+
+    bool operator()( _SpeechMsgPtr & message_ptr )
+    {
+        if( !frame_source_->waitForSpeech( KINECT_READ_TIMEOUT_MS ) ) return false;
+
+        try
+        {
+            frame_source_->pullSpeech( message_ptr );
+        }
+        catch( KinectException & e )
+        {
+            return false;
+        }
+
+        // only recognized phrases are worth sending
+        return message_ptr->size() > 0;
+    }
+};
+
+// ####################################################################################################
+// numbers each message a reader produces, starting from 0, and stamps its capture time; the count is shared between copies of the reader
+// messages read while the gate (if any) is closed are dropped before they're numbered, so the stream has no gaps for the reorder stage
+template<class __Reader>
+struct SequencedReader
+{
+    __Reader reader_;
+    std::shared_ptr<std::atomic<uint64_t> > next_sequence_ptr_;
+    std::atomic<bool> const * gate_ptr_;
+
+    SequencedReader( __Reader const & reader, std::atomic<bool> const * gate_ptr = NULL )
+    :
+        reader_( reader ),
+        next_sequence_ptr_( std::make_shared<std::atomic<uint64_t> >( 0 ) ),
+        gate_ptr_( gate_ptr )
+    {
+        //
+    }
+
+    template<class __MessagePtr>
+    bool operator()( __MessagePtr & message_ptr )
+    {
+        if( !reader_( message_ptr ) ) return false;
+        if( gate_ptr_ && !*gate_ptr_ ) return false;
+
+        message_ptr->sequence_ = ( *next_sequence_ptr_ )++;
+        message_ptr->trace_.mark( LatencyTraceMessage::Stage::CAPTURE );
+        return true;
+    }
+};
+
+template<class __Reader>
+SequencedReader<__Reader> makeSequencedReader( __Reader const & reader, std::atomic<bool> const * gate_ptr = NULL )
+{
+    return SequencedReader<__Reader>( reader, gate_ptr );
+}
+
+// ####################################################################################################
+// lets the reorder stage tell coded messages from different streams apart
+struct CodedMessageSequencer
+{
+    uint32_t stream( _CodedMsgPtr const & message_ptr ) const
+    {
+        return message_ptr->header_.payload_id_;
+    }
+
+    uint64_t sequence( _CodedMsgPtr const & message_ptr ) const
+    {
+        return message_ptr->sequence_;
+    }
+};
+
+typedef atomics::ReorderStage<_CodedMsgPtr, CodedMessageSequencer> _ReorderStage;
+
+// ####################################################################################################
+// the same, for raw messages that haven't been encoded yet
+template<class __MessagePtr>
+struct RawMessageSequencer
+{
+    uint32_t const stream_id_;
+
+    RawMessageSequencer()
+    :
+        stream_id_( __MessagePtr::element_type::ID() )
+    {
+        //
+    }
+
+    uint32_t stream( __MessagePtr const & ) const
+    {
+        return stream_id_;
+    }
+
+    uint64_t sequence( __MessagePtr const & message_ptr ) const
+    {
+        return message_ptr->sequence_;
+    }
+};
+
+// ####################################################################################################
+// whenever the given fifo drops a message, tell the reorder stage to stop waiting for it
+// the pipeline owns both the fifo and the stage, so we don't keep the stage alive from here
+template<class __MessagePtr, class __Sequencer>
+void skipWhenDropped( std::shared_ptr<atomics::Fifo<__MessagePtr> > const & fifo_ptr, _ReorderStage * reorder_stage_ptr, __Sequencer const & sequencer )
+{
+    fifo_ptr->setDropListener(
+        [reorder_stage_ptr, sequencer]( __MessagePtr const & message_ptr )
+        {
+            reorder_stage_ptr->skip( sequencer.stream( message_ptr ), sequencer.sequence( message_ptr ) );
+        }
+    );
+}
+
+template<class __MessagePtr>
+void skipWhenDropped( std::shared_ptr<atomics::Fifo<__MessagePtr> > const & fifo_ptr, _ReorderStage * reorder_stage_ptr )
+{
+    skipWhenDropped( fifo_ptr, reorder_stage_ptr, RawMessageSequencer<__MessagePtr>() );
+}
+
+// ####################################################################################################
+// only some messages (eg: PNG images) have a compression level to set; the rest ignore it
+template<class __Message>
+auto setCompressionLevel( __Message & message, int compression_level, int ) -> decltype( void( message.compression_level_ = compression_level ) )
+{
+    message.compression_level_ = compression_level;
+}
+
+template<class __Message>
+void setCompressionLevel( __Message &, int, long )
+{
+    //
+}
+
+// ####################################################################################################
+// encodes raw messages into CodedMessages with the given coder
+// compression_level < 0 leaves the message's own compression level alone
+template<class __MessageCoder>
+struct MessageCompressor
+{
+    __MessageCoder message_coder_;
+    int compression_level_;
+
+    MessageCompressor( __MessageCoder const & message_coder = __MessageCoder(), int compression_level = -1 )
+    :
+        message_coder_( message_coder ),
+        compression_level_( compression_level )
+    {
+        //
+    }
+
+    template<class __MessagePtr>
+    _CodedMsgPtr operator()( __MessagePtr & raw_message_ptr )
+    {
+        auto & trace = raw_message_ptr->trace_;
+        trace.mark( LatencyTraceMessage::Stage::DEQUEUE );
+
+        if( compression_level_ >= 0 ) setCompressionLevel( *raw_message_ptr, compression_level_, 0 );
+
+        trace.mark( LatencyTraceMessage::Stage::ENCODE_START );
+        auto coded_message_ptr = std::make_shared<_CodedMsg>( message_coder_.encode( *raw_message_ptr ) );
+        trace.mark( LatencyTraceMessage::Stage::ENCODE_END );
+
+        raw_message_ptr->copyTrackingTo( *coded_message_ptr );
+
+        return coded_message_ptr;
+    }
+};
+
+typedef MessageCoder<BinaryCodec<> > _BinaryMessageCoder;
+typedef MessageCoder<GZipCodec<> > _GZipMessageCoder;
+
+// ####################################################################################################
+// lets the sync stage bundle coded frames by capture time; bundles are numbered from 0 like any other stream
+struct FrameBundler
+{
+    size_t num_streams_;
+    uint64_t next_sequence_;
+    _BinaryMessageCoder message_coder_;
+
+    FrameBundler( size_t num_streams = 0 )
+    :
+        num_streams_( num_streams ),
+        next_sequence_( 0 )
+    {
+        //
+    }
+
+    uint32_t stream( _CodedMsgPtr const & message_ptr ) const
+    {
+        return message_ptr->header_.payload_id_;
+    }
+
+    // sensor stamps are in 100 ns ticks
+    uint64_t stamp( _CodedMsgPtr const & message_ptr ) const
+    {
+        return peekTimeStamp( *message_ptr ) * 100;
+    }
+
+    _CodedMsgPtr bundle( uint64_t stamp, std::vector<_CodedMsgPtr> & frame_ptrs )
+    {
+        FrameBundleMessage bundle_message( static_cast<uint32_t>( num_streams_ ), stamp / 100 );
+        _CodedMsgPtr const * earliest_frame_ptr = NULL;
+
+        // the frames are already encoded; they're moved into the bundle as is
+        for( auto frame_ptr_it = frame_ptrs.begin(); frame_ptr_it != frame_ptrs.end(); ++frame_ptr_it )
+        {
+            auto & frame_ptr = *frame_ptr_it;
+            if( !frame_ptr ) continue;
+
+            bundle_message.frames_.emplace_back( CodedMessageHeader( frame_ptr->header_ ), std::move( frame_ptr->payload_ ) );
+            if( !earliest_frame_ptr || frame_ptr->trace_.stamp( LatencyTraceMessage::Stage::CAPTURE ) < ( *earliest_frame_ptr )->trace_.stamp( LatencyTraceMessage::Stage::CAPTURE ) ) earliest_frame_ptr = &frame_ptr;
+        }
+
+        // a bundle is as old as its oldest frame
+        _CodedMsg tracking;
+        if( earliest_frame_ptr ) ( *earliest_frame_ptr )->copyTrackingTo( tracking );
+
+        tracking.trace_.mark( LatencyTraceMessage::Stage::ENCODE_START );
+        auto bundle_ptr = std::make_shared<_CodedMsg>( message_coder_.encode( bundle_message ) );
+        tracking.trace_.mark( LatencyTraceMessage::Stage::ENCODE_END );
+
+        tracking.sequence_ = next_sequence_++;
+        tracking.copyTrackingTo( *bundle_ptr );
+
+        return bundle_ptr;
+    }
+};
+
+typedef atomics::SyncStage<_CodedMsgPtr, FrameBundler> _SyncStage;
+
+// ####################################################################################################
+// which streams pipeline.sync.streams (a comma-separated list of stream names) asks to bundle; none if it's not set
+inline KinectStreams syncedStreams( Poco::Util::AbstractConfiguration const & config )
+{
+    KinectStreams streams( false, false, false, false, false, false );
+
+    std::stringstream names( config.getString( "pipeline.sync.streams", "" ) );
+    std::string name;
+    while( std::getline( names, name, ',' ) )
+    {
+        name.erase( 0, name.find_first_not_of( " \t" ) );
+        name.erase( name.find_last_not_of( " \t" ) + 1 );
+
+        if( name.empty() ) continue;
+        else if( name == "color" ) streams.color_ = true;
+        else if( name == "depth" ) streams.depth_ = true;
+        else if( name == "infrared" ) streams.infrared_ = true;
+        else if( name == "audio" ) streams.audio_ = true;
+        else if( name == "bodies" ) streams.bodies_ = true;
+        else if( name == "speech" ) streams.speech_ = true;
+        else throw std::invalid_argument( "unknown stream in pipeline.sync.streams: " + name );
+    }
+
+    return streams;
+}
+
+// ####################################################################################################
+// add all capture, compression, reordering, and (for any synced_streams) sync stages for the sensor (or anything standing in for it) to
+// the given pipeline, followed by a sink consuming write_fifo
+// worker counts are today's defaults; disabled streams start out with zero read workers. gates, if given, must outlive the pipeline
+template<class __SinkFn>
+void buildKinectPipeline( atomics::Pipeline & pipeline, KinectFrameSource & frame_source, KinectStreams const & streams, __SinkFn sink_fn, KinectStreams const & synced_streams = KinectStreams( false, false, false, false, false, false ), KinectStreamGates const * gates = NULL )
+{
+    auto color_image_read_fifo = pipeline.addFifo<_ColorImageMsgPtr>( "color_read_fifo", 2*16 );
+    auto depth_image_read_fifo = pipeline.addFifo<_DepthImageMsgPtr>( "depth_read_fifo", 2*16 );
+    auto infrared_image_read_fifo = pipeline.addFifo<_InfraredImageMsgPtr>( "infrared_read_fifo", 2*16 );
+    auto audio_read_fifo = pipeline.addFifo<_AudioMsgPtr>( "audio_read_fifo", 2*16 );
+    auto bodies_read_fifo = pipeline.addFifo<_BodiesMsgPtr>( "bodies_read_fifo", 2*16 );
+    auto speech_read_fifo = pipeline.addFifo<_SpeechMsgPtr>( "speech_read_fifo", 2*16 );
+
+    auto compress_fifo = pipeline.addFifo<_CodedMsgPtr>( "compress_fifo", 2*32 );
+    auto write_fifo = pipeline.addFifo<_CodedMsgPtr>( "write_fifo", 2*32 );
+
+    // every fifo is sized by what its messages hold rather than just counted, so a full color queue can't take hundreds of MB
+    color_image_read_fifo->setSizer( MessageByteSize() );
+    depth_image_read_fifo->setSizer( MessageByteSize() );
+    infrared_image_read_fifo->setSizer( MessageByteSize() );
+    audio_read_fifo->setSizer( MessageByteSize() );
+    bodies_read_fifo->setSizer( MessageByteSize() );
+    speech_read_fifo->setSizer( MessageByteSize() );
+    compress_fifo->setSizer( MessageByteSize() );
+    write_fifo->setSizer( MessageByteSize() );
+
+    color_image_read_fifo->setByteCapacity( 16*1024*1024 );
+    depth_image_read_fifo->setByteCapacity( 8*1024*1024 );
+    infrared_image_read_fifo->setByteCapacity( 8*1024*1024 );
+
+    // raw frames are by far the largest thing we hold, so the capture queues also share one overall limit. only they share it: their
+    // consumers never wait on each other, so freeing bytes never depends on a stage that's itself waiting for bytes
+    auto capture_budget = pipeline.addByteBudget( "capture_budget", 32*1024*1024 );
+    color_image_read_fifo->setByteBudget( capture_budget );
+    depth_image_read_fifo->setByteBudget( capture_budget );
+    infrared_image_read_fifo->setByteBudget( capture_budget );
+    audio_read_fifo->setByteBudget( capture_budget );
+    bodies_read_fifo->setByteBudget( capture_budget );
+    speech_read_fifo->setByteBudget( capture_budget );
+
+    // sources; stream readers aren't thread-safe, so there's never more than one worker per stream
+    pipeline.addSource( "color_read", streams.color_ ? 1 : 0, makeSequencedReader( ColorImageReader( frame_source ), gates ? &gates->color_ : NULL ), color_image_read_fifo );
+    pipeline.addSource( "depth_read", streams.depth_ ? 1 : 0, makeSequencedReader( DepthImageReader( frame_source ), gates ? &gates->depth_ : NULL ), depth_image_read_fifo );
+    pipeline.addSource( "infrared_read", streams.infrared_ ? 1 : 0, makeSequencedReader( InfraredImageReader( frame_source ), gates ? &gates->infrared_ : NULL ), infrared_image_read_fifo );
+    pipeline.addSource( "audio_read", streams.audio_ ? 1 : 0, makeSequencedReader( AudioReader( frame_source ), gates ? &gates->audio_ : NULL ), audio_read_fifo );
+    pipeline.addSource( "bodies_read", streams.bodies_ ? 1 : 0, makeSequencedReader( BodiesReader( frame_source ), gates ? &gates->bodies_ : NULL ), bodies_read_fifo );
+    pipeline.addSource( "speech_read", streams.speech_ ? 1 : 0, makeSequencedReader( SpeechReader( frame_source ), gates ? &gates->speech_ : NULL ), speech_read_fifo );
+
+    // compression; all streams share one pool of threads, so cores go to whichever streams currently have a backlog
+    // low-rate, latency-sensitive streams get the highest priority; the minimum shares keep every enabled stream moving under load
+    auto compress_pool = pipeline.addPool( "compress_pool" );
+
+    compress_pool->addStage( pipeline.addStage( "color_compress", 0, color_image_read_fifo, MessageCompressor<_BinaryMessageCoder>( _BinaryMessageCoder(), 1 ), compress_fifo ), 0, 2 );
+    compress_pool->addStage( pipeline.addStage( "depth_compress", 0, depth_image_read_fifo, MessageCompressor<_BinaryMessageCoder>( _BinaryMessageCoder(), 1 ), compress_fifo ), 1, 1 );
+    compress_pool->addStage( pipeline.addStage( "infrared_compress", 0, infrared_image_read_fifo, MessageCompressor<_BinaryMessageCoder>( _BinaryMessageCoder(), 1 ), compress_fifo ), 1, 1 );
+    compress_pool->addStage( pipeline.addStage( "audio_compress", 0, audio_read_fifo, MessageCompressor<_GZipMessageCoder>( _GZipMessageCoder( 1 ) ), compress_fifo ), 2, 1 );
+    compress_pool->addStage( pipeline.addStage( "bodies_compress", 0, bodies_read_fifo, MessageCompressor<_BinaryMessageCoder>(), compress_fifo ), 3, 1 );
+    compress_pool->addStage( pipeline.addStage( "speech_compress", 0, speech_read_fifo, MessageCompressor<_BinaryMessageCoder>(), compress_fifo ), 3, 0 );
+
+    std::vector<uint32_t> synced_stream_ids;
+    if( synced_streams.color_ ) synced_stream_ids.push_back( _ColorImageMsg::ID() );
+    if( synced_streams.depth_ ) synced_stream_ids.push_back( _DepthImageMsg::ID() );
+    if( synced_streams.infrared_ ) synced_stream_ids.push_back( _InfraredImageMsg::ID() );
+    if( synced_streams.audio_ ) synced_stream_ids.push_back( _AudioMsg::ID() );
+    if( synced_streams.bodies_ ) synced_stream_ids.push_back( _BodiesMsg::ID() );
+    if( synced_streams.speech_ ) synced_stream_ids.push_back( _SpeechMsg::ID() );
+
+    // put each stream back in capture order, then bundle the synced streams; bundling needs every stream in order, so it comes second
+    auto sync_fifo = synced_stream_ids.empty() ? write_fifo : pipeline.addFifo<_CodedMsgPtr>( "sync_fifo", 2*32 );
+    sync_fifo->setSizer( MessageByteSize() );
+
+    auto reorder_stage = pipeline.add( std::make_shared<_ReorderStage>( "reorder", compress_fifo, sync_fifo ) );
+    if( sync_fifo != write_fifo ) pipeline.add( std::make_shared<_SyncStage>( "sync", sync_fifo, write_fifo, synced_stream_ids, std::chrono::milliseconds( 10 ), std::chrono::milliseconds( 100 ), 8, FrameBundler( synced_stream_ids.size() ) ) );
+
+    // every fifo upstream of the reorder stage may be configured to drop frames; sync_fifo and write_fifo are past it, so their drops need
+    // no bookkeeping (a synced frame dropped from sync_fifo just leaves its bundle incomplete)
+    skipWhenDropped( color_image_read_fifo, reorder_stage.get() );
+    skipWhenDropped( depth_image_read_fifo, reorder_stage.get() );
+    skipWhenDropped( infrared_image_read_fifo, reorder_stage.get() );
+    skipWhenDropped( audio_read_fifo, reorder_stage.get() );
+    skipWhenDropped( bodies_read_fifo, reorder_stage.get() );
+    skipWhenDropped( speech_read_fifo, reorder_stage.get() );
+    skipWhenDropped( compress_fifo, reorder_stage.get(), CodedMessageSequencer() );
+
+    // output
+    pipeline.addSink( "write", 1, write_fifo, sink_fn );
+}
+
+// ####################################################################################################
+// bring up only the streams that have read workers configured
+inline void initializeFrameSource( KinectFrameSource & frame_source, atomics::Pipeline const & pipeline )
+{
+    auto const enabled = [&]( std::string const & name ){ return pipeline.getStage( name )->numWorkers() > 0; };
+
+    frame_source.initialize( enabled( "color_read" ), enabled( "depth_read" ), enabled( "infrared_read" ), enabled( "audio_read" ), enabled( "bodies_read" ), enabled( "speech_read" ) );
+}
+
+// ####################################################################################################
+// where frames come from: the sensor itself ("kinect", windows only) or generated test patterns at the sensor's rates ("synthetic")
+// config, if given, supplies the synthetic.* keys
+#ifdef _WIN32
+static char const * const DEFAULT_FRAME_SOURCE = "kinect";
+#else
+static char const * const DEFAULT_FRAME_SOURCE = "synthetic";
+#endif
+
+inline std::unique_ptr<KinectFrameSource> makeFrameSource( std::string const & name, Poco::Util::AbstractConfiguration const * config = NULL )
+{
+    if( name == "synthetic" )
+    {
+        std::unique_ptr<SyntheticFrameSource> synthetic_source_ptr( new SyntheticFrameSource() );
+        if( config ) synthetic_source_ptr->configure( *config );
+        return std::move( synthetic_source_ptr );
+    }
+#ifdef _WIN32
+    if( name == "kinect" ) return std::unique_ptr<KinectFrameSource>( new KinectDevice() );
+#endif
+
+    throw std::invalid_argument( "unknown frame source: " + name );
+}
+
+#endif // _KINECT_SERVER_KINECT_PIPELINE_H_
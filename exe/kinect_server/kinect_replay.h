@@ -0,0 +1,231 @@
+#ifndef _KINECT_SERVER_KINECT_REPLAY_H_
+#define _KINECT_SERVER_KINECT_REPLAY_H_
+
+// plays a kinect_logger .pak file back through the output side of the pipeline, without a sensor
+//
+// the log already holds encoded CodedMessages in (per-stream) capture order, so replay is a single source stage reading them into
+// write_fifo, followed by the caller's sink. messages are sent when their capture time comes around again, scaled by a speed factor, or
+// as fast as the sink will take them. configuration keys:
+//   pipeline.replay_read.workers     1 (more are safe, but only take turns)
+//   pipeline.write_fifo.capacity
+//   pipeline.write_fifo.overflow
+//   pipeline.write_fifo.max_kb
+
+#include <map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <cstdlib>
+
+#include "kinect_pipeline.h"
+
+#include <messages/input_log_device.h>
+#include <messages/peek_time_stamp.h>
+
+// ####################################################################################################
+// maps message stamps (100 ns ticks) onto wall-clock send times
+//
+// the sensor's frame streams share one clock, but speech phrases are stamped on the audio clock and some messages aren't stamped at all.
+// a stream whose first stamp is far from where the replay currently is gets shifted to start right there; unstamped messages go out as
+// soon as they're reached, which keeps them in step with the stamped messages around them in the log
+class ReplayClock
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+    typedef _Clock::time_point _TimePoint;
+
+    // stamps further than this from the replay's current position are taken to be on a different clock
+    static int64_t const MAX_CLOCK_SKEW = 10LL * 10000000LL;
+
+protected:
+    double speed_;
+
+    bool started_;
+    _TimePoint start_time_;
+    int64_t start_stamp_;
+    int64_t current_stamp_;
+
+    std::map<uint32_t, int64_t> stream_offsets_;
+
+public:
+    // speed <= 0 means as fast as possible
+    ReplayClock( double speed = 1 )
+    :
+        speed_( speed ),
+        started_( false ),
+        start_stamp_( 0 ),
+        current_stamp_( 0 )
+    {
+        //
+    }
+
+    // when the given message should be sent
+    _TimePoint due( uint32_t stream, uint64_t stamp, _TimePoint const & now = _Clock::now() )
+    {
+        if( speed_ <= 0 || stamp == 0 ) return now;
+
+        auto stream_offset_it = stream_offsets_.find( stream );
+        if( stream_offset_it == stream_offsets_.end() )
+        {
+            if( !started_ )
+            {
+                started_ = true;
+                start_time_ = now;
+                start_stamp_ = current_stamp_ = static_cast<int64_t>( stamp );
+            }
+
+            int64_t const skew = current_stamp_ - static_cast<int64_t>( stamp );
+            stream_offset_it = stream_offsets_.insert( std::make_pair( stream, std::llabs( skew ) > MAX_CLOCK_SKEW ? skew : 0 ) ).first;
+        }
+
+        int64_t const replay_stamp = static_cast<int64_t>( stamp ) + stream_offset_it->second;
+        if( replay_stamp > current_stamp_ ) current_stamp_ = replay_stamp;
+
+        // 100 ns ticks since the start of the replay, scaled
+        auto const offset = std::chrono::duration<double, std::ratio<1, 10000000> >( ( replay_stamp - start_stamp_ ) / speed_ );
+
+        return start_time_ + std::chrono::duration_cast<_Clock::duration>( offset );
+    }
+
+    double speed() const
+    {
+        return speed_;
+    }
+};
+
+// ####################################################################################################
+// source reading a log and releasing its messages on the ReplayClock's schedule
+// copies share the same log and schedule behind a mutex; replay_read is given one worker, as more would only take turns
+class LogReplayer
+{
+public:
+    typedef ReplayClock::_Clock _Clock;
+    typedef ReplayClock::_TimePoint _TimePoint;
+    typedef std::mutex _Mutex;
+    typedef std::unique_lock<_Mutex> _Lock;
+
+protected:
+    struct State
+    {
+        // guards everything below but finished_
+        _Mutex mutex_;
+
+        InputLogDevice input_device_;
+        ReplayClock replay_clock_;
+
+        // the next message, read but not yet due
+        _CodedMsgPtr message_ptr_;
+        _TimePoint due_time_;
+        uint64_t sequence_;
+
+        std::atomic<bool> finished_;
+
+        State( std::string const & input_path, double speed )
+        :
+            input_device_( input_path ),
+            replay_clock_( speed ),
+            sequence_( 0 ),
+            finished_( false )
+        {
+            //
+        }
+    };
+
+    std::shared_ptr<State> state_ptr_;
+
+public:
+    // throws MessageException if the log can't be opened
+    LogReplayer( std::string const & input_path, double speed = 1 )
+    :
+        state_ptr_( std::make_shared<State>( input_path, speed ) )
+    {
+        //
+    }
+
+    bool operator()( _CodedMsgPtr & output_message_ptr )
+    {
+        auto & state = *state_ptr_;
+
+        if( state.finished_ )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( KINECT_READ_TIMEOUT_MS ) );
+            return false;
+        }
+
+        _Lock lock( state.mutex_ );
+
+        if( !state.message_ptr_ )
+        {
+            auto message_ptr = std::make_shared<_CodedMsg>();
+
+            try
+            {
+                if( !state.input_device_.pull( *message_ptr ) )
+                {
+                    state.finished_ = true;
+                    return false;
+                }
+            }
+            catch( messages::MessageException & e )
+            {
+                std::cout << e.what() << std::endl;
+                state.finished_ = true;
+                return false;
+            }
+
+            // the log holds each stream in order, so a single running count keeps the messages ordered for anything downstream
+            message_ptr->sequence_ = state.sequence_++;
+
+            state.due_time_ = state.replay_clock_.due( message_ptr->header_.payload_id_, peekTimeStamp( *message_ptr ) );
+            state.message_ptr_ = message_ptr;
+        }
+
+        // sleep in short steps so we notice when we've been stopped, without holding the lock
+        auto const now = _Clock::now();
+        if( now < state.due_time_ )
+        {
+            auto const wait_time = std::min<_Clock::duration>( state.due_time_ - now, std::chrono::milliseconds( KINECT_READ_TIMEOUT_MS ) );
+            lock.unlock();
+            std::this_thread::sleep_for( wait_time );
+            lock.lock();
+
+            // another copy may have sent it in the meantime
+            if( !state.message_ptr_ || _Clock::now() < state.due_time_ ) return false;
+        }
+
+        // a replayed message is "captured" when it's released; it's already encoded, so it has no dequeue or encode stamps
+        state.message_ptr_->trace_.mark( LatencyTraceMessage::Stage::CAPTURE );
+
+        output_message_ptr = std::move( state.message_ptr_ );
+        state.message_ptr_.reset();
+
+        return true;
+    }
+
+    // true once the whole log has been read
+    bool finished() const
+    {
+        return state_ptr_->finished_;
+    }
+
+    uint64_t numMessages() const
+    {
+        _Lock lock( state_ptr_->mutex_ );
+        return state_ptr_->input_device_.numMessages();
+    }
+};
+
+// ####################################################################################################
+// add a replay source for the given log, followed by a sink consuming write_fifo
+template<class __SinkFn>
+void buildReplayPipeline( atomics::Pipeline & pipeline, LogReplayer const & log_replayer, __SinkFn sink_fn )
+{
+    auto write_fifo = pipeline.addFifo<_CodedMsgPtr>( "write_fifo", 2*32 );
+    write_fifo->setSizer( MessageByteSize() );
+
+    pipeline.addSource( "replay_read", 1, log_replayer, write_fifo );
+    pipeline.addSink( "write", 1, write_fifo, sink_fn );
+}
+
+#endif // _KINECT_SERVER_KINECT_REPLAY_H_
@@ -0,0 +1,114 @@
+#ifndef _KINECT_SERVER_METRICS_HTTP_SERVER_H_
+#define _KINECT_SERVER_METRICS_HTTP_SERVER_H_
+
+#include <string>
+#include <sstream>
+#include <iostream>
+
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+
+#include <atomics/metrics.h>
+#include <atomics/trace.h>
+
+// ####################################################################################################
+// answers GET /metrics with everything in the registry, in the Prometheus text format, and GET /trace with whatever the tracer has
+// recorded so far, as Chrome trace JSON (see atomics::Tracer); anything else gets a 404
+class MetricsRequestHandler : public Poco::Net::HTTPRequestHandler
+{
+protected:
+    atomics::MetricsRegistry const & registry_;
+
+public:
+    MetricsRequestHandler( atomics::MetricsRegistry const & registry )
+    :
+        registry_( registry )
+    {
+        //
+    }
+
+    void handleRequest( Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPServerResponse & response )
+    {
+        if( request.getURI() == "/metrics" )
+        {
+            std::string const body = registry_.write();
+
+            response.setContentType( "text/plain; version=0.0.4" );
+            response.setContentLength( body.size() );
+            response.send() << body;
+        }
+        else if( request.getURI() == "/trace" && atomics::Tracer::instance().enabled() )
+        {
+            std::stringstream body;
+            atomics::Tracer::instance().writeChromeTrace( body );
+
+            response.setContentType( "application/json" );
+            response.setContentLength( body.str().size() );
+            response.send() << body.str();
+        }
+        else
+        {
+            response.setStatusAndReason( Poco::Net::HTTPResponse::HTTP_NOT_FOUND );
+            response.setContentType( "text/plain" );
+            response.send() << "metrics are at /metrics, and with --chrome-trace, a trace at /trace\n";
+        }
+    }
+};
+
+class MetricsRequestHandlerFactory : public Poco::Net::HTTPRequestHandlerFactory
+{
+protected:
+    atomics::MetricsRegistry const & registry_;
+
+public:
+    MetricsRequestHandlerFactory( atomics::MetricsRegistry const & registry )
+    :
+        registry_( registry )
+    {
+        //
+    }
+
+    Poco::Net::HTTPRequestHandler * createRequestHandler( Poco::Net::HTTPServerRequest const & )
+    {
+        return new MetricsRequestHandler( registry_ );
+    }
+};
+
+// ####################################################################################################
+// serves the registry on http://<address>:<port>/metrics from its own thread until destroyed; scrapes are rare, so one thread is plenty
+// throws Poco::Exception if the port can't be bound
+class MetricsHTTPServer
+{
+protected:
+    Poco::Net::HTTPServer server_;
+
+    static Poco::Net::HTTPServerParams::Ptr makeParams()
+    {
+        Poco::Net::HTTPServerParams::Ptr params = new Poco::Net::HTTPServerParams();
+        params->setMaxThreads( 1 );
+        params->setKeepAlive( false );
+        return params;
+    }
+
+public:
+    MetricsHTTPServer( atomics::MetricsRegistry const & registry, std::string const & address, uint16_t port )
+    :
+        server_( new MetricsRequestHandlerFactory( registry ), Poco::Net::ServerSocket( Poco::Net::SocketAddress( address, port ) ), makeParams() )
+    {
+        server_.start();
+        std::cout << "serving metrics on http://" << server_.socket().address().toString() << "/metrics" << std::endl;
+    }
+
+    ~MetricsHTTPServer()
+    {
+        server_.stop();
+    }
+};
+
+#endif // _KINECT_SERVER_METRICS_HTTP_SERVER_H_
@@ -0,0 +1,204 @@
+// exports the bodies and the audio beam angles of a message log as column files (see messages/column_file.h and messages/kinect_columns.h),
+// and with --info, lists a column file's columns and scans every value of it once to show how quickly that goes
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+
+#include <messages/kinect_messages.h>
+#include <messages/wav_audio_message.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+#include <messages/message_coder.h>
+#include <messages/mapped_log.h>
+#include <messages/column_file.h>
+#include <messages/kinect_columns.h>
+
+typedef std::chrono::steady_clock _Clock;
+
+// decodes a message of the given type with whichever codec it was encoded with
+template<class __Message>
+void decodeMessage( __Message & message, MappedLog::_CodedMessage const & coded_message )
+{
+    if( coded_message.header_.encoding_ == GZipCodec<>::ID() ) MessageCoder<GZipCodec<> >().decode( message, coded_message );
+    else if( coded_message.header_.encoding_ == BinaryCodec<>::ID() ) MessageCoder<BinaryCodec<> >().decode( message, coded_message );
+    else throw messages::MessageException( "unknown encoding " + std::to_string( coded_message.header_.encoding_ ) );
+}
+
+// sum of the column's values that are numbers, and how many there were
+template<class __Value>
+void sumColumn( ColumnFile const & input_file, ColumnFile::ColumnInfo const & column_info, double & sum, uint64_t & count )
+{
+    auto const column = input_file.column<__Value>( column_info.name_ );
+    uint64_t const num_values = column.num_rows_ * column.width_;
+
+    for( uint64_t value_idx = 0; value_idx < num_values; ++value_idx )
+    {
+        double const value = static_cast<double>( column.data_[value_idx] );
+        if( std::isnan( value ) ) continue;
+
+        sum += value;
+        ++count;
+    }
+}
+
+int printInfo( std::string const & input_path )
+{
+    ColumnFile input_file( input_path );
+
+    std::cout << input_path << ": " << input_file.numRows() << " rows, " << input_file.columns().size() << " columns" << std::endl;
+
+    uint64_t total_size = 0;
+    auto const scan_start = _Clock::now();
+
+    for( auto column_it = input_file.columns().begin(); column_it != input_file.columns().end(); ++column_it )
+    {
+        double sum = 0;
+        uint64_t count = 0;
+
+        switch( column_it->type_ )
+        {
+        case column_file::ColumnType::UINT8: sumColumn<uint8_t>( input_file, *column_it, sum, count ); break;
+        case column_file::ColumnType::UINT32: sumColumn<uint32_t>( input_file, *column_it, sum, count ); break;
+        case column_file::ColumnType::UINT64: sumColumn<uint64_t>( input_file, *column_it, sum, count ); break;
+        case column_file::ColumnType::FLOAT32: sumColumn<float>( input_file, *column_it, sum, count ); break;
+        }
+
+        total_size += input_file.numRows() * column_it->width_ * column_file::valueSize( column_it->type_ );
+
+        std::cout << std::setw( 32 ) << std::left << column_it->name_ << std::right << " " << std::setw( 7 ) << column_file::typeName( column_it->type_ ) << " x " << column_it->width_
+                  << " mean: " << ( count > 0 ? sum / count : 0 ) << " (" << count << " values)" << std::endl;
+    }
+
+    double const scan_time = std::chrono::duration<double>( _Clock::now() - scan_start ).count();
+    std::cout << "scanned " << total_size / 1024 << " KB in " << std::setprecision( 3 ) << scan_time << " s (" << ( scan_time > 0 ? total_size / ( 1024.0 * 1024.0 ) / scan_time : 0 ) << " MB/s)" << std::endl;
+
+    return 0;
+}
+
+int main( int argc, char ** argv )
+{
+    std::string input_path;
+    std::string output_dir = ".";
+    size_t num_workers = 0;
+    size_t batch_size = 1024;
+    bool info = false;
+    bool usage = false;
+
+    for( int i = 1; i < argc && !usage; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            usage = true;
+        }
+        else if( arg == "--info" )
+        {
+            info = true;
+        }
+        else if( arg == "--output-dir" && i + 1 < argc )
+        {
+            output_dir = argv[++i];
+        }
+        else if( arg == "--workers" && i + 1 < argc )
+        {
+            num_workers = static_cast<size_t>( std::atoi( argv[++i] ) );
+        }
+        else if( input_path.empty() ) input_path = arg;
+        else usage = true;
+    }
+
+    if( usage || input_path.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <input .pak> [options]" << std::endl;
+        std::cout << "       " << argv[0] << " --info <column file>" << std::endl;
+        std::cout << "writes <output dir>/<input name>-bodies.columns and <output dir>/<input name>-audio.columns" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --output-dir <dir> (default: .)" << std::endl;
+        std::cout << "  --workers <decode threads> (default: one per hardware thread)" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        if( info ) return printInfo( input_path );
+
+        auto const start = _Clock::now();
+
+        MappedLog mapped_log( input_path );
+        if( mapped_log.truncated() ) std::cout << input_path << " ends partway through a message; everything before that is exported" << std::endl;
+
+        Poco::File( output_dir ).createDirectories();
+        std::string const base_path = Poco::Path( Poco::Path::forDirectory( output_dir ), Poco::Path( input_path ).getBaseName() ).toString();
+
+        // bodies have to be decoded, so they're decoded a batch at a time on all cores, then added in log order
+        KinectBodyColumns body_columns;
+        auto const & body_message_numbers = mapped_log.stream( KinectBodiesMessage::ID() ).messageNumbers();
+
+        std::vector<KinectBodiesMessage> bodies_messages( batch_size );
+        std::vector<size_t> batch_message_numbers;
+
+        for( size_t batch_start = 0; batch_start < body_message_numbers.size(); batch_start += batch_size )
+        {
+            size_t const batch_end = std::min( batch_start + batch_size, body_message_numbers.size() );
+            batch_message_numbers.assign( body_message_numbers.begin() + batch_start, body_message_numbers.begin() + batch_end );
+
+            mapped_log.parallelFor( batch_message_numbers, [&]( size_t message_number, MappedLog::_CodedMessage const & coded_message )
+            {
+                size_t const batch_idx = std::lower_bound( batch_message_numbers.begin(), batch_message_numbers.end(), message_number ) - batch_message_numbers.begin();
+                decodeMessage( bodies_messages[batch_idx], coded_message );
+            }, num_workers );
+
+            for( size_t batch_idx = 0; batch_idx < batch_message_numbers.size(); ++batch_idx )
+            {
+                body_columns.append( bodies_messages[batch_idx] );
+            }
+        }
+
+        // the audio info is at the end of each audio message, and can be read without unpacking the audio
+        KinectAudioInfoColumns audio_info_columns;
+        auto const audio_stream = mapped_log.stream( KinectAudioMessage<WAVAudioMessage<> >::ID() );
+
+        for( auto audio_it = audio_stream.begin(); audio_it != audio_stream.end(); ++audio_it )
+        {
+            KinectAudioInfoMessage audio_info;
+            uint64_t stamp = 0;
+            if( peekAudioInfo( *audio_it, audio_info, stamp ) ) audio_info_columns.append( audio_info, stamp );
+        }
+
+        if( body_columns.numRows() > 0 )
+        {
+            body_columns.write( base_path + "-bodies.columns" );
+            std::cout << base_path << "-bodies.columns: " << body_columns.numRows() << " bodies in " << body_columns.numFrames() << " frames" << std::endl;
+        }
+
+        if( audio_info_columns.numRows() > 0 )
+        {
+            audio_info_columns.write( base_path + "-audio.columns" );
+            std::cout << base_path << "-audio.columns: " << audio_info_columns.numRows() << " beam angles" << std::endl;
+        }
+
+        double const export_time = std::chrono::duration<double>( _Clock::now() - start ).count();
+        std::cout << "exported in " << std::setprecision( 3 ) << export_time << " s" << std::endl;
+    }
+    catch( Poco::Exception & e )
+    {
+        std::cout << e.displayText() << std::endl;
+        return 1;
+    }
+    catch( std::exception & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+// summarizes a message log per stream and, with --decode, decodes every message on all cores to check the log and measure decode speed
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <map>
+#include <functional>
+#include <cstdlib>
+
+#include <messages/kinect_messages.h>
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+#include <messages/message_coder.h>
+#include <messages/mapped_log.h>
+
+// decodes a message of the given type with whichever codec it was encoded with
+template<class __Message>
+void decodeMessage( MappedLog::_CodedMessage const & coded_message )
+{
+    __Message message;
+
+    if( coded_message.header_.encoding_ == GZipCodec<>::ID() ) MessageCoder<GZipCodec<> >().decode( message, coded_message );
+    else if( coded_message.header_.encoding_ == BinaryCodec<>::ID() ) MessageCoder<BinaryCodec<> >().decode( message, coded_message );
+    else throw messages::MessageException( "unknown encoding " + std::to_string( coded_message.header_.encoding_ ) );
+}
+
+struct StreamInfo
+{
+    std::string name_;
+    std::function<void( MappedLog::_CodedMessage const & )> decode_fn_;
+
+    StreamInfo( std::string const & name = "unknown", std::function<void( MappedLog::_CodedMessage const & )> decode_fn = std::function<void( MappedLog::_CodedMessage const & )>() )
+    :
+        name_( name ),
+        decode_fn_( decode_fn )
+    {
+        //
+    }
+};
+
+int main( int argc, char ** argv )
+{
+    std::string input_path;
+    bool decode = false;
+    size_t num_workers = 0;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            input_path.clear();
+            break;
+        }
+        else if( arg == "--decode" )
+        {
+            decode = true;
+        }
+        else if( arg == "--workers" && i + 1 < argc )
+        {
+            num_workers = static_cast<size_t>( std::atoi( argv[++i] ) );
+        }
+        else input_path = arg;
+    }
+
+    if( input_path.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <input .pak> [options]" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --decode (decode every message, in parallel)" << std::endl;
+        std::cout << "  --workers <decode threads> (default: one per hardware thread)" << std::endl;
+        return 1;
+    }
+
+    std::map<uint32_t, StreamInfo> streams;
+    streams[KinectColorImageMessage<PNGImageMessage<> >::ID()] = StreamInfo( "color", &decodeMessage<KinectColorImageMessage<PNGImageMessage<> > > );
+    streams[KinectDepthImageMessage<PNGImageMessage<> >::ID()] = StreamInfo( "depth", &decodeMessage<KinectDepthImageMessage<PNGImageMessage<> > > );
+    streams[KinectInfraredImageMessage<PNGImageMessage<> >::ID()] = StreamInfo( "infrared", &decodeMessage<KinectInfraredImageMessage<PNGImageMessage<> > > );
+    // WAVAudioMessage can't be unpacked from a binary stream yet, so audio is only counted
+    streams[KinectAudioMessage<WAVAudioMessage<> >::ID()] = StreamInfo( "audio" );
+    streams[KinectBodiesMessage::ID()] = StreamInfo( "bodies", &decodeMessage<KinectBodiesMessage> );
+    streams[KinectSpeechMessage::ID()] = StreamInfo( "speech", &decodeMessage<KinectSpeechMessage> );
+
+    try
+    {
+        auto const scan_start = std::chrono::steady_clock::now();
+        MappedLog mapped_log( input_path );
+        double const scan_time = std::chrono::duration<double>( std::chrono::steady_clock::now() - scan_start ).count();
+
+        std::cout << input_path << ": " << ( mapped_log.version() == 0 ? "legacy" : "version " + std::to_string( mapped_log.version() ) ) << ", "
+                  << mapped_log.size() << " messages, " << mapped_log.mappedSize() / ( 1024 * 1024 ) << " MB (scanned in " << scan_time << " s)" << std::endl;
+        if( mapped_log.truncated() ) std::cout << "the log ends partway through a message; everything before that is shown" << std::endl;
+
+        auto const payload_ids = mapped_log.payloadIds();
+        for( auto payload_id_it = payload_ids.begin(); payload_id_it != payload_ids.end(); ++payload_id_it )
+        {
+            auto const stream = mapped_log.stream( *payload_id_it );
+            auto const stream_info_it = streams.find( *payload_id_it );
+            std::string const name = stream_info_it == streams.end() ? std::to_string( *payload_id_it ) : stream_info_it->second.name_;
+
+            uint64_t encoded_size = 0;
+            uint64_t decoded_size = 0;
+            for( auto message_number_it = stream.messageNumbers().begin(); message_number_it != stream.messageNumbers().end(); ++message_number_it )
+            {
+                auto const & entry = mapped_log.entry( *message_number_it );
+                encoded_size += entry.size_;
+                decoded_size += entry.header_.decoded_size_;
+            }
+
+            std::cout << std::setw( 12 ) << std::left << name << std::right << " messages: " << std::setw( 8 ) << stream.size()
+                      << " encoded: " << std::setw( 8 ) << encoded_size / 1024 << " KB"
+                      << " decoded: " << std::setw( 8 ) << decoded_size / 1024 << " KB";
+
+            if( decode && stream_info_it != streams.end() && stream_info_it->second.decode_fn_ )
+            {
+                auto const & decode_fn = stream_info_it->second.decode_fn_;
+                auto const decode_start = std::chrono::steady_clock::now();
+
+                mapped_log.parallelFor( *payload_id_it, [&]( size_t, MappedLog::_CodedMessage const & coded_message ){ decode_fn( coded_message ); }, num_workers );
+
+                double const decode_time = std::chrono::duration<double>( std::chrono::steady_clock::now() - decode_start ).count();
+                std::cout << " decoded in: " << std::setprecision( 3 ) << decode_time << " s (" << ( decode_time > 0 ? stream.size() / decode_time : 0 ) << " msgs/s, "
+                          << ( decode_time > 0 ? encoded_size / ( 1024.0 * 1024.0 ) / decode_time : 0 ) << " MB/s)";
+            }
+
+            std::cout << std::endl;
+        }
+    }
+    catch( std::exception & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
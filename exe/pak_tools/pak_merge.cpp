@@ -0,0 +1,132 @@
+// merges several message logs into one, in time stamp order, eg: per-stream logs made by pak_split, or the logs of several sensors
+// recorded side by side. messages are copied as they are; only their headers (and stamps) are read, so this runs about as fast as the disk
+//
+// the inputs are each assumed to be in order already. messages without a stamp of their own (0) stay next to the message before them in
+// their log. the logs' messages don't say which sensor they came from, so merging several sensors' logs mixes their streams together
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+
+#include <messages/mapped_log.h>
+#include <messages/output_log_device.h>
+
+// the next message of one input
+struct MergeCursor
+{
+    // the larger of the message's stamp and every stamp before it in its log
+    uint64_t stamp_;
+    size_t input_idx_;
+    size_t message_number_;
+
+    MergeCursor( uint64_t stamp = 0, size_t input_idx = 0, size_t message_number = 0 )
+    :
+        stamp_( stamp ),
+        input_idx_( input_idx ),
+        message_number_( message_number )
+    {
+        //
+    }
+
+    // for the priority queue, which puts the largest first: earliest stamp first, then inputs in the order given
+    bool operator<( MergeCursor const & other ) const
+    {
+        if( stamp_ != other.stamp_ ) return stamp_ > other.stamp_;
+        return input_idx_ > other.input_idx_;
+    }
+};
+
+int main( int argc, char ** argv )
+{
+    std::string output_path;
+    std::vector<std::string> input_paths;
+    uint32_t sync_interval = 64;
+    uint32_t index_interval = 1;
+    bool usage = false;
+
+    for( int i = 1; i < argc && !usage; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            usage = true;
+        }
+        else if( arg == "--sync-interval" && i + 1 < argc )
+        {
+            sync_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( arg == "--index-interval" && i + 1 < argc )
+        {
+            index_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( output_path.empty() ) output_path = arg;
+        else input_paths.push_back( arg );
+    }
+
+    if( usage || input_paths.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <output .pak> <input .pak> [<input .pak> ...] [options]" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --sync-interval <messages> (default: 64)" << std::endl;
+        std::cout << "  --index-interval <messages> (default: 1)" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        auto const start = std::chrono::steady_clock::now();
+
+        std::vector<std::unique_ptr<MappedLog> > inputs;
+        for( auto input_path_it = input_paths.begin(); input_path_it != input_paths.end(); ++input_path_it )
+        {
+            inputs.push_back( std::unique_ptr<MappedLog>( new MappedLog( *input_path_it ) ) );
+            if( inputs.back()->truncated() ) std::cout << *input_path_it << " ends partway through a message; everything before that is merged" << std::endl;
+        }
+
+        OutputLogDevice output_log( output_path, sync_interval, index_interval );
+
+        std::priority_queue<MergeCursor> cursors;
+        for( size_t input_idx = 0; input_idx < inputs.size(); ++input_idx )
+        {
+            if( !inputs[input_idx]->empty() ) cursors.push( MergeCursor( inputs[input_idx]->timeStamp( 0 ), input_idx, 0 ) );
+        }
+
+        uint64_t num_messages = 0;
+        uint64_t total_size = 0;
+
+        while( !cursors.empty() )
+        {
+            MergeCursor const cursor = cursors.top();
+            cursors.pop();
+
+            MappedLog const & input = *inputs[cursor.input_idx_];
+
+            MappedLog::_CodedMessage coded_message = input[cursor.message_number_];
+            output_log.push( coded_message, input.timeStamp( cursor.message_number_ ) );
+
+            ++num_messages;
+            total_size += coded_message.payload_.size_;
+
+            size_t const next_message_number = cursor.message_number_ + 1;
+            if( next_message_number < input.size() ) cursors.push( MergeCursor( std::max( cursor.stamp_, input.timeStamp( next_message_number ) ), cursor.input_idx_, next_message_number ) );
+        }
+
+        output_log.close();
+
+        double const merge_time = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        std::cout << "merged " << num_messages << " messages (" << total_size / ( 1024 * 1024 ) << " MB) from " << inputs.size() << " logs into " << output_path << " in "
+                  << std::setprecision( 3 ) << merge_time << " s (" << ( merge_time > 0 ? total_size / ( 1024.0 * 1024.0 ) / merge_time : 0 ) << " MB/s)" << std::endl;
+    }
+    catch( std::exception & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+// repairs logs that were never closed (eg: the logger crashed): cuts off the torn final record and, unless told not to, rebuilds the index
+// works in place; logs that were closed cleanly are left alone. see messages/log_recovery.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <messages/log_recovery.h>
+
+int main( int argc, char ** argv )
+{
+    std::vector<std::string> paths;
+    bool rebuild_index = true;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            paths.clear();
+            break;
+        }
+        else if( arg == "--no-index" )
+        {
+            rebuild_index = false;
+        }
+        else paths.push_back( arg );
+    }
+
+    if( paths.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <.pak> [<.pak> ...] [options]" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --no-index (only cut off the torn record, starting from the last sync marker; much faster on large logs)" << std::endl;
+        return 1;
+    }
+
+    int result = 0;
+    for( auto path_it = paths.begin(); path_it != paths.end(); ++path_it )
+    {
+        try
+        {
+            LogRecovery const recovery = LogRecovery::recover( *path_it, rebuild_index );
+
+            if( recovery.was_closed_ ) std::cout << *path_it << ": closed cleanly; nothing to do" << std::endl;
+            else std::cout << *path_it << ": " << recovery.truncatedSize() << " bytes removed, " << ( recovery.indexed_ ? "index rebuilt for " + std::to_string( recovery.num_messages_ ) + " messages" : "no index" ) << std::endl;
+        }
+        catch( messages::MessageException & e )
+        {
+            std::cout << e.what() << std::endl;
+            result = 1;
+        }
+    }
+
+    return result;
+}
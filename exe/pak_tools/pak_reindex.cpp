@@ -0,0 +1,95 @@
+// copies a message log into the seekable format (see messages/log_format.h), giving it sync markers and a fresh index
+// works on legacy logs, logs that were never closed (and so have no index), and current ones (eg: to change the index interval)
+// the output is always a new file; the input is left alone
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include <messages/input_log_device.h>
+#include <messages/output_log_device.h>
+#include <messages/peek_time_stamp.h>
+
+int main( int argc, char ** argv )
+{
+    std::string input_path;
+    std::string output_path;
+    uint32_t sync_interval = 64;
+    uint32_t index_interval = 1;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            input_path.clear();
+            break;
+        }
+        else if( arg == "--sync-interval" && i + 1 < argc )
+        {
+            sync_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( arg == "--index-interval" && i + 1 < argc )
+        {
+            index_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( input_path.empty() ) input_path = arg;
+        else output_path = arg;
+    }
+
+    if( input_path.empty() || output_path.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <input .pak> <output .pak> [options]" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --sync-interval <messages between sync markers> (default: 64)" << std::endl;
+        std::cout << "  --index-interval <messages between index entries> (default: 1)" << std::endl;
+        return 1;
+    }
+
+    if( input_path == output_path )
+    {
+        std::cout << "the output has to be a different file from the input" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        InputLogDevice input_device( input_path );
+        std::cout << "reading " << input_path << " (" << ( input_device.version() == 0 ? "legacy" : "version " + std::to_string( input_device.version() ) ) << ", "
+                  << ( input_device.index().empty() ? "no index" : std::to_string( input_device.index().size() ) + " index entries" ) << ")" << std::endl;
+
+        OutputLogDevice output_device( output_path, sync_interval, index_interval );
+
+        bool truncated = false;
+        while( true )
+        {
+            CodedMessage<> coded_message;
+
+            try
+            {
+                if( !input_device.pull( coded_message ) ) break;
+            }
+            catch( messages::MessageException & e )
+            {
+                // keep everything up to the damage
+                std::cout << e.what() << std::endl;
+                truncated = true;
+                break;
+            }
+
+            output_device.push( coded_message, peekTimeStamp( coded_message ) );
+        }
+
+        output_device.close();
+
+        std::cout << "wrote " << output_device.numMessages() << " messages (" << output_device.numBytes() / 1024 << " KB) to " << output_path << std::endl;
+        if( truncated ) std::cout << "the input was damaged or cut short; everything before that point was kept" << std::endl;
+    }
+    catch( messages::MessageException & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
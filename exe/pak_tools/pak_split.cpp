@@ -0,0 +1,130 @@
+// splits a message log into one log per stream (payload id), eg: to hand out just the bodies or just the audio of a session
+// messages are copied as they are; only their headers are read, so this runs about as fast as the disk can go
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+
+#include <messages/mapped_log.h>
+#include <messages/output_log_device.h>
+
+#include "pak_streams.h"
+
+int main( int argc, char ** argv )
+{
+    std::string input_path;
+    std::string output_dir = ".";
+    std::set<std::string> stream_names;
+    uint32_t sync_interval = 64;
+    uint32_t index_interval = 1;
+    bool usage = false;
+
+    for( int i = 1; i < argc && !usage; ++i )
+    {
+        std::string const arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+        {
+            usage = true;
+        }
+        else if( arg == "--output-dir" && i + 1 < argc )
+        {
+            output_dir = argv[++i];
+        }
+        else if( arg == "--stream" && i + 1 < argc )
+        {
+            stream_names.insert( argv[++i] );
+        }
+        else if( arg == "--sync-interval" && i + 1 < argc )
+        {
+            sync_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( arg == "--index-interval" && i + 1 < argc )
+        {
+            index_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( input_path.empty() ) input_path = arg;
+        else usage = true;
+    }
+
+    if( usage || input_path.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <input .pak> [options]" << std::endl;
+        std::cout << "writes <output dir>/<input name>-<stream>.pak for each stream in the log" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --output-dir <dir> (default: .)" << std::endl;
+        std::cout << "  --stream <color|depth|infrared|audio|bodies|speech|payload id> (only split out this stream; may be repeated)" << std::endl;
+        std::cout << "  --sync-interval <messages> (default: 64)" << std::endl;
+        std::cout << "  --index-interval <messages> (default: 1)" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        auto const start = std::chrono::steady_clock::now();
+
+        MappedLog mapped_log( input_path );
+        if( mapped_log.truncated() ) std::cout << input_path << " ends partway through a message; everything before that is split" << std::endl;
+
+        Poco::File( output_dir ).createDirectories();
+        std::string const base_name = Poco::Path( input_path ).getBaseName();
+
+        // one log per stream, opened up front so the messages can be copied in a single pass in log order
+        std::map<uint32_t, std::unique_ptr<OutputLogDevice> > output_logs;
+        std::map<uint32_t, uint64_t> output_sizes;
+
+        auto const payload_ids = mapped_log.payloadIds();
+        for( auto payload_id_it = payload_ids.begin(); payload_id_it != payload_ids.end(); ++payload_id_it )
+        {
+            std::string const stream_name = streamName( *payload_id_it );
+            if( !stream_names.empty() && !stream_names.count( stream_name ) ) continue;
+
+            std::string const output_path = Poco::Path( Poco::Path::forDirectory( output_dir ), base_name + "-" + stream_name + ".pak" ).toString();
+            output_logs[*payload_id_it].reset( new OutputLogDevice( output_path, sync_interval, index_interval ) );
+        }
+
+        uint64_t total_size = 0;
+        for( size_t message_number = 0; message_number < mapped_log.size(); ++message_number )
+        {
+            auto const output_log_it = output_logs.find( mapped_log.entry( message_number ).header_.payload_id_ );
+            if( output_log_it == output_logs.end() ) continue;
+
+            MappedLog::_CodedMessage coded_message = mapped_log[message_number];
+            output_log_it->second->push( coded_message, mapped_log.timeStamp( message_number ) );
+
+            output_sizes[output_log_it->first] += coded_message.payload_.size_;
+            total_size += coded_message.payload_.size_;
+        }
+
+        for( auto output_log_it = output_logs.begin(); output_log_it != output_logs.end(); ++output_log_it )
+        {
+            output_log_it->second->close();
+
+            std::cout << std::setw( 12 ) << std::left << streamName( output_log_it->first ) << std::right << " messages: " << std::setw( 8 ) << mapped_log.stream( output_log_it->first ).size()
+                      << " size: " << std::setw( 8 ) << output_sizes[output_log_it->first] / 1024 << " KB -> " << output_log_it->second->outputPath() << std::endl;
+        }
+
+        double const split_time = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        std::cout << "split " << total_size / ( 1024 * 1024 ) << " MB in " << std::setprecision( 3 ) << split_time << " s (" << ( split_time > 0 ? total_size / ( 1024.0 * 1024.0 ) / split_time : 0 ) << " MB/s)" << std::endl;
+    }
+    catch( Poco::Exception & e )
+    {
+        std::cout << e.displayText() << std::endl;
+        return 1;
+    }
+    catch( std::exception & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
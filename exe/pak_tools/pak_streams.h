@@ -0,0 +1,34 @@
+#ifndef _PAK_TOOLS_PAK_STREAMS_H_
+#define _PAK_TOOLS_PAK_STREAMS_H_
+
+#include <map>
+#include <string>
+
+#include <messages/kinect_messages.h>
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+
+// the names the pak tools use for the Kinect streams, by payload id
+inline std::map<uint32_t, std::string> const & streamNames()
+{
+    static std::map<uint32_t, std::string> const stream_names
+    {
+        { KinectColorImageMessage<PNGImageMessage<> >::ID(), "color" },
+        { KinectDepthImageMessage<PNGImageMessage<> >::ID(), "depth" },
+        { KinectInfraredImageMessage<PNGImageMessage<> >::ID(), "infrared" },
+        { KinectAudioMessage<WAVAudioMessage<> >::ID(), "audio" },
+        { KinectBodiesMessage::ID(), "bodies" },
+        { KinectSpeechMessage::ID(), "speech" }
+    };
+
+    return stream_names;
+}
+
+// the stream's name, or its payload id for streams we don't know
+inline std::string streamName( uint32_t payload_id )
+{
+    auto const stream_name_it = streamNames().find( payload_id );
+    return stream_name_it == streamNames().end() ? std::to_string( payload_id ) : stream_name_it->second;
+}
+
+#endif // _PAK_TOOLS_PAK_STREAMS_H_
@@ -0,0 +1,386 @@
+// re-encodes selected streams of a message log with other codecs (or images with another PNG compression level) on all cores, and writes
+// the result to a new log in the original order with the original stamps; streams that aren't selected are copied as they are
+//
+// codecs work on the packed message, so any stream can move between them without being unpacked. changing the PNG compression level
+// means unpacking and repacking the images. audio can't be unpacked from a binary stream yet, so only its codec can be changed
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+
+#include <messages/kinect_messages.h>
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+#include <messages/message_coder.h>
+#include <messages/peek_time_stamp.h>
+#include <messages/mapped_log.h>
+#include <messages/output_log_device.h>
+
+#include "pak_streams.h"
+
+typedef MappedLog::_CodedMessage _CodedMessage;
+typedef CodecInterface<_CodedMessage> _Codec;
+typedef std::chrono::steady_clock _Clock;
+
+// codec id 0 (in encoding_) means "whatever the message is encoded with now"; compression levels < 0 leave the default alone
+struct StreamSettings
+{
+    uint32_t encoding_;
+    int gzip_level_;
+    int png_level_;
+
+    StreamSettings()
+    :
+        encoding_( 0 ),
+        gzip_level_( -1 ),
+        png_level_( -1 )
+    {
+        //
+    }
+
+    bool passThrough() const
+    {
+        return encoding_ == 0 && gzip_level_ < 0 && png_level_ < 0;
+    }
+};
+
+std::unique_ptr<_Codec> makeCodec( uint32_t encoding, int gzip_level = -1 )
+{
+    if( encoding == BinaryCodec<>::ID() ) return std::unique_ptr<_Codec>( new BinaryCodec<>() );
+    if( encoding == GZipCodec<>::ID() ) return std::unique_ptr<_Codec>( gzip_level >= 0 ? new GZipCodec<>( static_cast<uint8_t>( gzip_level ) ) : new GZipCodec<>() );
+    throw messages::MessageException( "unknown encoding " + std::to_string( encoding ) );
+}
+
+// re-encodes one coded message with the given settings
+typedef std::function<_CodedMessage( _CodedMessage const &, StreamSettings const & )> _TranscodeFn;
+
+// move the packed message from one codec to another, without unpacking it
+_CodedMessage recode( _CodedMessage const & coded_message, StreamSettings const & settings )
+{
+    uint32_t const encoding = settings.encoding_ != 0 ? settings.encoding_ : coded_message.header_.encoding_;
+
+    BinaryMessage<> const decoded_message = makeCodec( coded_message.header_.encoding_ )->decode( coded_message );
+    return makeCodec( encoding, settings.gzip_level_ )->encode( coded_message.header_.payload_id_, decoded_message );
+}
+
+template<class __Codec, class __Message>
+void decodeWith( __Message & message, _CodedMessage const & coded_message )
+{
+    MessageCoder<__Codec>().decode( message, coded_message );
+}
+
+// unpack an image message, set its PNG compression level, and pack it again
+template<class __Message>
+_CodedMessage repackImage( _CodedMessage const & coded_message, StreamSettings const & settings )
+{
+    if( settings.png_level_ < 0 ) return recode( coded_message, settings );
+
+    __Message message;
+    if( coded_message.header_.encoding_ == GZipCodec<>::ID() ) decodeWith<GZipCodec<> >( message, coded_message );
+    else if( coded_message.header_.encoding_ == BinaryCodec<>::ID() ) decodeWith<BinaryCodec<> >( message, coded_message );
+    else throw messages::MessageException( "unknown encoding " + std::to_string( coded_message.header_.encoding_ ) );
+
+    message.compression_level_ = settings.png_level_;
+
+    uint32_t const encoding = settings.encoding_ != 0 ? settings.encoding_ : coded_message.header_.encoding_;
+    if( encoding == GZipCodec<>::ID() ) return MessageCoder<GZipCodec<> >( settings.gzip_level_ >= 0 ? static_cast<uint8_t>( settings.gzip_level_ ) : 2 ).encode( message );
+    return MessageCoder<BinaryCodec<> >().encode( message );
+}
+
+struct StreamInfo
+{
+    std::string name_;
+    // NULL for streams that can't be repacked, only recoded
+    _TranscodeFn repack_fn_;
+
+    StreamSettings settings_;
+
+    uint64_t num_messages_;
+    uint64_t input_size_;
+    uint64_t output_size_;
+    // packed message sizes, before and after; they only differ for repacked images
+    uint64_t input_decoded_size_;
+    uint64_t output_decoded_size_;
+    // summed over all workers
+    double transcode_time_;
+
+    StreamInfo( std::string const & name = "unknown", _TranscodeFn repack_fn = _TranscodeFn() )
+    :
+        name_( name ),
+        repack_fn_( repack_fn ),
+        num_messages_( 0 ),
+        input_size_( 0 ),
+        output_size_( 0 ),
+        input_decoded_size_( 0 ),
+        output_decoded_size_( 0 ),
+        transcode_time_( 0 )
+    {
+        //
+    }
+};
+
+// one transcoded message of the batch being worked on; empty for messages that are copied as they are
+struct Result
+{
+    std::unique_ptr<_CodedMessage> coded_message_ptr_;
+    uint64_t stamp_;
+    double transcode_time_;
+
+    Result()
+    :
+        stamp_( 0 ),
+        transcode_time_( 0 )
+    {
+        //
+    }
+};
+
+// parse "<stream>=<value>" into its halves
+bool splitAssignment( std::string const & arg, std::string & stream_name, std::string & value )
+{
+    size_t const split_pos = arg.find( '=' );
+    if( split_pos == std::string::npos ) return false;
+
+    stream_name = arg.substr( 0, split_pos );
+    value = arg.substr( split_pos + 1 );
+    return true;
+}
+
+// apply fn to the settings of the named stream, or of every stream for "all"; false if there's no such stream
+bool applyToStreams( std::map<uint32_t, StreamInfo> & streams, std::string const & stream_name, std::function<void( StreamSettings & )> fn )
+{
+    bool found = false;
+    for( auto stream_it = streams.begin(); stream_it != streams.end(); ++stream_it )
+    {
+        if( stream_name != "all" && stream_name != stream_it->second.name_ ) continue;
+
+        fn( stream_it->second.settings_ );
+        found = true;
+    }
+
+    return found;
+}
+
+int main( int argc, char ** argv )
+{
+    // every stream the pak tools know can be recoded; only the images can be repacked
+    std::map<uint32_t, StreamInfo> streams;
+    for( auto stream_name_it = streamNames().begin(); stream_name_it != streamNames().end(); ++stream_name_it )
+    {
+        streams[stream_name_it->first] = StreamInfo( stream_name_it->second );
+    }
+
+    streams[KinectColorImageMessage<PNGImageMessage<> >::ID()].repack_fn_ = &repackImage<KinectColorImageMessage<PNGImageMessage<> > >;
+    streams[KinectDepthImageMessage<PNGImageMessage<> >::ID()].repack_fn_ = &repackImage<KinectDepthImageMessage<PNGImageMessage<> > >;
+    streams[KinectInfraredImageMessage<PNGImageMessage<> >::ID()].repack_fn_ = &repackImage<KinectInfraredImageMessage<PNGImageMessage<> > >;
+
+    std::string input_path;
+    std::string output_path;
+    size_t num_workers = 0;
+    size_t batch_size = 256;
+    uint32_t sync_interval = 64;
+    uint32_t index_interval = 1;
+    bool usage = false;
+
+    for( int i = 1; i < argc && !usage; ++i )
+    {
+        std::string const arg = argv[i];
+        std::string stream_name;
+        std::string value;
+
+        if( arg == "--help" || arg == "-h" )
+        {
+            usage = true;
+        }
+        else if( arg == "--codec" && i + 1 < argc && splitAssignment( argv[++i], stream_name, value ) )
+        {
+            // <codec>[:<level>]
+            size_t const split_pos = value.find( ':' );
+            std::string const codec_name = value.substr( 0, split_pos );
+            int const gzip_level = split_pos == std::string::npos ? -1 : std::atoi( value.substr( split_pos + 1 ).c_str() );
+
+            uint32_t encoding = 0;
+            if( codec_name == "binary" ) encoding = BinaryCodec<>::ID();
+            else if( codec_name == "gzip" ) encoding = GZipCodec<>::ID();
+
+            if( encoding == 0 || gzip_level > 9 )
+            {
+                std::cout << "unknown codec " << value << std::endl;
+                usage = true;
+            }
+            else if( !applyToStreams( streams, stream_name, [&]( StreamSettings & settings ){ settings.encoding_ = encoding; settings.gzip_level_ = gzip_level; } ) )
+            {
+                std::cout << "unknown stream " << stream_name << std::endl;
+                usage = true;
+            }
+        }
+        else if( arg == "--png-level" && i + 1 < argc && splitAssignment( argv[++i], stream_name, value ) )
+        {
+            int const png_level = std::atoi( value.c_str() );
+            if( png_level < 0 || png_level > 9 )
+            {
+                std::cout << "PNG compression levels go from 0 to 9" << std::endl;
+                usage = true;
+            }
+            else if( !applyToStreams( streams, stream_name, [&]( StreamSettings & settings ){ settings.png_level_ = png_level; } ) )
+            {
+                std::cout << "unknown stream " << stream_name << std::endl;
+                usage = true;
+            }
+        }
+        else if( arg == "--workers" && i + 1 < argc )
+        {
+            num_workers = static_cast<size_t>( std::atoi( argv[++i] ) );
+        }
+        else if( arg == "--batch" && i + 1 < argc )
+        {
+            batch_size = std::max( std::atoi( argv[++i] ), 1 );
+        }
+        else if( arg == "--sync-interval" && i + 1 < argc )
+        {
+            sync_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( arg == "--index-interval" && i + 1 < argc )
+        {
+            index_interval = static_cast<uint32_t>( std::atoi( argv[++i] ) );
+        }
+        else if( input_path.empty() ) input_path = arg;
+        else if( output_path.empty() ) output_path = arg;
+        else usage = true;
+    }
+
+    for( auto stream_it = streams.begin(); stream_it != streams.end() && !usage; ++stream_it )
+    {
+        if( stream_it->second.settings_.png_level_ >= 0 && !stream_it->second.repack_fn_ )
+        {
+            std::cout << "only images have a PNG compression level" << std::endl;
+            usage = true;
+        }
+    }
+
+    if( usage || input_path.empty() || output_path.empty() )
+    {
+        std::cout << "usage: " << argv[0] << " <input .pak> <output .pak> [options]" << std::endl;
+        std::cout << "streams: color, depth, infrared, audio, bodies, speech, or all" << std::endl;
+        std::cout << "options: " << std::endl;
+        std::cout << "  --codec <stream>=<binary|gzip[:<level>]> (re-encode the stream with this codec; gzip levels go from 0 to 9)" << std::endl;
+        std::cout << "  --png-level <stream>=<level> (repack the stream's images at this PNG compression level, 0 to 9)" << std::endl;
+        std::cout << "  --workers <transcode threads> (default: one per hardware thread)" << std::endl;
+        std::cout << "  --batch <messages> (messages transcoded between writes; default: 256)" << std::endl;
+        std::cout << "  --sync-interval <messages> (default: 64)" << std::endl;
+        std::cout << "  --index-interval <messages> (default: 1)" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        MappedLog mapped_log( input_path );
+        if( mapped_log.truncated() ) std::cout << input_path << " ends partway through a message; everything before that is transcoded" << std::endl;
+
+        OutputLogDevice output_log( output_path, sync_interval, index_interval );
+
+        // only ever read by the workers
+        std::map<uint32_t, StreamInfo> const & stream_infos = streams;
+        StreamInfo const unknown_stream;
+
+        std::vector<Result> results( batch_size );
+        std::vector<size_t> message_numbers;
+
+        auto const start = _Clock::now();
+
+        for( size_t batch_start = 0; batch_start < mapped_log.size(); batch_start += batch_size )
+        {
+            size_t const batch_end = std::min( batch_start + batch_size, mapped_log.size() );
+
+            message_numbers.clear();
+            for( size_t message_number = batch_start; message_number < batch_end; ++message_number )
+            {
+                message_numbers.push_back( message_number );
+            }
+
+            mapped_log.parallelFor( message_numbers, [&]( size_t message_number, _CodedMessage const & coded_message )
+            {
+                auto const stream_info_it = stream_infos.find( coded_message.header_.payload_id_ );
+                StreamInfo const & stream_info = stream_info_it == stream_infos.end() ? unknown_stream : stream_info_it->second;
+
+                Result & result = results[message_number - batch_start];
+                result.coded_message_ptr_.reset();
+                result.transcode_time_ = 0;
+
+                auto const transcode_start = _Clock::now();
+
+                if( !stream_info.settings_.passThrough() )
+                {
+                    result.coded_message_ptr_.reset( new _CodedMessage( stream_info.repack_fn_ ? stream_info.repack_fn_( coded_message, stream_info.settings_ ) : recode( coded_message, stream_info.settings_ ) ) );
+                }
+
+                // repacking leaves the message and its stamp alone, so the stamp can come from whichever copy is cheaper to read
+                result.stamp_ = peekTimeStamp( result.coded_message_ptr_ && result.coded_message_ptr_->header_.encoding_ == BinaryCodec<>::ID() ? *result.coded_message_ptr_ : coded_message );
+                result.transcode_time_ = std::chrono::duration<double>( _Clock::now() - transcode_start ).count();
+            }, num_workers );
+
+            // write in the original order
+            for( size_t message_number = batch_start; message_number < batch_end; ++message_number )
+            {
+                Result & result = results[message_number - batch_start];
+                _CodedMessage input_message = mapped_log[message_number];
+                _CodedMessage & output_message = result.coded_message_ptr_ ? *result.coded_message_ptr_ : input_message;
+
+                output_log.push( output_message, result.stamp_ );
+
+                auto const stream_info_it = streams.find( input_message.header_.payload_id_ );
+                if( stream_info_it == streams.end() ) streams[input_message.header_.payload_id_] = StreamInfo( std::to_string( input_message.header_.payload_id_ ) );
+
+                StreamInfo & stream_info = streams[input_message.header_.payload_id_];
+                ++stream_info.num_messages_;
+                stream_info.input_size_ += input_message.payload_.size_;
+                stream_info.output_size_ += output_message.payload_.size_;
+                stream_info.input_decoded_size_ += input_message.header_.decoded_size_;
+                stream_info.output_decoded_size_ += output_message.header_.decoded_size_;
+                stream_info.transcode_time_ += result.transcode_time_;
+
+                result.coded_message_ptr_.reset();
+            }
+        }
+
+        output_log.close();
+
+        double const total_time = std::chrono::duration<double>( _Clock::now() - start ).count();
+
+        std::cout << input_path << " -> " << output_path << ": " << mapped_log.size() << " messages in " << std::setprecision( 3 ) << total_time << " s" << std::endl;
+
+        for( auto stream_it = streams.begin(); stream_it != streams.end(); ++stream_it )
+        {
+            StreamInfo const & stream_info = stream_it->second;
+            if( stream_info.num_messages_ == 0 ) continue;
+
+            std::cout << std::setw( 12 ) << std::left << stream_info.name_ << std::right << " messages: " << std::setw( 8 ) << stream_info.num_messages_
+                      << " in: " << std::setw( 8 ) << stream_info.input_size_ / 1024 << " KB"
+                      << " out: " << std::setw( 8 ) << stream_info.output_size_ / 1024 << " KB"
+                      << " (" << std::setw( 6 ) << ( stream_info.input_size_ > 0 ? 100.0 * stream_info.output_size_ / stream_info.input_size_ : 0 ) << "%)"
+                      << " codec ratio: " << std::setw( 6 ) << ( stream_info.input_size_ > 0 ? static_cast<double>( stream_info.input_decoded_size_ ) / stream_info.input_size_ : 0 )
+                      << " -> " << std::setw( 6 ) << ( stream_info.output_size_ > 0 ? static_cast<double>( stream_info.output_decoded_size_ ) / stream_info.output_size_ : 0 );
+
+            // throughput per worker, of the packed messages going into the codecs
+            if( !stream_info.settings_.passThrough() ) std::cout << " " << ( stream_info.transcode_time_ > 0 ? stream_info.input_decoded_size_ / ( 1024.0 * 1024.0 ) / stream_info.transcode_time_ : 0 ) << " MB/s per worker";
+            else std::cout << " copied";
+
+            std::cout << std::endl;
+        }
+    }
+    catch( std::exception & e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
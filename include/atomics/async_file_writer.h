@@ -0,0 +1,518 @@
+#ifndef _ATOMICS_ASYNCFILEWRITER_H_
+#define _ATOMICS_ASYNCFILEWRITER_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <streambuf>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <atomics/fifo.h>
+
+namespace atomics
+{
+
+// streambuf writing a file from a dedicated thread, in large aligned blocks, so the producer only ever copies into memory
+//
+// the producer fills one block while the flusher thread writes out the others; it only waits (a "stall") if every block is full. blocks are
+// written with the page cache bypassed where the platform and file system allow it (O_DIRECT, FILE_FLAG_NO_BUFFERING), and the file is
+// preallocated ahead of the writes so it isn't extended a block at a time. the last, partial block is written by close()
+//
+// wrap it in a std::ostream to use it; tellp() gives the number of bytes written so far. flush() doesn't write anything, so data reaches the
+// disk a block at a time, and whatever is still in memory is lost if the process dies. a failed write puts the stream in a bad state and
+// every write after it fails; error() says what happened
+class AsyncFileWriter : public std::streambuf
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+
+    // block sizes and file offsets are kept to multiples of this for unbuffered I/O
+    static size_t const ALIGNMENT = 4096;
+
+    struct Settings
+    {
+        // bytes per block; rounded up to a multiple of ALIGNMENT
+        size_t block_size_;
+        // blocks in flight between the producer and the flusher, at least 2
+        size_t num_blocks_;
+        // the file is grown this far ahead of the writes; 0 to not preallocate
+        uint64_t preallocate_size_;
+        // bypass the page cache if possible
+        bool direct_io_;
+
+        Settings( size_t block_size = 4 * 1024 * 1024, size_t num_blocks = 2, uint64_t preallocate_size = 256 * 1024 * 1024, bool direct_io = true )
+        :
+            block_size_( block_size ),
+            num_blocks_( num_blocks ),
+            preallocate_size_( preallocate_size ),
+            direct_io_( direct_io )
+        {
+            //
+        }
+    };
+
+protected:
+    struct FilledBlock
+    {
+        size_t block_idx_;
+        size_t size_;
+
+        FilledBlock( size_t block_idx = 0, size_t size = 0 )
+        :
+            block_idx_( block_idx ),
+            size_( size )
+        {
+            //
+        }
+    };
+
+    std::string path_;
+    Settings settings_;
+
+#ifdef _WIN32
+    HANDLE file_handle_;
+#else
+    int file_descriptor_;
+#endif
+    // cleared by the flusher if the file system refuses unbuffered writes
+    std::atomic<bool> direct_io_;
+    bool open_;
+
+    std::vector<char *> blocks_;
+    size_t current_block_idx_;
+    // bytes handed to the flusher so far, ie: the file offset of the current block
+    uint64_t submitted_bytes_;
+
+    Fifo<FilledBlock> filled_blocks_;
+    Fifo<size_t> free_blocks_;
+    std::thread flusher_thread_;
+
+    // only touched by the flusher until it's been joined
+    uint64_t allocated_bytes_;
+
+    std::atomic<bool> failed_;
+    mutable std::mutex error_mutex_;
+    std::string error_;
+
+    _Clock::time_point open_time_;
+    std::atomic<uint64_t> written_bytes_;
+    std::atomic<uint64_t> write_time_;
+    std::atomic<uint64_t> num_stalls_;
+    std::atomic<uint64_t> stall_time_;
+
+public:
+    // check isOpen() (or error()) afterwards, as with a std::ofstream
+    AsyncFileWriter( std::string const & path, Settings const & settings = Settings() )
+    :
+        path_( path ),
+        settings_( settings ),
+#ifdef _WIN32
+        file_handle_( INVALID_HANDLE_VALUE ),
+#else
+        file_descriptor_( -1 ),
+#endif
+        direct_io_( false ),
+        open_( false ),
+        current_block_idx_( 0 ),
+        submitted_bytes_( 0 ),
+        filled_blocks_( std::max<size_t>( settings.num_blocks_, 2 ) ),
+        free_blocks_( std::max<size_t>( settings.num_blocks_, 2 ) ),
+        allocated_bytes_( 0 ),
+        failed_( false ),
+        open_time_( _Clock::now() ),
+        written_bytes_( 0 ),
+        write_time_( 0 ),
+        num_stalls_( 0 ),
+        stall_time_( 0 )
+    {
+        settings_.block_size_ = ( settings_.block_size_ + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+        if( settings_.block_size_ == 0 ) settings_.block_size_ = ALIGNMENT;
+        settings_.num_blocks_ = std::max<size_t>( settings_.num_blocks_, 2 );
+
+        if( !openFile() ) return;
+        open_ = true;
+
+        for( size_t block_idx = 0; block_idx < settings_.num_blocks_; ++block_idx )
+        {
+            blocks_.push_back( allocateBlock( settings_.block_size_ ) );
+            if( block_idx > 0 ) free_blocks_.push( block_idx );
+        }
+
+        setp( blocks_[0], blocks_[0] + settings_.block_size_ );
+
+        flusher_thread_ = std::thread( &AsyncFileWriter::flush, this );
+    }
+
+    ~AsyncFileWriter()
+    {
+        close();
+
+        for( auto block_it = blocks_.begin(); block_it != blocks_.end(); ++block_it )
+        {
+            freeBlock( *block_it );
+        }
+    }
+
+    // write out whatever is buffered, trim the preallocated space, and close the file; returns false if any write failed
+    bool close()
+    {
+        if( !open_ ) return !failed_;
+        open_ = false;
+
+        size_t const tail_size = static_cast<size_t>( pptr() - pbase() );
+        char * const tail_block = blocks_[current_block_idx_];
+        setp( NULL, NULL );
+
+        filled_blocks_.close();
+        flusher_thread_.join();
+
+        // the tail is written padded out to a whole aligned block, then the file is cut back to its real length
+        if( !failed_ && tail_size > 0 )
+        {
+            size_t const padded_size = ( tail_size + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+            std::memset( tail_block + tail_size, 0, padded_size - tail_size );
+            writeBlock( tail_block, padded_size );
+            if( !failed_ ) written_bytes_ -= padded_size - tail_size;
+        }
+
+        submitted_bytes_ += tail_size;
+        closeFile( submitted_bytes_ );
+
+        return !failed_;
+    }
+
+    bool isOpen() const
+    {
+        return open_;
+    }
+
+    // why the last write failed; empty if nothing has
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock( error_mutex_ );
+        return error_;
+    }
+
+    std::string const & path() const
+    {
+        return path_;
+    }
+
+    // false if the file system wouldn't let us bypass the page cache
+    bool directIO() const
+    {
+        return direct_io_;
+    }
+
+    // bytes accepted so far, whether or not they've reached the disk yet
+    uint64_t position() const
+    {
+        return submitted_bytes_ + static_cast<uint64_t>( pptr() - pbase() );
+    }
+
+    // bytes the flusher has written out
+    uint64_t writtenBytes() const
+    {
+        return written_bytes_;
+    }
+
+    // times the producer found every block full and had to wait, and for how long in total (us)
+    uint64_t numStalls() const
+    {
+        return num_stalls_;
+    }
+
+    uint64_t stallTime() const
+    {
+        return stall_time_;
+    }
+
+    // MB/s written since the file was opened, and MB/s while actually writing (ie: what the disk is giving us)
+    double sustainedRate() const
+    {
+        double const elapsed = std::chrono::duration<double>( _Clock::now() - open_time_ ).count();
+        return elapsed > 0 ? written_bytes_ / ( 1024.0 * 1024.0 ) / elapsed : 0;
+    }
+
+    double writeRate() const
+    {
+        return write_time_ > 0 ? written_bytes_ / ( 1024.0 * 1024.0 ) / ( write_time_ / 1000000.0 ) : 0;
+    }
+
+    void printMetrics( std::ostream & out ) const
+    {
+        std::ios::fmtflags const flags = out.flags();
+        std::streamsize const precision = out.precision();
+
+        out << std::setw( 24 ) << std::left << "log writer" << std::right
+            << " written: " << std::setw( 8 ) << writtenBytes() / ( 1024 * 1024 ) << " MB"
+            << " sustained: " << std::setw( 6 ) << std::fixed << std::setprecision( 1 ) << sustainedRate() << " MB/s"
+            << " disk: " << std::setw( 6 ) << writeRate() << " MB/s"
+            << " stalls: " << numStalls() << " (" << stallTime() / 1000 << " ms)"
+            << ( direct_io_ ? "" : " (buffered)" ) << std::endl;
+
+        out.flags( flags );
+        out.precision( precision );
+    }
+
+protected:
+    // the current block is full
+    virtual int_type overflow( int_type c )
+    {
+        if( !nextBlock() ) return traits_type::eof();
+        if( traits_type::eq_int_type( c, traits_type::eof() ) ) return traits_type::not_eof( c );
+
+        *pptr() = traits_type::to_char_type( c );
+        pbump( 1 );
+        return c;
+    }
+
+    // large writes (eg: image payloads) are copied straight across blocks
+    virtual std::streamsize xsputn( char const * data, std::streamsize size )
+    {
+        std::streamsize written = 0;
+        while( written < size )
+        {
+            if( pptr() == epptr() && !nextBlock() ) break;
+
+            std::streamsize const chunk_size = std::min<std::streamsize>( size - written, epptr() - pptr() );
+            std::memcpy( pptr(), data + written, static_cast<size_t>( chunk_size ) );
+            pbump( static_cast<int>( chunk_size ) );
+            written += chunk_size;
+        }
+
+        return written;
+    }
+
+    // nothing is written until a block fills up; just report whether the writes so far have worked
+    virtual int sync()
+    {
+        return failed_ ? -1 : 0;
+    }
+
+    // only tellp() is supported
+    virtual pos_type seekoff( off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode )
+    {
+        if( offset != 0 || direction != std::ios_base::cur || !( mode & std::ios_base::out ) ) return pos_type( off_type( -1 ) );
+        return pos_type( static_cast<off_type>( position() ) );
+    }
+
+    // hand the current block to the flusher and start on a free one, waiting for one if need be
+    bool nextBlock()
+    {
+        if( !open_ || failed_ ) return false;
+
+        size_t const size = static_cast<size_t>( pptr() - pbase() );
+        filled_blocks_.push( FilledBlock( current_block_idx_, size ) );
+        submitted_bytes_ += size;
+
+        if( !free_blocks_.tryPop( current_block_idx_ ) )
+        {
+            auto const stall_start = _Clock::now();
+            free_blocks_.pop( current_block_idx_ );
+
+            ++num_stalls_;
+            stall_time_ += std::chrono::duration_cast<std::chrono::microseconds>( _Clock::now() - stall_start ).count();
+        }
+
+        setp( blocks_[current_block_idx_], blocks_[current_block_idx_] + settings_.block_size_ );
+        return !failed_;
+    }
+
+    // flusher thread; writes blocks in the order they were filled until the producer closes us
+    void flush()
+    {
+        FilledBlock filled_block;
+        while( filled_blocks_.pop( filled_block ) )
+        {
+            // keep consuming blocks after a failure, so the producer never waits on us
+            if( !failed_ )
+            {
+                preallocate( written_bytes_ + filled_block.size_ );
+                writeBlock( blocks_[filled_block.block_idx_], filled_block.size_ );
+            }
+
+            free_blocks_.push( filled_block.block_idx_ );
+        }
+    }
+
+    void fail( std::string const & error )
+    {
+        std::lock_guard<std::mutex> lock( error_mutex_ );
+        if( error_.empty() ) error_ = "Failed to write " + path_ + ": " + error;
+        failed_ = true;
+    }
+
+    // make sure the file has room for at least the given number of bytes, growing it a whole preallocation step at a time
+    void preallocate( uint64_t size )
+    {
+        if( settings_.preallocate_size_ == 0 || size <= allocated_bytes_ ) return;
+
+        allocated_bytes_ = size + settings_.preallocate_size_;
+
+#ifdef _WIN32
+        FILE_ALLOCATION_INFO allocation_info;
+        allocation_info.AllocationSize.QuadPart = static_cast<LONGLONG>( allocated_bytes_ );
+        SetFileInformationByHandle( file_handle_, FileAllocationInfo, &allocation_info, sizeof( allocation_info ) );
+#elif defined( __linux__ ) && defined( FALLOC_FL_KEEP_SIZE )
+        // keep the file's size as it is, so readers only see what's been written; not every file system can do this, which is fine
+        fallocate( file_descriptor_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>( written_bytes_ ), static_cast<off_t>( allocated_bytes_ - written_bytes_ ) );
+#endif
+    }
+
+    static char * allocateBlock( size_t size )
+    {
+#ifdef _WIN32
+        return static_cast<char *>( _aligned_malloc( size, ALIGNMENT ) );
+#else
+        void * block = NULL;
+        if( posix_memalign( &block, ALIGNMENT, size ) != 0 ) throw std::bad_alloc();
+        return static_cast<char *>( block );
+#endif
+    }
+
+    static void freeBlock( char * block )
+    {
+#ifdef _WIN32
+        _aligned_free( block );
+#else
+        std::free( block );
+#endif
+    }
+
+#ifdef _WIN32
+    bool openFile()
+    {
+        DWORD const flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+
+        if( settings_.direct_io_ )
+        {
+            file_handle_ = CreateFileA( path_.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, flags | FILE_FLAG_NO_BUFFERING, NULL );
+            direct_io_ = file_handle_ != INVALID_HANDLE_VALUE;
+        }
+
+        if( file_handle_ == INVALID_HANDLE_VALUE ) file_handle_ = CreateFileA( path_.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, flags, NULL );
+
+        if( file_handle_ == INVALID_HANDLE_VALUE )
+        {
+            fail( "error " + std::to_string( GetLastError() ) + " opening the file" );
+            return false;
+        }
+
+        return true;
+    }
+
+    void writeBlock( char const * data, size_t size )
+    {
+        auto const write_start = _Clock::now();
+
+        DWORD written = 0;
+        if( !WriteFile( file_handle_, data, static_cast<DWORD>( size ), &written, NULL ) || written != size )
+        {
+            fail( "error " + std::to_string( GetLastError() ) );
+            return;
+        }
+
+        written_bytes_ += size;
+        write_time_ += std::chrono::duration_cast<std::chrono::microseconds>( _Clock::now() - write_start ).count();
+    }
+
+    // cut off the tail's padding and any preallocated space, and close
+    void closeFile( uint64_t size )
+    {
+        if( file_handle_ == INVALID_HANDLE_VALUE ) return;
+
+        LARGE_INTEGER end_of_file;
+        end_of_file.QuadPart = static_cast<LONGLONG>( size );
+        if( !SetFilePointerEx( file_handle_, end_of_file, NULL, FILE_BEGIN ) || !SetEndOfFile( file_handle_ ) ) fail( "error " + std::to_string( GetLastError() ) + " truncating the file" );
+
+        CloseHandle( file_handle_ );
+        file_handle_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    bool openFile()
+    {
+        int const flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef O_DIRECT
+        if( settings_.direct_io_ )
+        {
+            file_descriptor_ = ::open( path_.c_str(), flags | O_DIRECT, 0644 );
+            direct_io_ = file_descriptor_ >= 0;
+        }
+#endif
+
+        if( file_descriptor_ < 0 ) file_descriptor_ = ::open( path_.c_str(), flags, 0644 );
+
+        if( file_descriptor_ < 0 )
+        {
+            fail( std::string( "opening the file: " ) + std::strerror( errno ) );
+            return false;
+        }
+
+        return true;
+    }
+
+    void writeBlock( char const * data, size_t size )
+    {
+        auto const write_start = _Clock::now();
+
+        for( size_t written = 0; written < size; )
+        {
+            ssize_t const result = ::write( file_descriptor_, data + written, size - written );
+            if( result < 0 )
+            {
+                if( errno == EINTR ) continue;
+
+#ifdef O_DIRECT
+                // some file systems accept O_DIRECT when opening, then refuse the writes
+                if( errno == EINVAL && direct_io_ && written == 0 )
+                {
+                    direct_io_ = false;
+                    fcntl( file_descriptor_, F_SETFL, fcntl( file_descriptor_, F_GETFL ) & ~O_DIRECT );
+                    continue;
+                }
+#endif
+
+                fail( std::strerror( errno ) );
+                return;
+            }
+
+            written += static_cast<size_t>( result );
+        }
+
+        written_bytes_ += size;
+        write_time_ += std::chrono::duration_cast<std::chrono::microseconds>( _Clock::now() - write_start ).count();
+    }
+
+    // cut off the tail's padding and any preallocated space, and close
+    void closeFile( uint64_t size )
+    {
+        if( file_descriptor_ < 0 ) return;
+
+        if( ftruncate( file_descriptor_, static_cast<off_t>( size ) ) != 0 ) fail( std::string( "truncating the file: " ) + std::strerror( errno ) );
+        if( ::close( file_descriptor_ ) != 0 ) fail( std::string( "closing the file: " ) + std::strerror( errno ) );
+        file_descriptor_ = -1;
+    }
+#endif
+};
+
+} // atomics
+
+#endif // _ATOMICS_ASYNCFILEWRITER_H_
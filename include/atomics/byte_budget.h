@@ -0,0 +1,135 @@
+#ifndef _ATOMICS_BYTE_BUDGET_H_
+#define _ATOMICS_BYTE_BUDGET_H_
+
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <memory>
+
+#include <atomics/trace.h>
+
+namespace atomics
+{
+
+// a number of bytes shared by several fifos, so the total memory held in them stays bounded no matter which of them are busy
+//
+// a capacity of 0 means unlimited. a single item larger than the whole budget is still let through when nothing else is held, otherwise
+// it could never be pushed at all
+//
+// only share a budget between fifos whose consumers never wait on each other (eg: every stream's capture queue); if the consumer of one
+// budgeted fifo pushes into another, it can end up waiting for bytes that only it could free
+class ByteBudget
+{
+public:
+    typedef std::shared_ptr<ByteBudget> _Ptr;
+    typedef std::mutex _Mutex;
+    typedef std::unique_lock<_Mutex> _Lock;
+
+protected:
+    size_t capacity_;
+    size_t bytes_;
+    size_t peak_bytes_;
+
+    mutable _Mutex mutex_;
+    std::condition_variable bytes_available_condition_;
+
+public:
+    ByteBudget( size_t capacity = 0 )
+    :
+        capacity_( capacity ),
+        bytes_( 0 ),
+        peak_bytes_( 0 )
+    {
+        //
+    }
+
+    // block until the given number of bytes is available and take them; returns false (without taking anything) if abort() becomes true
+    // first; abort() is called with the budget locked, so it must not call back into the budget
+    template<class __Abort>
+    bool acquire( size_t bytes, __Abort abort )
+    {
+        _Lock lock( mutex_ );
+        TraceScope const wait_scope( abort() || fits( bytes ) ? NULL : "ByteBudget::acquire wait" );
+        bytes_available_condition_.wait( lock, [&](){ return abort() || fits( bytes ); } );
+
+        if( abort() ) return false;
+
+        take( bytes );
+        return true;
+    }
+
+    // take the given number of bytes only if they're available right now, or unconditionally if force is set
+    bool tryAcquire( size_t bytes, bool force = false )
+    {
+        _Lock lock( mutex_ );
+
+        if( !force && !fits( bytes ) ) return false;
+
+        take( bytes );
+        return true;
+    }
+
+    void release( size_t bytes )
+    {
+        {
+            _Lock lock( mutex_ );
+            bytes_ -= std::min( bytes, bytes_ );
+        }
+
+        bytes_available_condition_.notify_all();
+    }
+
+    // wake everyone blocked in acquire() so they re-check their abort condition
+    void wake()
+    {
+        {
+            _Lock lock( mutex_ );
+        }
+
+        bytes_available_condition_.notify_all();
+    }
+
+    size_t capacity() const
+    {
+        _Lock lock( mutex_ );
+        return capacity_;
+    }
+
+    void setCapacity( size_t capacity )
+    {
+        {
+            _Lock lock( mutex_ );
+            capacity_ = capacity;
+        }
+
+        bytes_available_condition_.notify_all();
+    }
+
+    size_t bytes() const
+    {
+        _Lock lock( mutex_ );
+        return bytes_;
+    }
+
+    size_t peakBytes() const
+    {
+        _Lock lock( mutex_ );
+        return peak_bytes_;
+    }
+
+protected:
+    bool fits( size_t bytes ) const
+    {
+        return capacity_ == 0 || bytes_ == 0 || bytes_ + bytes <= capacity_;
+    }
+
+    void take( size_t bytes )
+    {
+        bytes_ += bytes;
+        peak_bytes_ = std::max( peak_bytes_, bytes_ );
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_BYTE_BUDGET_H_
@@ -0,0 +1,543 @@
+#ifndef _ATOMICS_FIFO_H_
+#define _ATOMICS_FIFO_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+
+#include <atomics/byte_budget.h>
+#include <atomics/trace.h>
+#include <atomics/lock_stats.h>
+
+namespace atomics
+{
+
+// type-independent interface to a Fifo, so pipelines can configure and report on their queues without knowing what's in them
+class FifoBase
+{
+public:
+    typedef std::function<void()> _Listener;
+
+    // what push() does when the fifo is full
+    enum class OverflowPolicy
+    {
+        // wait for space; nothing is ever lost, but a slow consumer eventually stalls the producer
+        BLOCK,
+        // make room by discarding the oldest queued items, so the fifo always holds the newest ones
+        DROP_OLDEST,
+        // discard the incoming item and keep what's queued
+        DROP_NEWEST
+    };
+
+protected:
+    std::atomic<size_t> num_producers_;
+    std::atomic<OverflowPolicy> overflow_policy_;
+    std::atomic<uint64_t> num_dropped_;
+
+    // bytes currently queued and the most ever queued at once, as reported by the fifo's sizer
+    std::atomic<size_t> bytes_;
+    std::atomic<size_t> peak_bytes_;
+    // optional limit on the bytes held by this fifo together with any others sharing the budget; set before any threads use the fifo
+    ByteBudget::_Ptr byte_budget_;
+
+    // optional hooks for schedulers that multiplex many fifos onto a shared set of threads; set before any threads use the fifo
+    _Listener push_listener_;
+    _Listener close_listener_;
+
+    // NULL unless profileContention() was called
+    LockStats * lock_stats_;
+
+public:
+    FifoBase()
+    :
+        num_producers_( 0 ),
+        overflow_policy_( OverflowPolicy::BLOCK ),
+        num_dropped_( 0 ),
+        bytes_( 0 ),
+        peak_bytes_( 0 ),
+        lock_stats_( NULL )
+    {
+        //
+    }
+
+    virtual ~FifoBase()
+    {
+        //
+    }
+
+    virtual void close() = 0;
+    virtual bool closed() const = 0;
+    virtual size_t size() const = 0;
+    virtual size_t capacity() const = 0;
+    virtual void setCapacity( size_t capacity ) = 0;
+    // limit on the bytes held by this fifo alone; 0 means unlimited
+    virtual size_t byteCapacity() const = 0;
+    virtual void setByteCapacity( size_t byte_capacity ) = 0;
+
+    // when several producers share a fifo, each registers itself here; the fifo is closed when the last one is removed
+    void addProducer()
+    {
+        ++num_producers_;
+    }
+
+    void removeProducer()
+    {
+        if( --num_producers_ == 0 ) close();
+    }
+
+    size_t numProducers() const
+    {
+        return num_producers_;
+    }
+
+    void setOverflowPolicy( OverflowPolicy overflow_policy )
+    {
+        overflow_policy_ = overflow_policy;
+    }
+
+    OverflowPolicy overflowPolicy() const
+    {
+        return overflow_policy_;
+    }
+
+    // number of items discarded by a drop policy since construction
+    uint64_t numDropped() const
+    {
+        return num_dropped_;
+    }
+
+    size_t bytes() const
+    {
+        return bytes_;
+    }
+
+    size_t peakBytes() const
+    {
+        return peak_bytes_;
+    }
+
+    void setByteBudget( ByteBudget::_Ptr byte_budget_ptr )
+    {
+        byte_budget_ = byte_budget_ptr;
+    }
+
+    ByteBudget::_Ptr const & byteBudget() const
+    {
+        return byte_budget_;
+    }
+
+    // "block", "drop_oldest", or "drop_newest"; throws std::invalid_argument for anything else
+    static OverflowPolicy parseOverflowPolicy( std::string const & name )
+    {
+        if( name == "block" ) return OverflowPolicy::BLOCK;
+        if( name == "drop_oldest" ) return OverflowPolicy::DROP_OLDEST;
+        if( name == "drop_newest" ) return OverflowPolicy::DROP_NEWEST;
+        throw std::invalid_argument( "unknown fifo overflow policy: " + name );
+    }
+
+    static std::string overflowPolicyName( OverflowPolicy overflow_policy )
+    {
+        switch( overflow_policy )
+        {
+        case OverflowPolicy::DROP_OLDEST: return "drop_oldest";
+        case OverflowPolicy::DROP_NEWEST: return "drop_newest";
+        default: return "block";
+        }
+    }
+
+    // called (without any locks held) after every successful push
+    void setPushListener( _Listener listener )
+    {
+        push_listener_ = listener;
+    }
+
+    // called (without any locks held) after close()
+    void setCloseListener( _Listener listener )
+    {
+        close_listener_ = listener;
+    }
+
+    // count acquisitions of the fifo's lock, hold times, waits for items or space, and notifications in
+    // LockProfiler::instance().stats( name ); call before any threads use the fifo
+    void profileContention( std::string const & name )
+    {
+        lock_stats_ = &LockProfiler::instance().stats( name );
+    }
+
+    LockStats const * lockStats() const
+    {
+        return lock_stats_;
+    }
+
+protected:
+    void notifyPushListener()
+    {
+        if( push_listener_ ) push_listener_();
+    }
+
+    void notifyCloseListener()
+    {
+        if( close_listener_ ) close_listener_();
+    }
+};
+
+// bounded, blocking FIFO for passing items between threads
+// producers sleep until there is space available, consumers sleep until there is an item available; nobody polls
+// close() wakes everyone up: pushes fail immediately, pops keep succeeding until the remaining items are drained
+// with a drop policy, push() never waits; whatever doesn't fit is handed to the drop listener (if any) and counted instead
+//
+// besides the item count, the fifo can be bounded by bytes, both on its own and through a ByteBudget shared with other fifos; sizes come
+// from the sizer, which must give the same answer for an item every time. an empty fifo always accepts one item, however large
+template<class __Data>
+class Fifo : public FifoBase
+{
+public:
+    typedef __Data _Data;
+    typedef std::deque<__Data> _Container;
+    typedef std::mutex _Mutex;
+    typedef ProfiledLock<_Mutex> _Lock;
+    typedef std::function<void( __Data const & )> _DropListener;
+    typedef std::function<size_t( __Data const & )> _Sizer;
+
+protected:
+    _Container data_;
+    // the size of each item in data_, as given by the sizer when it was pushed
+    std::deque<size_t> item_bytes_;
+    size_t capacity_;
+    size_t byte_capacity_;
+    // only changed with the mutex held, but read without it while waiting on the byte budget
+    std::atomic<bool> closed_;
+    // set by wake() to make a blocked pop() / popFor() return without an item
+    bool woken_;
+
+    // called (without any locks held) for every item discarded by the overflow policy; set before any threads use the fifo
+    _DropListener drop_listener_;
+    // set before any threads use the fifo; without one every item counts as 0 bytes
+    _Sizer sizer_;
+
+    mutable _Mutex mutex_;
+    std::condition_variable item_available_condition_;
+    std::condition_variable space_available_condition_;
+
+public:
+    Fifo( size_t capacity = 32, OverflowPolicy overflow_policy = OverflowPolicy::BLOCK )
+    :
+        capacity_( capacity ),
+        byte_capacity_( 0 ),
+        closed_( false ),
+        woken_( false )
+    {
+        overflow_policy_ = overflow_policy;
+    }
+
+    void setDropListener( _DropListener drop_listener )
+    {
+        drop_listener_ = drop_listener;
+    }
+
+    void setSizer( _Sizer sizer )
+    {
+        sizer_ = sizer;
+    }
+
+    // push data, first making room for it according to the overflow policy; returns false if the fifo was closed
+    // an item discarded by a drop policy still counts as pushed, so producers carry on as normal
+    bool push( __Data data )
+    {
+        OverflowPolicy const overflow_policy = overflow_policy_;
+        size_t const bytes = sizer_ ? sizer_( data ) : 0;
+        std::vector<__Data> dropped;
+
+        if( overflow_policy == OverflowPolicy::BLOCK )
+        {
+            // take our share of the global budget first, then wait for room here; whoever pops from us gives it back
+            if( byte_budget_ && !byte_budget_->acquire( bytes, [this](){ return closed_.load(); } ) ) return false;
+
+            // decided under the lock: close() may come in as soon as we let go, and by then the item (and its bytes) belong to the fifo
+            bool pushed = false;
+            {
+                _Lock lock( mutex_, lock_stats_ );
+                TraceScope const wait_scope( closed_ || fits( bytes ) ? NULL : "Fifo::push wait" );
+                lock.wait( space_available_condition_, [&](){ return closed_ || fits( bytes ); } );
+
+                if( !closed_ )
+                {
+                    pushBack( std::move( data ), bytes );
+                    pushed = true;
+                }
+            }
+
+            if( !pushed )
+            {
+                if( byte_budget_ ) byte_budget_->release( bytes );
+                return false;
+            }
+        }
+        else
+        {
+            bool accepted = true;
+            {
+                _Lock lock( mutex_, lock_stats_ );
+
+                if( closed_ ) return false;
+
+                if( overflow_policy == OverflowPolicy::DROP_NEWEST )
+                {
+                    accepted = fits( bytes ) && ( !byte_budget_ || byte_budget_->tryAcquire( bytes, data_.empty() ) );
+                }
+                else
+                {
+                    // make room by throwing away our own oldest items; the budget can't take back what other fifos hold
+                    while( !data_.empty() && !fits( bytes ) ) dropped.push_back( popFront() );
+                    while( byte_budget_ && !byte_budget_->tryAcquire( bytes, data_.empty() ) ) dropped.push_back( popFront() );
+                }
+
+                if( accepted ) pushBack( std::move( data ), bytes );
+                else dropped.push_back( std::move( data ) );
+            }
+
+            if( !dropped.empty() ) notifyDropped( dropped );
+
+            // nothing was added, so there's nobody to wake
+            if( !accepted ) return true;
+        }
+
+        notifyOne( item_available_condition_ );
+        notifyPushListener();
+        return true;
+    }
+
+    // push data only if there is space for it right now; returns false if the fifo is full or closed
+    bool tryPush( __Data data )
+    {
+        size_t const bytes = sizer_ ? sizer_( data ) : 0;
+
+        {
+            _Lock lock( mutex_, lock_stats_ );
+
+            if( closed_ || !fits( bytes ) ) return false;
+            if( byte_budget_ && !byte_budget_->tryAcquire( bytes, data_.empty() ) ) return false;
+
+            pushBack( std::move( data ), bytes );
+        }
+
+        notifyOne( item_available_condition_ );
+        notifyPushListener();
+        return true;
+    }
+
+    // block until an item is available, then pop it into data; returns false once the fifo is closed and empty, or after a wake()
+    bool pop( __Data & data )
+    {
+        bool byte_bounded;
+        {
+            _Lock lock( mutex_, lock_stats_ );
+            TraceScope const wait_scope( closed_ || !data_.empty() ? NULL : "Fifo::pop wait" );
+            lock.wait( item_available_condition_, [this](){ return closed_ || woken_ || !data_.empty(); } );
+            woken_ = false;
+
+            if( data_.empty() ) return false;
+
+            data = popFront();
+            byte_bounded = byte_capacity_ > 0;
+        }
+
+        notifySpaceAvailable( byte_bounded );
+        return true;
+    }
+
+    // pop an item only if one is available right now
+    bool tryPop( __Data & data )
+    {
+        bool byte_bounded;
+        {
+            _Lock lock( mutex_, lock_stats_ );
+
+            if( data_.empty() ) return false;
+
+            data = popFront();
+            byte_bounded = byte_capacity_ > 0;
+        }
+
+        notifySpaceAvailable( byte_bounded );
+        return true;
+    }
+
+    // like pop(), but give up after the given duration
+    template<class __Rep, class __Period>
+    bool popFor( __Data & data, std::chrono::duration<__Rep, __Period> const & duration )
+    {
+        bool byte_bounded;
+        {
+            _Lock lock( mutex_, lock_stats_ );
+            TraceScope const wait_scope( closed_ || !data_.empty() ? NULL : "Fifo::pop wait" );
+            if( !lock.waitFor( item_available_condition_, duration, [this](){ return closed_ || woken_ || !data_.empty(); } ) ) return false;
+            woken_ = false;
+
+            if( data_.empty() ) return false;
+
+            data = popFront();
+            byte_bounded = byte_capacity_ > 0;
+        }
+
+        notifySpaceAvailable( byte_bounded );
+        return true;
+    }
+
+    // make a consumer blocked in pop() / popFor() return false without an item, so it can look at whatever else it is waiting on
+    // if nobody is waiting, the next pop() / popFor() on an empty fifo returns at once instead
+    void wake()
+    {
+        {
+            _Lock lock( mutex_, lock_stats_ );
+            woken_ = true;
+        }
+
+        notifyAll( item_available_condition_ );
+    }
+
+    // stop accepting new items and wake up everyone waiting on us
+    virtual void close()
+    {
+        {
+            _Lock lock( mutex_, lock_stats_ );
+            closed_ = true;
+        }
+
+        notifyAll( item_available_condition_ );
+        notifyAll( space_available_condition_ );
+        if( byte_budget_ ) byte_budget_->wake();
+        notifyCloseListener();
+    }
+
+    // accept new items again after a close()
+    void open()
+    {
+        _Lock lock( mutex_, lock_stats_ );
+        closed_ = false;
+    }
+
+    virtual bool closed() const
+    {
+        return closed_;
+    }
+
+    virtual size_t size() const
+    {
+        _Lock lock( mutex_, lock_stats_ );
+        return data_.size();
+    }
+
+    bool empty() const
+    {
+        _Lock lock( mutex_, lock_stats_ );
+        return data_.empty();
+    }
+
+    virtual size_t capacity() const
+    {
+        _Lock lock( mutex_, lock_stats_ );
+        return capacity_;
+    }
+
+    virtual void setCapacity( size_t capacity )
+    {
+        {
+            _Lock lock( mutex_, lock_stats_ );
+            capacity_ = capacity;
+        }
+
+        notifyAll( space_available_condition_ );
+    }
+
+    virtual size_t byteCapacity() const
+    {
+        _Lock lock( mutex_, lock_stats_ );
+        return byte_capacity_;
+    }
+
+    virtual void setByteCapacity( size_t byte_capacity )
+    {
+        {
+            _Lock lock( mutex_, lock_stats_ );
+            byte_capacity_ = byte_capacity;
+        }
+
+        notifyAll( space_available_condition_ );
+    }
+
+protected:
+    // whether an item of the given size fits within our own limits; call with the mutex held
+    bool fits( size_t bytes ) const
+    {
+        if( data_.empty() ) return capacity_ > 0;
+        return data_.size() < capacity_ && ( byte_capacity_ == 0 || bytes_ + bytes <= byte_capacity_ );
+    }
+
+    // call with the mutex held; the bytes must already have been taken from the budget, if there is one
+    void pushBack( __Data data, size_t bytes )
+    {
+        data_.push_back( std::move( data ) );
+        item_bytes_.push_back( bytes );
+
+        bytes_ += bytes;
+        if( bytes_ > peak_bytes_ ) peak_bytes_ = bytes_.load();
+    }
+
+    // call with the mutex held and data_ not empty; gives the item's bytes back to the budget
+    __Data popFront()
+    {
+        __Data data = std::move( data_.front() );
+        size_t const bytes = item_bytes_.front();
+
+        data_.pop_front();
+        item_bytes_.pop_front();
+
+        bytes_ -= bytes;
+        if( byte_budget_ ) byte_budget_->release( bytes );
+
+        return data;
+    }
+
+    // with a byte limit, the one producer we'd wake might be waiting for more room than was just freed while another would fit
+    void notifySpaceAvailable( bool byte_bounded )
+    {
+        if( byte_bounded ) notifyAll( space_available_condition_ );
+        else notifyOne( space_available_condition_ );
+    }
+
+    void notifyOne( std::condition_variable & condition )
+    {
+        if( lock_stats_ ) lock_stats_->countNotifyOne();
+        condition.notify_one();
+    }
+
+    void notifyAll( std::condition_variable & condition )
+    {
+        if( lock_stats_ ) lock_stats_->countNotifyAll();
+        condition.notify_all();
+    }
+
+    void notifyDropped( std::vector<__Data> const & dropped )
+    {
+        num_dropped_ += dropped.size();
+
+        if( !drop_listener_ ) return;
+        for( auto dropped_it = dropped.begin(); dropped_it != dropped.end(); ++dropped_it )
+        {
+            drop_listener_( *dropped_it );
+        }
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_FIFO_H_
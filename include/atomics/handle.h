@@ -9,6 +9,8 @@
 #include <cstdint>
 
 #include <atomics/exceptions.h>
+#include <atomics/trace.h>
+#include <atomics/lock_stats.h>
 //#include <atomics/print.h>
 
 namespace atomics
@@ -40,6 +42,9 @@ protected:
     std::atomic<uint8_t> _notify_destruct;
     std::atomic<uint8_t> _notify_policy;
 
+    // when lock_ was last taken; only kept if the wrapper is profiled (see Wrapper::profileContention())
+    uint64_t hold_start_;
+
 public:
     __Wrapper * wrapper_;
     _Lock lock_;
@@ -79,6 +84,7 @@ public:
     :
         _notify_destruct( other._notify_destruct.load() ),
         _notify_policy( other._notify_policy.load() ),
+        hold_start_( other.hold_start_ ),
         wrapper_( other.wrapper_ ),
         lock_( std::move( other.lock_ ) )
     {
@@ -89,6 +95,7 @@ public:
     :
         _notify_destruct( static_cast<uint8_t>( NotifyType::DELAY_NOTIFY_NONE ) ),
         _notify_policy( static_cast<uint8_t>( notify_policy ) ),
+        hold_start_( 0 ),
         wrapper_( wrapper ),
         lock_( wrapper->mutex_, std::defer_lock )
     {
@@ -122,6 +129,8 @@ public:
         {
 //            if( !name_.empty() ) std::cout << "Handle [" << name_ << "] unlocking" << std::endl;
 
+            if( wrapper_->lock_stats_ && lock_ ) wrapper_->lock_stats_->holdEnded( hold_start_ );
+
             // MSVCP 12 : no exception thrown for unlocking an unlocked lock
             // gcc 4.8.1 : throws std::errc::operation_not_permitted
             lock_.unlock();
@@ -163,7 +172,7 @@ public:
         {
             // MSVCP 12 : throws std::errc::device_or_resource_busy
             // gcc 4.8.1 : throws std::errc::operation_not_permitted
-            if( !lock_ ) lock_.lock();
+            if( !lock_ ) acquire( [this](){ lock_.lock(); return true; } );
         }
         catch( std::system_error & e )
         {
@@ -189,7 +198,7 @@ public:
         {
             // MSVCP 12 : throws std::errc::device_or_resource_busy
             // gcc 4.8.1 : throws std::errc::operation_not_permitted
-            is_locked = lock_ || lock_.try_lock();
+            is_locked = lock_ || acquire( [this](){ return lock_.try_lock(); } );
         }
         catch( std::system_error & e )
         {
@@ -218,7 +227,7 @@ public:
         {
             // MSVCP 12 : throws std::errc::device_or_resource_busy
             // gcc 4.8.1 : throws std::errc::operation_not_permitted
-            is_locked = lock_ || lock_.try_lock_for( duration );
+            is_locked = lock_ || acquire( [&](){ return lock_.try_lock_for( duration ); } );
         }
         catch( std::system_error & e )
         {
@@ -260,7 +269,7 @@ public:
         {
             // MSVCP 12 : throws std::errc::device_or_resource_busy
             // gcc 4.8.1 : throws std::errc::operation_not_permitted
-            if( !lock_ ) lock_.lock();
+            if( !lock_ ) acquire( [this](){ lock_.lock(); return true; } );
 //            if( !name_.empty() ) std::cout << "Handle [" << name_ << "] locked" << std::endl;
         }
         catch( std::system_error & e )
@@ -282,7 +291,12 @@ public:
 
 //        if( !name_.empty() ) std::cout << "Handle [" << name_ << "] waiting on condition" << std::endl;
 //        _Lock lock( wrapper_->condition_mutex_ );
+        ATOMICS_TRACE_SCOPE( "Handle::waitOn" );
+
+        LockStats * const lock_stats = wrapper_->lock_stats_;
+        if( lock_stats ) lock_stats->beginWait( hold_start_ );
         wrapper_->condition_.wait( lock_ );
+        if( lock_stats ) hold_start_ = lock_stats->endWait();
         return *this;
     }
 
@@ -316,7 +330,7 @@ public:
         {
             // MSVCP 12 : throws std::errc::device_or_resource_busy
             // gcc 4.8.1 : throws std::errc::operation_not_permitted
-            is_locked = lock_.try_lock_until( end_time );
+            is_locked = acquire( [&](){ return lock_.try_lock_until( end_time ); } );
         }
         catch( std::system_error & e )
         {
@@ -333,9 +347,14 @@ public:
             is_locked = true;
         }
 
-        if( is_locked && std::chrono::high_resolution_clock::now() < end_time && wrapper_->condition_.wait_until( lock_, end_time ) == std::cv_status::no_timeout )
+        if( is_locked && std::chrono::high_resolution_clock::now() < end_time )
         {
-            return *this;
+            LockStats * const lock_stats = wrapper_->lock_stats_;
+            if( lock_stats ) lock_stats->beginWait( hold_start_ );
+            std::cv_status const status = wrapper_->condition_.wait_until( lock_, end_time );
+            if( lock_stats ) hold_start_ = lock_stats->endWait();
+
+            if( status == std::cv_status::no_timeout ) return *this;
         }
 
         release();
@@ -347,12 +366,14 @@ public:
     void notifyOne()
     {
 //        std::cout <<  "AtomicHandle notifying one [" << name_ << "]" << std::endl;
+        if( wrapper_->lock_stats_ ) wrapper_->lock_stats_->countNotifyOne();
         wrapper_->condition_.notify_one();
     }
 
     void notifyAll()
     {
 //        std::cout <<  "AtomicHandle notifying all [" << name_ << "]" << std::endl;
+        if( wrapper_->lock_stats_ ) wrapper_->lock_stats_->countNotifyAll();
         wrapper_->condition_.notify_all();
     }
 
@@ -364,13 +385,13 @@ public:
 
     _Handle & delayNotifyOne()
     {
-        _notify_destruct |= NotifyType::DELAY_NOTIFY_ONE;
+        _notify_destruct |= static_cast<uint8_t>( NotifyType::DELAY_NOTIFY_ONE );
         return *this;
     }
 
     _Handle & delayNotifyAll()
     {
-        _notify_destruct |= NotifyType::DELAY_NOTIFY_ALL;
+        _notify_destruct |= static_cast<uint8_t>( NotifyType::DELAY_NOTIFY_ALL );
         return *this;
     }
 
@@ -397,6 +418,17 @@ public:
     {
         return get();
     }
+
+protected:
+    // take lock_ with attempt (which returns whether it got it), counting it in the wrapper's lock stats if it has any
+    template<class __Attempt>
+    bool acquire( __Attempt const & attempt )
+    {
+        LockStats * const lock_stats = wrapper_->lock_stats_;
+        if( !lock_stats ) return attempt();
+
+        return lock_stats->acquire( lock_, attempt, hold_start_ );
+    }
 };
 
 } // atomic
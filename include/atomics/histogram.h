@@ -0,0 +1,201 @@
+#ifndef _ATOMICS_HISTOGRAM_H_
+#define _ATOMICS_HISTOGRAM_H_
+
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <ostream>
+#include <cstdint>
+
+namespace atomics
+{
+
+// counts of non-negative integer values (eg: latencies in microseconds) in buckets that grow with the value, so percentiles come out
+// within a few percent whatever the range, in a fixed amount of memory
+//
+// values below SUB_BUCKETS get a bucket each; above that, every power of two is split into SUB_BUCKETS equal buckets, so a value is
+// reported to within 1 / SUB_BUCKETS of itself
+//
+// record() is lock-free and may be called from any number of threads; reads made meanwhile see some consistent-enough mix of old and new
+class Histogram
+{
+public:
+    static uint32_t const SUB_BUCKET_BITS = 4;
+    static uint64_t const SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+    static size_t const NUM_BUCKETS = SUB_BUCKETS + ( 64 - SUB_BUCKET_BITS ) * SUB_BUCKETS;
+
+protected:
+    std::vector<std::atomic<uint64_t> > buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+
+public:
+    Histogram()
+    :
+        buckets_( NUM_BUCKETS ),
+        count_( 0 ),
+        sum_( 0 ),
+        min_( std::numeric_limits<uint64_t>::max() ),
+        max_( 0 )
+    {
+        for( auto bucket_it = buckets_.begin(); bucket_it != buckets_.end(); ++bucket_it )
+        {
+            bucket_it->store( 0, std::memory_order_relaxed );
+        }
+    }
+
+    void record( uint64_t value )
+    {
+        buckets_[bucketIndex( value )].fetch_add( 1, std::memory_order_relaxed );
+        count_.fetch_add( 1, std::memory_order_relaxed );
+        sum_.fetch_add( value, std::memory_order_relaxed );
+
+        uint64_t min = min_.load( std::memory_order_relaxed );
+        while( value < min && !min_.compare_exchange_weak( min, value, std::memory_order_relaxed ) ){}
+
+        uint64_t max = max_.load( std::memory_order_relaxed );
+        while( value > max && !max_.compare_exchange_weak( max, value, std::memory_order_relaxed ) ){}
+    }
+
+    uint64_t count() const
+    {
+        return count_.load( std::memory_order_relaxed );
+    }
+
+    uint64_t sum() const
+    {
+        return sum_.load( std::memory_order_relaxed );
+    }
+
+    // 0 while empty
+    uint64_t min() const
+    {
+        return count() > 0 ? min_.load( std::memory_order_relaxed ) : 0;
+    }
+
+    uint64_t max() const
+    {
+        return max_.load( std::memory_order_relaxed );
+    }
+
+    double mean() const
+    {
+        uint64_t const count = this->count();
+        return count > 0 ? static_cast<double>( sum() ) / count : 0;
+    }
+
+    // the value below which the given fraction (0 to 1) of the recorded values fall: the middle of the bucket it falls in, but never outside
+    // the smallest and largest values seen. 0 while empty
+    uint64_t percentile( double fraction ) const
+    {
+        uint64_t const count = this->count();
+        if( count == 0 ) return 0;
+
+        // the rank of the value we want, counting from 1
+        uint64_t const rank = std::max<uint64_t>( 1, static_cast<uint64_t>( std::min( std::max( fraction, 0.0 ), 1.0 ) * count + 0.5 ) );
+
+        uint64_t seen = 0;
+        for( size_t bucket_idx = 0; bucket_idx < NUM_BUCKETS; ++bucket_idx )
+        {
+            seen += buckets_[bucket_idx].load( std::memory_order_relaxed );
+            if( seen < rank ) continue;
+
+            uint64_t const value = bucketLowerBound( bucket_idx ) + bucketWidth( bucket_idx ) / 2;
+            return std::min( std::max( value, min() ), max() );
+        }
+
+        return max();
+    }
+
+    // the number of values recorded in the given bucket; see bucketLowerBound() and bucketWidth() for the values it covers
+    uint64_t bucketCount( size_t bucket_idx ) const
+    {
+        return buckets_[bucket_idx].load( std::memory_order_relaxed );
+    }
+
+    // add everything recorded in another histogram to this one, as if it had been recorded here
+    void merge( Histogram const & other )
+    {
+        if( other.count() == 0 ) return;
+
+        for( size_t bucket_idx = 0; bucket_idx < NUM_BUCKETS; ++bucket_idx )
+        {
+            uint64_t const bucket_count = other.bucketCount( bucket_idx );
+            if( bucket_count > 0 ) buckets_[bucket_idx].fetch_add( bucket_count, std::memory_order_relaxed );
+        }
+
+        count_.fetch_add( other.count(), std::memory_order_relaxed );
+        sum_.fetch_add( other.sum(), std::memory_order_relaxed );
+
+        uint64_t const other_min = other.min();
+        uint64_t min = min_.load( std::memory_order_relaxed );
+        while( other_min < min && !min_.compare_exchange_weak( min, other_min, std::memory_order_relaxed ) ){}
+
+        uint64_t const other_max = other.max();
+        uint64_t max = max_.load( std::memory_order_relaxed );
+        while( other_max > max && !max_.compare_exchange_weak( max, other_max, std::memory_order_relaxed ) ){}
+    }
+
+    // not atomic with respect to concurrent record()s; values recorded meanwhile may be partly kept
+    void reset()
+    {
+        for( auto bucket_it = buckets_.begin(); bucket_it != buckets_.end(); ++bucket_it )
+        {
+            bucket_it->store( 0, std::memory_order_relaxed );
+        }
+
+        count_.store( 0, std::memory_order_relaxed );
+        sum_.store( 0, std::memory_order_relaxed );
+        min_.store( std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed );
+        max_.store( 0, std::memory_order_relaxed );
+    }
+
+    // "count: <n> mean: <m> p50: <v> p99: <v> p999: <v> max: <v>"
+    void print( std::ostream & out ) const
+    {
+        out << "count: " << count() << " mean: " << static_cast<uint64_t>( mean() ) << " p50: " << percentile( 0.5 ) << " p99: " << percentile( 0.99 )
+            << " p999: " << percentile( 0.999 ) << " max: " << max();
+    }
+
+    static size_t bucketIndex( uint64_t value )
+    {
+        if( value < SUB_BUCKETS ) return static_cast<size_t>( value );
+
+        uint32_t const exponent = highestBit( value );
+        uint64_t const sub_bucket = ( value >> ( exponent - SUB_BUCKET_BITS ) ) & ( SUB_BUCKETS - 1 );
+        return static_cast<size_t>( SUB_BUCKETS + ( exponent - SUB_BUCKET_BITS ) * SUB_BUCKETS + sub_bucket );
+    }
+
+    static uint64_t bucketLowerBound( size_t bucket_idx )
+    {
+        if( bucket_idx < SUB_BUCKETS ) return bucket_idx;
+
+        uint32_t const exponent = static_cast<uint32_t>( ( bucket_idx - SUB_BUCKETS ) / SUB_BUCKETS ) + SUB_BUCKET_BITS;
+        uint64_t const sub_bucket = ( bucket_idx - SUB_BUCKETS ) % SUB_BUCKETS;
+        return ( SUB_BUCKETS + sub_bucket ) << ( exponent - SUB_BUCKET_BITS );
+    }
+
+    static uint64_t bucketWidth( size_t bucket_idx )
+    {
+        if( bucket_idx < SUB_BUCKETS ) return 1;
+
+        uint32_t const exponent = static_cast<uint32_t>( ( bucket_idx - SUB_BUCKETS ) / SUB_BUCKETS ) + SUB_BUCKET_BITS;
+        return 1ULL << ( exponent - SUB_BUCKET_BITS );
+    }
+
+protected:
+    // position of the highest set bit; value must not be 0
+    static uint32_t highestBit( uint64_t value )
+    {
+        uint32_t bit = 0;
+        while( value >>= 1 ) ++bit;
+        return bit;
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_HISTOGRAM_H_
@@ -0,0 +1,392 @@
+#ifndef _ATOMICS_LOCK_STATS_H_
+#define _ATOMICS_LOCK_STATS_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+
+#include <atomics/histogram.h>
+#include <atomics/metrics.h>
+
+namespace atomics
+{
+
+// ####################################################################################################
+// how contended one lock is: how long threads waited to take it and then held it (in nanoseconds), how many were waiting at once, and
+// how often its condition was waited on and notified
+//
+// everything is lock-free, so a profiled lock's threads only contend with each other over the counters they were already contending for
+class LockStats
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+    typedef std::vector<std::pair<LockStats const *, std::string> > _LabelledStats;
+
+protected:
+    std::string name_;
+
+    std::atomic<uint64_t> num_acquisitions_;
+    // acquisitions that found the lock already taken, whether they then waited for it or (see num_timeouts_) gave up
+    std::atomic<uint64_t> num_contended_;
+    std::atomic<uint64_t> num_timeouts_;
+    Histogram wait_time_;
+    Histogram hold_time_;
+
+    // threads blocked taking the lock, now and at most
+    std::atomic<uint32_t> num_waiters_;
+    std::atomic<uint32_t> peak_waiters_;
+
+    // threads waiting on the lock's condition, now and at most
+    std::atomic<uint64_t> num_condition_waits_;
+    std::atomic<uint32_t> num_condition_waiters_;
+    std::atomic<uint32_t> peak_condition_waiters_;
+
+    std::atomic<uint64_t> num_notify_one_;
+    std::atomic<uint64_t> num_notify_all_;
+
+public:
+    LockStats( std::string const & name )
+    :
+        name_( name ),
+        num_acquisitions_( 0 ),
+        num_contended_( 0 ),
+        num_timeouts_( 0 ),
+        num_waiters_( 0 ),
+        peak_waiters_( 0 ),
+        num_condition_waits_( 0 ),
+        num_condition_waiters_( 0 ),
+        peak_condition_waiters_( 0 ),
+        num_notify_one_( 0 ),
+        num_notify_all_( 0 )
+    {
+        //
+    }
+
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now().time_since_epoch() ).count() );
+    }
+
+    // take the lock with attempt (which returns whether it got it), first trying without waiting so uncontended acquisitions are told
+    // apart; returns what attempt did, and the time the lock was taken (for holdEnded()) in hold_start
+    template<class __Lockable, class __Attempt>
+    bool acquire( __Lockable & lockable, __Attempt const & attempt, uint64_t & hold_start )
+    {
+        uint64_t const start_time = now();
+        if( lockable.try_lock() )
+        {
+            hold_start = now();
+            num_acquisitions_.fetch_add( 1, std::memory_order_relaxed );
+            wait_time_.record( hold_start - start_time );
+            return true;
+        }
+
+        num_contended_.fetch_add( 1, std::memory_order_relaxed );
+        raise( peak_waiters_, num_waiters_.fetch_add( 1, std::memory_order_relaxed ) + 1 );
+        bool const is_locked = attempt();
+        num_waiters_.fetch_sub( 1, std::memory_order_relaxed );
+
+        hold_start = now();
+        if( is_locked )
+        {
+            num_acquisitions_.fetch_add( 1, std::memory_order_relaxed );
+            wait_time_.record( hold_start - start_time );
+        }
+        else
+        {
+            num_timeouts_.fetch_add( 1, std::memory_order_relaxed );
+        }
+
+        return is_locked;
+    }
+
+    // the lock taken at hold_start is being released
+    void holdEnded( uint64_t hold_start )
+    {
+        hold_time_.record( now() - hold_start );
+    }
+
+    // a thread is about to wait on the lock's condition, releasing the lock meanwhile; the hold is over, and starts again in endWait()
+    void beginWait( uint64_t hold_start )
+    {
+        holdEnded( hold_start );
+        num_condition_waits_.fetch_add( 1, std::memory_order_relaxed );
+        raise( peak_condition_waiters_, num_condition_waiters_.fetch_add( 1, std::memory_order_relaxed ) + 1 );
+    }
+
+    // returns the new hold_start
+    uint64_t endWait()
+    {
+        num_condition_waiters_.fetch_sub( 1, std::memory_order_relaxed );
+        return now();
+    }
+
+    void countNotifyOne()
+    {
+        num_notify_one_.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    void countNotifyAll()
+    {
+        num_notify_all_.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    std::string const & name() const
+    {
+        return name_;
+    }
+
+    uint64_t numAcquisitions() const
+    {
+        return num_acquisitions_.load( std::memory_order_relaxed );
+    }
+
+    uint64_t numContended() const
+    {
+        return num_contended_.load( std::memory_order_relaxed );
+    }
+
+    // tries and timed acquisitions that gave up
+    uint64_t numTimeouts() const
+    {
+        return num_timeouts_.load( std::memory_order_relaxed );
+    }
+
+    Histogram const & waitTime() const
+    {
+        return wait_time_;
+    }
+
+    Histogram const & holdTime() const
+    {
+        return hold_time_;
+    }
+
+    uint32_t numWaiters() const
+    {
+        return num_waiters_.load( std::memory_order_relaxed );
+    }
+
+    uint32_t peakWaiters() const
+    {
+        return peak_waiters_.load( std::memory_order_relaxed );
+    }
+
+    uint64_t numConditionWaits() const
+    {
+        return num_condition_waits_.load( std::memory_order_relaxed );
+    }
+
+    uint32_t numConditionWaiters() const
+    {
+        return num_condition_waiters_.load( std::memory_order_relaxed );
+    }
+
+    uint32_t peakConditionWaiters() const
+    {
+        return peak_condition_waiters_.load( std::memory_order_relaxed );
+    }
+
+    uint64_t numNotifyOne() const
+    {
+        return num_notify_one_.load( std::memory_order_relaxed );
+    }
+
+    uint64_t numNotifyAll() const
+    {
+        return num_notify_all_.load( std::memory_order_relaxed );
+    }
+
+    // two lines: acquisitions, contention, and waiters; then the wait and hold times in ns
+    void print( std::ostream & out ) const
+    {
+        uint64_t const num_acquisitions = numAcquisitions();
+
+        out << std::setw( 24 ) << std::left << name_ << std::right << " locks: " << std::setw( 8 ) << num_acquisitions
+            << " contended: " << std::setw( 8 ) << numContended() << " (" << ( num_acquisitions > 0 ? 100 * numContended() / num_acquisitions : 0 ) << "%)"
+            << " peak waiters: " << peakWaiters() << " condition waits: " << numConditionWaits() << " peak: " << peakConditionWaiters()
+            << " notify one: " << numNotifyOne() << " all: " << numNotifyAll();
+
+        if( numTimeouts() > 0 ) out << " timeouts: " << numTimeouts();
+
+        out << std::endl << std::setw( 24 ) << "" << " wait ns: ";
+        wait_time_.print( out );
+        out << " hold ns: ";
+        hold_time_.print( out );
+        out << std::endl;
+    }
+
+    // <prefix>acquisitions_total, _contended_total, _timeouts_total, _wait_ns, _hold_ns, _waiters, _peak_waiters, _condition_waits_total,
+    // _condition_waiters, _peak_condition_waiters, and _notify_total{notify="one|all"}, for each of the given stats with its labels; every
+    // lock's samples of one metric are written together, as MetricsWriter requires
+    static void writeMetrics( MetricsWriter & writer, std::string const & prefix, _LabelledStats const & all_stats )
+    {
+        auto const each = [&]( std::function<void( LockStats const &, std::string const & )> const & write )
+        {
+            for( auto stats_it = all_stats.begin(); stats_it != all_stats.end(); ++stats_it ) write( *stats_it->first, stats_it->second );
+        };
+
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.counter( prefix + "acquisitions_total", "times the lock was taken", stats.numAcquisitions(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.counter( prefix + "contended_total", "times the lock was already taken by another thread", stats.numContended(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.counter( prefix + "timeouts_total", "tries and timed attempts to take the lock that gave up", stats.numTimeouts(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.summary( prefix + "wait_ns", "time to take the lock, in nanoseconds", stats.waitTime(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.summary( prefix + "hold_ns", "time the lock was held, in nanoseconds", stats.holdTime(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.gauge( prefix + "waiters", "threads waiting to take the lock", stats.numWaiters(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.gauge( prefix + "peak_waiters", "most threads waiting to take the lock at once", stats.peakWaiters(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.counter( prefix + "condition_waits_total", "waits on the lock's condition", stats.numConditionWaits(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.gauge( prefix + "condition_waiters", "threads waiting on the lock's condition", stats.numConditionWaiters(), labels ); } );
+        each( [&]( LockStats const & stats, std::string const & labels ){ writer.gauge( prefix + "peak_condition_waiters", "most threads waiting on the lock's condition at once", stats.peakConditionWaiters(), labels ); } );
+        each(
+            [&]( LockStats const & stats, std::string const & labels )
+            {
+                std::string const separator = labels.empty() ? "" : ",";
+                writer.counter( prefix + "notify_total", "notifications of one or all of the condition's waiters", stats.numNotifyOne(), labels + separator + MetricsWriter::label( "notify", "one" ) );
+                writer.counter( prefix + "notify_total", "notifications of one or all of the condition's waiters", stats.numNotifyAll(), labels + separator + MetricsWriter::label( "notify", "all" ) );
+            }
+        );
+    }
+
+protected:
+    static void raise( std::atomic<uint32_t> & peak, uint32_t value )
+    {
+        uint32_t current_peak = peak.load( std::memory_order_relaxed );
+        while( value > current_peak && !peak.compare_exchange_weak( current_peak, value, std::memory_order_relaxed ) ){}
+    }
+};
+
+// ####################################################################################################
+// every lock whose contention is being profiled (see Wrapper::profileContention() and FifoBase::profileContention()), by name
+//
+// profiling is opt-in per lock; a lock that isn't profiled pays one NULL check per acquisition. stats live as long as the process, so
+// locks can keep plain pointers to theirs, and locks given the same name share their stats
+class LockProfiler
+{
+public:
+    typedef std::mutex _Mutex;
+    typedef std::lock_guard<_Mutex> _Lock;
+
+protected:
+    mutable _Mutex mutex_;
+    std::vector<std::shared_ptr<LockStats> > stats_;
+
+    LockProfiler()
+    {
+        //
+    }
+
+public:
+    static LockProfiler & instance()
+    {
+        static LockProfiler lock_profiler;
+        return lock_profiler;
+    }
+
+    LockStats & stats( std::string const & name )
+    {
+        _Lock lock( mutex_ );
+
+        for( auto stats_it = stats_.begin(); stats_it != stats_.end(); ++stats_it )
+        {
+            if( ( *stats_it )->name() == name ) return **stats_it;
+        }
+
+        stats_.push_back( std::make_shared<LockStats>( name ) );
+        return *stats_.back();
+    }
+
+    // every profiled lock, in the order they were first profiled
+    std::vector<std::shared_ptr<LockStats const> > all() const
+    {
+        _Lock lock( mutex_ );
+        return std::vector<std::shared_ptr<LockStats const> >( stats_.begin(), stats_.end() );
+    }
+
+    void print( std::ostream & out ) const
+    {
+        auto const all_stats = all();
+        for( auto stats_it = all_stats.begin(); stats_it != all_stats.end(); ++stats_it )
+        {
+            ( *stats_it )->print( out );
+        }
+    }
+
+    // as atomics_lock_*{lock="<name>"}; see LockStats::writeMetrics()
+    void writeMetrics( MetricsWriter & writer ) const
+    {
+        auto const all_stats = all();
+
+        LockStats::_LabelledStats labelled_stats;
+        for( auto stats_it = all_stats.begin(); stats_it != all_stats.end(); ++stats_it )
+        {
+            labelled_stats.push_back( std::make_pair( stats_it->get(), MetricsWriter::label( "lock", ( *stats_it )->name() ) ) );
+        }
+
+        LockStats::writeMetrics( writer, "atomics_lock_", labelled_stats );
+    }
+};
+
+// ####################################################################################################
+// a std::unique_lock that counts itself in the given stats, if any; with NULL stats it's just a std::unique_lock
+// waits on a condition should go through wait() and waitFor(), so time spent waiting isn't counted as time held
+template<class __Mutex>
+class ProfiledLock : public std::unique_lock<__Mutex>
+{
+public:
+    typedef std::unique_lock<__Mutex> _Lock;
+
+protected:
+    LockStats * lock_stats_;
+    uint64_t hold_start_;
+
+public:
+    ProfiledLock( __Mutex & mutex, LockStats * lock_stats )
+    :
+        _Lock( mutex, std::defer_lock ),
+        lock_stats_( lock_stats ),
+        hold_start_( 0 )
+    {
+        if( !lock_stats_ ) _Lock::lock();
+        else lock_stats_->acquire( static_cast<_Lock &>( *this ), [this](){ _Lock::lock(); return true; }, hold_start_ );
+    }
+
+    ~ProfiledLock()
+    {
+        if( lock_stats_ && _Lock::owns_lock() ) lock_stats_->holdEnded( hold_start_ );
+    }
+
+    template<class __Condition, class __Predicate>
+    void wait( __Condition & condition, __Predicate predicate )
+    {
+        if( !lock_stats_ || predicate() ) return condition.wait( *this, predicate );
+
+        lock_stats_->beginWait( hold_start_ );
+        condition.wait( *this, predicate );
+        hold_start_ = lock_stats_->endWait();
+    }
+
+    template<class __Condition, class __Rep, class __Period, class __Predicate>
+    bool waitFor( __Condition & condition, std::chrono::duration<__Rep, __Period> const & duration, __Predicate predicate )
+    {
+        if( !lock_stats_ || predicate() ) return condition.wait_for( *this, duration, predicate );
+
+        lock_stats_->beginWait( hold_start_ );
+        bool const result = condition.wait_for( *this, duration, predicate );
+        hold_start_ = lock_stats_->endWait();
+        return result;
+    }
+
+    ProfiledLock( ProfiledLock const & ) = delete;
+    ProfiledLock & operator=( ProfiledLock const & ) = delete;
+};
+
+} // atomics
+
+#endif // _ATOMICS_LOCK_STATS_H_
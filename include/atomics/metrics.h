@@ -0,0 +1,293 @@
+#ifndef _ATOMICS_METRICS_H_
+#define _ATOMICS_METRICS_H_
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <cstdint>
+
+#include <atomics/histogram.h>
+
+namespace atomics
+{
+
+// ####################################################################################################
+// a count that only goes up
+class MetricsCounter
+{
+protected:
+    std::atomic<uint64_t> value_;
+
+public:
+    MetricsCounter()
+    :
+        value_( 0 )
+    {
+        //
+    }
+
+    void increment( uint64_t amount = 1 )
+    {
+        value_.fetch_add( amount, std::memory_order_relaxed );
+    }
+
+    uint64_t value() const
+    {
+        return value_.load( std::memory_order_relaxed );
+    }
+};
+
+// ####################################################################################################
+// a value that goes up and down
+class MetricsGauge
+{
+protected:
+    std::atomic<double> value_;
+
+public:
+    MetricsGauge()
+    :
+        value_( 0 )
+    {
+        //
+    }
+
+    void set( double value )
+    {
+        value_.store( value, std::memory_order_relaxed );
+    }
+
+    void add( double amount )
+    {
+        double value = value_.load( std::memory_order_relaxed );
+        while( !value_.compare_exchange_weak( value, value + amount, std::memory_order_relaxed ) ){}
+    }
+
+    double value() const
+    {
+        return value_.load( std::memory_order_relaxed );
+    }
+};
+
+// ####################################################################################################
+// writes metrics in the Prometheus text format (version 0.0.4):
+//
+//   # HELP <name> <help>
+//   # TYPE <name> counter|gauge|summary
+//   <name>{<labels>} <value>
+//
+// the HELP and TYPE lines are written once per name, however many label sets follow; all of a name's samples must be written together
+// histograms are written as summaries: p50, p99, and p999, then <name>_sum and <name>_count
+class MetricsWriter
+{
+protected:
+    std::ostream & out_;
+    std::set<std::string> names_;
+
+public:
+    MetricsWriter( std::ostream & out )
+    :
+        out_( out )
+    {
+        //
+    }
+
+    // a single label, eg: label( "stream", "color" ) -> stream="color"; join several with commas
+    static std::string label( std::string const & name, std::string const & value )
+    {
+        std::string escaped_value;
+        for( auto char_it = value.begin(); char_it != value.end(); ++char_it )
+        {
+            if( *char_it == '\\' || *char_it == '"' ) escaped_value += '\\';
+            if( *char_it == '\n' ) escaped_value += "\\n";
+            else escaped_value += *char_it;
+        }
+
+        return name + "=\"" + escaped_value + "\"";
+    }
+
+    template<class __Value>
+    void counter( std::string const & name, std::string const & help, __Value value, std::string const & labels = "" )
+    {
+        writeHeader( name, help, "counter" );
+        writeSample( name, labels, value );
+    }
+
+    template<class __Value>
+    void gauge( std::string const & name, std::string const & help, __Value value, std::string const & labels = "" )
+    {
+        writeHeader( name, help, "gauge" );
+        writeSample( name, labels, value );
+    }
+
+    void summary( std::string const & name, std::string const & help, Histogram const & histogram, std::string const & labels = "" )
+    {
+        writeHeader( name, help, "summary" );
+
+        std::string const separator = labels.empty() ? "" : ",";
+        writeSample( name, labels + separator + label( "quantile", "0.5" ), histogram.percentile( 0.5 ) );
+        writeSample( name, labels + separator + label( "quantile", "0.99" ), histogram.percentile( 0.99 ) );
+        writeSample( name, labels + separator + label( "quantile", "0.999" ), histogram.percentile( 0.999 ) );
+        writeSample( name + "_sum", labels, histogram.sum() );
+        writeSample( name + "_count", labels, histogram.count() );
+    }
+
+protected:
+    void writeHeader( std::string const & name, std::string const & help, char const * type )
+    {
+        if( !names_.insert( name ).second ) return;
+
+        out_ << "# HELP " << name << " " << help << "\n";
+        out_ << "# TYPE " << name << " " << type << "\n";
+    }
+
+    template<class __Value>
+    void writeSample( std::string const & name, std::string const & labels, __Value value )
+    {
+        out_ << name;
+        if( !labels.empty() ) out_ << "{" << labels << "}";
+        out_ << " " << value << "\n";
+    }
+};
+
+// ####################################################################################################
+// named counters, gauges, and histograms, each optionally split by labels, written out together on request
+//
+// a metric is created (under a lock) the first time it's asked for and lives as long as the registry, so callers look theirs up once
+// and keep the reference; updating one is then lock-free. values that already live elsewhere (eg: fifo sizes) are better sampled when
+// the metrics are written, by a collector
+class MetricsRegistry
+{
+public:
+    typedef std::function<void( MetricsWriter & )> _Collector;
+    typedef std::mutex _Mutex;
+    typedef std::lock_guard<_Mutex> _Lock;
+
+protected:
+    template<class __Metric>
+    struct Entry
+    {
+        std::string name_;
+        std::string help_;
+        std::string labels_;
+        std::unique_ptr<__Metric> metric_ptr_;
+    };
+
+    mutable _Mutex mutex_;
+    std::vector<Entry<MetricsCounter> > counters_;
+    std::vector<Entry<MetricsGauge> > gauges_;
+    std::vector<Entry<Histogram> > histograms_;
+    std::vector<_Collector> collectors_;
+
+public:
+    // labels as for MetricsWriter, eg: MetricsWriter::label( "stream", "color" )
+    MetricsCounter & counter( std::string const & name, std::string const & help, std::string const & labels = "" )
+    {
+        return find( counters_, name, help, labels );
+    }
+
+    MetricsGauge & gauge( std::string const & name, std::string const & help, std::string const & labels = "" )
+    {
+        return find( gauges_, name, help, labels );
+    }
+
+    Histogram & histogram( std::string const & name, std::string const & help, std::string const & labels = "" )
+    {
+        return find( histograms_, name, help, labels );
+    }
+
+    // called (from whichever thread writes the metrics) every time they're written
+    void addCollector( _Collector const & collector )
+    {
+        _Lock lock( mutex_ );
+        collectors_.push_back( collector );
+    }
+
+    // everything, in the order it was registered, followed by whatever the collectors write
+    void write( std::ostream & out ) const
+    {
+        _Lock lock( mutex_ );
+        MetricsWriter writer( out );
+
+        // samples with the same name have to be written together, whatever order their labels were registered in
+        for( auto counter_it = counters_.begin(); counter_it != counters_.end(); ++counter_it )
+        {
+            if( !firstOfName( counters_, counter_it ) ) continue;
+            for( auto sample_it = counter_it; sample_it != counters_.end(); ++sample_it )
+            {
+                if( sample_it->name_ == counter_it->name_ ) writer.counter( sample_it->name_, sample_it->help_, sample_it->metric_ptr_->value(), sample_it->labels_ );
+            }
+        }
+
+        for( auto gauge_it = gauges_.begin(); gauge_it != gauges_.end(); ++gauge_it )
+        {
+            if( !firstOfName( gauges_, gauge_it ) ) continue;
+            for( auto sample_it = gauge_it; sample_it != gauges_.end(); ++sample_it )
+            {
+                if( sample_it->name_ == gauge_it->name_ ) writer.gauge( sample_it->name_, sample_it->help_, sample_it->metric_ptr_->value(), sample_it->labels_ );
+            }
+        }
+
+        for( auto histogram_it = histograms_.begin(); histogram_it != histograms_.end(); ++histogram_it )
+        {
+            if( !firstOfName( histograms_, histogram_it ) ) continue;
+            for( auto sample_it = histogram_it; sample_it != histograms_.end(); ++sample_it )
+            {
+                if( sample_it->name_ == histogram_it->name_ ) writer.summary( sample_it->name_, sample_it->help_, *sample_it->metric_ptr_, sample_it->labels_ );
+            }
+        }
+
+        for( auto collector_it = collectors_.begin(); collector_it != collectors_.end(); ++collector_it )
+        {
+            (*collector_it)( writer );
+        }
+    }
+
+    std::string write() const
+    {
+        std::stringstream out;
+        write( out );
+        return out.str();
+    }
+
+protected:
+    template<class __Metric>
+    __Metric & find( std::vector<Entry<__Metric> > & entries, std::string const & name, std::string const & help, std::string const & labels )
+    {
+        _Lock lock( mutex_ );
+
+        for( auto entry_it = entries.begin(); entry_it != entries.end(); ++entry_it )
+        {
+            if( entry_it->name_ == name && entry_it->labels_ == labels ) return *entry_it->metric_ptr_;
+        }
+
+        Entry<__Metric> entry;
+        entry.name_ = name;
+        entry.help_ = help;
+        entry.labels_ = labels;
+        entry.metric_ptr_.reset( new __Metric() );
+        entries.push_back( std::move( entry ) );
+
+        return *entries.back().metric_ptr_;
+    }
+
+    template<class __Entries>
+    static bool firstOfName( __Entries const & entries, typename __Entries::const_iterator entry_it )
+    {
+        for( auto other_it = entries.begin(); other_it != entry_it; ++other_it )
+        {
+            if( other_it->name_ == entry_it->name_ ) return false;
+        }
+        return true;
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_METRICS_H_
@@ -0,0 +1,387 @@
+#ifndef _ATOMICS_PIPELINE_H_
+#define _ATOMICS_PIPELINE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <iomanip>
+
+#include <Poco/Util/AbstractConfiguration.h>
+
+#include <atomics/fifo.h>
+#include <atomics/byte_budget.h>
+#include <atomics/stage.h>
+#include <atomics/work_stealing_pool.h>
+#include <atomics/metrics.h>
+
+namespace atomics
+{
+
+// owns a set of named fifos and the stages connecting them
+//
+// stages must be added in pipeline order (sources first, sinks last); the pipeline starts them in reverse order so that consumers
+// are ready before their producers, and shuts them down front to back: sources are stopped, and each subsequent stage drains its
+// input and exits once every stage feeding it has finished
+//
+// worker counts and queue capacities given in code are defaults; configure() overrides them from keys of the form
+//   pipeline.<stage name>.workers
+//   pipeline.<fifo name>.capacity
+//   pipeline.<fifo name>.overflow     block, drop_oldest, or drop_newest; see FifoBase::OverflowPolicy
+//   pipeline.<fifo name>.max_kb       byte limit for that fifo alone, 0 for none; only meaningful for fifos with a sizer
+//   pipeline.<budget name>.max_kb     byte limit shared by every fifo using that budget, 0 for none
+//   pipeline.<fifo name>.profile_contention
+//                                     true to collect lock contention stats for that fifo (see LockStats); defaults to
+//   pipeline.profile_contention       which defaults to false
+// individual stage types may read additional pipeline.<stage name>.* keys
+// stages handed to one of the pipeline's shared pools ignore their worker count; see WorkStealingPool for the pool's own keys
+class Pipeline
+{
+public:
+    typedef std::shared_ptr<FifoBase> _FifoPtr;
+    typedef std::pair<std::string, _FifoPtr> _NamedFifo;
+    typedef std::pair<std::string, ByteBudget::_Ptr> _NamedByteBudget;
+
+protected:
+    std::string name_;
+    std::vector<_NamedFifo> fifos_;
+    std::vector<StageBase::_Ptr> stages_;
+    std::vector<WorkStealingPool::_Ptr> pools_;
+    std::vector<_NamedByteBudget> byte_budgets_;
+
+public:
+    Pipeline( std::string const & name = "pipeline" )
+    :
+        name_( name )
+    {
+        //
+    }
+
+    ~Pipeline()
+    {
+        stop();
+    }
+
+    template<class __Data>
+    std::shared_ptr<Fifo<__Data> > addFifo( std::string const & name, size_t capacity, FifoBase::OverflowPolicy overflow_policy = FifoBase::OverflowPolicy::BLOCK )
+    {
+        auto fifo_ptr = std::make_shared<Fifo<__Data> >( capacity, overflow_policy );
+        fifos_.push_back( _NamedFifo( name, fifo_ptr ) );
+        return fifo_ptr;
+    }
+
+    // a byte limit to be shared by several fifos with FifoBase::setByteBudget(); see ByteBudget for which fifos may safely share one
+    ByteBudget::_Ptr addByteBudget( std::string const & name, size_t capacity = 0 )
+    {
+        auto byte_budget_ptr = std::make_shared<ByteBudget>( capacity );
+        byte_budgets_.push_back( _NamedByteBudget( name, byte_budget_ptr ) );
+        return byte_budget_ptr;
+    }
+
+    // a set of threads shared by any stages later handed to it with WorkStealingPool::addStage()
+    WorkStealingPool::_Ptr addPool( std::string const & name, size_t num_workers = std::thread::hardware_concurrency() )
+    {
+        auto pool_ptr = std::make_shared<WorkStealingPool>( name, num_workers );
+        pools_.push_back( pool_ptr );
+        return pool_ptr;
+    }
+
+    // source: bool fn( __Out & ), called repeatedly until the pipeline is stopped
+    template<class __Out, class __Fn>
+    std::shared_ptr<Stage<void, __Out, __Fn> > addSource( std::string const & name, size_t num_workers, __Fn fn, std::shared_ptr<Fifo<__Out> > output_ptr )
+    {
+        auto stage_ptr = std::make_shared<Stage<void, __Out, __Fn> >( name, num_workers, fn, output_ptr );
+        stages_.push_back( stage_ptr );
+        return stage_ptr;
+    }
+
+    // transform: __Out fn( __In & )
+    template<class __In, class __Out, class __Fn>
+    std::shared_ptr<Stage<__In, __Out, __Fn> > addStage( std::string const & name, size_t num_workers, std::shared_ptr<Fifo<__In> > input_ptr, __Fn fn, std::shared_ptr<Fifo<__Out> > output_ptr )
+    {
+        auto stage_ptr = std::make_shared<Stage<__In, __Out, __Fn> >( name, num_workers, input_ptr, fn, output_ptr );
+        stages_.push_back( stage_ptr );
+        return stage_ptr;
+    }
+
+    // sink: void fn( __In & )
+    template<class __In, class __Fn>
+    std::shared_ptr<Stage<__In, void, __Fn> > addSink( std::string const & name, size_t num_workers, std::shared_ptr<Fifo<__In> > input_ptr, __Fn fn )
+    {
+        auto stage_ptr = std::make_shared<Stage<__In, void, __Fn> >( name, num_workers, input_ptr, fn );
+        stages_.push_back( stage_ptr );
+        return stage_ptr;
+    }
+
+    // any other kind of stage, eg: ReorderStage
+    template<class __Stage>
+    std::shared_ptr<__Stage> add( std::shared_ptr<__Stage> stage_ptr )
+    {
+        stages_.push_back( stage_ptr );
+        return stage_ptr;
+    }
+
+    // apply worker counts, fifo capacities and byte limits, and overflow policies from the given configuration; anything not mentioned keeps its default
+    void configure( Poco::Util::AbstractConfiguration const & config )
+    {
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            (*stage_it)->configure( config, name_ );
+        }
+
+        bool const profile_contention = config.getBool( name_ + ".profile_contention", false );
+
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            auto & fifo = *fifo_it->second;
+            if( config.getBool( name_ + "." + fifo_it->first + ".profile_contention", profile_contention ) ) fifo.profileContention( name_ + "." + fifo_it->first );
+            fifo.setCapacity( config.getInt( name_ + "." + fifo_it->first + ".capacity", static_cast<int>( fifo.capacity() ) ) );
+            fifo.setOverflowPolicy( FifoBase::parseOverflowPolicy( config.getString( name_ + "." + fifo_it->first + ".overflow", FifoBase::overflowPolicyName( fifo.overflowPolicy() ) ) ) );
+            fifo.setByteCapacity( static_cast<size_t>( config.getInt( name_ + "." + fifo_it->first + ".max_kb", static_cast<int>( fifo.byteCapacity() / 1024 ) ) ) * 1024 );
+        }
+
+        for( auto byte_budget_it = byte_budgets_.begin(); byte_budget_it != byte_budgets_.end(); ++byte_budget_it )
+        {
+            auto & byte_budget = *byte_budget_it->second;
+            byte_budget.setCapacity( static_cast<size_t>( config.getInt( name_ + "." + byte_budget_it->first + ".max_kb", static_cast<int>( byte_budget.capacity() / 1024 ) ) ) * 1024 );
+        }
+
+        for( auto pool_it = pools_.begin(); pool_it != pools_.end(); ++pool_it )
+        {
+            (*pool_it)->configure( config, name_ );
+        }
+    }
+
+    // start all stages, outputs first, then the shared pools that drive the pooled ones
+    void start()
+    {
+        for( auto stage_it = stages_.rbegin(); stage_it != stages_.rend(); ++stage_it )
+        {
+            (*stage_it)->start();
+        }
+
+        for( auto pool_it = pools_.begin(); pool_it != pools_.end(); ++pool_it )
+        {
+            (*pool_it)->start();
+        }
+    }
+
+    // stop the sources, then wait for every stage to drain its input and exit, in pipeline order
+    void stop()
+    {
+        // stop every source before waiting on any of them; one blocked on a full fifo may need the others to go quiet before that fifo
+        // gets any share of a busy pool
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            (*stage_it)->stop();
+        }
+
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            (*stage_it)->join();
+        }
+
+        // pooled stages have all drained by now, so the pools have nothing left to do
+        for( auto pool_it = pools_.begin(); pool_it != pools_.end(); ++pool_it )
+        {
+            (*pool_it)->stop();
+        }
+    }
+
+    StageBase::_Ptr getStage( std::string const & name ) const
+    {
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            if( (*stage_it)->name() == name ) return *stage_it;
+        }
+        return StageBase::_Ptr();
+    }
+
+    _FifoPtr getFifo( std::string const & name ) const
+    {
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            if( fifo_it->first == name ) return fifo_it->second;
+        }
+        return _FifoPtr();
+    }
+
+    std::vector<StageBase::_Ptr> const & stages() const
+    {
+        return stages_;
+    }
+
+    std::vector<_NamedFifo> const & fifos() const
+    {
+        return fifos_;
+    }
+
+    std::vector<WorkStealingPool::_Ptr> const & pools() const
+    {
+        return pools_;
+    }
+
+    std::vector<_NamedByteBudget> const & byteBudgets() const
+    {
+        return byte_budgets_;
+    }
+
+    // the same numbers as printMetrics(), as <pipeline name>_stage_*, _fifo_*, _byte_budget_*, and _pool_* metrics labelled with the
+    // stage, fifo, budget, or pool name; byte counts are in bytes and times in seconds, except for the _fifo_lock_* metrics of fifos with
+    // contention profiling, which are as for LockStats::writeMetrics(). meant to be called from a MetricsRegistry collector
+    void writeMetrics( MetricsWriter & writer ) const
+    {
+        std::string const prefix = name_ + "_";
+
+        auto const stage_label = []( StageBase const & stage ){ return MetricsWriter::label( "stage", stage.name() ); };
+        auto const fifo_label = []( _NamedFifo const & named_fifo ){ return MetricsWriter::label( "fifo", named_fifo.first ); };
+        auto const byte_budget_label = []( _NamedByteBudget const & named_byte_budget ){ return MetricsWriter::label( "budget", named_byte_budget.first ); };
+
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            writer.gauge( prefix + "stage_workers", "worker threads (0 for stages run by a pool)", ( *stage_it )->pooled() ? 0 : ( *stage_it )->numWorkers(), stage_label( **stage_it ) );
+        }
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            writer.counter( prefix + "stage_processed_total", "items produced (or, for sinks, consumed)", ( *stage_it )->metrics().num_processed_.load(), stage_label( **stage_it ) );
+        }
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            writer.counter( prefix + "stage_busy_seconds_total", "time spent in the stage function", ( *stage_it )->metrics().busy_time_ / 1e6, stage_label( **stage_it ) );
+        }
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            writer.counter( prefix + "stage_dropped_total", "items the stage threw away", ( *stage_it )->metrics().num_dropped_.load(), stage_label( **stage_it ) );
+        }
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            writer.counter( prefix + "stage_skipped_total", "items the stage gave up waiting for", ( *stage_it )->metrics().num_skipped_.load(), stage_label( **stage_it ) );
+        }
+
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            writer.gauge( prefix + "fifo_size", "items queued", fifo_it->second->size(), fifo_label( *fifo_it ) );
+        }
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            writer.gauge( prefix + "fifo_capacity", "most items the fifo holds", fifo_it->second->capacity(), fifo_label( *fifo_it ) );
+        }
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            writer.gauge( prefix + "fifo_bytes", "bytes held by the queued items (fifos with a sizer only)", fifo_it->second->bytes(), fifo_label( *fifo_it ) );
+        }
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            writer.gauge( prefix + "fifo_peak_bytes", "most bytes held at once", fifo_it->second->peakBytes(), fifo_label( *fifo_it ) );
+        }
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            writer.gauge( prefix + "fifo_byte_capacity", "most bytes the fifo holds, 0 for no limit", fifo_it->second->byteCapacity(), fifo_label( *fifo_it ) );
+        }
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            writer.counter( prefix + "fifo_dropped_total", "items dropped by the fifo's overflow policy", fifo_it->second->numDropped(), fifo_label( *fifo_it ) );
+        }
+
+        LockStats::_LabelledStats fifo_lock_stats;
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            if( fifo_it->second->lockStats() ) fifo_lock_stats.push_back( std::make_pair( fifo_it->second->lockStats(), fifo_label( *fifo_it ) ) );
+        }
+        LockStats::writeMetrics( writer, prefix + "fifo_lock_", fifo_lock_stats );
+
+        for( auto byte_budget_it = byte_budgets_.begin(); byte_budget_it != byte_budgets_.end(); ++byte_budget_it )
+        {
+            writer.gauge( prefix + "byte_budget_bytes", "bytes taken from the budget", byte_budget_it->second->bytes(), byte_budget_label( *byte_budget_it ) );
+        }
+        for( auto byte_budget_it = byte_budgets_.begin(); byte_budget_it != byte_budgets_.end(); ++byte_budget_it )
+        {
+            writer.gauge( prefix + "byte_budget_peak_bytes", "most bytes taken at once", byte_budget_it->second->peakBytes(), byte_budget_label( *byte_budget_it ) );
+        }
+        for( auto byte_budget_it = byte_budgets_.begin(); byte_budget_it != byte_budgets_.end(); ++byte_budget_it )
+        {
+            writer.gauge( prefix + "byte_budget_capacity", "bytes in the budget, 0 for no limit", byte_budget_it->second->capacity(), byte_budget_label( *byte_budget_it ) );
+        }
+
+        for( auto pool_it = pools_.begin(); pool_it != pools_.end(); ++pool_it )
+        {
+            writer.gauge( prefix + "pool_workers", "threads in the pool", ( *pool_it )->numWorkers(), MetricsWriter::label( "pool", ( *pool_it )->name() ) );
+        }
+        for( auto pool_it = pools_.begin(); pool_it != pools_.end(); ++pool_it )
+        {
+            auto const & jobs = ( *pool_it )->jobs();
+            for( auto job_it = jobs.begin(); job_it != jobs.end(); ++job_it )
+            {
+                std::string const labels = MetricsWriter::label( "pool", ( *pool_it )->name() ) + "," + stage_label( *( *job_it )->stage_ptr_ );
+                writer.counter( prefix + "pool_steps_total", "items processed by the stage's home workers (home) or by workers stealing from elsewhere (stolen)", ( *job_it )->num_home_steps_.load(), labels + "," + MetricsWriter::label( "worker", "home" ) );
+                writer.counter( prefix + "pool_steps_total", "items processed by the stage's home workers (home) or by workers stealing from elsewhere (stolen)", ( *job_it )->num_stolen_steps_.load(), labels + "," + MetricsWriter::label( "worker", "stolen" ) );
+            }
+        }
+    }
+
+    // one line per stage, fifo, and byte budget, then two per fifo with contention profiling, followed by the pools; byte counts are in KB
+    void printMetrics( std::ostream & out ) const
+    {
+        for( auto stage_it = stages_.begin(); stage_it != stages_.end(); ++stage_it )
+        {
+            auto const & stage = **stage_it;
+            uint64_t const num_processed = stage.metrics().num_processed_;
+            uint64_t const busy_time = stage.metrics().busy_time_;
+
+            out << std::setw( 24 ) << std::left << stage.name() << std::right << " workers: ";
+            if( stage.pooled() ) out << " -";
+            else out << std::setw( 2 ) << stage.numWorkers();
+
+            out << " processed: " << std::setw( 8 ) << num_processed
+                << " avg: " << std::setw( 8 ) << ( num_processed > 0 ? busy_time / num_processed : 0 ) << " us";
+
+            if( stage.metrics().num_dropped_ > 0 ) out << " dropped: " << stage.metrics().num_dropped_;
+            if( stage.metrics().num_skipped_ > 0 ) out << " skipped: " << stage.metrics().num_skipped_;
+
+            out << std::endl;
+        }
+
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            auto const & fifo = *fifo_it->second;
+            out << std::setw( 24 ) << std::left << fifo_it->first << std::right
+                << " size: " << std::setw( 4 ) << fifo.size() << " / " << fifo.capacity();
+
+            if( fifo.peakBytes() > 0 || fifo.byteCapacity() > 0 )
+            {
+                out << " kb: " << std::setw( 6 ) << fifo.bytes() / 1024 << " / ";
+                if( fifo.byteCapacity() > 0 ) out << fifo.byteCapacity() / 1024;
+                else out << "-";
+                out << " peak: " << fifo.peakBytes() / 1024;
+            }
+
+            if( fifo.overflowPolicy() != FifoBase::OverflowPolicy::BLOCK ) out << " " << FifoBase::overflowPolicyName( fifo.overflowPolicy() ) << " dropped: " << fifo.numDropped();
+
+            out << ( fifo.closed() ? " (closed)" : "" ) << std::endl;
+        }
+
+        for( auto fifo_it = fifos_.begin(); fifo_it != fifos_.end(); ++fifo_it )
+        {
+            if( fifo_it->second->lockStats() ) fifo_it->second->lockStats()->print( out );
+        }
+
+        for( auto byte_budget_it = byte_budgets_.begin(); byte_budget_it != byte_budgets_.end(); ++byte_budget_it )
+        {
+            auto const & byte_budget = *byte_budget_it->second;
+            out << std::setw( 24 ) << std::left << byte_budget_it->first << std::right
+                << " kb: " << std::setw( 6 ) << byte_budget.bytes() / 1024 << " / ";
+            if( byte_budget.capacity() > 0 ) out << byte_budget.capacity() / 1024;
+            else out << "-";
+            out << " peak: " << byte_budget.peakBytes() / 1024 << std::endl;
+        }
+
+        for( auto pool_it = pools_.begin(); pool_it != pools_.end(); ++pool_it )
+        {
+            (*pool_it)->printMetrics( out );
+        }
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_PIPELINE_H_
@@ -0,0 +1,330 @@
+#ifndef _ATOMICS_REORDER_BUFFER_H_
+#define _ATOMICS_REORDER_BUFFER_H_
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+#include <atomics/stage.h>
+
+namespace atomics
+{
+
+// puts items from any number of independently-sequenced streams back into per-stream sequence order
+//
+// every stream's sequence numbers are expected to start at 0 and count up by one. an item is released as soon as all of its predecessors
+// have been released (or skipped). if a stream's next item hasn't shown up within max_wait of the buffer first having to hold something
+// back, or more than max_pending items are being held back, we give up on the missing items and move on. anything that arrives after
+// we've given up on it is dropped, since releasing it would break the ordering
+//
+// __Data must be default-constructible and test false when empty (eg: a shared_ptr); empty items mark holes we know about
+template<class __Data>
+class ReorderBuffer
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+    typedef _Clock::duration _Duration;
+    typedef _Clock::time_point _TimePoint;
+    typedef std::vector<__Data> _Output;
+
+protected:
+    struct Stream
+    {
+        uint64_t next_sequence_;
+        std::map<uint64_t, __Data> pending_;
+        // when we started holding items back waiting for next_sequence_
+        _TimePoint stalled_since_;
+
+        Stream()
+        :
+            next_sequence_( 0 )
+        {
+            //
+        }
+    };
+
+    std::map<uint32_t, Stream> streams_;
+    _Duration max_wait_;
+    size_t max_pending_;
+
+    uint64_t num_skipped_;
+    uint64_t num_late_;
+
+public:
+    ReorderBuffer( _Duration max_wait = std::chrono::milliseconds( 200 ), size_t max_pending = 64 )
+    :
+        max_wait_( max_wait ),
+        max_pending_( max_pending ),
+        num_skipped_( 0 ),
+        num_late_( 0 )
+    {
+        //
+    }
+
+    // add an item; anything now in order is appended to output
+    void push( uint32_t stream_id, uint64_t sequence, __Data data, _Output & output, _TimePoint const & now = _Clock::now() )
+    {
+        auto & stream = streams_[stream_id];
+
+        if( sequence < stream.next_sequence_ || stream.pending_.count( sequence ) )
+        {
+            ++num_late_;
+            return;
+        }
+
+        if( stream.pending_.empty() ) stream.stalled_since_ = now;
+        stream.pending_.insert( std::make_pair( sequence, std::move( data ) ) );
+
+        release( stream, output, now );
+
+        if( stream.pending_.size() > max_pending_ ) skipToPending( stream, output, now );
+    }
+
+    // we know the given item is never going to arrive (eg: it was dropped upstream), so don't wait for it
+    void skip( uint32_t stream_id, uint64_t sequence, _Output & output, _TimePoint const & now = _Clock::now() )
+    {
+        auto & stream = streams_[stream_id];
+
+        if( sequence < stream.next_sequence_ ) return;
+
+        if( sequence == stream.next_sequence_ )
+        {
+            ++stream.next_sequence_;
+            ++num_skipped_;
+            stream.stalled_since_ = now;
+            release( stream, output, now );
+            return;
+        }
+
+        // not our turn yet; remember the hole with an empty placeholder, which release() will step over
+        if( stream.pending_.empty() ) stream.stalled_since_ = now;
+        stream.pending_.insert( std::make_pair( sequence, __Data() ) );
+    }
+
+    // give up on anything that's been holding up its stream for longer than max_wait
+    void flush( _Output & output, _TimePoint const & now = _Clock::now() )
+    {
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            auto & stream = stream_it->second;
+            if( !stream.pending_.empty() && now - stream.stalled_since_ >= max_wait_ ) skipToPending( stream, output, now );
+        }
+    }
+
+    // release everything we're holding, in order, regardless of gaps
+    void drain( _Output & output )
+    {
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            auto & stream = stream_it->second;
+            while( !stream.pending_.empty() ) skipToPending( stream, output, _Clock::now() );
+        }
+    }
+
+    // how long until flush() next has something to do; _Duration::max() if nothing is being held back
+    _Duration timeUntilFlush( _TimePoint const & now = _Clock::now() ) const
+    {
+        _Duration result = _Duration::max();
+
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            auto const & stream = stream_it->second;
+            if( stream.pending_.empty() ) continue;
+
+            _Duration const remaining = stream.stalled_since_ + max_wait_ - now;
+            if( remaining < result ) result = remaining;
+        }
+
+        return result < _Duration::zero() ? _Duration::zero() : result;
+    }
+
+    void setMaxWait( _Duration max_wait )
+    {
+        max_wait_ = max_wait;
+    }
+
+    void setMaxPending( size_t max_pending )
+    {
+        max_pending_ = max_pending;
+    }
+
+    _Duration maxWait() const
+    {
+        return max_wait_;
+    }
+
+    size_t maxPending() const
+    {
+        return max_pending_;
+    }
+
+    // number of sequence numbers we gave up waiting for
+    uint64_t numSkipped() const
+    {
+        return num_skipped_;
+    }
+
+    // number of items that showed up after we'd given up on them
+    uint64_t numLate() const
+    {
+        return num_late_;
+    }
+
+protected:
+    // release items from the front of the stream for as long as they're in sequence
+    void release( Stream & stream, _Output & output, _TimePoint const & now )
+    {
+        bool released = false;
+
+        while( !stream.pending_.empty() && stream.pending_.begin()->first == stream.next_sequence_ )
+        {
+            auto & data = stream.pending_.begin()->second;
+            // empty placeholders mark items that are known to be missing
+            if( data ) output.push_back( std::move( data ) );
+            else ++num_skipped_;
+
+            stream.pending_.erase( stream.pending_.begin() );
+            ++stream.next_sequence_;
+            released = true;
+        }
+
+        // whatever is still held back has only been waiting since now
+        if( released ) stream.stalled_since_ = now;
+    }
+
+    // give up on the gap in front of the oldest pending item
+    void skipToPending( Stream & stream, _Output & output, _TimePoint const & now )
+    {
+        if( stream.pending_.empty() ) return;
+
+        uint64_t const first_pending = stream.pending_.begin()->first;
+        num_skipped_ += first_pending - stream.next_sequence_;
+        stream.next_sequence_ = first_pending;
+
+        release( stream, output, now );
+    }
+};
+
+// ####################################################################################################
+// single-threaded stage that runs everything from its input through a ReorderBuffer before passing it on
+// __Sequencer provides uint32_t stream( __Data const & ) and uint64_t sequence( __Data const & )
+//
+// configuration keys, besides workers (which is always 1):
+//   <prefix>.<stage name>.max_wait_ms
+//   <prefix>.<stage name>.max_pending
+template<class __Data, class __Sequencer>
+class ReorderStage : public StageBase
+{
+public:
+    typedef Fifo<__Data> _Fifo;
+    typedef std::shared_ptr<_Fifo> _FifoPtr;
+    typedef ReorderBuffer<__Data> _ReorderBuffer;
+    typedef typename _ReorderBuffer::_Output _Output;
+
+protected:
+    _FifoPtr input_ptr_;
+    _FifoPtr output_ptr_;
+    __Sequencer sequencer_;
+
+    // guards the buffer and ready_, since skip() may be called from any thread
+    _Mutex buffer_mutex_;
+    _ReorderBuffer buffer_;
+    // items released by the buffer but not yet passed on; only the worker thread pushes to the output, so they stay in order
+    _Output ready_;
+
+public:
+    ReorderStage( std::string const & name, _FifoPtr input_ptr, _FifoPtr output_ptr, std::chrono::milliseconds max_wait = std::chrono::milliseconds( 200 ), size_t max_pending = 64, __Sequencer sequencer = __Sequencer() )
+    :
+        StageBase( name, 1, input_ptr.get(), output_ptr.get() ),
+        input_ptr_( input_ptr ),
+        output_ptr_( output_ptr ),
+        sequencer_( sequencer ),
+        buffer_( max_wait, max_pending )
+    {
+        //
+    }
+
+    void configure( Poco::Util::AbstractConfiguration const & config, std::string const & prefix )
+    {
+        _Lock lock( buffer_mutex_ );
+
+        int const max_wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>( buffer_.maxWait() ).count();
+        buffer_.setMaxWait( std::chrono::milliseconds( config.getInt( prefix + "." + name_ + ".max_wait_ms", max_wait_ms ) ) );
+        buffer_.setMaxPending( config.getInt( prefix + "." + name_ + ".max_pending", static_cast<int>( buffer_.maxPending() ) ) );
+    }
+
+    // the given item was dropped before it got to us; stop waiting for it
+    // anything this releases goes out with the worker's next batch, so wake the worker in case it is blocked on an empty input
+    void skip( uint32_t stream, uint64_t sequence )
+    {
+        bool released;
+        {
+            _Lock lock( buffer_mutex_ );
+            buffer_.skip( stream, sequence, ready_ );
+            released = !ready_.empty();
+            updateMetrics();
+        }
+
+        if( released ) input_ptr_->wake();
+    }
+
+protected:
+    void run()
+    {
+        _Output output;
+        __Data input;
+
+        while( true )
+        {
+            typename _ReorderBuffer::_Duration wait_time;
+            {
+                _Lock lock( buffer_mutex_ );
+                wait_time = buffer_.timeUntilFlush();
+            }
+
+            // sleep until something arrives, or until the oldest held-back item has waited long enough
+            bool const popped = wait_time == _ReorderBuffer::_Duration::max() ? input_ptr_->pop( input ) : input_ptr_->popFor( input, wait_time );
+            bool const done = !popped && input_ptr_->closed() && input_ptr_->empty();
+
+            {
+                _Lock lock( buffer_mutex_ );
+
+                if( popped )
+                {
+                    auto const start_time = _Clock::now();
+                    uint32_t const stream = sequencer_.stream( input );
+                    uint64_t const sequence = sequencer_.sequence( input );
+                    buffer_.push( stream, sequence, std::move( input ), ready_ );
+                    recordCall( start_time );
+                }
+
+                buffer_.flush( ready_ );
+
+                if( done ) buffer_.drain( ready_ );
+
+                updateMetrics();
+                output.swap( ready_ );
+            }
+
+            for( auto output_it = output.begin(); output_it != output.end(); ++output_it )
+            {
+                if( !output_ptr_->push( std::move( *output_it ) ) ) return;
+            }
+            output.clear();
+
+            if( done ) break;
+        }
+    }
+
+    void updateMetrics()
+    {
+        metrics_.num_skipped_ = buffer_.numSkipped();
+        metrics_.num_dropped_ = buffer_.numLate();
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_REORDER_BUFFER_H_
@@ -0,0 +1,424 @@
+#ifndef _ATOMICS_STAGE_H_
+#define _ATOMICS_STAGE_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include <Poco/Util/AbstractConfiguration.h>
+
+#include <atomics/fifo.h>
+#include <atomics/trace.h>
+
+namespace atomics
+{
+
+// counters shared by all of a stage's workers
+struct StageMetrics
+{
+    // number of times the stage function produced (or, for sinks, consumed) an item
+    std::atomic<uint64_t> num_processed_;
+    // total time spent inside the stage function, in microseconds; for sources this includes time spent waiting on the device
+    std::atomic<uint64_t> busy_time_;
+    // number of items this stage threw away
+    std::atomic<uint64_t> num_dropped_;
+    // number of items this stage gave up waiting for
+    std::atomic<uint64_t> num_skipped_;
+
+    StageMetrics()
+    :
+        num_processed_( 0 ),
+        busy_time_( 0 ),
+        num_dropped_( 0 ),
+        num_skipped_( 0 )
+    {
+        //
+    }
+};
+
+// ####################################################################################################
+// type-independent part of a pipeline stage: owns the worker threads and the start/stop/drain logic
+//
+// sources run until stop() is called; all other stages run until their input fifo is closed and drained
+// a pooled stage owns no threads; instead some scheduler (see WorkStealingPool) calls tryStep() whenever it has a thread to spare
+// a stage registers itself as a producer on its output fifo when started, and deregisters once all of its workers have exited,
+// so the output is closed (and the next stage starts draining) as soon as the last stage feeding it is done
+class StageBase
+{
+public:
+    typedef std::shared_ptr<StageBase> _Ptr;
+    typedef std::chrono::steady_clock _Clock;
+    typedef std::mutex _Mutex;
+    typedef std::unique_lock<_Mutex> _Lock;
+
+protected:
+    std::string name_;
+    size_t num_workers_;
+    FifoBase * input_fifo_;
+    FifoBase * output_fifo_;
+
+    std::atomic<bool> running_;
+    bool started_;
+    std::vector<std::thread> workers_;
+    StageMetrics metrics_;
+
+    bool pooled_;
+    // number of tryStep() calls in flight; a pooled stage is done once its input is closed and drained and this drops to zero
+    std::atomic<size_t> active_steps_;
+    _Mutex drained_mutex_;
+    std::condition_variable drained_condition_;
+
+public:
+    StageBase( std::string const & name, size_t num_workers, FifoBase * input_fifo, FifoBase * output_fifo )
+    :
+        name_( name ),
+        num_workers_( num_workers ),
+        input_fifo_( input_fifo ),
+        output_fifo_( output_fifo ),
+        running_( false ),
+        started_( false ),
+        pooled_( false ),
+        active_steps_( 0 )
+    {
+        //
+    }
+
+    // stages should be stopped and joined (normally by their Pipeline) before they are destroyed; this is only a last resort
+    virtual ~StageBase()
+    {
+        stop();
+        join();
+    }
+
+    // launch num_workers_ threads running run(); pooled stages just get marked as running
+    void start()
+    {
+        if( started_ ) return;
+
+        if( output_fifo_ ) output_fifo_->addProducer();
+
+        running_ = true;
+        started_ = true;
+
+        if( pooled_ ) return;
+
+        for( size_t i = 0; i < num_workers_; ++i )
+        {
+            workers_.emplace_back( &StageBase::runWorker, this );
+        }
+    }
+
+    // ask the workers to exit; only sources check this flag, everyone else exits once their input has been drained
+    void stop()
+    {
+        running_ = false;
+    }
+
+    // wait for all workers to exit (or, for pooled stages, for the input to be drained), then release our hold on the output fifo
+    void join()
+    {
+        if( pooled_ && started_ && input_fifo_ )
+        {
+            _Lock lock( drained_mutex_ );
+            drained_condition_.wait( lock, [this](){ return drained(); } );
+        }
+
+        for( auto worker_it = workers_.begin(); worker_it != workers_.end(); ++worker_it )
+        {
+            if( worker_it->joinable() ) worker_it->join();
+        }
+        workers_.clear();
+
+        if( started_ && output_fifo_ ) output_fifo_->removeProducer();
+        started_ = false;
+    }
+
+    // read this stage's settings from keys of the form <prefix>.<stage name>.<setting>; the base stage only knows about workers
+    virtual void configure( Poco::Util::AbstractConfiguration const & config, std::string const & prefix )
+    {
+        num_workers_ = config.getInt( prefix + "." + name_ + ".workers", static_cast<int>( num_workers_ ) );
+    }
+
+    std::string const & name() const
+    {
+        return name_;
+    }
+
+    size_t numWorkers() const
+    {
+        return num_workers_;
+    }
+
+    // only takes effect on the next start()
+    void setNumWorkers( size_t num_workers )
+    {
+        num_workers_ = num_workers;
+    }
+
+    bool running() const
+    {
+        return running_;
+    }
+
+    bool pooled() const
+    {
+        return pooled_;
+    }
+
+    // must be set before start()
+    void setPooled( bool pooled )
+    {
+        pooled_ = pooled;
+    }
+
+    // process at most one item without blocking on the input; returns true if an item was processed
+    // only stages with an input support this; everyone else always returns false
+    virtual bool tryStep()
+    {
+        return false;
+    }
+
+    bool drained() const
+    {
+        return input_fifo_ && input_fifo_->closed() && input_fifo_->size() == 0 && active_steps_ == 0;
+    }
+
+    StageMetrics const & metrics() const
+    {
+        return metrics_;
+    }
+
+    FifoBase * inputFifo() const
+    {
+        return input_fifo_;
+    }
+
+    FifoBase * outputFifo() const
+    {
+        return output_fifo_;
+    }
+
+protected:
+    // the loop executed by each worker thread
+    virtual void run() = 0;
+
+    // names the worker's thread in traces (see atomics/trace.h), then runs it
+    void runWorker()
+    {
+        Tracer::instance().setThreadName( name_ );
+        run();
+    }
+
+    void beginStep()
+    {
+        ++active_steps_;
+    }
+
+    // wake up join() if this was the last step it was waiting on
+    void endStep()
+    {
+        --active_steps_;
+
+        if( !drained() ) return;
+
+        {
+            _Lock lock( drained_mutex_ );
+        }
+        drained_condition_.notify_all();
+    }
+
+    void recordCall( _Clock::time_point const & start_time )
+    {
+        ++metrics_.num_processed_;
+        metrics_.busy_time_ += std::chrono::duration_cast<std::chrono::microseconds>( _Clock::now() - start_time ).count();
+    }
+};
+
+// ####################################################################################################
+// transform stage: pops an __In off the input fifo, calls __Out __Fn( __In & ), and pushes the result onto the output fifo
+// each worker calls its own copy of the function object, so stateful functions (codecs, accumulators) don't need to be thread-safe
+template<class __In, class __Out, class __Fn>
+class Stage : public StageBase
+{
+public:
+    typedef Fifo<__In> _InputFifo;
+    typedef Fifo<__Out> _OutputFifo;
+    typedef std::shared_ptr<_InputFifo> _InputFifoPtr;
+    typedef std::shared_ptr<_OutputFifo> _OutputFifoPtr;
+    typedef __Fn _Fn;
+
+protected:
+    _InputFifoPtr input_ptr_;
+    _OutputFifoPtr output_ptr_;
+    _Fn fn_;
+
+    // copies of fn_ for tryStep(), which may be called from any number of threads at once
+    _Mutex fn_copies_mutex_;
+    std::vector<std::unique_ptr<_Fn> > fn_copies_;
+
+public:
+    Stage( std::string const & name, size_t num_workers, _InputFifoPtr input_ptr, _Fn fn, _OutputFifoPtr output_ptr )
+    :
+        StageBase( name, num_workers, input_ptr.get(), output_ptr.get() ),
+        input_ptr_( input_ptr ),
+        output_ptr_( output_ptr ),
+        fn_( fn )
+    {
+        //
+    }
+
+    bool tryStep()
+    {
+        beginStep();
+
+        __In input;
+        bool const stepped = input_ptr_->tryPop( input );
+
+        if( stepped )
+        {
+            auto fn_ptr = acquireFn();
+
+            auto const start_time = _Clock::now();
+            __Out output = (*fn_ptr)( input );
+            recordCall( start_time );
+
+            releaseFn( std::move( fn_ptr ) );
+
+            output_ptr_->push( std::move( output ) );
+        }
+
+        endStep();
+        return stepped;
+    }
+
+protected:
+    std::unique_ptr<_Fn> acquireFn()
+    {
+        {
+            _Lock lock( fn_copies_mutex_ );
+            if( !fn_copies_.empty() )
+            {
+                auto fn_ptr = std::move( fn_copies_.back() );
+                fn_copies_.pop_back();
+                return fn_ptr;
+            }
+        }
+
+        return std::unique_ptr<_Fn>( new _Fn( fn_ ) );
+    }
+
+    void releaseFn( std::unique_ptr<_Fn> fn_ptr )
+    {
+        _Lock lock( fn_copies_mutex_ );
+        fn_copies_.push_back( std::move( fn_ptr ) );
+    }
+
+    void run()
+    {
+        _Fn fn( fn_ );
+        __In input;
+
+        // sleep until there's something to do; pop() only fails once the input has been closed and drained
+        while( input_ptr_->pop( input ) )
+        {
+            auto const start_time = _Clock::now();
+            __Out output = fn( input );
+            recordCall( start_time );
+
+            // sleep until there is room downstream
+            if( !output_ptr_->push( std::move( output ) ) ) break;
+        }
+    }
+};
+
+// ####################################################################################################
+// source stage: repeatedly calls bool __Fn( __Out & ) and pushes the result whenever the function returns true
+// the function is expected to block on its device for a bounded amount of time and return false if nothing arrived,
+// so that workers notice stop() in a timely manner
+template<class __Out, class __Fn>
+class Stage<void, __Out, __Fn> : public StageBase
+{
+public:
+    typedef Fifo<__Out> _OutputFifo;
+    typedef std::shared_ptr<_OutputFifo> _OutputFifoPtr;
+    typedef __Fn _Fn;
+
+protected:
+    _OutputFifoPtr output_ptr_;
+    _Fn fn_;
+
+public:
+    Stage( std::string const & name, size_t num_workers, _Fn fn, _OutputFifoPtr output_ptr )
+    :
+        StageBase( name, num_workers, NULL, output_ptr.get() ),
+        output_ptr_( output_ptr ),
+        fn_( fn )
+    {
+        //
+    }
+
+protected:
+    void run()
+    {
+        _Fn fn( fn_ );
+
+        while( running_ )
+        {
+            __Out output;
+
+            auto const start_time = _Clock::now();
+            if( !fn( output ) ) continue;
+            recordCall( start_time );
+
+            if( !output_ptr_->push( std::move( output ) ) ) break;
+        }
+    }
+};
+
+// ####################################################################################################
+// sink stage: pops an __In off the input fifo and calls void __Fn( __In & )
+template<class __In, class __Fn>
+class Stage<__In, void, __Fn> : public StageBase
+{
+public:
+    typedef Fifo<__In> _InputFifo;
+    typedef std::shared_ptr<_InputFifo> _InputFifoPtr;
+    typedef __Fn _Fn;
+
+protected:
+    _InputFifoPtr input_ptr_;
+    _Fn fn_;
+
+public:
+    Stage( std::string const & name, size_t num_workers, _InputFifoPtr input_ptr, _Fn fn )
+    :
+        StageBase( name, num_workers, input_ptr.get(), NULL ),
+        input_ptr_( input_ptr ),
+        fn_( fn )
+    {
+        //
+    }
+
+protected:
+    void run()
+    {
+        _Fn fn( fn_ );
+        __In input;
+
+        while( input_ptr_->pop( input ) )
+        {
+            auto const start_time = _Clock::now();
+            fn( input );
+            recordCall( start_time );
+        }
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_STAGE_H_
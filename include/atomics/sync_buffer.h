@@ -0,0 +1,389 @@
+#ifndef _ATOMICS_SYNC_BUFFER_H_
+#define _ATOMICS_SYNC_BUFFER_H_
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include <atomics/stage.h>
+
+namespace atomics
+{
+
+// groups items from a fixed set of streams into bundles of one item per stream, matched by timestamp
+//
+// an item joins the open bundle whose reference stamp (that of the bundle's first item) is closest to its own and within tolerance, as
+// long as that bundle doesn't have an item from its stream yet; otherwise it opens a new bundle. bundles are released in stamp order: a
+// complete bundle right away, along with any older ones still open (their streams have all moved on, so at most a straggler could still
+// fill them); an incomplete one once it's been open for max_wait, or once more than max_pending are open. an item no newer than the
+// last released bundle's stamp plus tolerance missed its bundle and is dropped, as is one from a stream we don't group
+//
+// stamps are in nanoseconds on whatever clock the items were stamped with; tolerance should be under half the streams' frame period
+//
+// __Data must be default-constructible and test false when empty (eg: a shared_ptr); empty slots in a released bundle are missing items
+template<class __Data>
+class SyncBuffer
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+    typedef _Clock::duration _Duration;
+    typedef _Clock::time_point _TimePoint;
+
+    struct Bundle
+    {
+        // the earliest stamp of the items it holds
+        uint64_t stamp_;
+        // one slot per stream, in the order the streams were given
+        std::vector<__Data> items_;
+        size_t num_items_;
+
+        // when the bundle was opened; it's keyed by the stamp of its first item, which is what later items are matched against
+        _TimePoint opened_;
+    };
+
+    typedef std::vector<Bundle> _Output;
+
+protected:
+    std::vector<uint32_t> stream_ids_;
+    std::map<uint64_t, Bundle> open_;
+
+    std::chrono::nanoseconds tolerance_;
+    _Duration max_wait_;
+    size_t max_pending_;
+
+    bool released_any_;
+    uint64_t last_released_stamp_;
+
+    uint64_t num_bundles_;
+    uint64_t num_incomplete_;
+    uint64_t num_missing_;
+    uint64_t num_dropped_;
+
+public:
+    SyncBuffer( std::vector<uint32_t> const & stream_ids, std::chrono::nanoseconds tolerance = std::chrono::milliseconds( 10 ), _Duration max_wait = std::chrono::milliseconds( 100 ), size_t max_pending = 8 )
+    :
+        stream_ids_( stream_ids ),
+        tolerance_( tolerance ),
+        max_wait_( max_wait ),
+        max_pending_( max_pending ),
+        released_any_( false ),
+        last_released_stamp_( 0 ),
+        num_bundles_( 0 ),
+        num_incomplete_( 0 ),
+        num_missing_( 0 ),
+        num_dropped_( 0 )
+    {
+        //
+    }
+
+    // add an item; any bundles now ready are appended to output
+    void push( uint32_t stream_id, uint64_t stamp, __Data data, _Output & output, _TimePoint const & now = _Clock::now() )
+    {
+        size_t const slot = std::find( stream_ids_.begin(), stream_ids_.end(), stream_id ) - stream_ids_.begin();
+        uint64_t const tolerance = static_cast<uint64_t>( tolerance_.count() );
+
+        if( slot == stream_ids_.size() || ( released_any_ && stamp <= last_released_stamp_ + tolerance ) )
+        {
+            ++num_dropped_;
+            return;
+        }
+
+        // the closest open bundle within tolerance that still has room for this stream
+        auto bundle_it = open_.end();
+        uint64_t best_distance = tolerance + 1;
+        for( auto open_it = open_.lower_bound( stamp > tolerance ? stamp - tolerance : 0 ); open_it != open_.end() && open_it->first <= stamp + tolerance; ++open_it )
+        {
+            uint64_t const distance = open_it->first > stamp ? open_it->first - stamp : stamp - open_it->first;
+            if( distance < best_distance && !open_it->second.items_[slot] )
+            {
+                bundle_it = open_it;
+                best_distance = distance;
+            }
+        }
+
+        if( bundle_it == open_.end() )
+        {
+            Bundle bundle;
+            bundle.stamp_ = stamp;
+            bundle.items_.resize( stream_ids_.size() );
+            bundle.num_items_ = 0;
+            bundle.opened_ = now;
+
+            // two items with the same stamp from the same stream; make room for the second
+            uint64_t reference_stamp = stamp;
+            while( open_.count( reference_stamp ) ) ++reference_stamp;
+
+            bundle_it = open_.insert( std::make_pair( reference_stamp, std::move( bundle ) ) ).first;
+        }
+
+        Bundle & bundle = bundle_it->second;
+        bundle.items_[slot] = std::move( data );
+        bundle.stamp_ = std::min( bundle.stamp_, stamp );
+        ++bundle.num_items_;
+
+        if( bundle.num_items_ == stream_ids_.size() ) releaseThrough( bundle_it, output );
+
+        while( open_.size() > max_pending_ ) releaseThrough( open_.begin(), output );
+    }
+
+    // release every bundle up to the newest one that's been open for longer than max_wait
+    void flush( _Output & output, _TimePoint const & now = _Clock::now() )
+    {
+        auto last_expired_it = open_.end();
+        for( auto open_it = open_.begin(); open_it != open_.end(); ++open_it )
+        {
+            if( now - open_it->second.opened_ >= max_wait_ ) last_expired_it = open_it;
+        }
+
+        if( last_expired_it != open_.end() ) releaseThrough( last_expired_it, output );
+    }
+
+    // release everything we're holding, complete or not
+    void drain( _Output & output )
+    {
+        if( !open_.empty() ) releaseThrough( std::prev( open_.end() ), output );
+    }
+
+    // how long until flush() next has something to do; _Duration::max() if no bundle is open
+    _Duration timeUntilFlush( _TimePoint const & now = _Clock::now() ) const
+    {
+        _Duration result = _Duration::max();
+
+        for( auto open_it = open_.begin(); open_it != open_.end(); ++open_it )
+        {
+            _Duration const remaining = open_it->second.opened_ + max_wait_ - now;
+            if( remaining < result ) result = remaining;
+        }
+
+        return result < _Duration::zero() ? _Duration::zero() : result;
+    }
+
+    void setTolerance( std::chrono::nanoseconds tolerance )
+    {
+        tolerance_ = tolerance;
+    }
+
+    void setMaxWait( _Duration max_wait )
+    {
+        max_wait_ = max_wait;
+    }
+
+    void setMaxPending( size_t max_pending )
+    {
+        max_pending_ = std::max<size_t>( max_pending, 1 );
+    }
+
+    std::chrono::nanoseconds tolerance() const
+    {
+        return tolerance_;
+    }
+
+    _Duration maxWait() const
+    {
+        return max_wait_;
+    }
+
+    size_t maxPending() const
+    {
+        return max_pending_;
+    }
+
+    size_t numStreams() const
+    {
+        return stream_ids_.size();
+    }
+
+    // whether items from the given stream are bundled at all
+    bool grouped( uint32_t stream_id ) const
+    {
+        return std::find( stream_ids_.begin(), stream_ids_.end(), stream_id ) != stream_ids_.end();
+    }
+
+    // number of bundles released, and how many of those were missing at least one item
+    uint64_t numBundles() const
+    {
+        return num_bundles_;
+    }
+
+    uint64_t numIncomplete() const
+    {
+        return num_incomplete_;
+    }
+
+    // number of empty slots across all released bundles
+    uint64_t numMissing() const
+    {
+        return num_missing_;
+    }
+
+    // number of items that missed their bundle or belonged to no stream we group
+    uint64_t numDropped() const
+    {
+        return num_dropped_;
+    }
+
+protected:
+    // release the given bundle and every older one, oldest first
+    void releaseThrough( typename std::map<uint64_t, Bundle>::iterator last_it, _Output & output )
+    {
+        auto const end_it = std::next( last_it );
+        for( auto open_it = open_.begin(); open_it != end_it; ++open_it )
+        {
+            Bundle & bundle = open_it->second;
+
+            ++num_bundles_;
+            if( bundle.num_items_ < stream_ids_.size() )
+            {
+                ++num_incomplete_;
+                num_missing_ += stream_ids_.size() - bundle.num_items_;
+            }
+
+            last_released_stamp_ = released_any_ ? std::max( last_released_stamp_, open_it->first ) : open_it->first;
+            released_any_ = true;
+
+            output.push_back( std::move( bundle ) );
+        }
+
+        open_.erase( open_.begin(), end_it );
+    }
+};
+
+// ####################################################################################################
+// single-threaded stage that groups the items of the given streams with a SyncBuffer and passes on one item per bundle in their place;
+// items of any other stream are passed on as they come
+// __Bundler provides uint32_t stream( __Data const & ), uint64_t stamp( __Data const & ) in nanoseconds, and
+// __Data bundle( uint64_t stamp, std::vector<__Data> & items ), which gets one slot per stream (empty where an item is missing)
+//
+// metrics: skipped counts the items missing from released bundles, and dropped the items that came too late for theirs
+//
+// configuration keys, besides workers (which is always 1):
+//   <prefix>.<stage name>.tolerance_ms
+//   <prefix>.<stage name>.max_wait_ms
+//   <prefix>.<stage name>.max_pending
+template<class __Data, class __Bundler>
+class SyncStage : public StageBase
+{
+public:
+    typedef Fifo<__Data> _Fifo;
+    typedef std::shared_ptr<_Fifo> _FifoPtr;
+    typedef SyncBuffer<__Data> _SyncBuffer;
+    typedef typename _SyncBuffer::_Output _Output;
+
+protected:
+    _FifoPtr input_ptr_;
+    _FifoPtr output_ptr_;
+    __Bundler bundler_;
+
+    // guards the buffer against configure() while running
+    _Mutex buffer_mutex_;
+    _SyncBuffer buffer_;
+
+    std::atomic<uint64_t> num_bundles_;
+    std::atomic<uint64_t> num_incomplete_;
+
+public:
+    SyncStage( std::string const & name, _FifoPtr input_ptr, _FifoPtr output_ptr, std::vector<uint32_t> const & stream_ids, std::chrono::milliseconds tolerance = std::chrono::milliseconds( 10 ), std::chrono::milliseconds max_wait = std::chrono::milliseconds( 100 ), size_t max_pending = 8, __Bundler bundler = __Bundler() )
+    :
+        StageBase( name, 1, input_ptr.get(), output_ptr.get() ),
+        input_ptr_( input_ptr ),
+        output_ptr_( output_ptr ),
+        bundler_( bundler ),
+        buffer_( stream_ids, tolerance, max_wait, max_pending ),
+        num_bundles_( 0 ),
+        num_incomplete_( 0 )
+    {
+        //
+    }
+
+    void configure( Poco::Util::AbstractConfiguration const & config, std::string const & prefix )
+    {
+        _Lock lock( buffer_mutex_ );
+
+        int const tolerance_ms = std::chrono::duration_cast<std::chrono::milliseconds>( buffer_.tolerance() ).count();
+        int const max_wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>( buffer_.maxWait() ).count();
+        buffer_.setTolerance( std::chrono::milliseconds( config.getInt( prefix + "." + name_ + ".tolerance_ms", tolerance_ms ) ) );
+        buffer_.setMaxWait( std::chrono::milliseconds( config.getInt( prefix + "." + name_ + ".max_wait_ms", max_wait_ms ) ) );
+        buffer_.setMaxPending( config.getInt( prefix + "." + name_ + ".max_pending", static_cast<int>( buffer_.maxPending() ) ) );
+    }
+
+    // bundles passed on, and how many of those were missing at least one stream
+    uint64_t numBundles() const
+    {
+        return num_bundles_;
+    }
+
+    uint64_t numIncomplete() const
+    {
+        return num_incomplete_;
+    }
+
+protected:
+    void run()
+    {
+        _Output output;
+        std::vector<__Data> passed;
+        __Data input;
+
+        while( true )
+        {
+            typename _SyncBuffer::_Duration wait_time;
+            {
+                _Lock lock( buffer_mutex_ );
+                wait_time = buffer_.timeUntilFlush();
+            }
+
+            // sleep until something arrives, or until the oldest open bundle has waited long enough
+            bool const popped = wait_time == _SyncBuffer::_Duration::max() ? input_ptr_->pop( input ) : input_ptr_->popFor( input, wait_time );
+            bool const done = !popped && input_ptr_->closed() && input_ptr_->empty();
+
+            {
+                _Lock lock( buffer_mutex_ );
+
+                if( popped )
+                {
+                    auto const start_time = _Clock::now();
+                    uint32_t const stream = bundler_.stream( input );
+                    if( buffer_.grouped( stream ) )
+                    {
+                        uint64_t const stamp = bundler_.stamp( input );
+                        buffer_.push( stream, stamp, std::move( input ), output );
+                    }
+                    else passed.push_back( std::move( input ) );
+                    recordCall( start_time );
+                }
+
+                buffer_.flush( output );
+
+                if( done ) buffer_.drain( output );
+
+                metrics_.num_skipped_ = buffer_.numMissing();
+                metrics_.num_dropped_ = buffer_.numDropped();
+                num_bundles_ = buffer_.numBundles();
+                num_incomplete_ = buffer_.numIncomplete();
+            }
+
+            for( auto passed_it = passed.begin(); passed_it != passed.end(); ++passed_it )
+            {
+                if( !output_ptr_->push( std::move( *passed_it ) ) ) return;
+            }
+            passed.clear();
+
+            // bundling may mean encoding, so it's done outside the lock
+            for( auto bundle_it = output.begin(); bundle_it != output.end(); ++bundle_it )
+            {
+                if( !output_ptr_->push( bundler_.bundle( bundle_it->stamp_, bundle_it->items_ ) ) ) return;
+            }
+            output.clear();
+
+            if( done ) break;
+        }
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_SYNC_BUFFER_H_
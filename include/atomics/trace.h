@@ -0,0 +1,294 @@
+#ifndef _ATOMICS_TRACE_H_
+#define _ATOMICS_TRACE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+// a plain pointer per thread; msvc 12 has no thread_local, but both compilers have had this forever
+#ifdef _MSC_VER
+#define ATOMICS_THREAD_LOCAL __declspec( thread )
+#else
+#define ATOMICS_THREAD_LOCAL __thread
+#endif
+
+#define ATOMICS_TRACE_CONCAT_IMPL( a, b ) a##b
+#define ATOMICS_TRACE_CONCAT( a, b ) ATOMICS_TRACE_CONCAT_IMPL( a, b )
+
+// record the time from here to the end of the enclosing scope as an event with the given name (a string literal) while tracing is on
+#define ATOMICS_TRACE_SCOPE( name ) atomics::TraceScope ATOMICS_TRACE_CONCAT( atomics_trace_scope_, __LINE__ )( name )
+
+namespace atomics
+{
+
+// ####################################################################################################
+// a span of time on one thread, in nanoseconds on the steady clock; name_ must outlive the tracer (use string literals)
+struct TraceEvent
+{
+    char const * name_;
+    uint64_t start_;
+    uint64_t duration_;
+};
+
+// ####################################################################################################
+// the most recent events recorded on one thread; only that thread records, and anyone may take a snapshot meanwhile
+class TraceBuffer
+{
+protected:
+    std::vector<TraceEvent> events_;
+    std::atomic<uint64_t> num_events_;
+
+    uint32_t thread_id_;
+
+    mutable std::mutex name_mutex_;
+    std::string thread_name_;
+
+public:
+    TraceBuffer( size_t capacity, uint32_t thread_id )
+    :
+        events_( capacity ),
+        num_events_( 0 ),
+        thread_id_( thread_id )
+    {
+        //
+    }
+
+    void record( TraceEvent const & event )
+    {
+        uint64_t const num_events = num_events_.load( std::memory_order_relaxed );
+        events_[num_events % events_.size()] = event;
+        num_events_.store( num_events + 1, std::memory_order_release );
+    }
+
+    // the events still held, oldest first; any the owning thread may have overwritten while we copied are left out
+    std::vector<TraceEvent> snapshot() const
+    {
+        uint64_t const capacity = events_.size();
+        uint64_t const end = num_events_.load( std::memory_order_acquire );
+        uint64_t begin = end > capacity ? end - capacity : 0;
+
+        std::vector<TraceEvent> events;
+        events.reserve( static_cast<size_t>( end - begin ) );
+        for( uint64_t event_idx = begin; event_idx < end; ++event_idx )
+        {
+            events.push_back( events_[event_idx % capacity] );
+        }
+
+        // everything recorded since we started copying may have landed on top of what we copied first
+        uint64_t const new_end = num_events_.load( std::memory_order_acquire );
+        uint64_t const overwritten = new_end > capacity ? new_end - capacity : 0;
+        if( overwritten > begin ) events.erase( events.begin(), events.begin() + static_cast<size_t>( std::min( overwritten - begin, end - begin ) ) );
+
+        return events;
+    }
+
+    uint32_t threadId() const
+    {
+        return thread_id_;
+    }
+
+    void setThreadName( std::string const & thread_name )
+    {
+        std::lock_guard<std::mutex> lock( name_mutex_ );
+        thread_name_ = thread_name;
+    }
+
+    std::string threadName() const
+    {
+        std::lock_guard<std::mutex> lock( name_mutex_ );
+        return thread_name_;
+    }
+};
+
+// ####################################################################################################
+// the process-wide trace: off until enable()d, after which each thread that records an event gets its own TraceBuffer of the given
+// capacity. buffers outlive their threads, so a trace written at exit still holds the pipeline's finished workers
+//
+// while off, a TraceScope costs one relaxed load; while on, two clock reads and a store into the thread's own buffer
+class Tracer
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+    typedef std::mutex _Mutex;
+    typedef std::lock_guard<_Mutex> _Lock;
+
+    static size_t const DEFAULT_EVENTS_PER_THREAD = 16 * 1024;
+
+protected:
+    std::atomic<bool> enabled_;
+    size_t events_per_thread_;
+
+    mutable _Mutex mutex_;
+    std::vector<std::shared_ptr<TraceBuffer> > buffers_;
+
+    Tracer()
+    :
+        enabled_( false ),
+        events_per_thread_( DEFAULT_EVENTS_PER_THREAD )
+    {
+        //
+    }
+
+public:
+    static Tracer & instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // events_per_thread only applies to threads that haven't recorded anything yet
+    void enable( size_t events_per_thread = DEFAULT_EVENTS_PER_THREAD )
+    {
+        {
+            _Lock lock( mutex_ );
+            events_per_thread_ = std::max<size_t>( events_per_thread, 1 );
+        }
+        enabled_.store( true, std::memory_order_relaxed );
+    }
+
+    void disable()
+    {
+        enabled_.store( false, std::memory_order_relaxed );
+    }
+
+    bool enabled() const
+    {
+        return enabled_.load( std::memory_order_relaxed );
+    }
+
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now().time_since_epoch() ).count() );
+    }
+
+    void record( TraceEvent const & event )
+    {
+        threadBuffer().record( event );
+    }
+
+    // shown in place of the thread's number in the trace viewer; only kept while tracing is on
+    void setThreadName( std::string const & thread_name )
+    {
+        if( enabled() ) threadBuffer().setThreadName( thread_name );
+    }
+
+    // every thread's events as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev): a complete ("X") event per TraceEvent, with
+    // times in microseconds, plus a thread_name metadata event for each named thread
+    void writeChromeTrace( std::ostream & out ) const
+    {
+        std::vector<std::shared_ptr<TraceBuffer> > buffers;
+        {
+            _Lock lock( mutex_ );
+            buffers = buffers_;
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        bool first = true;
+        auto const separator = [&]() -> char const * { char const * result = first ? "\n" : ",\n"; first = false; return result; };
+
+        for( auto buffer_it = buffers.begin(); buffer_it != buffers.end(); ++buffer_it )
+        {
+            TraceBuffer const & buffer = **buffer_it;
+
+            std::string const thread_name = buffer.threadName();
+            if( !thread_name.empty() )
+            {
+                out << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.threadId() << ",\"args\":{\"name\":\"" << escape( thread_name ) << "\"}}";
+            }
+
+            std::vector<TraceEvent> const events = buffer.snapshot();
+            for( auto event_it = events.begin(); event_it != events.end(); ++event_it )
+            {
+                out << separator() << "{\"name\":\"" << escape( event_it->name_ ) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.threadId()
+                    << ",\"ts\":" << event_it->start_ / 1000 << "." << digits3( event_it->start_ % 1000 )
+                    << ",\"dur\":" << event_it->duration_ / 1000 << "." << digits3( event_it->duration_ % 1000 ) << "}";
+            }
+        }
+
+        out << "\n]}\n";
+    }
+
+    // throws std::runtime_error if the file can't be written
+    void writeChromeTrace( std::string const & path ) const
+    {
+        std::ofstream out( path.c_str() );
+        if( !out ) throw std::runtime_error( "failed to open " + path + " for writing" );
+
+        writeChromeTrace( out );
+
+        out.flush();
+        if( !out ) throw std::runtime_error( "failed to write " + path );
+    }
+
+protected:
+    TraceBuffer & threadBuffer()
+    {
+        static ATOMICS_THREAD_LOCAL TraceBuffer * buffer_ptr = NULL;
+        if( buffer_ptr ) return *buffer_ptr;
+
+        _Lock lock( mutex_ );
+        buffers_.push_back( std::make_shared<TraceBuffer>( events_per_thread_, static_cast<uint32_t>( buffers_.size() + 1 ) ) );
+        buffer_ptr = buffers_.back().get();
+        return *buffer_ptr;
+    }
+
+    static std::string escape( std::string const & text )
+    {
+        std::string escaped_text;
+        for( auto char_it = text.begin(); char_it != text.end(); ++char_it )
+        {
+            if( *char_it == '"' || *char_it == '\\' ) escaped_text += '\\';
+            escaped_text += *char_it;
+        }
+        return escaped_text;
+    }
+
+    static std::string digits3( uint64_t value )
+    {
+        std::string const digits = std::to_string( value );
+        return std::string( 3 - digits.size(), '0' ) + digits;
+    }
+};
+
+// ####################################################################################################
+// records the time between its construction and destruction (see ATOMICS_TRACE_SCOPE); a NULL name records nothing, so a scope can be
+// made conditional, eg: only when a wait is actually going to block
+class TraceScope
+{
+protected:
+    char const * name_;
+    uint64_t start_;
+
+public:
+    TraceScope( char const * name )
+    :
+        name_( name && Tracer::instance().enabled() ? name : NULL ),
+        start_( name_ ? Tracer::now() : 0 )
+    {
+        //
+    }
+
+    ~TraceScope()
+    {
+        if( !name_ ) return;
+
+        TraceEvent const event = { name_, start_, Tracer::now() - start_ };
+        Tracer::instance().record( event );
+    }
+
+    TraceScope( TraceScope const & ) = delete;
+    TraceScope & operator=( TraceScope const & ) = delete;
+};
+
+} // atomics
+
+#endif // _ATOMICS_TRACE_H_
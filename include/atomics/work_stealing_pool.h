@@ -0,0 +1,244 @@
+#ifndef _ATOMICS_WORK_STEALING_POOL_H_
+#define _ATOMICS_WORK_STEALING_POOL_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+
+#include <Poco/Util/AbstractConfiguration.h>
+
+#include <atomics/stage.h>
+
+namespace atomics
+{
+
+// a fixed set of threads shared by any number of pooled stages
+//
+// each stage has a priority and a minimum share. the first sum( min_share ) workers are given a home stage (highest priority first), which
+// they always check first; whenever a worker's home has nothing to do it steals an item from whichever stage has work, highest priority
+// first. workers with no home only steal. so a stream is guaranteed min_share threads whenever it has a backlog, and every thread is
+// available to every stream when its own is idle or disabled
+//
+// idle workers sleep until one of the pooled stages' inputs is pushed to or closed
+class WorkStealingPool
+{
+public:
+    typedef std::shared_ptr<WorkStealingPool> _Ptr;
+    typedef std::mutex _Mutex;
+    typedef std::unique_lock<_Mutex> _Lock;
+
+    struct Job
+    {
+        StageBase::_Ptr stage_ptr_;
+        int priority_;
+        size_t min_share_;
+
+        // items processed by this stage's home workers vs. by workers stealing from elsewhere
+        std::atomic<uint64_t> num_home_steps_;
+        std::atomic<uint64_t> num_stolen_steps_;
+
+        Job( StageBase::_Ptr stage_ptr, int priority, size_t min_share )
+        :
+            stage_ptr_( stage_ptr ),
+            priority_( priority ),
+            min_share_( min_share ),
+            num_home_steps_( 0 ),
+            num_stolen_steps_( 0 )
+        {
+            //
+        }
+    };
+
+    typedef std::shared_ptr<Job> _JobPtr;
+
+protected:
+    std::string name_;
+    size_t num_workers_;
+    std::vector<_JobPtr> jobs_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<bool> running_;
+    // bumped every time new work may be available, so workers can tell whether they missed anything while scanning
+    uint64_t work_epoch_;
+    _Mutex mutex_;
+    std::condition_variable work_available_condition_;
+
+public:
+    WorkStealingPool( std::string const & name, size_t num_workers = std::thread::hardware_concurrency() )
+    :
+        name_( name ),
+        num_workers_( std::max<size_t>( num_workers, 1 ) ),
+        running_( false ),
+        work_epoch_( 0 )
+    {
+        //
+    }
+
+    ~WorkStealingPool()
+    {
+        stop();
+    }
+
+    // hand the stage over to this pool; must be called before the stage or the pool is started
+    void addStage( StageBase::_Ptr stage_ptr, int priority = 0, size_t min_share = 0 )
+    {
+        stage_ptr->setPooled( true );
+
+        FifoBase * input_fifo = stage_ptr->inputFifo();
+        input_fifo->setPushListener( [this](){ notifyWork( false ); } );
+        input_fifo->setCloseListener( [this](){ notifyWork( true ); } );
+
+        jobs_.push_back( std::make_shared<Job>( stage_ptr, priority, min_share ) );
+    }
+
+    // override the number of workers and each stage's priority and minimum share from keys of the form
+    //   <prefix>.<pool name>.workers
+    //   <prefix>.<stage name>.priority (any int; higher goes first)
+    //   <prefix>.<stage name>.min_share (negative values count as 0)
+    void configure( Poco::Util::AbstractConfiguration const & config, std::string const & prefix )
+    {
+        num_workers_ = std::max( config.getInt( prefix + "." + name_ + ".workers", static_cast<int>( num_workers_ ) ), 1 );
+
+        for( auto job_it = jobs_.begin(); job_it != jobs_.end(); ++job_it )
+        {
+            auto & job = **job_it;
+            job.priority_ = config.getInt( prefix + "." + job.stage_ptr_->name() + ".priority", job.priority_ );
+            job.min_share_ = std::max( config.getInt( prefix + "." + job.stage_ptr_->name() + ".min_share", static_cast<int>( job.min_share_ ) ), 0 );
+        }
+    }
+
+    void start()
+    {
+        if( running_ ) return;
+
+        // steal in priority order
+        std::stable_sort( jobs_.begin(), jobs_.end(), []( _JobPtr const & lhs, _JobPtr const & rhs ){ return lhs->priority_ > rhs->priority_; } );
+
+        // hand out home stages, highest priority first, until we run out of minimum shares or workers
+        std::vector<_JobPtr> homes;
+        for( auto job_it = jobs_.begin(); job_it != jobs_.end(); ++job_it )
+        {
+            for( size_t i = 0; i < (*job_it)->min_share_ && homes.size() < num_workers_; ++i ) homes.push_back( *job_it );
+        }
+        homes.resize( num_workers_ );
+
+        running_ = true;
+
+        for( size_t i = 0; i < num_workers_; ++i )
+        {
+            workers_.emplace_back( &WorkStealingPool::run, this, homes[i] );
+        }
+    }
+
+    // stop all workers; the pooled stages should already have been joined, otherwise their remaining input is left unprocessed
+    void stop()
+    {
+        {
+            _Lock lock( mutex_ );
+            running_ = false;
+        }
+        work_available_condition_.notify_all();
+
+        for( auto worker_it = workers_.begin(); worker_it != workers_.end(); ++worker_it )
+        {
+            if( worker_it->joinable() ) worker_it->join();
+        }
+        workers_.clear();
+    }
+
+    std::string const & name() const
+    {
+        return name_;
+    }
+
+    size_t numWorkers() const
+    {
+        return num_workers_;
+    }
+
+    std::vector<_JobPtr> const & jobs() const
+    {
+        return jobs_;
+    }
+
+    void printMetrics( std::ostream & out ) const
+    {
+        out << std::setw( 24 ) << std::left << name_ << std::right << " workers: " << std::setw( 2 ) << num_workers_ << std::endl;
+
+        for( auto job_it = jobs_.begin(); job_it != jobs_.end(); ++job_it )
+        {
+            auto const & job = **job_it;
+            out << "  " << std::setw( 22 ) << std::left << job.stage_ptr_->name() << std::right
+                << " priority: " << std::setw( 2 ) << job.priority_
+                << " min share: " << std::setw( 2 ) << job.min_share_
+                << " home: " << std::setw( 8 ) << job.num_home_steps_
+                << " stolen: " << std::setw( 8 ) << job.num_stolen_steps_ << std::endl;
+        }
+    }
+
+protected:
+    void notifyWork( bool all )
+    {
+        {
+            _Lock lock( mutex_ );
+            ++work_epoch_;
+        }
+
+        if( all ) work_available_condition_.notify_all();
+        else work_available_condition_.notify_one();
+    }
+
+    void run( _JobPtr home_ptr )
+    {
+        Tracer::instance().setThreadName( name_ + ( home_ptr ? "/" + home_ptr->stage_ptr_->name() : "" ) );
+
+        while( running_ )
+        {
+            uint64_t epoch;
+            {
+                _Lock lock( mutex_ );
+                epoch = work_epoch_;
+            }
+
+            if( home_ptr && home_ptr->stage_ptr_->tryStep() )
+            {
+                ++home_ptr->num_home_steps_;
+                continue;
+            }
+
+            if( steal( home_ptr ) ) continue;
+
+            // nothing to do anywhere; sleep until something is pushed, unless something was pushed while we were looking
+            _Lock lock( mutex_ );
+            work_available_condition_.wait( lock, [&](){ return !running_ || work_epoch_ != epoch; } );
+        }
+    }
+
+    bool steal( _JobPtr const & home_ptr )
+    {
+        for( auto job_it = jobs_.begin(); job_it != jobs_.end(); ++job_it )
+        {
+            auto & job = **job_it;
+            if( &job == home_ptr.get() ) continue;
+
+            if( job.stage_ptr_->tryStep() )
+            {
+                ++job.num_stolen_steps_;
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+} // atomics
+
+#endif // _ATOMICS_WORK_STEALING_POOL_H_
@@ -4,8 +4,10 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <string>
 
 #include <atomics/handle.h>
+#include <atomics/lock_stats.h>
 
 namespace atomics
 {
@@ -26,16 +28,21 @@ public:
     _Condition condition_;
     __Mutex condition_mutex_;
 
+    // NULL unless profileContention() was called
+    LockStats * lock_stats_;
+
     Wrapper()
     :
-        data_()
+        data_(),
+        lock_stats_( NULL )
     {
         //
     }
 
     Wrapper( __Data const & data )
     :
-        data_( data )
+        data_( data ),
+        lock_stats_( NULL )
     {
         //
     }
@@ -43,11 +50,24 @@ public:
     template<class... __Args>
     Wrapper( __Args&&... args )
     :
-        data_( std::forward<__Args>( args )... )
+        data_( std::forward<__Args>( args )... ),
+        lock_stats_( NULL )
     {
         //
     }
 
+    // count every handle's lock acquisitions, hold times, waits, and notifications in LockProfiler::instance().stats( name ); call before
+    // any threads use the wrapper
+    void profileContention( std::string const & name )
+    {
+        lock_stats_ = &LockProfiler::instance().stats( name );
+    }
+
+    LockStats const * lockStats() const
+    {
+        return lock_stats_;
+    }
+
     _Handle getHandle( HandleBase::NotifyType policy = HandleBase::NotifyType::DELAY_NOTIFY_NONE )
     {
         return _Handle( this, policy );
@@ -29,8 +29,10 @@ __pragma(warning(pop))
 #include <kinect_common/memory.h>
 #include <kinect_common/exceptions.h>
 #include <kinect_common/kinect_audio_stream.h>
+#include <kinect_common/kinect_frame_source.h>
 
 #include <messages/kinect_messages.h>
+#include <atomics/trace.h>
 
 // ####################################################################################################
 /*
@@ -264,7 +266,7 @@ public:
 */
 
 // ####################################################################################################
-class KinectDevice
+class KinectDevice : public KinectFrameSource
 {
 public:
 
@@ -303,21 +305,45 @@ public:
     {
         typedef ReleasableWrapper<IColorFrameReader> _ReleasableWrapper;
 
+        // signalled by the SDK whenever a new frame is available from this reader
+        WAITABLE_HANDLE frame_event_;
+
         // ====================================================================================================
         template<class... __Args>
         ColorFrameReader( __Args&&... args )
         :
-            _ReleasableWrapper( std::forward<__Args>( args )... )
+            _ReleasableWrapper( std::forward<__Args>( args )... ),
+            frame_event_( 0 )
         {
             //
         }
 
+        // ====================================================================================================
+        ~ColorFrameReader()
+        {
+            if( frame_event_ && _ReleasableWrapper::get() ) _ReleasableWrapper::get()->UnsubscribeFrameArrived( frame_event_ );
+        }
+
         // ====================================================================================================
         void initialize( KinectSensor & kinect_sensor )
         {
             ReleasableWrapper<IColorFrameSource> color_frame_source;
             if( FAILED( kinect_sensor->get_ColorFrameSource( color_frame_source.getAddr() ) ) ) throw KinectException( "Failed to get color frame source" );
             if( FAILED( color_frame_source->OpenReader( _ReleasableWrapper::getAddr() ) ) ) throw KinectException( "Failed to open color frame reader" );
+            if( FAILED( _ReleasableWrapper::get()->SubscribeFrameArrived( &frame_event_ ) ) ) throw KinectException( "Failed to subscribe to color frame events" );
+        }
+
+        // ====================================================================================================
+        // sleep until the SDK signals a new frame; returns false on timeout
+        // the event stays signalled until its data is fetched, so fetch (and release) it after every wait
+        bool waitForFrame( uint32_t timeout_ms )
+        {
+            if( !frame_event_ ) return false;
+            if( WaitForSingleObject( reinterpret_cast<HANDLE>( frame_event_ ), timeout_ms ) != WAIT_OBJECT_0 ) return false;
+
+            ReleasableWrapper<IColorFrameArrivedEventArgs> event_args;
+            _ReleasableWrapper::get()->GetFrameArrivedEventData( frame_event_, event_args.getAddr() );
+            return true;
         }
     };
 
@@ -326,21 +352,45 @@ public:
     {
         typedef ReleasableWrapper<IDepthFrameReader> _ReleasableWrapper;
 
+        // signalled by the SDK whenever a new frame is available from this reader
+        WAITABLE_HANDLE frame_event_;
+
         // ====================================================================================================
         template<class... __Args>
         DepthFrameReader( __Args&&... args )
         :
-            _ReleasableWrapper( std::forward<__Args>( args )... )
+            _ReleasableWrapper( std::forward<__Args>( args )... ),
+            frame_event_( 0 )
         {
             //
         }
 
+        // ====================================================================================================
+        ~DepthFrameReader()
+        {
+            if( frame_event_ && _ReleasableWrapper::get() ) _ReleasableWrapper::get()->UnsubscribeFrameArrived( frame_event_ );
+        }
+
         // ====================================================================================================
         void initialize( KinectSensor & kinect_sensor )
         {
             ReleasableWrapper<IDepthFrameSource> depth_frame_source;
             if( FAILED( kinect_sensor->get_DepthFrameSource( depth_frame_source.getAddr() ) ) ) throw KinectException( "Failed to get depth frame source" );
             if( FAILED( depth_frame_source->OpenReader( _ReleasableWrapper::getAddr() ) ) ) throw KinectException( "Failed to open depth frame reader" );
+            if( FAILED( _ReleasableWrapper::get()->SubscribeFrameArrived( &frame_event_ ) ) ) throw KinectException( "Failed to subscribe to depth frame events" );
+        }
+
+        // ====================================================================================================
+        // sleep until the SDK signals a new frame; returns false on timeout
+        // the event stays signalled until its data is fetched, so fetch (and release) it after every wait
+        bool waitForFrame( uint32_t timeout_ms )
+        {
+            if( !frame_event_ ) return false;
+            if( WaitForSingleObject( reinterpret_cast<HANDLE>( frame_event_ ), timeout_ms ) != WAIT_OBJECT_0 ) return false;
+
+            ReleasableWrapper<IDepthFrameArrivedEventArgs> event_args;
+            _ReleasableWrapper::get()->GetFrameArrivedEventData( frame_event_, event_args.getAddr() );
+            return true;
         }
     };
 
@@ -349,21 +399,45 @@ public:
     {
         typedef ReleasableWrapper<IInfraredFrameReader> _ReleasableWrapper;
 
+        // signalled by the SDK whenever a new frame is available from this reader
+        WAITABLE_HANDLE frame_event_;
+
         // ====================================================================================================
         template<class... __Args>
         InfraredFrameReader( __Args&&... args )
         :
-            _ReleasableWrapper( std::forward<__Args>( args )... )
+            _ReleasableWrapper( std::forward<__Args>( args )... ),
+            frame_event_( 0 )
         {
             //
         }
 
+        // ====================================================================================================
+        ~InfraredFrameReader()
+        {
+            if( frame_event_ && _ReleasableWrapper::get() ) _ReleasableWrapper::get()->UnsubscribeFrameArrived( frame_event_ );
+        }
+
         // ====================================================================================================
         void initialize( KinectSensor & kinect_sensor )
         {
             ReleasableWrapper<IInfraredFrameSource> infrared_frame_source;
             if( FAILED( kinect_sensor->get_InfraredFrameSource( infrared_frame_source.getAddr() ) ) ) throw KinectException( "Failed to get infrared frame source" );
             if( FAILED( infrared_frame_source->OpenReader( _ReleasableWrapper::getAddr() ) ) ) throw KinectException( "Failed to open infrared frame reader" );
+            if( FAILED( _ReleasableWrapper::get()->SubscribeFrameArrived( &frame_event_ ) ) ) throw KinectException( "Failed to subscribe to infrared frame events" );
+        }
+
+        // ====================================================================================================
+        // sleep until the SDK signals a new frame; returns false on timeout
+        // the event stays signalled until its data is fetched, so fetch (and release) it after every wait
+        bool waitForFrame( uint32_t timeout_ms )
+        {
+            if( !frame_event_ ) return false;
+            if( WaitForSingleObject( reinterpret_cast<HANDLE>( frame_event_ ), timeout_ms ) != WAIT_OBJECT_0 ) return false;
+
+            ReleasableWrapper<IInfraredFrameArrivedEventArgs> event_args;
+            _ReleasableWrapper::get()->GetFrameArrivedEventData( frame_event_, event_args.getAddr() );
+            return true;
         }
     };
 
@@ -372,12 +446,23 @@ public:
     {
         typedef ReleasableWrapper<IAudioBeamFrameReader> _ReleasableWrapper;
 
+        // signalled by the SDK whenever a new frame is available from this reader
+        WAITABLE_HANDLE frame_event_;
+
         // ====================================================================================================
         AudioBeamFrameReader()
+        :
+            frame_event_( 0 )
         {
             //
         }
 
+        // ====================================================================================================
+        ~AudioBeamFrameReader()
+        {
+            if( frame_event_ && _ReleasableWrapper::get() ) _ReleasableWrapper::get()->UnsubscribeFrameArrived( frame_event_ );
+        }
+
         // ====================================================================================================
         void initialize( KinectSensor & kinect_sensor )
         {
@@ -385,6 +470,20 @@ public:
 
             if( FAILED( kinect_sensor->get_AudioSource( audio_source.getAddr() ) ) ) throw KinectException( "Failed to get audio source" );
             if( FAILED( audio_source->OpenReader( _ReleasableWrapper::getAddr() ) ) ) throw KinectException( "Failed to open audio beam frame reader" );
+            if( FAILED( _ReleasableWrapper::get()->SubscribeFrameArrived( &frame_event_ ) ) ) throw KinectException( "Failed to subscribe to audio beam frame events" );
+        }
+
+        // ====================================================================================================
+        // sleep until the SDK signals a new frame; returns false on timeout
+        // the event stays signalled until its data is fetched, so fetch (and release) it after every wait
+        bool waitForFrame( uint32_t timeout_ms )
+        {
+            if( !frame_event_ ) return false;
+            if( WaitForSingleObject( reinterpret_cast<HANDLE>( frame_event_ ), timeout_ms ) != WAIT_OBJECT_0 ) return false;
+
+            ReleasableWrapper<IAudioBeamFrameArrivedEventArgs> event_args;
+            _ReleasableWrapper::get()->GetFrameArrivedEventData( frame_event_, event_args.getAddr() );
+            return true;
         }
     };
 
@@ -393,12 +492,23 @@ public:
     {
         typedef ReleasableWrapper<IBodyFrameReader> _ReleasableWrapper;
 
+        // signalled by the SDK whenever a new frame is available from this reader
+        WAITABLE_HANDLE frame_event_;
+
         // ====================================================================================================
         BodyFrameReader()
+        :
+            frame_event_( 0 )
         {
             //
         }
 
+        // ====================================================================================================
+        ~BodyFrameReader()
+        {
+            if( frame_event_ && _ReleasableWrapper::get() ) _ReleasableWrapper::get()->UnsubscribeFrameArrived( frame_event_ );
+        }
+
         // ====================================================================================================
         void initialize( KinectSensor & kinect_sensor )
         {
@@ -406,7 +516,21 @@ public:
 
             if( FAILED( kinect_sensor->get_BodyFrameSource( body_frame_source.getAddr() ) ) ) throw KinectException( "Failed to get body frame source from kinect sensor" );
             if( FAILED( body_frame_source->OpenReader( _ReleasableWrapper::getAddr() ) ) ) throw KinectException( "Failed to get body frame reader from body frame source" );
+            if( FAILED( _ReleasableWrapper::get()->SubscribeFrameArrived( &frame_event_ ) ) ) throw KinectException( "Failed to subscribe to body frame events" );
+
+        }
+
+        // ====================================================================================================
+        // sleep until the SDK signals a new frame; returns false on timeout
+        // the event stays signalled until its data is fetched, so fetch (and release) it after every wait
+        bool waitForFrame( uint32_t timeout_ms )
+        {
+            if( !frame_event_ ) return false;
+            if( WaitForSingleObject( reinterpret_cast<HANDLE>( frame_event_ ), timeout_ms ) != WAIT_OBJECT_0 ) return false;
 
+            ReleasableWrapper<IBodyFrameArrivedEventArgs> event_args;
+            _ReleasableWrapper::get()->GetFrameArrivedEventData( frame_event_, event_args.getAddr() );
+            return true;
         }
     };
 
@@ -433,11 +557,13 @@ public:
         // Speech grammar
         ReleasableWrapper<ISpRecoGrammar> speech_grammar_;
 
-//        // Event triggered when we detect speech recognition
-//        HANDLE speech_event_;
+        // Event triggered when we detect speech recognition
+        HANDLE speech_event_;
 
         // ====================================================================================================
         SpeechRecognizer()
+        :
+            speech_event_( NULL )
         {
             //
         }
@@ -538,7 +664,17 @@ public:
             // Ensure that engine is recognizing speech and not in paused state
             if( FAILED( speech_context_->Resume( 0 ) ) ) throw KinectException( "Failed to start speech recognition engine" );
 
-//          m_hSpeechEvent = m_pSpeechContext->GetNotifyEventHandle();
+            // have the recognizer signal a win32 event whenever it has events for us so readers don't have to poll
+            if( FAILED( speech_context_->SetNotifyWin32Event() ) ) throw KinectException( "Failed to set speech recognition notification event" );
+            speech_event_ = speech_context_->GetNotifyEventHandle();
+        }
+
+        // ====================================================================================================
+        // sleep until the recognizer signals an event; returns false on timeout
+        bool waitForEvent( uint32_t timeout_ms )
+        {
+            if( !speech_event_ ) return false;
+            return WaitForSingleObject( speech_event_, timeout_ms ) == WAIT_OBJECT_0;
         }
     };
 
@@ -669,11 +805,50 @@ public:
         initialized_ = true;
     }
 
+    // ====================================================================================================
+    // frame readiness; each of these sleeps until the corresponding stream has new data or the timeout expires
+    bool waitForColorImage( uint32_t timeout_ms )
+    {
+        return color_frame_reader_.waitForFrame( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForDepthImage( uint32_t timeout_ms )
+    {
+        return depth_frame_reader_.waitForFrame( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForInfraredImage( uint32_t timeout_ms )
+    {
+        return infrared_frame_reader_.waitForFrame( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForAudio( uint32_t timeout_ms )
+    {
+        return audio_beam_frame_reader_.waitForFrame( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForBodies( uint32_t timeout_ms )
+    {
+        return body_frame_reader_.waitForFrame( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForSpeech( uint32_t timeout_ms )
+    {
+        return speech_recognizer_.waitForEvent( timeout_ms );
+    }
+
 /*
     // ====================================================================================================
     template<class __Allocator>
     void pullColorImage( KinectColorImageMessage<__Allocator> & image_message )
     {
+        ATOMICS_TRACE_SCOPE( "KinectDevice::pullColorImage" );
+
         ReleasableWrapper<IColorFrame> color_frame;
         ReleasableWrapper<IFrameDescription> color_frame_description;
 
@@ -859,10 +1034,19 @@ public:
 //        return image_message_ptr;
     }
 
+    // ====================================================================================================
+    // KinectFrameSource
+    void pullColorImage( _ColorImageMessage & image_message )
+    {
+        pullColorImageRGBA( image_message );
+    }
+
     // ====================================================================================================
     template<class __ImageMessage>
     void pullDepthImage( KinectDepthImageMessage<__ImageMessage> & image_message )
     {
+        ATOMICS_TRACE_SCOPE( "KinectDevice::pullDepthImage" );
+
         ReleasableWrapper<IDepthFrame> depth_frame;
         ReleasableWrapper<IFrameDescription> depth_frame_description;
 
@@ -905,10 +1089,19 @@ public:
         pullDepthImage( *image_message_ptr );
     }
 
+    // ====================================================================================================
+    // KinectFrameSource
+    void pullDepthImage( _DepthImageMessage & image_message )
+    {
+        pullDepthImage<PNGImageMessage<> >( image_message );
+    }
+
     // ====================================================================================================
     template<class __ImageMessage>
     void pullInfraredImage( KinectInfraredImageMessage<__ImageMessage> & image_message )
     {
+        ATOMICS_TRACE_SCOPE( "KinectDevice::pullInfraredImage" );
+
         ReleasableWrapper<IInfraredFrame> infrared_frame;
         ReleasableWrapper<IFrameDescription> infrared_frame_description;
 
@@ -949,10 +1142,19 @@ public:
         pullInfraredImage( *image_message_ptr );
     }
 
+    // ====================================================================================================
+    // KinectFrameSource
+    void pullInfraredImage( _InfraredImageMessage & image_message )
+    {
+        pullInfraredImage<PNGImageMessage<> >( image_message );
+    }
+
     // ====================================================================================================
     template<class __AudioMessage>
     void pullAudio( KinectAudioMessage<__AudioMessage> & audio_message )
     {
+        ATOMICS_TRACE_SCOPE( "KinectDevice::pullAudio" );
+
         ReleasableWrapper<IAudioBeamFrameList> audio_beam_frame_list;
         ReleasableWrapper<IAudioBeamFrame> audio_beam_frame;
 
@@ -1015,9 +1217,18 @@ public:
         pullAudio( *audio_message_ptr );
     }
 
+    // ====================================================================================================
+    // KinectFrameSource
+    void pullAudio( _AudioMessage & audio_message )
+    {
+        pullAudio<WAVAudioMessage<> >( audio_message );
+    }
+
     // ====================================================================================================
     void pullBodies( KinectBodiesMessage & bodies_message )
     {
+        ATOMICS_TRACE_SCOPE( "KinectDevice::pullBodies" );
+
         std::array<ReleasableWrapper<IBody>, BODY_COUNT> bodies;
         ReleasableWrapper<IBodyFrame> body_frame;
 
@@ -1109,6 +1320,8 @@ public:
     // ====================================================================================================
     void pullSpeech( KinectSpeechMessage & speech_message )
     {
+        ATOMICS_TRACE_SCOPE( "KinectDevice::pullSpeech" );
+
         auto & header = speech_message.header_;
         auto & payload = speech_message.payload_;
         payload.clear();
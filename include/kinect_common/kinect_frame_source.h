@@ -0,0 +1,116 @@
+#ifndef _KINECTCOMMON_KINECTFRAMESOURCE_H_
+#define _KINECTCOMMON_KINECTFRAMESOURCE_H_
+
+#include <cstdint>
+#include <memory>
+
+#include <kinect_common/exceptions.h>
+
+#include <messages/kinect_messages.h>
+#include <messages/png_image_message.h>
+#include <messages/wav_audio_message.h>
+
+// ####################################################################################################
+// anything that produces Kinect v2 streams: the sensor itself (KinectDevice) or a stand-in for it (eg: SyntheticFrameSource)
+//
+// each stream is read by at most one thread at a time, which calls waitFor*() until it returns true and then pull*() to fetch the frame;
+// different streams may be read from different threads concurrently. pull*() throws KinectException if the frame can't be had
+class KinectFrameSource
+{
+public:
+    typedef KinectColorImageMessage<PNGImageMessage<> > _ColorImageMessage;
+    typedef KinectDepthImageMessage<PNGImageMessage<> > _DepthImageMessage;
+    typedef KinectInfraredImageMessage<PNGImageMessage<> > _InfraredImageMessage;
+    typedef KinectAudioMessage<WAVAudioMessage<> > _AudioMessage;
+    typedef KinectBodiesMessage _BodiesMessage;
+    typedef KinectSpeechMessage _SpeechMessage;
+
+    // ====================================================================================================
+    virtual ~KinectFrameSource()
+    {
+        //
+    }
+
+    // ====================================================================================================
+    // bring up the given streams; throws KinectException if the source isn't ready yet
+    virtual void initialize( bool color = true, bool depth = true, bool infrared = true, bool audio = true, bool body = true, bool speech = true ) = 0;
+
+    // ====================================================================================================
+    // frame readiness; each of these sleeps until the corresponding stream has new data or the timeout expires
+    virtual bool waitForColorImage( uint32_t timeout_ms ) = 0;
+    virtual bool waitForDepthImage( uint32_t timeout_ms ) = 0;
+    virtual bool waitForInfraredImage( uint32_t timeout_ms ) = 0;
+    virtual bool waitForAudio( uint32_t timeout_ms ) = 0;
+    virtual bool waitForBodies( uint32_t timeout_ms ) = 0;
+    virtual bool waitForSpeech( uint32_t timeout_ms ) = 0;
+
+    // ====================================================================================================
+    // color frames are full-resolution RGBA
+    virtual void pullColorImage( _ColorImageMessage & image_message ) = 0;
+    virtual void pullDepthImage( _DepthImageMessage & image_message ) = 0;
+    virtual void pullInfraredImage( _InfraredImageMessage & image_message ) = 0;
+    // a single frame of audio, as delivered by the sensor
+    virtual void pullAudio( _AudioMessage & audio_message ) = 0;
+    virtual void pullBodies( _BodiesMessage & bodies_message ) = 0;
+    // leaves the message empty if nothing was recognized
+    virtual void pullSpeech( _SpeechMessage & speech_message ) = 0;
+
+    // ====================================================================================================
+    // the same, allocating the message first if necessary
+    template<class __Message>
+    void pullColorImage( std::shared_ptr<__Message> & image_message_ptr )
+    {
+        allocate( image_message_ptr );
+        pullColorImage( static_cast<_ColorImageMessage &>( *image_message_ptr ) );
+    }
+
+    // ====================================================================================================
+    template<class __Message>
+    void pullDepthImage( std::shared_ptr<__Message> & image_message_ptr )
+    {
+        allocate( image_message_ptr );
+        pullDepthImage( static_cast<_DepthImageMessage &>( *image_message_ptr ) );
+    }
+
+    // ====================================================================================================
+    template<class __Message>
+    void pullInfraredImage( std::shared_ptr<__Message> & image_message_ptr )
+    {
+        allocate( image_message_ptr );
+        pullInfraredImage( static_cast<_InfraredImageMessage &>( *image_message_ptr ) );
+    }
+
+    // ====================================================================================================
+    template<class __Message>
+    void pullAudio( std::shared_ptr<__Message> & audio_message_ptr )
+    {
+        allocate( audio_message_ptr );
+        pullAudio( static_cast<_AudioMessage &>( *audio_message_ptr ) );
+    }
+
+    // ====================================================================================================
+    template<class __Message>
+    void pullBodies( std::shared_ptr<__Message> & bodies_message_ptr )
+    {
+        allocate( bodies_message_ptr );
+        pullBodies( static_cast<_BodiesMessage &>( *bodies_message_ptr ) );
+    }
+
+    // ====================================================================================================
+    template<class __Message>
+    void pullSpeech( std::shared_ptr<__Message> & speech_message_ptr )
+    {
+        allocate( speech_message_ptr );
+        pullSpeech( static_cast<_SpeechMessage &>( *speech_message_ptr ) );
+    }
+
+protected:
+    // ====================================================================================================
+    template<class __Message>
+    static void allocate( std::shared_ptr<__Message> & message_ptr )
+    {
+        if( !message_ptr ) message_ptr = std::make_shared<__Message>();
+    }
+};
+
+#endif // _KINECTCOMMON_KINECTFRAMESOURCE_H_
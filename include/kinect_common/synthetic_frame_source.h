@@ -0,0 +1,580 @@
+#ifndef _KINECTCOMMON_SYNTHETICFRAMESOURCE_H_
+#define _KINECTCOMMON_SYNTHETICFRAMESOURCE_H_
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include <Poco/Util/AbstractConfiguration.h>
+
+#include <atomics/trace.h>
+
+#include <kinect_common/kinect_frame_source.h>
+
+// ####################################################################################################
+// stands in for a Kinect v2 so the pipeline can run (and be load-tested) without the sensor or Windows
+//
+// produces every stream at the sensor's native format and size: 1920x1080 RGBA color, 512x424 16-bit depth and infrared, 16 kHz float
+// audio in 256-sample frames, six bodies of 25 joints each, and the occasional recognized phrase from grammar.grxml. the content moves
+// and carries sensor-like noise, so compression costs roughly what it does on real frames
+//
+// every stream runs at its own fixed rate; a reader that falls behind skips the frames it missed instead of getting a burst of them, as
+// with the sensor. configuration keys, all optional:
+//   <prefix>.<stream>.fps        color, depth, infrared, and bodies default to 30, audio to 62.5 (256 samples at 16 kHz), speech to 0.2
+//   <prefix>.audio.channels      defaults to 1, like the sensor's single beam; 4 matches the raw microphone array
+//   <prefix>.bodies.tracked      how many of the six bodies are tracked; defaults to 2
+class SyntheticFrameSource : public KinectFrameSource
+{
+public:
+    typedef std::chrono::steady_clock _Clock;
+
+    static uint16_t const COLOR_WIDTH = 1920;
+    static uint16_t const COLOR_HEIGHT = 1080;
+    static uint16_t const DEPTH_WIDTH = 512;
+    static uint16_t const DEPTH_HEIGHT = 424;
+    static uint32_t const AUDIO_SAMPLE_RATE = 16000;
+    static uint32_t const AUDIO_FRAME_SAMPLES = 256;
+    static size_t const NUM_BODIES = 6;
+    static size_t const NUM_JOINTS = 25;
+
+    // ####################################################################################################
+    // paces a single stream
+    class StreamClock
+    {
+    protected:
+        double fps_;
+        bool enabled_;
+        _Clock::time_point next_frame_time_;
+        uint64_t num_frames_;
+
+    public:
+        StreamClock( double fps = 30 )
+        :
+            fps_( fps ),
+            enabled_( false ),
+            num_frames_( 0 )
+        {
+            //
+        }
+
+        void start( _Clock::time_point const & now )
+        {
+            enabled_ = fps_ > 0;
+            next_frame_time_ = now;
+        }
+
+        // sleep until the next frame is due, or until the timeout expires
+        bool wait( uint32_t timeout_ms )
+        {
+            auto const deadline = _Clock::now() + std::chrono::milliseconds( timeout_ms );
+
+            if( !enabled_ || next_frame_time_ > deadline )
+            {
+                std::this_thread::sleep_until( deadline );
+                return false;
+            }
+
+            std::this_thread::sleep_until( next_frame_time_ );
+            return true;
+        }
+
+        // mark the current frame as taken; returns how many frames this stream has produced before it
+        uint64_t advance()
+        {
+            auto const now = _Clock::now();
+            auto const period = std::chrono::duration_cast<_Clock::duration>( std::chrono::duration<double>( 1.0 / fps_ ) );
+
+            next_frame_time_ += period;
+            // we fell behind; like the sensor, skip what we missed rather than catching up in a burst
+            if( next_frame_time_ < now ) next_frame_time_ = now + period;
+
+            return num_frames_++;
+        }
+
+        double fps() const
+        {
+            return fps_;
+        }
+
+        void setFps( double fps )
+        {
+            fps_ = fps;
+        }
+    };
+
+protected:
+    // ####################################################################################################
+    // cheap noise; the content only has to look like a sensor's, not pass for random
+    struct XorShift
+    {
+        uint32_t state_;
+
+        XorShift( uint32_t seed = 2463534242u )
+        :
+            state_( seed )
+        {
+            //
+        }
+
+        uint32_t operator()()
+        {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 17;
+            state_ ^= state_ << 5;
+            return state_;
+        }
+
+        // roughly uniform in [-1, 1]
+        float uniform()
+        {
+            return static_cast<int32_t>( ( *this )() ) / 2147483648.0f;
+        }
+    };
+
+    StreamClock color_clock_;
+    StreamClock depth_clock_;
+    StreamClock infrared_clock_;
+    StreamClock audio_clock_;
+    StreamClock bodies_clock_;
+    StreamClock speech_clock_;
+
+    uint16_t num_audio_channels_;
+    size_t num_tracked_bodies_;
+
+    bool initialized_;
+    _Clock::time_point start_time_;
+
+    // static scenery, rendered once; each frame adds a moving subject and fresh noise on top
+    std::vector<uint8_t> color_background_;
+    std::vector<uint16_t> depth_background_;
+
+    // depth rendering is shared with the infrared stream, which may be read from a different thread; each keeps its own copy
+    XorShift color_noise_;
+    XorShift depth_noise_;
+    XorShift infrared_noise_;
+    XorShift audio_noise_;
+    XorShift speech_noise_;
+
+public:
+    // ====================================================================================================
+    SyntheticFrameSource()
+    :
+        color_clock_( 30 ),
+        depth_clock_( 30 ),
+        infrared_clock_( 30 ),
+        audio_clock_( static_cast<double>( AUDIO_SAMPLE_RATE ) / AUDIO_FRAME_SAMPLES ),
+        bodies_clock_( 30 ),
+        speech_clock_( 0.2 ),
+        num_audio_channels_( 1 ),
+        num_tracked_bodies_( 2 ),
+        initialized_( false ),
+        color_noise_( 1 ),
+        depth_noise_( 2 ),
+        infrared_noise_( 3 ),
+        audio_noise_( 4 ),
+        speech_noise_( 5 )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    // must be called before initialize()
+    void configure( Poco::Util::AbstractConfiguration const & config, std::string const & prefix = "synthetic" )
+    {
+        configureClock( color_clock_, config, prefix + ".color" );
+        configureClock( depth_clock_, config, prefix + ".depth" );
+        configureClock( infrared_clock_, config, prefix + ".infrared" );
+        configureClock( audio_clock_, config, prefix + ".audio" );
+        configureClock( bodies_clock_, config, prefix + ".bodies" );
+        configureClock( speech_clock_, config, prefix + ".speech" );
+
+        num_audio_channels_ = std::max( config.getInt( prefix + ".audio.channels", num_audio_channels_ ), 1 );
+        int const num_tracked_bodies = config.getInt( prefix + ".bodies.tracked", static_cast<int>( num_tracked_bodies_ ) );
+        num_tracked_bodies_ = num_tracked_bodies < 0 ? 0 : std::min<size_t>( num_tracked_bodies, size_t( NUM_BODIES ) );
+    }
+
+    // ====================================================================================================
+    void initialize( bool color = true, bool depth = true, bool infrared = true, bool audio = true, bool body = true, bool speech = true )
+    {
+        if( initialized_ ) return;
+
+        start_time_ = _Clock::now();
+
+        if( color )
+        {
+            renderColorBackground();
+            color_clock_.start( start_time_ );
+        }
+
+        if( depth || infrared )
+        {
+            renderDepthBackground();
+            if( depth ) depth_clock_.start( start_time_ );
+            if( infrared ) infrared_clock_.start( start_time_ );
+        }
+
+        if( audio ) audio_clock_.start( start_time_ );
+        if( body ) bodies_clock_.start( start_time_ );
+        // give the first phrase a moment, like somebody walking up to the sensor
+        if( speech ) speech_clock_.start( start_time_ + std::chrono::seconds( 1 ) );
+
+        initialized_ = true;
+    }
+
+    // ====================================================================================================
+    bool waitForColorImage( uint32_t timeout_ms )
+    {
+        return color_clock_.wait( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForDepthImage( uint32_t timeout_ms )
+    {
+        return depth_clock_.wait( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForInfraredImage( uint32_t timeout_ms )
+    {
+        return infrared_clock_.wait( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForAudio( uint32_t timeout_ms )
+    {
+        return audio_clock_.wait( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForBodies( uint32_t timeout_ms )
+    {
+        return bodies_clock_.wait( timeout_ms );
+    }
+
+    // ====================================================================================================
+    bool waitForSpeech( uint32_t timeout_ms )
+    {
+        return speech_clock_.wait( timeout_ms );
+    }
+
+    // ====================================================================================================
+    // the background with a subject walking back and forth in front of it
+    void pullColorImage( _ColorImageMessage & image_message )
+    {
+        ATOMICS_TRACE_SCOPE( "SyntheticFrameSource::pullColorImage" );
+
+        if( color_background_.empty() ) throw KinectException( "Color stream not initialized" );
+
+        color_clock_.advance();
+        double const t = stamp( image_message.stamp_ );
+
+        auto & header = image_message.header_;
+        header.width_ = COLOR_WIDTH;
+        header.height_ = COLOR_HEIGHT;
+        header.num_channels_ = 4;
+        header.pixel_depth_ = 8;
+        header.encoding_ = "rgba";
+
+        image_message.payload_.allocate( color_background_.size() );
+        uint8_t * pixels = reinterpret_cast<uint8_t *>( image_message.payload_.data_ );
+        std::memcpy( pixels, color_background_.data(), color_background_.size() );
+
+        // subject: a shaded torso-sized box
+        int const subject_w = COLOR_WIDTH / 6;
+        int const subject_h = COLOR_HEIGHT * 2 / 3;
+        int const subject_x = static_cast<int>( ( COLOR_WIDTH - subject_w ) * ( 0.5 + 0.4 * std::sin( 0.5 * t ) ) );
+        int const subject_y = COLOR_HEIGHT - subject_h - COLOR_HEIGHT / 10;
+
+        for( int row = subject_y; row < subject_y + subject_h; ++row )
+        {
+            uint8_t * out = pixels + ( row * COLOR_WIDTH + subject_x ) * 4;
+            for( int col = 0; col < subject_w; ++col, out += 4 )
+            {
+                uint8_t const shade = static_cast<uint8_t>( 96 + 64 * col / subject_w + ( color_noise_() & 0x07 ) );
+                out[0] = shade;
+                out[1] = shade / 2;
+                out[2] = shade / 3;
+            }
+        }
+
+        // sensor noise on a sparse set of pixels, so consecutive frames never compress identically
+        for( size_t i = 0; i < COLOR_WIDTH * COLOR_HEIGHT / 16; ++i )
+        {
+            uint32_t const r = color_noise_();
+            pixels[( r % ( COLOR_WIDTH * COLOR_HEIGHT ) ) * 4 + ( r >> 30 ) % 3] ^= 0x03;
+        }
+    }
+
+    // ====================================================================================================
+    void pullDepthImage( _DepthImageMessage & image_message )
+    {
+        ATOMICS_TRACE_SCOPE( "SyntheticFrameSource::pullDepthImage" );
+
+        if( depth_background_.empty() ) throw KinectException( "Depth stream not initialized" );
+
+        depth_clock_.advance();
+        double const t = stamp( image_message.stamp_ );
+
+        image_message.min_reliable_distance_ = 500;
+        image_message.max_reliable_distance_ = 4500;
+
+        setDepthHeader( image_message.header_ );
+        image_message.payload_.allocate( depth_background_.size() * sizeof( uint16_t ) );
+        renderDepth( reinterpret_cast<uint16_t *>( image_message.payload_.data_ ), t, depth_noise_ );
+    }
+
+    // ====================================================================================================
+    // active IR falls off with the square of the distance to whatever it hits
+    void pullInfraredImage( _InfraredImageMessage & image_message )
+    {
+        ATOMICS_TRACE_SCOPE( "SyntheticFrameSource::pullInfraredImage" );
+
+        if( depth_background_.empty() ) throw KinectException( "Infrared stream not initialized" );
+
+        infrared_clock_.advance();
+        double const t = stamp( image_message.stamp_ );
+
+        setDepthHeader( image_message.header_ );
+        image_message.payload_.allocate( depth_background_.size() * sizeof( uint16_t ) );
+
+        uint16_t * pixels = reinterpret_cast<uint16_t *>( image_message.payload_.data_ );
+        renderDepth( pixels, t, infrared_noise_ );
+
+        for( size_t i = 0; i < depth_background_.size(); ++i )
+        {
+            float const meters = std::max( pixels[i], static_cast<uint16_t>( 1 ) ) / 1000.0f;
+            float const intensity = 8000.0f / ( meters * meters ) + 200.0f * infrared_noise_.uniform();
+            pixels[i] = static_cast<uint16_t>( std::min( std::max( intensity, 0.0f ), 65535.0f ) );
+        }
+    }
+
+    // ====================================================================================================
+    // a voice-band tone that comes and goes over a noise floor, from a source slowly moving across the room
+    void pullAudio( _AudioMessage & audio_message )
+    {
+        ATOMICS_TRACE_SCOPE( "SyntheticFrameSource::pullAudio" );
+
+        uint64_t const frame = audio_clock_.advance();
+        stamp( audio_message.stamp_ );
+
+        auto & header = audio_message.header_;
+        header.num_channels_ = num_audio_channels_;
+        header.sample_depth_ = 8 * sizeof( float );
+        header.sample_rate_ = AUDIO_SAMPLE_RATE;
+        header.encoding_ = "PCM32F";
+        header.num_samples_ = AUDIO_FRAME_SAMPLES;
+
+        audio_message.payload_.allocate( AUDIO_FRAME_SAMPLES * num_audio_channels_ * sizeof( float ) );
+        float * samples = reinterpret_cast<float *>( audio_message.payload_.data_ );
+
+        double const pi = 3.14159265358979;
+        for( uint32_t i = 0; i < AUDIO_FRAME_SAMPLES; ++i )
+        {
+            double const t = static_cast<double>( frame * AUDIO_FRAME_SAMPLES + i ) / AUDIO_SAMPLE_RATE;
+            double const envelope = 0.5 + 0.5 * std::sin( 2 * pi * 0.25 * t );
+            float const voice = static_cast<float>( envelope * ( 0.2 * std::sin( 2 * pi * 220 * t ) + 0.1 * std::sin( 2 * pi * 440 * t ) ) );
+
+            // the microphones are a few cm apart, so every channel hears the same thing plus its own noise
+            for( uint16_t channel = 0; channel < num_audio_channels_; ++channel )
+            {
+                samples[i * num_audio_channels_ + channel] = voice + 0.01f * audio_noise_.uniform();
+            }
+        }
+
+        double const t = static_cast<double>( frame * AUDIO_FRAME_SAMPLES ) / AUDIO_SAMPLE_RATE;
+        audio_message.beam_angle_ = static_cast<float>( 0.8 * std::sin( 0.1 * t ) );
+        audio_message.beam_angle_confidence_ = static_cast<float>( 0.5 + 0.5 * std::sin( 2 * pi * 0.25 * t ) );
+    }
+
+    // ====================================================================================================
+    // six bodies, like the sensor reports; the tracked ones stand side by side, swaying and waving
+    void pullBodies( _BodiesMessage & bodies_message )
+    {
+        ATOMICS_TRACE_SCOPE( "SyntheticFrameSource::pullBodies" );
+
+        bodies_clock_.advance();
+        double const t = stamp( bodies_message.stamp_ );
+
+        auto & payload = bodies_message.payload_;
+        payload.clear();
+
+        for( size_t body_idx = 0; body_idx < NUM_BODIES; ++body_idx )
+        {
+            KinectBodyMessage body_msg;
+            body_msg.is_tracked_ = body_idx < num_tracked_bodies_;
+
+            if( body_msg.is_tracked_ )
+            {
+                body_msg.tracking_id_ = 72057594037930000ull + body_idx;
+                body_msg.hand_state_left_ = static_cast<KinectBodyMessage::HandState>( 2 + static_cast<int>( t + body_idx ) % 3 );
+                body_msg.hand_state_right_ = static_cast<KinectBodyMessage::HandState>( 2 + static_cast<int>( t / 2 + body_idx ) % 3 );
+
+                float const x = 0.8f * ( body_idx - ( num_tracked_bodies_ - 1 ) / 2.0f ) + 0.1f * static_cast<float>( std::sin( 0.7 * t + body_idx ) );
+                float const z = 2.5f + 0.3f * static_cast<float>( std::sin( 0.3 * t + body_idx ) );
+                float const wave = 0.25f * static_cast<float>( std::sin( 3.0 * t + body_idx ) );
+
+                renderSkeleton( body_msg.joints_, x, z, wave );
+            }
+
+            payload.emplace_back( std::move( body_msg ) );
+        }
+    }
+
+    // ====================================================================================================
+    void pullSpeech( _SpeechMessage & speech_message )
+    {
+        ATOMICS_TRACE_SCOPE( "SyntheticFrameSource::pullSpeech" );
+
+        static std::array<char const *, 7> const tags = { { "FOLLOW", "LOOK_AT", "MOVE_BACKWARD", "MOVE_FORWARD", "STOP", "VOLUME_DOWN", "VOLUME_UP" } };
+
+        uint64_t const frame = speech_clock_.advance();
+        stamp( speech_message.stamp_ );
+
+        auto & payload = speech_message.payload_;
+        payload.clear();
+
+        KinectSpeechPhraseMessage speech_phrase_message;
+        speech_phrase_message.tag_ = tags[frame % tags.size()];
+        speech_phrase_message.confidence_ = 0.8f + 0.15f * speech_noise_.uniform();
+
+        payload.emplace_back( std::move( speech_phrase_message ) );
+    }
+
+protected:
+    // ====================================================================================================
+    static void configureClock( StreamClock & clock, Poco::Util::AbstractConfiguration const & config, std::string const & prefix )
+    {
+        clock.setFps( config.getDouble( prefix + ".fps", clock.fps() ) );
+    }
+
+    // ====================================================================================================
+    // fill in a timestamp in the sensor's units (100 ns ticks since it started); returns the same time in seconds
+    template<class __Stamp>
+    double stamp( __Stamp & stamp ) const
+    {
+        auto const elapsed = _Clock::now() - start_time_;
+        stamp = static_cast<__Stamp>( std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count() / 100 );
+        return std::chrono::duration<double>( elapsed ).count();
+    }
+
+    // ====================================================================================================
+    template<class __Header>
+    static void setDepthHeader( __Header & header )
+    {
+        header.width_ = DEPTH_WIDTH;
+        header.height_ = DEPTH_HEIGHT;
+        header.num_channels_ = 1;
+        header.pixel_depth_ = 16;
+        header.encoding_ = "gray";
+    }
+
+    // ====================================================================================================
+    // a lit back wall and floor, with noise baked in
+    void renderColorBackground()
+    {
+        color_background_.resize( COLOR_WIDTH * COLOR_HEIGHT * 4 );
+
+        uint8_t * out = color_background_.data();
+        for( int row = 0; row < COLOR_HEIGHT; ++row )
+        {
+            bool const floor = row > COLOR_HEIGHT * 3 / 4;
+            for( int col = 0; col < COLOR_WIDTH; ++col, out += 4 )
+            {
+                int const light = 200 - std::abs( col - COLOR_WIDTH / 2 ) * 80 / COLOR_WIDTH - row * 40 / COLOR_HEIGHT;
+                int const noise = color_noise_() & 0x0f;
+
+                out[0] = static_cast<uint8_t>( floor ? light / 2 + noise : light + noise / 2 );
+                out[1] = static_cast<uint8_t>( floor ? light / 2 + noise : light - 10 + noise / 2 );
+                out[2] = static_cast<uint8_t>( floor ? light / 3 + noise : light - 30 + noise / 2 );
+                out[3] = 255;
+            }
+        }
+    }
+
+    // ====================================================================================================
+    // a back wall 4 m away and a floor rising towards the sensor, in mm
+    void renderDepthBackground()
+    {
+        depth_background_.resize( DEPTH_WIDTH * DEPTH_HEIGHT );
+
+        for( int row = 0; row < DEPTH_HEIGHT; ++row )
+        {
+            uint16_t const depth = row < DEPTH_HEIGHT * 2 / 3 ? 4000 : static_cast<uint16_t>( 4000 - ( row - DEPTH_HEIGHT * 2 / 3 ) * 3000 / ( DEPTH_HEIGHT / 3 ) );
+            std::fill_n( depth_background_.begin() + row * DEPTH_WIDTH, DEPTH_WIDTH, depth );
+        }
+    }
+
+    // ====================================================================================================
+    // the background with a person-sized ellipse moving across it, plus a few mm of noise everywhere
+    void renderDepth( uint16_t * pixels, double t, XorShift & noise ) const
+    {
+        float const center_x = DEPTH_WIDTH * static_cast<float>( 0.5 + 0.35 * std::sin( 0.5 * t ) );
+        float const center_y = DEPTH_HEIGHT * 0.5f;
+        float const radius_x = DEPTH_WIDTH / 12.0f;
+        float const radius_y = DEPTH_HEIGHT / 3.0f;
+        float const subject_depth = 2000.0f + 500.0f * static_cast<float>( std::sin( 0.3 * t ) );
+
+        for( int row = 0; row < DEPTH_HEIGHT; ++row )
+        {
+            float const dy = ( row - center_y ) / radius_y;
+            for( int col = 0; col < DEPTH_WIDTH; ++col )
+            {
+                float const dx = ( col - center_x ) / radius_x;
+                float const r2 = dx * dx + dy * dy;
+
+                size_t const i = row * DEPTH_WIDTH + col;
+                float depth = r2 < 1.0f ? subject_depth - 150.0f * std::sqrt( 1.0f - r2 ) : depth_background_[i];
+                depth += 3.0f * noise.uniform();
+
+                pixels[i] = static_cast<uint16_t>( depth );
+            }
+        }
+    }
+
+    // ====================================================================================================
+    // a standing skeleton centered on (x, z) in camera space, in m; wave raises and lowers the right forearm
+    static void renderSkeleton( std::vector<KinectJointMessage> & joints, float x, float z, float wave )
+    {
+        // joint positions relative to the spine base, in KinectJointMessage::JointType order
+        static float const pose[NUM_JOINTS][3] =
+        {
+            {  0.00f, 0.00f, 0.00f }, {  0.00f, 0.30f, 0.00f }, {  0.00f, 0.55f, 0.00f }, {  0.00f, 0.70f, 0.00f },
+            { -0.18f, 0.48f, 0.00f }, { -0.25f, 0.22f, 0.02f }, { -0.28f, 0.00f, 0.05f }, { -0.29f,-0.07f, 0.06f },
+            {  0.18f, 0.48f, 0.00f }, {  0.25f, 0.22f, 0.02f }, {  0.28f, 0.00f, 0.05f }, {  0.29f,-0.07f, 0.06f },
+            { -0.08f,-0.05f, 0.00f }, { -0.09f,-0.45f, 0.02f }, { -0.09f,-0.85f, 0.00f }, { -0.09f,-0.90f,-0.08f },
+            {  0.08f,-0.05f, 0.00f }, {  0.09f,-0.45f, 0.02f }, {  0.09f,-0.85f, 0.00f }, {  0.09f,-0.90f,-0.08f },
+            {  0.00f, 0.48f, 0.00f }, { -0.30f,-0.14f, 0.07f }, { -0.26f,-0.09f, 0.08f }, {  0.30f,-0.14f, 0.07f },
+            {  0.26f,-0.09f, 0.08f }
+        };
+
+        joints.resize( NUM_JOINTS );
+
+        for( size_t i = 0; i < NUM_JOINTS; ++i )
+        {
+            auto const joint_type = static_cast<KinectJointMessage::JointType>( i );
+            bool const right_forearm = joint_type == KinectJointMessage::JointType::WRIST_RIGHT || joint_type == KinectJointMessage::JointType::HAND_RIGHT
+                || joint_type == KinectJointMessage::JointType::HANDTIP_RIGHT || joint_type == KinectJointMessage::JointType::THUMB_RIGHT;
+
+            auto & joint = joints[i];
+            joint.joint_type_ = joint_type;
+            joint.tracking_state_ = KinectJointMessage::TrackingState::TRACKED;
+
+            joint.position_.x = x + pose[i][0];
+            joint.position_.y = pose[i][1] + ( right_forearm ? 0.3f + wave : 0.0f );
+            joint.position_.z = z + pose[i][2];
+
+            joint.orientation_.x = 0.0f;
+            joint.orientation_.y = 0.0f;
+            joint.orientation_.z = 0.0f;
+            joint.orientation_.w = 1.0f;
+        }
+    }
+};
+
+#endif // _KINECTCOMMON_SYNTHETICFRAMESOURCE_H_
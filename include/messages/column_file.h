@@ -0,0 +1,393 @@
+#ifndef _MESSAGES_COLUMNFILE_H_
+#define _MESSAGES_COLUMNFILE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <cstring>
+
+#include <Poco/File.h>
+#include <Poco/Exception.h>
+#include <Poco/SharedMemory.h>
+
+#include <messages/exceptions.h>
+
+// a table of fixed-width columns, one after the other in one file, for scanning long time series (eg: every body frame of a session)
+// without decoding a message per row
+//
+// header: magic (8), version (4), byte order mark (4), number of rows (8), number of columns (4), reserved (4)
+// then one 64-byte entry per column: name (48, nul-padded), type (4), width (4: values per row), offset (8: of the column's data)
+// then the columns' data, each starting on a COLUMN_ALIGNMENT boundary; row r of a column is values [r * width, (r + 1) * width)
+//
+// unlike the message logs, values are stored in the writer's own byte order so a mapped column can be used as a plain array; the byte
+// order mark tells a reader on a machine of the other kind that it can't do that
+namespace column_file
+{
+    // "KCOLUMNS"
+    static uint64_t const FILE_MAGIC = 0x4B434F4C554D4E53ULL;
+    static uint32_t const VERSION = 1;
+    static uint32_t const BYTE_ORDER_MARK = 0x01020304;
+
+    static size_t const HEADER_SIZE = 32;
+    static size_t const COLUMN_ENTRY_SIZE = 64;
+    static size_t const MAX_NAME_SIZE = 48;
+    static size_t const COLUMN_ALIGNMENT = 64;
+
+    enum class ColumnType : uint32_t
+    {
+        UINT8 = 0,
+        UINT32 = 1,
+        UINT64 = 2,
+        FLOAT32 = 3
+    };
+
+    template<class __Value>
+    struct ColumnTypeOf;
+
+    template<> struct ColumnTypeOf<uint8_t> { static ColumnType const value = ColumnType::UINT8; };
+    template<> struct ColumnTypeOf<uint32_t> { static ColumnType const value = ColumnType::UINT32; };
+    template<> struct ColumnTypeOf<uint64_t> { static ColumnType const value = ColumnType::UINT64; };
+    template<> struct ColumnTypeOf<float> { static ColumnType const value = ColumnType::FLOAT32; };
+
+    inline size_t valueSize( ColumnType type )
+    {
+        switch( type )
+        {
+        case ColumnType::UINT8: return sizeof( uint8_t );
+        case ColumnType::UINT32: return sizeof( uint32_t );
+        case ColumnType::UINT64: return sizeof( uint64_t );
+        case ColumnType::FLOAT32: return sizeof( float );
+        }
+        return 0;
+    }
+
+    inline std::string typeName( ColumnType type )
+    {
+        switch( type )
+        {
+        case ColumnType::UINT8: return "uint8";
+        case ColumnType::UINT32: return "uint32";
+        case ColumnType::UINT64: return "uint64";
+        case ColumnType::FLOAT32: return "float32";
+        }
+        return "unknown";
+    }
+} // column_file
+
+// ####################################################################################################
+// builds the columns in memory and writes them out in one go
+//
+// add every column first, then append rows by filling in each column's values; write() checks they all ended up with the same number of rows
+class ColumnFileWriter
+{
+public:
+    typedef column_file::ColumnType _ColumnType;
+
+protected:
+    struct ColumnBase
+    {
+        std::string name_;
+        _ColumnType type_;
+        uint32_t width_;
+
+        ColumnBase( std::string const & name, _ColumnType type, uint32_t width )
+        :
+            name_( name ),
+            type_( type ),
+            width_( width )
+        {
+            //
+        }
+
+        virtual ~ColumnBase()
+        {
+            //
+        }
+
+        virtual char const * data() const = 0;
+        virtual size_t numValues() const = 0;
+    };
+
+    template<class __Value>
+    struct Column : public ColumnBase
+    {
+        std::vector<__Value> values_;
+
+        Column( std::string const & name, uint32_t width )
+        :
+            ColumnBase( name, column_file::ColumnTypeOf<__Value>::value, width )
+        {
+            //
+        }
+
+        char const * data() const
+        {
+            return reinterpret_cast<char const *>( values_.data() );
+        }
+
+        size_t numValues() const
+        {
+            return values_.size();
+        }
+    };
+
+    std::vector<std::unique_ptr<ColumnBase> > columns_;
+
+public:
+    // add a column with width values per row; returns the vector to append its values to, which stays valid as long as the writer does
+    template<class __Value>
+    std::vector<__Value> & addColumn( std::string const & name, uint32_t width = 1 )
+    {
+        if( name.size() >= column_file::MAX_NAME_SIZE ) throw messages::MessageException( "Column name " + name + " is too long" );
+        if( width == 0 ) throw messages::MessageException( "Column " + name + " has no values" );
+
+        Column<__Value> * column_ptr = new Column<__Value>( name, width );
+        columns_.push_back( std::unique_ptr<ColumnBase>( column_ptr ) );
+        return column_ptr->values_;
+    }
+
+    // rows so far, going by the first column
+    uint64_t numRows() const
+    {
+        return columns_.empty() ? 0 : columns_.front()->numValues() / columns_.front()->width_;
+    }
+
+    // throws MessageException if the columns don't all have the same number of rows, or the file can't be written
+    void write( std::string const & output_path ) const
+    {
+        uint64_t const num_rows = numRows();
+
+        for( auto column_it = columns_.begin(); column_it != columns_.end(); ++column_it )
+        {
+            if( ( *column_it )->numValues() != num_rows * ( *column_it )->width_ ) throw messages::MessageException( "Column " + ( *column_it )->name_ + " doesn't have " + std::to_string( num_rows ) + " rows" );
+        }
+
+        std::ofstream output_stream( output_path, std::ios::out | std::ios::binary | std::ios::trunc );
+        if( !output_stream ) throw messages::MessageException( "Failed to open column file " + output_path );
+
+        uint64_t offset = align( column_file::HEADER_SIZE + column_file::COLUMN_ENTRY_SIZE * columns_.size() );
+
+        writeValue( output_stream, column_file::FILE_MAGIC );
+        writeValue( output_stream, column_file::VERSION );
+        writeValue( output_stream, column_file::BYTE_ORDER_MARK );
+        writeValue( output_stream, num_rows );
+        writeValue( output_stream, static_cast<uint32_t>( columns_.size() ) );
+        writeValue( output_stream, static_cast<uint32_t>( 0 ) );
+
+        for( auto column_it = columns_.begin(); column_it != columns_.end(); ++column_it )
+        {
+            ColumnBase const & column = **column_it;
+
+            char name[column_file::MAX_NAME_SIZE] = { 0 };
+            std::memcpy( name, column.name_.data(), column.name_.size() );
+            output_stream.write( name, sizeof( name ) );
+
+            writeValue( output_stream, static_cast<uint32_t>( column.type_ ) );
+            writeValue( output_stream, column.width_ );
+            writeValue( output_stream, offset );
+
+            offset = align( offset + column.numValues() * column_file::valueSize( column.type_ ) );
+        }
+
+        for( auto column_it = columns_.begin(); column_it != columns_.end(); ++column_it )
+        {
+            ColumnBase const & column = **column_it;
+
+            pad( output_stream );
+            output_stream.write( column.data(), static_cast<std::streamsize>( column.numValues() * column_file::valueSize( column.type_ ) ) );
+        }
+
+        output_stream.close();
+        if( !output_stream ) throw messages::MessageException( "Failed to write column file " + output_path );
+    }
+
+protected:
+    static uint64_t align( uint64_t offset )
+    {
+        return ( offset + column_file::COLUMN_ALIGNMENT - 1 ) / column_file::COLUMN_ALIGNMENT * column_file::COLUMN_ALIGNMENT;
+    }
+
+    template<class __Value>
+    static void writeValue( std::ostream & output_stream, __Value const & value )
+    {
+        output_stream.write( reinterpret_cast<char const *>( &value ), sizeof( value ) );
+    }
+
+    static void pad( std::ostream & output_stream )
+    {
+        uint64_t const position = static_cast<uint64_t>( output_stream.tellp() );
+        std::string const padding( static_cast<size_t>( align( position ) - position ), '\0' );
+        output_stream.write( padding.data(), static_cast<std::streamsize>( padding.size() ) );
+    }
+};
+
+// ####################################################################################################
+// read-only view of a column file, mapped into memory; columns are plain arrays pointing into the mapping, valid as long as the ColumnFile is
+class ColumnFile
+{
+public:
+    typedef column_file::ColumnType _ColumnType;
+
+    struct ColumnInfo
+    {
+        std::string name_;
+        _ColumnType type_;
+        uint32_t width_;
+        uint64_t offset_;
+
+        ColumnInfo()
+        :
+            type_( _ColumnType::UINT8 ),
+            width_( 0 ),
+            offset_( 0 )
+        {
+            //
+        }
+    };
+
+    // the values of one column: row r is data_[r * width_] to data_[r * width_ + width_ - 1]
+    template<class __Value>
+    struct Column
+    {
+        __Value const * data_;
+        uint32_t width_;
+        uint64_t num_rows_;
+
+        Column( __Value const * data = NULL, uint32_t width = 0, uint64_t num_rows = 0 )
+        :
+            data_( data ),
+            width_( width ),
+            num_rows_( num_rows )
+        {
+            //
+        }
+
+        __Value const * row( uint64_t row_idx ) const
+        {
+            return data_ + row_idx * width_;
+        }
+
+        __Value const & operator()( uint64_t row_idx, uint32_t value_idx = 0 ) const
+        {
+            return data_[row_idx * width_ + value_idx];
+        }
+    };
+
+protected:
+    std::string input_path_;
+    std::unique_ptr<Poco::SharedMemory> mapping_ptr_;
+    char const * begin_;
+    char const * end_;
+
+    uint64_t num_rows_;
+    std::vector<ColumnInfo> columns_;
+    std::map<std::string, size_t> column_indices_;
+
+public:
+    // throws MessageException if the file can't be mapped, isn't a column file, or was written on a machine of the other byte order
+    ColumnFile( std::string const & input_path )
+    :
+        input_path_( input_path ),
+        begin_( NULL ),
+        end_( NULL ),
+        num_rows_( 0 )
+    {
+        try
+        {
+            Poco::File const input_file( input_path );
+            if( input_file.getSize() > 0 )
+            {
+                mapping_ptr_.reset( new Poco::SharedMemory( input_file, Poco::SharedMemory::AM_READ ) );
+                begin_ = mapping_ptr_->begin();
+                end_ = mapping_ptr_->end();
+            }
+        }
+        catch( Poco::Exception & e )
+        {
+            throw messages::MessageException( "Failed to map column file " + input_path + ": " + e.displayText() );
+        }
+
+        readHeader();
+    }
+
+    uint64_t numRows() const
+    {
+        return num_rows_;
+    }
+
+    std::vector<ColumnInfo> const & columns() const
+    {
+        return columns_;
+    }
+
+    bool hasColumn( std::string const & name ) const
+    {
+        return column_indices_.count( name ) > 0;
+    }
+
+    // throws MessageException if there's no such column, or it holds another type of value
+    template<class __Value>
+    Column<__Value> column( std::string const & name ) const
+    {
+        auto const column_index_it = column_indices_.find( name );
+        if( column_index_it == column_indices_.end() ) throw messages::MessageException( "Column file " + input_path_ + " has no column " + name );
+
+        ColumnInfo const & column_info = columns_[column_index_it->second];
+        if( column_info.type_ != column_file::ColumnTypeOf<__Value>::value ) throw messages::MessageException( "Column " + name + " holds " + column_file::typeName( column_info.type_ ) + " values" );
+
+        return Column<__Value>( reinterpret_cast<__Value const *>( begin_ + column_info.offset_ ), column_info.width_, num_rows_ );
+    }
+
+    std::string const & inputPath() const
+    {
+        return input_path_;
+    }
+
+protected:
+    template<class __Value>
+    __Value readValue( size_t offset ) const
+    {
+        __Value value;
+        std::memcpy( &value, begin_ + offset, sizeof( value ) );
+        return value;
+    }
+
+    size_t size() const
+    {
+        return static_cast<size_t>( end_ - begin_ );
+    }
+
+    void readHeader()
+    {
+        if( size() < column_file::HEADER_SIZE || readValue<uint64_t>( 0 ) != column_file::FILE_MAGIC ) throw messages::MessageException( input_path_ + " isn't a column file" );
+        if( readValue<uint32_t>( 8 ) > column_file::VERSION ) throw messages::MessageException( "Column file " + input_path_ + " is from a newer version (" + std::to_string( readValue<uint32_t>( 8 ) ) + ")" );
+        if( readValue<uint32_t>( 12 ) != column_file::BYTE_ORDER_MARK ) throw messages::MessageException( "Column file " + input_path_ + " was written on a machine with the other byte order" );
+
+        num_rows_ = readValue<uint64_t>( 16 );
+        uint32_t const num_columns = readValue<uint32_t>( 24 );
+
+        if( size() < column_file::HEADER_SIZE + column_file::COLUMN_ENTRY_SIZE * num_columns ) throw messages::MessageException( "Column file " + input_path_ + " is cut short" );
+
+        for( uint32_t column_idx = 0; column_idx < num_columns; ++column_idx )
+        {
+            size_t const entry_offset = column_file::HEADER_SIZE + column_file::COLUMN_ENTRY_SIZE * column_idx;
+
+            ColumnInfo column_info;
+            char const * name = begin_ + entry_offset;
+            column_info.name_.assign( name, strnlen( name, column_file::MAX_NAME_SIZE ) );
+            column_info.type_ = static_cast<_ColumnType>( readValue<uint32_t>( entry_offset + column_file::MAX_NAME_SIZE ) );
+            column_info.width_ = readValue<uint32_t>( entry_offset + column_file::MAX_NAME_SIZE + 4 );
+            column_info.offset_ = readValue<uint64_t>( entry_offset + column_file::MAX_NAME_SIZE + 8 );
+
+            uint64_t const column_size = num_rows_ * column_info.width_ * column_file::valueSize( column_info.type_ );
+            if( column_file::valueSize( column_info.type_ ) == 0 || column_info.offset_ > size() || column_size > size() - column_info.offset_ ) throw messages::MessageException( "Column " + column_info.name_ + " of " + input_path_ + " is damaged or cut short" );
+
+            column_indices_[column_info.name_] = columns_.size();
+            columns_.push_back( column_info );
+        }
+    }
+};
+
+#endif // _MESSAGES_COLUMNFILE_H_
@@ -328,6 +328,43 @@ public:
         //
     }
 
+    // the helper's references have to point into our own payload, never into the one we were copied or moved from
+    ArrayMessage( ArrayMessage const & other )
+    :
+        _Message( static_cast<_Message const &>( other ) ),
+        ArrayHelper<__Payload, __Dim>( this->payload_.begin() )
+    {
+        //
+    }
+
+    // non-const copies would otherwise be taken by the forwarding constructor above
+    ArrayMessage( ArrayMessage & other )
+    :
+        ArrayMessage( static_cast<ArrayMessage const &>( other ) )
+    {
+        //
+    }
+
+    ArrayMessage( ArrayMessage && other )
+    :
+        _Message( static_cast<_Message &&>( other ) ),
+        ArrayHelper<__Payload, __Dim>( this->payload_.begin() )
+    {
+        //
+    }
+
+    ArrayMessage & operator=( ArrayMessage const & other )
+    {
+        _Message::operator=( static_cast<_Message const &>( other ) );
+        return *this;
+    }
+
+    ArrayMessage & operator=( ArrayMessage && other )
+    {
+        _Message::operator=( static_cast<_Message &&>( other ) );
+        return *this;
+    }
+
     template<class __Archive>
     void pack( __Archive & archive )
     {
@@ -0,0 +1,636 @@
+#ifndef _MESSAGES_FANOUTTCPDEVICE_H_
+#define _MESSAGES_FANOUTTCPDEVICE_H_
+
+#include <string>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/MemoryStream.h>
+
+#include <atomics/binary_stream.h>
+#include <atomics/trace.h>
+
+#include <messages/exceptions.h>
+
+#include <messages/message_coder.h>
+#include <messages/binary_codec.h>
+#include <messages/message_extensions.h>
+#include <messages/subscription_message.h>
+
+// ####################################################################################################
+// like OutputTCPDevice, but streams to any number of clients at once; every client gets the same frames (same protocol, so an
+// InputTCPDevice can't tell the difference)
+//
+// clients connect whenever they like and are picked up by a background thread. each message is encoded once and queued for every
+// client; each client has its own thread sending from its queue, so a slow client only holds itself back. once more than max_queued
+// frames are waiting for a client, its oldest are dropped (whole frames, so the stream stays readable). push() never blocks on a client
+//
+// clients may also send a SubscriptionMessage (see InputTCPDevice::push()) to only get some streams, each at most so often. messages
+// pushed with a stream id (their payload id) go only to the clients that want that stream, decimated separately for each client; messages
+// pushed without one go to everyone. a client gets every stream until it subscribes. wants() tells whether anyone wants a stream at all,
+// and the subscription listener hears whenever that may have changed
+class FanOutTCPDevice
+{
+public:
+    // one encoded frame, protocol header included, shared by every client it's queued for
+    typedef std::shared_ptr<std::string const> _FramePtr;
+
+    typedef std::mutex _Mutex;
+    typedef std::unique_lock<_Mutex> _Lock;
+
+    // the largest frame a client may send us; a SubscriptionMessage takes a few bytes per stream
+    static uint32_t const MAX_RECEIVED_FRAME_SIZE = 64*1024;
+    // the longest a client may ask to wait between two messages of a stream; slower rates are rounded up to this (in ns: an hour)
+    static uint64_t const MAX_STREAM_INTERVAL = 3600ull * 1000000000ull;
+
+protected:
+    // how often one client wants one stream; see admit()
+    struct StreamFilter
+    {
+        // in ns; 0 for every message
+        uint64_t min_interval_;
+        uint64_t next_due_;
+    };
+
+    struct Client
+    {
+        Poco::Net::StreamSocket socket_;
+        Poco::Net::SocketAddress address_;
+
+        _Mutex mutex_;
+        std::condition_variable frame_available_condition_;
+        std::deque<_FramePtr> frames_;
+
+        // guarded by mutex_, like frames_; until a client subscribes, it gets everything
+        bool subscribed_;
+        std::map<uint32_t, StreamFilter> filters_;
+
+        std::atomic<bool> connected_;
+        // whether the send thread is busy with a frame it's already taken off frames_
+        std::atomic<bool> sending_;
+        std::atomic<uint64_t> num_sent_;
+        std::atomic<uint64_t> num_dropped_;
+
+        std::thread send_thread_;
+        std::thread receive_thread_;
+
+        Client( Poco::Net::StreamSocket const & socket, Poco::Net::SocketAddress const & address )
+        :
+            socket_( socket ),
+            address_( address ),
+            subscribed_( false ),
+            connected_( true ),
+            sending_( false ),
+            num_sent_( 0 ),
+            num_dropped_( 0 )
+        {
+            //
+        }
+    };
+
+    typedef std::shared_ptr<Client> _ClientPtr;
+
+    std::atomic<bool> running_;
+
+    size_t max_queued_;
+
+    // guards clients_ and subscription_listener_
+    mutable _Mutex clients_mutex_;
+    std::list<_ClientPtr> clients_;
+
+    std::function<void()> subscription_listener_;
+
+    std::atomic<uint64_t> num_clients_accepted_;
+    // frames dropped for clients that have since gone away
+    std::atomic<uint64_t> num_dropped_departed_;
+
+    std::thread accept_thread_;
+
+public:
+    Poco::Net::ServerSocket server_socket_;
+
+    // ====================================================================================================
+    FanOutTCPDevice( std::string const & address, uint16_t port, size_t max_queued = 64 )
+    :
+        running_( true ),
+        max_queued_( max_queued ),
+        num_clients_accepted_( 0 ),
+        num_dropped_departed_( 0 ),
+        server_socket_( Poco::Net::SocketAddress( address, port ) )
+    {
+        std::cout << "server listening on " << server_socket_.address().toString() << std::endl;
+        accept_thread_ = std::thread( &FanOutTCPDevice::acceptTask, this );
+    }
+
+    // ====================================================================================================
+    ~FanOutTCPDevice()
+    {
+        closeOutput();
+    }
+
+    // ====================================================================================================
+    // stop accepting clients and hang up on everyone still connected; anything still queued for them is discarded
+    void closeOutput()
+    {
+        if( !running_.exchange( false ) ) return;
+
+        std::cout << "closing output" << std::endl;
+
+        if( accept_thread_.joinable() ) accept_thread_.join();
+        server_socket_.close();
+
+        std::list<_ClientPtr> clients;
+        {
+            _Lock lock( clients_mutex_ );
+            clients.swap( clients_ );
+        }
+
+        for( auto client_it = clients.begin(); client_it != clients.end(); ++client_it )
+        {
+            disconnect( **client_it );
+            join( **client_it );
+        }
+    }
+
+    // ====================================================================================================
+    // wait until every connected client has been sent everything queued for it, or the timeout runs out; false if it did
+    bool flush( std::chrono::milliseconds timeout )
+    {
+        auto const deadline = std::chrono::steady_clock::now() + timeout;
+
+        while( true )
+        {
+            bool flushed = true;
+            {
+                _Lock lock( clients_mutex_ );
+                for( auto client_it = clients_.begin(); client_it != clients_.end() && flushed; ++client_it )
+                {
+                    Client & client = **client_it;
+                    if( !client.connected_ ) continue;
+
+                    _Lock client_lock( client.mutex_ );
+                    flushed = client.frames_.empty() && !client.sending_;
+                }
+            }
+
+            if( flushed ) return true;
+            if( std::chrono::steady_clock::now() >= deadline ) return false;
+
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        }
+    }
+
+    // ====================================================================================================
+    // encode the message and queue it for every connected client; safe to call from any number of threads
+    template<class __Serializable>
+    void push( __Serializable & serializable )
+    {
+        if( !running_ ) throw messages::MessageException( "Failed to serialize message; FanOutTCPDevice closed" );
+
+        queue( encodeFrame( serializable ), false, 0, 0 );
+    }
+
+    // ====================================================================================================
+    // the same, with the given extensions (see message_extensions.h) after the message in the same frame
+    template<class __Serializable>
+    void push( __Serializable & serializable, MessageExtensions const & extensions )
+    {
+        ExtendedMessageRef<__Serializable> extended_message( serializable, extensions );
+        push( extended_message );
+    }
+
+    // ====================================================================================================
+    // encode the message and queue it for the clients that want the given stream; decimation goes by stamp (in ns, from any steady clock
+    // the stream's messages all share; 0 for the time of the push)
+    template<class __Serializable>
+    void push( __Serializable & serializable, uint32_t stream_id, uint64_t stamp = 0 )
+    {
+        if( !running_ ) throw messages::MessageException( "Failed to serialize message; FanOutTCPDevice closed" );
+
+        // don't spend time encoding what nobody's going to get
+        if( !wants( stream_id ) ) return;
+
+        queue( encodeFrame( serializable ), true, stream_id, stamp );
+    }
+
+    // ====================================================================================================
+    template<class __Serializable>
+    void push( __Serializable & serializable, MessageExtensions const & extensions, uint32_t stream_id, uint64_t stamp = 0 )
+    {
+        ExtendedMessageRef<__Serializable> extended_message( serializable, extensions );
+        push( extended_message, stream_id, stamp );
+    }
+
+    // ====================================================================================================
+    // queue an already-encoded frame for every connected client
+    void push( _FramePtr const & frame_ptr )
+    {
+        queue( frame_ptr, false, 0, 0 );
+    }
+
+    // ====================================================================================================
+    // called, from whichever of our threads noticed, whenever a client connects, subscribes, or goes away; see wants()
+    void setSubscriptionListener( std::function<void()> const & subscription_listener )
+    {
+        _Lock lock( clients_mutex_ );
+        subscription_listener_ = subscription_listener;
+    }
+
+    // ====================================================================================================
+    // whether any connected client wants the given stream
+    bool wants( uint32_t stream_id ) const
+    {
+        _Lock lock( clients_mutex_ );
+
+        for( auto client_it = clients_.begin(); client_it != clients_.end(); ++client_it )
+        {
+            Client & client = **client_it;
+            if( !client.connected_ ) continue;
+
+            _Lock client_lock( client.mutex_ );
+            if( !client.subscribed_ || client.filters_.count( stream_id ) > 0 ) return true;
+        }
+
+        return false;
+    }
+
+protected:
+    // ====================================================================================================
+    void queue( _FramePtr const & frame_ptr, bool filtered, uint32_t stream_id, uint64_t stamp )
+    {
+        if( filtered && stamp == 0 ) stamp = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+
+        // clients that have hung up are joined once we've let go of clients_mutex_; their threads may still need it on the way out
+        std::list<_ClientPtr> departed_clients;
+
+        _Lock lock( clients_mutex_ );
+        reapClients( departed_clients );
+
+        for( auto client_it = clients_.begin(); client_it != clients_.end(); ++client_it )
+        {
+            Client & client = **client_it;
+            {
+                _Lock client_lock( client.mutex_ );
+
+                if( filtered && client.subscribed_ )
+                {
+                    auto const filter_it = client.filters_.find( stream_id );
+                    if( filter_it == client.filters_.end() || !admit( filter_it->second, stamp ) ) continue;
+                }
+
+                client.frames_.push_back( frame_ptr );
+                while( client.frames_.size() > max_queued_ )
+                {
+                    client.frames_.pop_front();
+                    ++client.num_dropped_;
+                }
+            }
+            client.frame_available_condition_.notify_one();
+        }
+
+        lock.unlock();
+
+        for( auto client_it = departed_clients.begin(); client_it != departed_clients.end(); ++client_it )
+        {
+            join( **client_it );
+        }
+    }
+
+    // ====================================================================================================
+    // whether a message stamped so should go out, for at most one per min_interval_ on average. one that's a little early still goes (and
+    // brings the next one forward as much), so jitter in the stamps can't halve a rate that divides the stream's evenly; after a gap of
+    // more than an interval, the count starts over rather than catching up
+    static bool admit( StreamFilter & filter, uint64_t stamp )
+    {
+        if( filter.min_interval_ == 0 ) return true;
+        if( stamp + filter.min_interval_ / 8 < filter.next_due_ ) return false;
+
+        filter.next_due_ = stamp >= filter.next_due_ + filter.min_interval_ ? stamp + filter.min_interval_ : filter.next_due_ + filter.min_interval_;
+        return true;
+    }
+
+public:
+    // ====================================================================================================
+    // a message as push() sends it: the protocol header ('<', size, '>') followed by the binary-coded message
+    template<class __Serializable>
+    static _FramePtr encodeFrame( __Serializable & serializable )
+    {
+        MessageCoder<BinaryCodec<> > binary_coder;
+        auto binary_coded_message = binary_coder.encode( serializable );
+
+        uint32_t const message_size = binary_coded_message.payload_.size_;
+
+        std::shared_ptr<std::string> frame_ptr = std::make_shared<std::string>( 6 + message_size, '\0' );
+        char * frame = &( *frame_ptr )[0];
+        frame[0] = '<';
+        *reinterpret_cast<uint32_t *>( frame + 1 ) = message_size;
+        frame[5] = '>';
+        std::memcpy( frame + 6, binary_coded_message.payload_.data_, message_size );
+
+        return frame_ptr;
+    }
+
+    // ====================================================================================================
+    size_t numClients() const
+    {
+        _Lock lock( clients_mutex_ );
+
+        size_t num_clients = 0;
+        for( auto client_it = clients_.begin(); client_it != clients_.end(); ++client_it )
+        {
+            if( ( *client_it )->connected_ ) ++num_clients;
+        }
+        return num_clients;
+    }
+
+    // ====================================================================================================
+    uint64_t numClientsAccepted() const
+    {
+        return num_clients_accepted_;
+    }
+
+    // ====================================================================================================
+    // frames dropped because a client couldn't keep up, over all clients past and present
+    uint64_t numDropped() const
+    {
+        _Lock lock( clients_mutex_ );
+
+        uint64_t num_dropped = num_dropped_departed_;
+        for( auto client_it = clients_.begin(); client_it != clients_.end(); ++client_it )
+        {
+            num_dropped += ( *client_it )->num_dropped_;
+        }
+        return num_dropped;
+    }
+
+protected:
+    // ====================================================================================================
+    void acceptTask()
+    {
+        while( running_ )
+        {
+            try
+            {
+                // wake up periodically so we notice when we've been closed
+                if( !server_socket_.poll( Poco::Timespan( 100 * 1000 ), Poco::Net::Socket::SELECT_READ ) ) continue;
+
+                Poco::Net::SocketAddress client_address;
+                Poco::Net::StreamSocket socket = server_socket_.acceptConnection( client_address );
+                socket.setNoDelay( true );
+
+                std::cout << "accepted connection from client " << client_address.toString() << std::endl;
+
+                auto client_ptr = std::make_shared<Client>( socket, client_address );
+                client_ptr->send_thread_ = std::thread( &FanOutTCPDevice::sendTask, this, client_ptr.get() );
+                client_ptr->receive_thread_ = std::thread( &FanOutTCPDevice::receiveTask, this, client_ptr.get() );
+
+                {
+                    _Lock lock( clients_mutex_ );
+                    clients_.push_back( client_ptr );
+                    ++num_clients_accepted_;
+                }
+
+                notifySubscriptionListener();
+            }
+            catch( std::exception & e )
+            {
+                if( running_ ) std::cout << "acceptTask(): " << e.what() << std::endl;
+            }
+        }
+    }
+
+    // ====================================================================================================
+    void sendTask( Client * client_ptr )
+    {
+        Client & client = *client_ptr;
+
+        while( true )
+        {
+            _FramePtr frame_ptr;
+            {
+                _Lock lock( client.mutex_ );
+                client.frame_available_condition_.wait( lock, [&client](){ return !client.connected_ || !client.frames_.empty(); } );
+                if( !client.connected_ ) break;
+
+                frame_ptr = std::move( client.frames_.front() );
+                client.frames_.pop_front();
+                client.sending_ = true;
+            }
+
+            try
+            {
+                sendBytes( client.socket_, frame_ptr->data(), frame_ptr->size() );
+                ++client.num_sent_;
+                client.sending_ = false;
+            }
+            catch( std::exception & e )
+            {
+                client.sending_ = false;
+                std::cout << "failed to send data to " << client.address_.toString() << ": " << e.what() << std::endl;
+                disconnect( client );
+                break;
+            }
+        }
+    }
+
+    // ====================================================================================================
+    // the only thing clients send us is subscriptions; reading is also how we notice they've hung up
+    void receiveTask( Client * client_ptr )
+    {
+        Client & client = *client_ptr;
+
+        std::string frame;
+        while( client.connected_ )
+        {
+            try
+            {
+                if( !client.socket_.poll( Poco::Timespan( 100 * 1000 ), Poco::Net::Socket::SELECT_READ ) ) continue;
+                if( receiveFrame( client.socket_, frame ) )
+                {
+                    receiveSubscription( client, frame );
+                    continue;
+                }
+
+                std::cout << "client " << client.address_.toString() << " disconnected" << std::endl;
+            }
+            catch( std::exception & e )
+            {
+                if( client.connected_ ) std::cout << "client " << client.address_.toString() << ": " << e.what() << std::endl;
+            }
+
+            disconnect( client );
+        }
+    }
+
+    // ====================================================================================================
+    // read one frame (as InputTCPDevice::push() sends it) into frame, minus the protocol header; false if the client hung up instead
+    bool receiveFrame( Poco::Net::StreamSocket & socket, std::string & frame )
+    {
+        char protocol_message[6];
+        if( !receiveBytes( socket, protocol_message, 6 ) ) return false;
+
+        // unlike InputTCPDevice, we don't hunt for the next frame; a client that sends anything else is broken, so we hang up on it
+        if( protocol_message[0] != '<' || protocol_message[5] != '>' ) throw messages::MessageException( "received malformed frame" );
+
+        uint32_t const message_size = *reinterpret_cast<uint32_t *>( protocol_message + 1 );
+        if( message_size > MAX_RECEIVED_FRAME_SIZE ) throw messages::MessageException( "received oversized frame" );
+
+        frame.resize( message_size );
+        return message_size == 0 || receiveBytes( socket, &frame[0], message_size );
+    }
+
+    // ====================================================================================================
+    // false if the socket was closed before all of them arrived
+    bool receiveBytes( Poco::Net::StreamSocket & socket, char * bytes, size_t length )
+    {
+        size_t bytes_received = 0;
+        while( bytes_received < length )
+        {
+            int receive_result = socket.receiveBytes( bytes + bytes_received, static_cast<int>( length - bytes_received ) );
+            if( receive_result < 0 ) throw messages::MessageException( "receiveBytes() failed" );
+            else if( receive_result == 0 ) return false;
+            else bytes_received += receive_result;
+        }
+
+        return true;
+    }
+
+    // ====================================================================================================
+    // replace the client's subscription with the binary-coded SubscriptionMessage in the frame; anything else is ignored
+    void receiveSubscription( Client & client, std::string const & frame )
+    {
+        Poco::MemoryInputStream raw_input_stream( frame.data(), frame.size() );
+        atomics::BinaryInputStream binary_reader( raw_input_stream );
+        binary_reader.readBOM();
+
+        // the payload's size comes from the client; never allocate more than the frame actually holds
+        CodedMessage<> coded_message;
+        coded_message.header_.unpack( binary_reader );
+        coded_message.payload_.unpackHeader( binary_reader );
+
+        std::streamsize const bytes_left = raw_input_stream.rdbuf()->in_avail();
+        if( !raw_input_stream || bytes_left < 0 || coded_message.payload_.size_ > static_cast<uint64_t>( bytes_left ) ) throw messages::MessageException( "received malformed subscription" );
+
+        coded_message.payload_.unpackPayload( binary_reader );
+
+        if( coded_message.header_.payload_id_ != SubscriptionMessage::ID() )
+        {
+            std::cout << "ignoring unknown message from client " << client.address_.toString() << std::endl;
+            return;
+        }
+
+        MessageCoder<BinaryCodec<> > binary_coder;
+        auto const subscription = binary_coder.decode<SubscriptionMessage>( coded_message );
+
+        std::map<uint32_t, StreamFilter> filters;
+        for( auto stream_it = subscription.streams_.cbegin(); stream_it != subscription.streams_.cend(); ++stream_it )
+        {
+            // a rate too small to mean anything would overflow the interval
+            double const min_interval = stream_it->max_rate_ > 0 ? std::min( 1e9 / stream_it->max_rate_, static_cast<double>( MAX_STREAM_INTERVAL ) ) : 0;
+
+            StreamFilter filter = { static_cast<uint64_t>( min_interval ), 0 };
+            filters[stream_it->payload_id_] = filter;
+        }
+
+        {
+            _Lock lock( client.mutex_ );
+            client.subscribed_ = true;
+            client.filters_.swap( filters );
+        }
+
+        std::cout << "client " << client.address_.toString() << " subscribed to " << subscription.streams_.size() << " streams" << std::endl;
+
+        notifySubscriptionListener();
+    }
+
+    // ====================================================================================================
+    void notifySubscriptionListener()
+    {
+        std::function<void()> subscription_listener;
+        {
+            _Lock lock( clients_mutex_ );
+            subscription_listener = subscription_listener_;
+        }
+
+        if( subscription_listener ) subscription_listener();
+    }
+
+    // ====================================================================================================
+    void sendBytes( Poco::Net::StreamSocket & socket, char const * bytes, size_t length )
+    {
+        ATOMICS_TRACE_SCOPE( "FanOutTCPDevice::sendBytes" );
+
+        size_t bytes_sent = 0;
+        while( bytes_sent < length )
+        {
+            int send_result = socket.sendBytes( bytes + bytes_sent, static_cast<int>( length - bytes_sent ) );
+            if( send_result < 0 ) throw messages::MessageException( "sendBytes() failed" );
+            else bytes_sent += send_result;
+        }
+    }
+
+    // ====================================================================================================
+    // wakes up both of the client's threads; either may call this
+    void disconnect( Client & client )
+    {
+        {
+            _Lock lock( client.mutex_ );
+            if( !client.connected_.exchange( false ) ) return;
+            client.frames_.clear();
+        }
+        client.frame_available_condition_.notify_all();
+
+        try
+        {
+            client.socket_.shutdown();
+        }
+        catch( std::exception & )
+        {
+            // already gone
+        }
+
+        notifySubscriptionListener();
+    }
+
+    // ====================================================================================================
+    void join( Client & client )
+    {
+        if( client.send_thread_.joinable() ) client.send_thread_.join();
+        if( client.receive_thread_.joinable() ) client.receive_thread_.join();
+        client.socket_.close();
+    }
+
+    // ====================================================================================================
+    // move clients that have hung up to departed_clients, for the caller to join; called with clients_mutex_ held. their threads are
+    // already on their way out
+    void reapClients( std::list<_ClientPtr> & departed_clients )
+    {
+        for( auto client_it = clients_.begin(); client_it != clients_.end(); )
+        {
+            if( ( *client_it )->connected_ )
+            {
+                ++client_it;
+                continue;
+            }
+
+            num_dropped_departed_ += ( *client_it )->num_dropped_;
+            departed_clients.splice( departed_clients.end(), clients_, client_it++ );
+        }
+    }
+};
+
+#endif // _MESSAGES_FANOUTTCPDEVICE_H_
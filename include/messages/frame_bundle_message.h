@@ -0,0 +1,90 @@
+#ifndef _MESSAGES_FRAMEBUNDLEMESSAGE_H_
+#define _MESSAGES_FRAMEBUNDLEMESSAGE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <Poco/MD5Engine.h>
+
+#include <messages/serializable_message.h>
+#include <messages/codec.h>
+
+// ####################################################################################################
+// frames from several streams captured at (nearly) the same time, sent as one message so a client gets a consistent snapshot
+// each frame stays encoded the way its own stream encodes it, so decoding one doesn't mean decoding all of them; a bundle may be missing
+// the frames of streams that didn't produce one in time
+//
+// like every Kinect message, the bundle ends with its stamp (in the sensor's 100 ns ticks: the earliest of its frames' stamps), so
+// peekTimeStamp() works on it too
+class FrameBundleMessage : public SerializableInterface
+{
+public:
+    std::vector<CodedMessage<> > frames_;
+    uint32_t num_expected_;
+    uint64_t stamp_;
+
+    // ====================================================================================================
+    FrameBundleMessage( uint32_t num_expected = 0, uint64_t stamp = 0 )
+    :
+        num_expected_( num_expected ),
+        stamp_( stamp )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void pack( __Archive & archive )
+    {
+        archive << static_cast<uint32_t>( frames_.size() );
+        for( auto frame_it = frames_.begin(); frame_it != frames_.end(); ++frame_it )
+        {
+            frame_it->pack( archive );
+        }
+
+        archive << num_expected_;
+        archive << stamp_;
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        uint32_t num_frames = 0;
+        archive >> num_frames;
+
+        frames_.clear();
+        frames_.resize( num_frames );
+        for( auto frame_it = frames_.begin(); frame_it != frames_.end(); ++frame_it )
+        {
+            frame_it->unpack( archive );
+        }
+
+        archive >> num_expected_;
+        archive >> stamp_;
+    }
+
+    // ====================================================================================================
+    // whether every stream we were bundling contributed a frame
+    bool complete() const
+    {
+        return frames_.size() >= num_expected_;
+    }
+
+    // ====================================================================================================
+    // the frame with the given payload id, or NULL if this bundle doesn't have one
+    CodedMessage<> const * find( uint32_t payload_id ) const
+    {
+        for( auto frame_it = frames_.cbegin(); frame_it != frames_.cend(); ++frame_it )
+        {
+            if( frame_it->header_.payload_id_ == payload_id ) return &*frame_it;
+        }
+
+        return NULL;
+    }
+
+    // ====================================================================================================
+    DECLARE_MESSAGE_INFO( FrameBundleMessage )
+};
+
+#endif // _MESSAGES_FRAMEBUNDLEMESSAGE_H_
@@ -45,11 +45,11 @@ public:
         archive >> pixel_depth_;
         archive >> encoding_;
 
-        std::cout << static_cast<int>( width_ ) << std::endl;
-        std::cout << static_cast<int>( height_ ) << std::endl;
-        std::cout << static_cast<int>( num_channels_ ) << std::endl;
-        std::cout << static_cast<int>( pixel_depth_ ) << std::endl;
-        std::cout << encoding_ << std::endl;
+//        std::cout << static_cast<int>( width_ ) << std::endl;
+//        std::cout << static_cast<int>( height_ ) << std::endl;
+//        std::cout << static_cast<int>( num_channels_ ) << std::endl;
+//        std::cout << static_cast<int>( pixel_depth_ ) << std::endl;
+//        std::cout << encoding_ << std::endl;
     }
 };
 
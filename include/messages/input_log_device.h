@@ -0,0 +1,326 @@
+#ifndef _MESSAGES_INPUTLOGDEVICE_H_
+#define _MESSAGES_INPUTLOGDEVICE_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <atomics/binary_stream.h>
+
+#include <messages/codec.h>
+#include <messages/exceptions.h>
+#include <messages/log_format.h>
+
+// reads back a log of CodedMessages, either one written by OutputLogDevice (see log_format.h) or a legacy one made of packed CodedMessages
+// back to back
+//
+// messages are read in order with pull(). if the log was closed cleanly, its index is loaded as well, and seekToMessage() / seekToTime()
+// jump to the right place in O(log n); otherwise (and for legacy logs) seeking has to read its way there from the start
+class InputLogDevice
+{
+public:
+    typedef std::ifstream _InputStream;
+    typedef atomics::BinaryInputStream _BinaryReader;
+    typedef std::vector<LogIndexEntry> _Index;
+
+protected:
+    std::string input_path_;
+    _InputStream input_stream_;
+    _BinaryReader binary_reader_;
+
+    uint32_t version_;
+    uint32_t sync_interval_;
+    uint32_t index_interval_;
+
+    // offset of the first record
+    uint64_t data_offset_;
+
+    _Index index_;
+    // largest stamp in the index up to and including each entry, so time seeks can binary-search even though stamps from different
+    // streams aren't in order
+    std::vector<uint64_t> index_max_stamps_;
+
+    // number of the next message pull() will return
+    uint64_t message_number_;
+    // we've already read the tag of the record at which the next message starts
+    bool at_message_;
+
+    uint64_t num_messages_;
+    uint64_t num_bytes_;
+
+public:
+    // throws MessageException if the log can't be opened, or has a header from a newer version
+    InputLogDevice( std::string const & input_path )
+    :
+        input_path_( input_path ),
+        input_stream_( input_path, std::ios::in | std::ios::binary ),
+        binary_reader_( input_stream_, _BinaryReader::NETWORK_BYTE_ORDER ),
+        version_( 0 ),
+        sync_interval_( 0 ),
+        index_interval_( 0 ),
+        data_offset_( 0 ),
+        message_number_( 0 ),
+        at_message_( false ),
+        num_messages_( 0 ),
+        num_bytes_( 0 )
+    {
+        if( !input_stream_ ) throw messages::MessageException( "Failed to open log " + input_path );
+
+        readHeader();
+        if( version_ > 0 ) readIndex();
+
+        seekToOffset( data_offset_, 0 );
+    }
+
+    // read the next message into coded_message, which must not already hold a payload; returns false at the end of the log
+    // throws MessageException if the log ends partway through a message (eg: the logger was killed mid-write) or is damaged
+    template<class __Allocator>
+    bool pull( CodedMessage<__Allocator> & coded_message )
+    {
+        if( !skipToMessage() ) return false;
+
+        coded_message.unpack( binary_reader_ );
+        at_message_ = false;
+
+        if( !input_stream_ ) throw messages::MessageException( "Log " + input_path_ + " ends partway through a message" );
+
+        ++message_number_;
+        ++num_messages_;
+        num_bytes_ += coded_message.payload_.size_;
+
+        return true;
+    }
+
+    // position the log so the next pull() returns the given message; returns false if there aren't that many
+    bool seekToMessage( uint64_t message_number )
+    {
+        if( !index_.empty() )
+        {
+            // the last entry at or before the message we want
+            auto entry_it = std::upper_bound( index_.begin(), index_.end(), message_number, []( uint64_t number, LogIndexEntry const & entry ){ return number < entry.message_number_; } );
+            if( entry_it != index_.begin() )
+            {
+                --entry_it;
+                seekToOffset( entry_it->offset_, entry_it->message_number_ );
+            }
+            else seekToOffset( data_offset_, 0 );
+        }
+        else if( message_number < message_number_ )
+        {
+            seekToOffset( data_offset_, 0 );
+        }
+
+        return skipMessages( message_number - message_number_ );
+    }
+
+    // position the log at (or up to one index interval before) the first message stamped at or after the given time
+    // unstamped messages and streams on other clocks can make this land early, never late; returns false if nothing is that late
+    // a CodedMessage's stamp can't be seen without decoding it, so this needs the index; throws MessageException if there isn't one
+    bool seekToTime( uint64_t stamp )
+    {
+        if( index_.empty() ) throw messages::MessageException( "Log " + input_path_ + " has no index to seek by time in" );
+
+        auto const max_stamp_it = std::lower_bound( index_max_stamps_.begin(), index_max_stamps_.end(), stamp );
+        if( max_stamp_it == index_max_stamps_.end() )
+        {
+            // the last indexed entry is as close as the index can get us
+            seekToOffset( index_.back().offset_, index_.back().message_number_ );
+            return skipMessages( 0 );
+        }
+
+        auto const & entry = index_[max_stamp_it - index_max_stamps_.begin()];
+
+        // with a sparse index, the message we want may be anywhere since the previous entry
+        if( max_stamp_it != index_max_stamps_.begin() && index_interval_ > 1 )
+        {
+            auto const & previous_entry = *( index_.begin() + ( max_stamp_it - index_max_stamps_.begin() ) - 1 );
+            seekToOffset( previous_entry.offset_, previous_entry.message_number_ );
+        }
+        else seekToOffset( entry.offset_, entry.message_number_ );
+
+        return skipMessages( 0 );
+    }
+
+    std::string const & inputPath() const
+    {
+        return input_path_;
+    }
+
+    // 0 for legacy logs
+    uint32_t version() const
+    {
+        return version_;
+    }
+
+    // empty for legacy logs and logs that weren't closed cleanly
+    _Index const & index() const
+    {
+        return index_;
+    }
+
+    uint32_t indexInterval() const
+    {
+        return index_interval_;
+    }
+
+    uint32_t syncInterval() const
+    {
+        return sync_interval_;
+    }
+
+    // number of the next message pull() will return
+    uint64_t messageNumber() const
+    {
+        return message_number_;
+    }
+
+    // messages read so far, including any skipped over while seeking
+    uint64_t numMessages() const
+    {
+        return num_messages_;
+    }
+
+    // payload bytes read so far
+    uint64_t numBytes() const
+    {
+        return num_bytes_;
+    }
+
+protected:
+    void readHeader()
+    {
+        uint64_t magic = 0;
+        binary_reader_ >> magic;
+
+        if( !input_stream_ || magic != log_format::FILE_MAGIC )
+        {
+            // no header; a legacy log starts with its first message
+            input_stream_.clear();
+            version_ = 0;
+            data_offset_ = 0;
+            return;
+        }
+
+        binary_reader_ >> version_;
+        binary_reader_ >> sync_interval_;
+        binary_reader_ >> index_interval_;
+
+        if( !input_stream_ ) throw messages::MessageException( "Log " + input_path_ + " has a truncated header" );
+        if( version_ > log_format::VERSION ) throw messages::MessageException( "Log " + input_path_ + " is from a newer version (" + std::to_string( version_ ) + ")" );
+
+        data_offset_ = log_format::HEADER_SIZE;
+    }
+
+    // load the index, if the log was closed cleanly
+    void readIndex()
+    {
+        input_stream_.seekg( 0, std::ios::end );
+        uint64_t const file_size = static_cast<uint64_t>( input_stream_.tellg() );
+        if( file_size < data_offset_ + log_format::TRAILER_SIZE ) return;
+
+        uint64_t index_offset = 0;
+        uint64_t trailer_magic = 0;
+
+        input_stream_.seekg( file_size - log_format::TRAILER_SIZE );
+        binary_reader_ >> index_offset;
+        binary_reader_ >> trailer_magic;
+
+        if( !input_stream_ || trailer_magic != log_format::TRAILER_MAGIC || index_offset < data_offset_ || index_offset >= file_size )
+        {
+            input_stream_.clear();
+            return;
+        }
+
+        input_stream_.seekg( index_offset );
+
+        uint8_t tag = 0;
+        uint64_t num_entries = 0;
+        binary_reader_ >> tag;
+        binary_reader_ >> num_entries;
+
+        if( !input_stream_ || tag != log_format::RECORD_INDEX ) throw messages::MessageException( "Log " + input_path_ + " has a damaged index" );
+
+        // more entries than there's room for in the file means the count itself is damaged; don't try to allocate it
+        if( file_size - index_offset < log_format::INDEX_HEADER_SIZE || num_entries > ( file_size - index_offset - log_format::INDEX_HEADER_SIZE ) / log_format::INDEX_ENTRY_SIZE )
+        {
+            throw messages::MessageException( "Log " + input_path_ + " has a damaged index" );
+        }
+
+        index_.resize( static_cast<size_t>( num_entries ) );
+        index_max_stamps_.resize( static_cast<size_t>( num_entries ) );
+
+        uint64_t max_stamp = 0;
+        for( size_t entry_idx = 0; entry_idx < num_entries; ++entry_idx )
+        {
+            index_[entry_idx].unpack( binary_reader_ );
+            max_stamp = std::max( max_stamp, index_[entry_idx].stamp_ );
+            index_max_stamps_[entry_idx] = max_stamp;
+
+            // seekToMessage() searches the index by message number
+            if( entry_idx > 0 && index_[entry_idx].message_number_ <= index_[entry_idx - 1].message_number_ )
+            {
+                throw messages::MessageException( "Log " + input_path_ + " has a damaged index" );
+            }
+        }
+
+        if( !input_stream_ ) throw messages::MessageException( "Log " + input_path_ + " has a damaged index" );
+    }
+
+    void seekToOffset( uint64_t offset, uint64_t message_number )
+    {
+        input_stream_.clear();
+        input_stream_.seekg( offset );
+        message_number_ = message_number;
+        at_message_ = false;
+    }
+
+    // step over anything that isn't a message; returns false at the end of the log
+    bool skipToMessage()
+    {
+        while( !at_message_ )
+        {
+            if( input_stream_.peek() == _InputStream::traits_type::eof() ) return false;
+
+            // legacy logs are nothing but messages
+            if( version_ == 0 ) break;
+
+            uint8_t tag = 0;
+            binary_reader_ >> tag;
+
+            if( tag == log_format::RECORD_MESSAGE ) break;
+            if( tag == log_format::RECORD_INDEX ) return false;
+
+            if( tag == log_format::RECORD_SYNC )
+            {
+                uint64_t magic = 0;
+                uint64_t message_number = 0;
+                binary_reader_ >> magic;
+                binary_reader_ >> message_number;
+
+                if( !input_stream_ ) return false;
+                if( magic == log_format::SYNC_MAGIC && message_number == message_number_ ) continue;
+            }
+
+            throw messages::MessageException( "Log " + input_path_ + " is damaged near message " + std::to_string( message_number_ ) );
+        }
+
+        at_message_ = true;
+        return true;
+    }
+
+    // read past the given number of messages without keeping them; returns false if the log ends first
+    bool skipMessages( uint64_t count )
+    {
+        for( uint64_t i = 0; i < count; ++i )
+        {
+            CodedMessage<> coded_message;
+            if( !pull( coded_message ) ) return false;
+        }
+
+        // make sure there's a message to return next
+        return skipToMessage();
+    }
+};
+
+#endif // _MESSAGES_INPUTLOGDEVICE_H_
@@ -13,6 +13,8 @@
 #include <messages/container_messages.h>
 #include <messages/binary_message.h>
 #include <messages/exceptions.h>
+#include <messages/message_coder.h>
+#include <messages/binary_codec.h>
 
 #define INPUTTCPDEVICE_PROTOCOL_BUFSIZE 1024
 
@@ -225,6 +227,28 @@ public:
         serializable.unpack( binary_reader );
     }
 
+    // send a message back up the connection, framed just like the ones we pull; servers that read what their clients send (see
+    // FanOutTCPDevice) take a binary-coded SubscriptionMessage this way
+    template<class __Serializable>
+    void push( __Serializable & serializable )
+    {
+        if( !input_socket_.impl()->initialized() ) throw messages::MessageException( "Failed to serialize message; TCPInputDevice not initialized" );
+
+        MessageCoder<BinaryCodec<> > binary_coder;
+
+        auto binary_coded_message = binary_coder.encode( serializable );
+
+        uint32_t message_size = binary_coded_message.payload_.size_;
+        char protocol_message[6];
+        protocol_message[0] = '<';
+        protocol_message[5] = '>';
+
+        *reinterpret_cast<decltype(message_size)*>( protocol_message + 1 ) = message_size;
+
+        sendBytes( input_socket_, protocol_message, 6 );
+        sendBytes( input_socket_, binary_coded_message.payload_.data_, message_size );
+    }
+
     uint32_t decodeMessageSize( char * protocol_message )
     {
         return *reinterpret_cast<uint32_t *>( protocol_message + 1 );
@@ -247,6 +271,18 @@ public:
         }
     }
 
+    template<class __Socket>
+    void sendBytes( __Socket & socket, char const * bytes, uint32_t length )
+    {
+        uint32_t bytes_sent = 0;
+        while( bytes_sent < length )
+        {
+            int send_result = socket.sendBytes( bytes + bytes_sent, length - bytes_sent );
+            if( send_result < 0 ) throw messages::MessageException( "sendBytes() failed" );
+            else bytes_sent += send_result;
+        }
+    }
+
     template<class __Serializable>
     __Serializable pullAs()
     {
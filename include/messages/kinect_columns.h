@@ -0,0 +1,230 @@
+#ifndef _MESSAGES_KINECTCOLUMNS_H_
+#define _MESSAGES_KINECTCOLUMNS_H_
+
+#include <string>
+#include <vector>
+#include <limits>
+
+#include <Poco/MemoryStream.h>
+
+#include <atomics/binary_stream.h>
+
+#include <messages/kinect_messages.h>
+#include <messages/column_file.h>
+#include <messages/codec.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+
+// column files (see column_file.h) for the small messages the sensor sends many times a second, so a whole session's skeletons or beam
+// angles can be scanned as arrays instead of decoding a message per frame
+
+// ####################################################################################################
+// one row per body per KinectBodiesMessage, in the order they were added:
+//
+//   stamp (uint64), frame (uint32: which bodies message, counting from 0), body (uint8: the body's slot in its message), tracking_id
+//   (uint64), is_tracked, hand_state_left, hand_state_right (uint8)
+//
+// and for each joint, named as in KinectJointMessage::getJointNamesMap():
+//
+//   position.<joint> (3 x float32: x, y, z), orientation.<joint> (4 x float32: x, y, z, w), tracking_state.<joint> (uint8)
+//
+// bodies that aren't tracked have no joints; theirs read NaN and NOT_TRACKED
+class KinectBodyColumns
+{
+public:
+    typedef KinectJointMessage::JointType _JointType;
+
+    static size_t const NUM_JOINTS = static_cast<size_t>( _JointType::THUMB_RIGHT ) + 1;
+
+    static std::string positionColumn( _JointType joint_type )
+    {
+        return "position." + KinectJointMessage::getJointNamesMap().find( joint_type )->second;
+    }
+
+    static std::string orientationColumn( _JointType joint_type )
+    {
+        return "orientation." + KinectJointMessage::getJointNamesMap().find( joint_type )->second;
+    }
+
+    static std::string trackingStateColumn( _JointType joint_type )
+    {
+        return "tracking_state." + KinectJointMessage::getJointNamesMap().find( joint_type )->second;
+    }
+
+protected:
+    ColumnFileWriter writer_;
+
+    std::vector<uint64_t> & stamps_;
+    std::vector<uint32_t> & frames_;
+    std::vector<uint8_t> & body_indices_;
+    std::vector<uint64_t> & tracking_ids_;
+    std::vector<uint8_t> & is_tracked_;
+    std::vector<uint8_t> & hand_states_left_;
+    std::vector<uint8_t> & hand_states_right_;
+
+    std::vector<std::vector<float> *> positions_;
+    std::vector<std::vector<float> *> orientations_;
+    std::vector<std::vector<uint8_t> *> tracking_states_;
+
+    uint32_t num_frames_;
+
+public:
+    KinectBodyColumns()
+    :
+        stamps_( writer_.addColumn<uint64_t>( "stamp" ) ),
+        frames_( writer_.addColumn<uint32_t>( "frame" ) ),
+        body_indices_( writer_.addColumn<uint8_t>( "body" ) ),
+        tracking_ids_( writer_.addColumn<uint64_t>( "tracking_id" ) ),
+        is_tracked_( writer_.addColumn<uint8_t>( "is_tracked" ) ),
+        hand_states_left_( writer_.addColumn<uint8_t>( "hand_state_left" ) ),
+        hand_states_right_( writer_.addColumn<uint8_t>( "hand_state_right" ) ),
+        num_frames_( 0 )
+    {
+        for( size_t joint_idx = 0; joint_idx < NUM_JOINTS; ++joint_idx )
+        {
+            positions_.push_back( &writer_.addColumn<float>( positionColumn( static_cast<_JointType>( joint_idx ) ), 3 ) );
+            orientations_.push_back( &writer_.addColumn<float>( orientationColumn( static_cast<_JointType>( joint_idx ) ), 4 ) );
+            tracking_states_.push_back( &writer_.addColumn<uint8_t>( trackingStateColumn( static_cast<_JointType>( joint_idx ) ) ) );
+        }
+    }
+
+    // add a row for each of the message's bodies
+    void append( KinectBodiesMessage const & bodies_message )
+    {
+        float const nan = std::numeric_limits<float>::quiet_NaN();
+        auto const & bodies = bodies_message.payload_;
+
+        for( size_t body_idx = 0; body_idx < bodies.size(); ++body_idx )
+        {
+            auto const & body = bodies[body_idx];
+
+            stamps_.push_back( bodies_message.stamp_ );
+            frames_.push_back( num_frames_ );
+            body_indices_.push_back( static_cast<uint8_t>( body_idx ) );
+            tracking_ids_.push_back( body.tracking_id_ );
+            is_tracked_.push_back( body.is_tracked_ );
+            hand_states_left_.push_back( static_cast<uint8_t>( body.hand_state_left_ ) );
+            hand_states_right_.push_back( static_cast<uint8_t>( body.hand_state_right_ ) );
+
+            // every joint gets a value, whether or not the body had it
+            for( size_t joint_idx = 0; joint_idx < NUM_JOINTS; ++joint_idx )
+            {
+                positions_[joint_idx]->insert( positions_[joint_idx]->end(), 3, nan );
+                orientations_[joint_idx]->insert( orientations_[joint_idx]->end(), 4, nan );
+                tracking_states_[joint_idx]->push_back( static_cast<uint8_t>( KinectJointMessage::TrackingState::NOT_TRACKED ) );
+            }
+
+            for( auto joint_it = body.joints_.begin(); joint_it != body.joints_.end(); ++joint_it )
+            {
+                size_t const joint_idx = static_cast<size_t>( joint_it->joint_type_ );
+                if( joint_idx >= NUM_JOINTS ) continue;
+
+                float * position = &positions_[joint_idx]->back() - 2;
+                position[0] = joint_it->position_.x;
+                position[1] = joint_it->position_.y;
+                position[2] = joint_it->position_.z;
+
+                float * orientation = &orientations_[joint_idx]->back() - 3;
+                orientation[0] = joint_it->orientation_.x;
+                orientation[1] = joint_it->orientation_.y;
+                orientation[2] = joint_it->orientation_.z;
+                orientation[3] = joint_it->orientation_.w;
+
+                tracking_states_[joint_idx]->back() = static_cast<uint8_t>( joint_it->tracking_state_ );
+            }
+        }
+
+        ++num_frames_;
+    }
+
+    uint64_t numRows() const
+    {
+        return writer_.numRows();
+    }
+
+    uint32_t numFrames() const
+    {
+        return num_frames_;
+    }
+
+    // throws MessageException if the file can't be written
+    void write( std::string const & output_path ) const
+    {
+        writer_.write( output_path );
+    }
+};
+
+// ####################################################################################################
+// one row per KinectAudioMessage: stamp (uint64), beam_angle, beam_angle_confidence (float32)
+class KinectAudioInfoColumns
+{
+protected:
+    ColumnFileWriter writer_;
+
+    std::vector<uint64_t> & stamps_;
+    std::vector<float> & beam_angles_;
+    std::vector<float> & beam_angle_confidences_;
+
+public:
+    KinectAudioInfoColumns()
+    :
+        stamps_( writer_.addColumn<uint64_t>( "stamp" ) ),
+        beam_angles_( writer_.addColumn<float>( "beam_angle" ) ),
+        beam_angle_confidences_( writer_.addColumn<float>( "beam_angle_confidence" ) )
+    {
+        //
+    }
+
+    void append( KinectAudioInfoMessage const & audio_info, uint64_t stamp )
+    {
+        stamps_.push_back( stamp );
+        beam_angles_.push_back( audio_info.beam_angle_ );
+        beam_angle_confidences_.push_back( audio_info.beam_angle_confidence_ );
+    }
+
+    uint64_t numRows() const
+    {
+        return writer_.numRows();
+    }
+
+    // throws MessageException if the file can't be written
+    void write( std::string const & output_path ) const
+    {
+        writer_.write( output_path );
+    }
+};
+
+// ####################################################################################################
+// a KinectAudioMessage ends with its KinectAudioInfoMessage and TimeStampMessage, so, as with peekTimeStamp(), both can be had without
+// unpacking the audio. returns false if the message is too short or uses a codec we don't know
+template<class __Allocator>
+bool peekAudioInfo( CodedMessage<__Allocator> const & coded_message, KinectAudioInfoMessage & audio_info, uint64_t & stamp )
+{
+    // beam angle, beam angle confidence, stamp
+    size_t const tail_size = 2 * sizeof( float ) + sizeof( uint64_t );
+
+    BinaryMessage<__Allocator> decoded_message;
+    BinaryMessage<__Allocator> const * decoded_message_ptr = &coded_message.payload_;
+
+    if( coded_message.header_.encoding_ == GZipCodec<__Allocator>::ID() )
+    {
+        decoded_message = GZipCodec<__Allocator>().decode( coded_message );
+        decoded_message_ptr = &decoded_message;
+    }
+    else if( coded_message.header_.encoding_ != BinaryCodec<__Allocator>::ID() )
+    {
+        return false;
+    }
+
+    if( decoded_message_ptr->size_ < tail_size ) return false;
+
+    Poco::MemoryInputStream tail_stream( decoded_message_ptr->data_ + decoded_message_ptr->size_ - tail_size, tail_size );
+    atomics::BinaryInputStream binary_reader( tail_stream, atomics::BinaryInputStream::NETWORK_BYTE_ORDER );
+
+    audio_info.unpack( binary_reader );
+    binary_reader >> stamp;
+
+    return true;
+}
+
+#endif // _MESSAGES_KINECTCOLUMNS_H_
@@ -317,6 +317,55 @@ public:
         //
     }
 
+    // ====================================================================================================
+    // joints_ has to refer to our own payload, never to the one we were copied or moved from
+    KinectBodyMessage( KinectBodyMessage const & other )
+    :
+        _Message( static_cast<_Message const &>( other ) ),
+        joints_( this->payload_ ),
+        is_tracked_( other.is_tracked_ ),
+        hand_state_left_( other.hand_state_left_ ),
+        hand_state_right_( other.hand_state_right_ ),
+        tracking_id_( other.tracking_id_ )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    KinectBodyMessage( KinectBodyMessage && other )
+    :
+        _Message( static_cast<_Message &&>( other ) ),
+        joints_( this->payload_ ),
+        is_tracked_( other.is_tracked_ ),
+        hand_state_left_( other.hand_state_left_ ),
+        hand_state_right_( other.hand_state_right_ ),
+        tracking_id_( other.tracking_id_ )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    KinectBodyMessage & operator=( KinectBodyMessage const & other )
+    {
+        _Message::operator=( static_cast<_Message const &>( other ) );
+        is_tracked_ = other.is_tracked_;
+        hand_state_left_ = other.hand_state_left_;
+        hand_state_right_ = other.hand_state_right_;
+        tracking_id_ = other.tracking_id_;
+        return *this;
+    }
+
+    // ====================================================================================================
+    KinectBodyMessage & operator=( KinectBodyMessage && other )
+    {
+        _Message::operator=( static_cast<_Message &&>( other ) );
+        is_tracked_ = other.is_tracked_;
+        hand_state_left_ = other.hand_state_left_;
+        hand_state_right_ = other.hand_state_right_;
+        tracking_id_ = other.tracking_id_;
+        return *this;
+    }
+
     // ====================================================================================================
     template<class __Archive>
     void pack( __Archive & archive )
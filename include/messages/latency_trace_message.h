@@ -0,0 +1,232 @@
+#ifndef _MESSAGES_LATENCYTRACEMESSAGE_H_
+#define _MESSAGES_LATENCYTRACEMESSAGE_H_
+
+#include <map>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+
+#include <Poco/MD5Engine.h>
+
+#include <atomics/histogram.h>
+
+#include <messages/serializable_message.h>
+
+// when a message reached each stage on its way from the sensor to a client, in nanoseconds on a monotonic clock (0 if it never did)
+//
+// the server's stamps and the client's come from their own machines' clocks, so the time between SEND and RECEIVE (and anything spanning
+// it) only means something when both run on the same machine
+class LatencyTraceMessage : public SerializableInterface
+{
+public:
+    enum class Stage
+    {
+        // read from the sensor (or, when replaying, released by the replay clock)
+        CAPTURE = 0,
+        // taken off its read fifo by a compression worker
+        DEQUEUE = 1,
+        ENCODE_START = 2,
+        ENCODE_END = 3,
+        // handed to the socket
+        SEND = 4,
+        // whole message received by the client
+        RECEIVE = 5,
+        // decoded by the client
+        DECODE_END = 6,
+        NUM_STAGES = 7
+    };
+
+    static size_t const NUM_STAGES = static_cast<size_t>( Stage::NUM_STAGES );
+
+    typedef std::chrono::steady_clock _Clock;
+
+    uint64_t stamps_[NUM_STAGES];
+
+    // ====================================================================================================
+    LatencyTraceMessage()
+    {
+        for( size_t stage_idx = 0; stage_idx < NUM_STAGES; ++stage_idx )
+        {
+            stamps_[stage_idx] = 0;
+        }
+    }
+
+    // ====================================================================================================
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now().time_since_epoch() ).count() );
+    }
+
+    // ====================================================================================================
+    void mark( Stage stage )
+    {
+        stamps_[static_cast<size_t>( stage )] = now();
+    }
+
+    // ====================================================================================================
+    uint64_t stamp( Stage stage ) const
+    {
+        return stamps_[static_cast<size_t>( stage )];
+    }
+
+    // ====================================================================================================
+    bool has( Stage stage ) const
+    {
+        return stamp( stage ) != 0;
+    }
+
+    // ====================================================================================================
+    // nanoseconds from one stage to another, or -1 if either is missing or they're out of order
+    int64_t elapsed( Stage from, Stage to ) const
+    {
+        if( !has( from ) || !has( to ) || stamp( to ) < stamp( from ) ) return -1;
+        return static_cast<int64_t>( stamp( to ) - stamp( from ) );
+    }
+
+    // ====================================================================================================
+    static std::string const & stageName( Stage stage )
+    {
+        static std::string const names[NUM_STAGES + 1] = { "capture", "dequeue", "encode_start", "encode_end", "send", "receive", "decode_end", "unknown" };
+        return names[static_cast<size_t>( stage ) < NUM_STAGES ? static_cast<size_t>( stage ) : NUM_STAGES];
+    }
+
+    // ====================================================================================================
+    // the number of stages first, so a reader with fewer stages than the writer can skip the rest and one with more leaves them at 0
+    template<class __Archive>
+    void pack( __Archive & archive ) const
+    {
+        archive << static_cast<uint8_t>( NUM_STAGES );
+        for( size_t stage_idx = 0; stage_idx < NUM_STAGES; ++stage_idx )
+        {
+            archive << stamps_[stage_idx];
+        }
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        uint8_t num_stages = 0;
+        archive >> num_stages;
+
+        for( size_t stage_idx = 0; stage_idx < num_stages; ++stage_idx )
+        {
+            uint64_t stamp = 0;
+            archive >> stamp;
+            if( stage_idx < NUM_STAGES ) stamps_[stage_idx] = stamp;
+        }
+    }
+
+    // ====================================================================================================
+    DECLARE_MESSAGE_INFO( LatencyTraceMessage )
+};
+
+// ####################################################################################################
+// latency histograms per stream (payload id) and per step between consecutive stages, plus end to end, in microseconds
+class LatencyTraceStats
+{
+public:
+    typedef LatencyTraceMessage::Stage _Stage;
+
+    // the steps we keep histograms for: each stage to the next, then capture to send (the whole server) and capture to decode end (end to end)
+    struct Step
+    {
+        _Stage from_;
+        _Stage to_;
+    };
+
+    static size_t const NUM_STEPS = ( LatencyTraceMessage::NUM_STAGES - 1 ) + 2;
+
+    static Step const & step( size_t step_idx )
+    {
+        static Step const steps[NUM_STEPS] =
+        {
+            { _Stage::CAPTURE, _Stage::DEQUEUE },
+            { _Stage::DEQUEUE, _Stage::ENCODE_START },
+            { _Stage::ENCODE_START, _Stage::ENCODE_END },
+            { _Stage::ENCODE_END, _Stage::SEND },
+            { _Stage::SEND, _Stage::RECEIVE },
+            { _Stage::RECEIVE, _Stage::DECODE_END },
+            { _Stage::CAPTURE, _Stage::SEND },
+            { _Stage::CAPTURE, _Stage::DECODE_END }
+        };
+        return steps[step_idx];
+    }
+
+    // whether a step compares stamps taken on two different machines' clocks
+    static bool crossesMachines( size_t step_idx )
+    {
+        bool const from_server = step( step_idx ).from_ < _Stage::RECEIVE;
+        bool const to_server = step( step_idx ).to_ < _Stage::RECEIVE;
+        return from_server != to_server;
+    }
+
+protected:
+    struct StreamStats
+    {
+        atomics::Histogram histograms_[NUM_STEPS];
+    };
+
+    // the server and client share a clock, so steps across the network mean something
+    bool same_machine_;
+    std::map<uint32_t, std::unique_ptr<StreamStats> > streams_;
+
+public:
+    LatencyTraceStats( bool same_machine = true )
+    :
+        same_machine_( same_machine )
+    {
+        //
+    }
+
+    // not thread-safe: a stream's histograms are created on its first trace
+    void record( uint32_t payload_id, LatencyTraceMessage const & trace )
+    {
+        std::unique_ptr<StreamStats> & stream_stats_ptr = streams_[payload_id];
+        if( !stream_stats_ptr ) stream_stats_ptr.reset( new StreamStats() );
+
+        for( size_t step_idx = 0; step_idx < NUM_STEPS; ++step_idx )
+        {
+            if( !same_machine_ && crossesMachines( step_idx ) ) continue;
+
+            int64_t const elapsed = trace.elapsed( step( step_idx ).from_, step( step_idx ).to_ );
+            if( elapsed >= 0 ) stream_stats_ptr->histograms_[step_idx].record( static_cast<uint64_t>( elapsed / 1000 ) );
+        }
+    }
+
+    bool empty() const
+    {
+        return streams_.empty();
+    }
+
+    // one line per stream and step: "<stream> <from> -> <to> (us): count: ... p50: ... p99: ... p999: ..."; stream_names maps payload ids to
+    // names, and streams that aren't in it are shown by id
+    void print( std::ostream & out, std::map<uint32_t, std::string> const & stream_names = std::map<uint32_t, std::string>() ) const
+    {
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            auto const stream_name_it = stream_names.find( stream_it->first );
+            std::string const stream_name = stream_name_it == stream_names.end() ? std::to_string( stream_it->first ) : stream_name_it->second;
+
+            for( size_t step_idx = 0; step_idx < NUM_STEPS; ++step_idx )
+            {
+                atomics::Histogram const & histogram = stream_it->second->histograms_[step_idx];
+                if( histogram.count() == 0 ) continue;
+
+                out << std::setw( 10 ) << std::left << stream_name << " " << std::setw( 34 ) << LatencyTraceMessage::stageName( step( step_idx ).from_ ) + " -> " + LatencyTraceMessage::stageName( step( step_idx ).to_ ) + " (us):" << std::right << " ";
+                histogram.print( out );
+                out << std::endl;
+            }
+        }
+    }
+
+    void reset()
+    {
+        streams_.clear();
+    }
+};
+
+#endif // _MESSAGES_LATENCYTRACEMESSAGE_H_
@@ -0,0 +1,89 @@
+#ifndef _MESSAGES_LOGFORMAT_H_
+#define _MESSAGES_LOGFORMAT_H_
+
+#include <cstdint>
+
+// layout of the message logs written by OutputLogDevice and read by InputLogDevice; every integer is in network byte order
+//
+// version 1:
+//   header:   FILE_MAGIC (u64), version (u32), sync interval (u32), index interval (u32)
+//   records:  a one-byte tag followed by the record
+//     RECORD_MESSAGE   a packed CodedMessage
+//     RECORD_SYNC      SYNC_MAGIC (u64), number of the message that follows (u64); written every <sync interval> messages so a reader
+//                      can find its footing again in a damaged log by scanning for SYNC_MAGIC
+//     RECORD_INDEX     entry count (u64), then that many LogIndexEntry; only ever written once, as the last record
+//   trailer:  offset of the RECORD_INDEX tag (u64), TRAILER_MAGIC (u64); only present if the log was closed cleanly
+//
+// the index has an entry for every <index interval>th message, starting with the first
+//
+// legacy logs (version 0) are packed CodedMessages back to back, with no header, sync markers, or index
+namespace log_format
+{
+
+static uint64_t const FILE_MAGIC = 0x4B423250414B0D0AULL;    // "KB2PAK\r\n"
+static uint64_t const SYNC_MAGIC = 0x4B423253594E4321ULL;    // "KB2SYNC!"
+static uint64_t const TRAILER_MAGIC = 0x4B4232494E445821ULL; // "KB2INDX!"
+
+static uint32_t const VERSION = 1;
+
+static uint8_t const RECORD_MESSAGE = 'M';
+static uint8_t const RECORD_SYNC = 'S';
+static uint8_t const RECORD_INDEX = 'X';
+
+// bytes taken by the header and the trailer
+static uint32_t const HEADER_SIZE = 8 + 4 + 4 + 4;
+static uint32_t const TRAILER_SIZE = 8 + 8;
+// bytes taken by the index record's tag and entry count, and by each packed LogIndexEntry after them
+static uint32_t const INDEX_HEADER_SIZE = 1 + 8;
+static uint32_t const INDEX_ENTRY_SIZE = 8 + 8 + 4 + 8 + 4;
+
+} // log_format
+
+// ####################################################################################################
+// where to find one message in a log
+struct LogIndexEntry
+{
+    // position of the message in the log, counting from 0
+    uint64_t message_number_;
+    // file offset of the message's record tag
+    uint64_t offset_;
+    // the CodedMessage's payload id, ie: the ID() of the message it encodes
+    uint32_t payload_id_;
+    // the message's own time stamp, 0 if it doesn't have one
+    uint64_t stamp_;
+    // encoded payload size
+    uint32_t size_;
+
+    LogIndexEntry( uint64_t message_number = 0, uint64_t offset = 0, uint32_t payload_id = 0, uint64_t stamp = 0, uint32_t size = 0 )
+    :
+        message_number_( message_number ),
+        offset_( offset ),
+        payload_id_( payload_id ),
+        stamp_( stamp ),
+        size_( size )
+    {
+        //
+    }
+
+    template<class __Archive>
+    void pack( __Archive & archive ) const
+    {
+        archive << message_number_;
+        archive << offset_;
+        archive << payload_id_;
+        archive << stamp_;
+        archive << size_;
+    }
+
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        archive >> message_number_;
+        archive >> offset_;
+        archive >> payload_id_;
+        archive >> stamp_;
+        archive >> size_;
+    }
+};
+
+#endif // _MESSAGES_LOGFORMAT_H_
@@ -0,0 +1,272 @@
+#ifndef _MESSAGES_LOGRECOVERY_H_
+#define _MESSAGES_LOGRECOVERY_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <Poco/File.h>
+#include <Poco/Exception.h>
+
+#include <atomics/binary_stream.h>
+
+#include <messages/codec.h>
+#include <messages/exceptions.h>
+#include <messages/log_format.h>
+#include <messages/peek_time_stamp.h>
+
+// repairs a log (see log_format.h) that was never closed, eg: because the logger crashed or lost power
+//
+// everything after the last whole message (a torn record, or a half-written index) is cut off, leaving a log InputLogDevice reads to the end
+// without complaint. finding that point only means reading from the last sync marker on, so it's quick however large the log is; giving
+// the log its index back as well means walking every record header, but not reading the messages themselves
+struct LogRecovery
+{
+    typedef std::ifstream _InputStream;
+    typedef atomics::BinaryInputStream _BinaryReader;
+    typedef atomics::BinaryOutputStream _BinaryWriter;
+
+    // how far back from the end to look for a sync marker before giving up and starting from the header
+    static uint64_t const MAX_SYNC_SEARCH = 256ULL * 1024 * 1024;
+
+    // the log already had its trailer, and was left alone
+    bool was_closed_;
+    // whole messages in the log
+    uint64_t num_messages_;
+    uint64_t original_size_;
+    uint64_t recovered_size_;
+    // an index and trailer were written
+    bool indexed_;
+
+    LogRecovery()
+    :
+        was_closed_( false ),
+        num_messages_( 0 ),
+        original_size_( 0 ),
+        recovered_size_( 0 ),
+        indexed_( false )
+    {
+        //
+    }
+
+    // bytes cut off the end
+    uint64_t truncatedSize() const
+    {
+        return original_size_ > recovered_size_ ? original_size_ - recovered_size_ : 0;
+    }
+
+    // repair the log at path in place; throws MessageException if it isn't a version 1 log or can't be written
+    // legacy logs have no sync markers to recover from; pak_reindex copies whatever can be read of them into a new log instead
+    static LogRecovery recover( std::string const & path, bool rebuild_index = true )
+    {
+        LogRecovery recovery;
+        std::vector<LogIndexEntry> index;
+        uint32_t index_interval = 1;
+
+        {
+            _InputStream input_stream( path, std::ios::in | std::ios::binary );
+            _BinaryReader binary_reader( input_stream, _BinaryReader::NETWORK_BYTE_ORDER );
+            if( !input_stream ) throw messages::MessageException( "Failed to open log " + path );
+
+            input_stream.seekg( 0, std::ios::end );
+            recovery.original_size_ = static_cast<uint64_t>( input_stream.tellg() );
+            input_stream.seekg( 0 );
+
+            uint64_t magic = 0;
+            uint32_t version = 0;
+            uint32_t sync_interval = 0;
+            binary_reader >> magic >> version >> sync_interval >> index_interval;
+
+            if( !input_stream || magic != log_format::FILE_MAGIC || version != log_format::VERSION ) throw messages::MessageException( "Log " + path + " isn't a version " + std::to_string( log_format::VERSION ) + " log; it can only be recovered with pak_reindex" );
+            if( index_interval == 0 ) index_interval = 1;
+
+            if( hasTrailer( input_stream, binary_reader, recovery.original_size_ ) )
+            {
+                recovery.was_closed_ = true;
+                recovery.recovered_size_ = recovery.original_size_;
+                return recovery;
+            }
+
+            // without the index to rebuild, we only need to know where the messages stop, and the last sync marker gets us close
+            uint64_t offset = log_format::HEADER_SIZE;
+            uint64_t message_number = 0;
+            if( !rebuild_index ) findLastSync( input_stream, binary_reader, recovery.original_size_, offset, message_number );
+
+            recovery.recovered_size_ = walk( input_stream, binary_reader, recovery.original_size_, offset, message_number, index_interval, rebuild_index ? &index : NULL );
+            recovery.num_messages_ = message_number;
+        }
+
+        try
+        {
+            Poco::File( path ).setSize( recovery.recovered_size_ );
+        }
+        catch( Poco::Exception & e )
+        {
+            throw messages::MessageException( "Failed to truncate log " + path + ": " + e.displayText() );
+        }
+
+        if( rebuild_index )
+        {
+            std::ofstream output_stream( path, std::ios::in | std::ios::out | std::ios::binary );
+            _BinaryWriter binary_writer( output_stream, _BinaryWriter::NETWORK_BYTE_ORDER );
+            output_stream.seekp( static_cast<std::streamoff>( recovery.recovered_size_ ) );
+
+            binary_writer << log_format::RECORD_INDEX;
+            binary_writer << static_cast<uint64_t>( index.size() );
+            for( auto entry_it = index.begin(); entry_it != index.end(); ++entry_it )
+            {
+                entry_it->pack( binary_writer );
+            }
+
+            binary_writer << recovery.recovered_size_;
+            binary_writer << log_format::TRAILER_MAGIC;
+            binary_writer.flush();
+            output_stream.close();
+
+            if( !output_stream ) throw messages::MessageException( "Failed to write the index of log " + path );
+            recovery.indexed_ = true;
+        }
+
+        return recovery;
+    }
+
+protected:
+    static bool hasTrailer( _InputStream & input_stream, _BinaryReader & binary_reader, uint64_t file_size )
+    {
+        if( file_size < log_format::HEADER_SIZE + log_format::TRAILER_SIZE ) return false;
+
+        uint64_t index_offset = 0;
+        uint64_t trailer_magic = 0;
+        input_stream.seekg( static_cast<std::streamoff>( file_size - log_format::TRAILER_SIZE ) );
+        binary_reader >> index_offset >> trailer_magic;
+
+        bool const has_trailer = input_stream && trailer_magic == log_format::TRAILER_MAGIC && index_offset >= log_format::HEADER_SIZE && index_offset < file_size;
+        input_stream.clear();
+        return has_trailer;
+    }
+
+    // search backwards from the end for the last sync record; leaves offset and message_number alone if there isn't one close enough
+    static void findLastSync( _InputStream & input_stream, _BinaryReader & binary_reader, uint64_t file_size, uint64_t & offset, uint64_t & message_number )
+    {
+        // the tag and magic, as they appear in the file
+        char pattern[9];
+        pattern[0] = static_cast<char>( log_format::RECORD_SYNC );
+        for( size_t i = 0; i < 8; ++i )
+        {
+            pattern[1 + i] = static_cast<char>( ( log_format::SYNC_MAGIC >> ( 8 * ( 7 - i ) ) ) & 0xFF );
+        }
+
+        size_t const chunk_size = 1024 * 1024;
+        std::vector<char> chunk( chunk_size + sizeof( pattern ) );
+
+        uint64_t const search_begin = std::max<uint64_t>( log_format::HEADER_SIZE, file_size > MAX_SYNC_SEARCH ? file_size - MAX_SYNC_SEARCH : 0 );
+        uint64_t chunk_end = file_size;
+
+        while( chunk_end > search_begin )
+        {
+            uint64_t const chunk_begin = std::max<uint64_t>( search_begin, chunk_end > chunk_size ? chunk_end - chunk_size : 0 );
+            // overlap the next chunk by a pattern's length so a marker straddling the two isn't missed
+            size_t const read_size = static_cast<size_t>( std::min<uint64_t>( file_size, chunk_end + sizeof( pattern ) ) - chunk_begin );
+
+            input_stream.seekg( static_cast<std::streamoff>( chunk_begin ) );
+            input_stream.read( &chunk[0], static_cast<std::streamsize>( read_size ) );
+            input_stream.clear();
+
+            for( size_t position = read_size >= sizeof( pattern ) ? read_size - sizeof( pattern ) + 1 : 0; position-- > 0; )
+            {
+                if( !std::equal( pattern, pattern + sizeof( pattern ), chunk.begin() + position ) ) continue;
+
+                uint64_t const sync_offset = chunk_begin + position;
+                if( sync_offset + 1 + 2 * sizeof( uint64_t ) > file_size ) continue;
+
+                uint64_t magic = 0;
+                uint64_t sync_message_number = 0;
+                input_stream.seekg( static_cast<std::streamoff>( sync_offset + 1 ) );
+                binary_reader >> magic >> sync_message_number;
+                input_stream.clear();
+
+                offset = sync_offset;
+                message_number = sync_message_number;
+                return;
+            }
+
+            chunk_end = chunk_begin;
+        }
+    }
+
+    // read record headers forward from offset until the log ends or stops making sense; returns the end of the last whole message, and
+    // leaves message_number at the number of messages before that point. fills in the index if one is given
+    static uint64_t walk( _InputStream & input_stream, _BinaryReader & binary_reader, uint64_t file_size, uint64_t offset, uint64_t & message_number, uint32_t index_interval, std::vector<LogIndexEntry> * index_ptr )
+    {
+        // tag, then the CodedMessage: encoding, payload id, decoded size, payload size
+        uint64_t const message_header_size = 1 + 4 * sizeof( uint32_t );
+        uint64_t const sync_size = 1 + 2 * sizeof( uint64_t );
+
+        uint64_t valid_end = offset;
+
+        while( offset < file_size )
+        {
+            input_stream.clear();
+            input_stream.seekg( static_cast<std::streamoff>( offset ) );
+
+            uint8_t tag = 0;
+            binary_reader >> tag;
+
+            if( tag == log_format::RECORD_SYNC )
+            {
+                if( offset + sync_size > file_size ) break;
+
+                uint64_t magic = 0;
+                uint64_t sync_message_number = 0;
+                binary_reader >> magic >> sync_message_number;
+                if( magic != log_format::SYNC_MAGIC || sync_message_number != message_number ) break;
+
+                offset += sync_size;
+                continue;
+            }
+
+            if( tag != log_format::RECORD_MESSAGE || offset + message_header_size > file_size ) break;
+
+            CodedMessageHeader header;
+            uint32_t size = 0;
+            header.unpack( binary_reader );
+            binary_reader >> size;
+
+            uint64_t const message_end = offset + message_header_size + size;
+            if( !input_stream || message_end > file_size ) break;
+
+            if( index_ptr && message_number % index_interval == 0 )
+            {
+                index_ptr->push_back( LogIndexEntry( message_number, offset, header.payload_id_, readTimeStamp( input_stream, binary_reader, header, size ), size ) );
+            }
+
+            ++message_number;
+            offset = valid_end = message_end;
+        }
+
+        input_stream.clear();
+        return valid_end;
+    }
+
+    // the stamp of the message whose payload is next in the stream
+    static uint64_t readTimeStamp( _InputStream & input_stream, _BinaryReader & binary_reader, CodedMessageHeader const & header, uint32_t size )
+    {
+        // BinaryCodec payloads end with the message itself, and so with its stamp
+        if( header.encoding_ == BinaryCodec<>::ID() )
+        {
+            if( size < sizeof( uint64_t ) ) return 0;
+
+            uint64_t stamp = 0;
+            input_stream.seekg( static_cast<std::streamoff>( size - sizeof( uint64_t ) ), std::ios::cur );
+            binary_reader >> stamp;
+            return stamp;
+        }
+
+        CodedMessage<> coded_message( CodedMessageHeader( header ), BinaryMessage<>( NULL, size ) );
+        coded_message.payload_.unpackPayload( binary_reader );
+        return peekTimeStamp( coded_message );
+    }
+};
+
+#endif // _MESSAGES_LOGRECOVERY_H_
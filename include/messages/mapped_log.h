@@ -0,0 +1,472 @@
+#ifndef _MESSAGES_MAPPEDLOG_H_
+#define _MESSAGES_MAPPEDLOG_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <iterator>
+#include <exception>
+
+#include <Poco/File.h>
+#include <Poco/Exception.h>
+#include <Poco/SharedMemory.h>
+
+#include <messages/codec.h>
+#include <messages/exceptions.h>
+#include <messages/log_format.h>
+#include <messages/peek_time_stamp.h>
+
+// read-only view of a whole message log (see log_format.h), mapped into memory for offline analysis
+//
+// opening the log walks it once to find where every message starts, touching only the message headers. after that, any message can be had
+// in O(1) as a CodedMessage whose payload points straight into the mapping; nothing is copied until it's decoded. views stay valid for as
+// long as the MappedLog does
+//
+// messages can be visited one stream (payload id) at a time with stream(), or decoded on every core at once with parallelFor()
+//
+// the whole file is mapped at once, so logs larger than a few GB need a 64-bit build
+class MappedLog
+{
+public:
+    typedef CodedMessage<> _CodedMessage;
+
+    // where one message lives in the mapping
+    struct Entry
+    {
+        CodedMessageHeader header_;
+        char const * data_;
+        uint32_t size_;
+
+        Entry( CodedMessageHeader const & header = CodedMessageHeader(), char const * data = NULL, uint32_t size = 0 )
+        :
+            header_( header ),
+            data_( data ),
+            size_( size )
+        {
+            //
+        }
+    };
+
+    // ####################################################################################################
+    // the messages of one stream, in log order
+    class Stream
+    {
+    public:
+        class Iterator
+        {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef _CodedMessage value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef _CodedMessage const * pointer;
+            typedef _CodedMessage reference;
+
+        protected:
+            MappedLog const * log_ptr_;
+            std::vector<size_t>::const_iterator message_number_it_;
+
+        public:
+            Iterator( MappedLog const * log_ptr = NULL, std::vector<size_t>::const_iterator message_number_it = std::vector<size_t>::const_iterator() )
+            :
+                log_ptr_( log_ptr ),
+                message_number_it_( message_number_it )
+            {
+                //
+            }
+
+            // a view of the message; see MappedLog::operator[]
+            _CodedMessage operator*() const
+            {
+                return ( *log_ptr_ )[*message_number_it_];
+            }
+
+            // position of the message in the whole log
+            size_t messageNumber() const
+            {
+                return *message_number_it_;
+            }
+
+            Iterator & operator++()
+            {
+                ++message_number_it_;
+                return *this;
+            }
+
+            Iterator operator++( int )
+            {
+                Iterator result( *this );
+                ++message_number_it_;
+                return result;
+            }
+
+            bool operator==( Iterator const & other ) const
+            {
+                return message_number_it_ == other.message_number_it_;
+            }
+
+            bool operator!=( Iterator const & other ) const
+            {
+                return message_number_it_ != other.message_number_it_;
+            }
+        };
+
+    protected:
+        MappedLog const * log_ptr_;
+        std::vector<size_t> const * message_numbers_ptr_;
+
+    public:
+        Stream( MappedLog const * log_ptr, std::vector<size_t> const * message_numbers_ptr )
+        :
+            log_ptr_( log_ptr ),
+            message_numbers_ptr_( message_numbers_ptr )
+        {
+            //
+        }
+
+        Iterator begin() const
+        {
+            return Iterator( log_ptr_, message_numbers_ptr_->begin() );
+        }
+
+        Iterator end() const
+        {
+            return Iterator( log_ptr_, message_numbers_ptr_->end() );
+        }
+
+        size_t size() const
+        {
+            return message_numbers_ptr_->size();
+        }
+
+        bool empty() const
+        {
+            return message_numbers_ptr_->empty();
+        }
+
+        // positions of the stream's messages in the whole log
+        std::vector<size_t> const & messageNumbers() const
+        {
+            return *message_numbers_ptr_;
+        }
+    };
+
+protected:
+    std::string input_path_;
+    std::unique_ptr<Poco::SharedMemory> mapping_ptr_;
+    char const * begin_;
+    char const * end_;
+
+    uint32_t version_;
+    std::vector<Entry> entries_;
+    std::map<uint32_t, std::vector<size_t> > streams_;
+    // the log's own index, if it has one, by message number
+    std::vector<LogIndexEntry> index_;
+    bool truncated_;
+
+public:
+    // throws MessageException if the log can't be mapped or is damaged; a log that's merely cut short (eg: the logger was killed) is
+    // kept up to its last whole message, see truncated()
+    MappedLog( std::string const & input_path )
+    :
+        input_path_( input_path ),
+        begin_( NULL ),
+        end_( NULL ),
+        version_( 0 ),
+        truncated_( false )
+    {
+        try
+        {
+            Poco::File const input_file( input_path );
+            if( input_file.getSize() > 0 )
+            {
+                mapping_ptr_.reset( new Poco::SharedMemory( input_file, Poco::SharedMemory::AM_READ ) );
+                begin_ = mapping_ptr_->begin();
+                end_ = mapping_ptr_->end();
+            }
+        }
+        catch( Poco::Exception & e )
+        {
+            throw messages::MessageException( "Failed to map log " + input_path + ": " + e.displayText() );
+        }
+
+        scan();
+    }
+
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    bool empty() const
+    {
+        return entries_.empty();
+    }
+
+    Entry const & entry( size_t message_number ) const
+    {
+        return entries_[message_number];
+    }
+
+    // a CodedMessage whose payload points into the mapping; only valid while this MappedLog is. copying it copies the payload, moving it doesn't
+    _CodedMessage operator[]( size_t message_number ) const
+    {
+        auto const & entry = entries_[message_number];
+        return _CodedMessage( CodedMessageHeader( entry.header_ ), BinaryMessage<>( entry.data_, entry.size_ ) );
+    }
+
+    // the messages with the given payload id, ie: with the given message type's ID(); empty if there are none
+    Stream stream( uint32_t payload_id ) const
+    {
+        static std::vector<size_t> const no_message_numbers;
+
+        auto const stream_it = streams_.find( payload_id );
+        return Stream( this, stream_it == streams_.end() ? &no_message_numbers : &stream_it->second );
+    }
+
+    // the message's stamp, without decoding it where possible: BinaryCodec payloads end with the stamp, and the log's index has the stamps
+    // of the messages it covers. anything else is decoded (see peekTimeStamp()). 0 if the message has no stamp
+    uint64_t timeStamp( size_t message_number ) const
+    {
+        auto const & entry = entries_[message_number];
+
+        if( entry.header_.encoding_ == BinaryCodec<>::ID() )
+        {
+            if( entry.size_ < sizeof( uint64_t ) ) return 0;
+
+            char const * position = entry.data_ + entry.size_ - sizeof( uint64_t );
+            return readInteger<uint64_t>( position );
+        }
+
+        auto const index_entry_it = std::lower_bound( index_.begin(), index_.end(), message_number, []( LogIndexEntry const & index_entry, size_t number ){ return index_entry.message_number_ < number; } );
+        if( index_entry_it != index_.end() && index_entry_it->message_number_ == message_number ) return index_entry_it->stamp_;
+
+        return peekTimeStamp( ( *this )[message_number] );
+    }
+
+    // payload ids present in the log
+    std::vector<uint32_t> payloadIds() const
+    {
+        std::vector<uint32_t> payload_ids;
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            payload_ids.push_back( stream_it->first );
+        }
+        return payload_ids;
+    }
+
+    // call fn( size_t message_number, _CodedMessage const & message ) for each of the given messages, spread over num_workers threads (0 for
+    // one per hardware thread); fn must be safe to call concurrently. the order of the calls is unspecified
+    // if fn throws, the remaining messages are abandoned and the first exception is rethrown here once every worker has stopped
+    template<class __Fn>
+    void parallelFor( std::vector<size_t> const & message_numbers, __Fn fn, size_t num_workers = 0 ) const
+    {
+        if( num_workers == 0 ) num_workers = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+        num_workers = std::min( num_workers, message_numbers.size() );
+
+        std::atomic<size_t> next_idx( 0 );
+        std::atomic<bool> failed( false );
+        std::exception_ptr exception_ptr;
+        std::mutex exception_mutex;
+
+        auto worker_fn = [&]()
+        {
+            for( size_t idx = next_idx++; idx < message_numbers.size() && !failed; idx = next_idx++ )
+            {
+                try
+                {
+                    fn( message_numbers[idx], ( *this )[message_numbers[idx]] );
+                }
+                catch( ... )
+                {
+                    std::lock_guard<std::mutex> lock( exception_mutex );
+                    if( !failed ) exception_ptr = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for( size_t worker_idx = 1; worker_idx < num_workers; ++worker_idx )
+        {
+            workers.push_back( std::thread( worker_fn ) );
+        }
+
+        // the calling thread does its share too
+        if( num_workers > 0 ) worker_fn();
+
+        for( auto worker_it = workers.begin(); worker_it != workers.end(); ++worker_it )
+        {
+            worker_it->join();
+        }
+
+        if( exception_ptr ) std::rethrow_exception( exception_ptr );
+    }
+
+    // every message of one stream
+    template<class __Fn>
+    void parallelFor( uint32_t payload_id, __Fn fn, size_t num_workers = 0 ) const
+    {
+        parallelFor( stream( payload_id ).messageNumbers(), fn, num_workers );
+    }
+
+    // every message in the log
+    template<class __Fn>
+    void parallelFor( __Fn fn, size_t num_workers = 0 ) const
+    {
+        std::vector<size_t> message_numbers( entries_.size() );
+        for( size_t message_number = 0; message_number < message_numbers.size(); ++message_number )
+        {
+            message_numbers[message_number] = message_number;
+        }
+
+        parallelFor( message_numbers, fn, num_workers );
+    }
+
+    std::string const & inputPath() const
+    {
+        return input_path_;
+    }
+
+    // 0 for legacy logs
+    uint32_t version() const
+    {
+        return version_;
+    }
+
+    // the log ends partway through a record
+    bool truncated() const
+    {
+        return truncated_;
+    }
+
+    // bytes mapped
+    uint64_t mappedSize() const
+    {
+        return static_cast<uint64_t>( end_ - begin_ );
+    }
+
+protected:
+    // integers in the log are in network byte order
+    template<class __Integer>
+    static __Integer readInteger( char const *& position )
+    {
+        __Integer value = 0;
+        for( size_t i = 0; i < sizeof( __Integer ); ++i )
+        {
+            value = static_cast<__Integer>( ( value << 8 ) | static_cast<unsigned char>( position[i] ) );
+        }
+        position += sizeof( __Integer );
+        return value;
+    }
+
+    size_t remaining( char const * position ) const
+    {
+        return static_cast<size_t>( end_ - position );
+    }
+
+    void scan()
+    {
+        char const * position = begin_;
+
+        if( remaining( position ) >= log_format::HEADER_SIZE && readInteger<uint64_t>( position ) == log_format::FILE_MAGIC )
+        {
+            version_ = readInteger<uint32_t>( position );
+            if( version_ > log_format::VERSION ) throw messages::MessageException( "Log " + input_path_ + " is from a newer version (" + std::to_string( version_ ) + ")" );
+            position = begin_ + log_format::HEADER_SIZE;
+        }
+        else
+        {
+            // no header; a legacy log starts with its first message
+            version_ = 0;
+            position = begin_;
+        }
+
+        // encoding, payload id, decoded size, payload size
+        size_t const message_header_size = 4 * sizeof( uint32_t );
+
+        while( position < end_ )
+        {
+            if( version_ > 0 )
+            {
+                uint8_t const tag = static_cast<uint8_t>( *position++ );
+
+                if( tag == log_format::RECORD_INDEX )
+                {
+                    readIndex( position );
+                    break;
+                }
+
+                if( tag == log_format::RECORD_SYNC )
+                {
+                    if( remaining( position ) < 2 * sizeof( uint64_t ) )
+                    {
+                        truncated_ = true;
+                        break;
+                    }
+
+                    uint64_t const magic = readInteger<uint64_t>( position );
+                    uint64_t const message_number = readInteger<uint64_t>( position );
+                    if( magic == log_format::SYNC_MAGIC && message_number == entries_.size() ) continue;
+                }
+
+                if( tag != log_format::RECORD_MESSAGE ) throw messages::MessageException( "Log " + input_path_ + " is damaged near message " + std::to_string( entries_.size() ) );
+            }
+
+            if( remaining( position ) < message_header_size )
+            {
+                truncated_ = true;
+                break;
+            }
+
+            CodedMessageHeader header;
+            header.encoding_ = readInteger<uint32_t>( position );
+            header.payload_id_ = readInteger<uint32_t>( position );
+            header.decoded_size_ = readInteger<uint32_t>( position );
+            uint32_t const size = readInteger<uint32_t>( position );
+
+            if( remaining( position ) < size )
+            {
+                truncated_ = true;
+                break;
+            }
+
+            streams_[header.payload_id_].push_back( entries_.size() );
+            entries_.push_back( Entry( header, position, size ) );
+
+            position += size;
+        }
+    }
+
+    // position is just past the index record's tag. an index that's cut short, or doesn't match the messages, is ignored; it's only a shortcut
+    void readIndex( char const * position )
+    {
+        // message number, offset, payload id, stamp, size
+        size_t const index_entry_size = 3 * sizeof( uint64_t ) + 2 * sizeof( uint32_t );
+
+        if( remaining( position ) < sizeof( uint64_t ) ) return;
+        uint64_t const num_index_entries = readInteger<uint64_t>( position );
+        if( num_index_entries > remaining( position ) / index_entry_size ) return;
+
+        std::vector<LogIndexEntry> index( static_cast<size_t>( num_index_entries ) );
+        for( auto index_entry_it = index.begin(); index_entry_it != index.end(); ++index_entry_it )
+        {
+            index_entry_it->message_number_ = readInteger<uint64_t>( position );
+            index_entry_it->offset_ = readInteger<uint64_t>( position );
+            index_entry_it->payload_id_ = readInteger<uint32_t>( position );
+            index_entry_it->stamp_ = readInteger<uint64_t>( position );
+            index_entry_it->size_ = readInteger<uint32_t>( position );
+
+            if( index_entry_it->message_number_ >= entries_.size() || entries_[index_entry_it->message_number_].header_.payload_id_ != index_entry_it->payload_id_ ) return;
+            if( index_entry_it != index.begin() && index_entry_it->message_number_ <= ( index_entry_it - 1 )->message_number_ ) return;
+        }
+
+        index_.swap( index );
+    }
+};
+
+#endif // _MESSAGES_MAPPEDLOG_H_
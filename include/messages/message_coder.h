@@ -7,6 +7,7 @@
 #include <Poco/Timestamp.h>
 
 #include <atomics/binary_stream.h>
+#include <atomics/trace.h>
 
 #include <messages/codec.h>
 
@@ -35,6 +36,8 @@ public:
     template<class __Serializable>
     _CodedMessage encode( __Serializable & serializable )
     {
+        ATOMICS_TRACE_SCOPE( "MessageCoder::encode" );
+
         _OutputArchive archive;
         // set up binary writer to write to output archive
         _BinaryWriter binary_writer( archive, _BinaryWriter::NETWORK_BYTE_ORDER );
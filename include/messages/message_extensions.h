@@ -0,0 +1,209 @@
+#ifndef _MESSAGES_MESSAGEEXTENSIONS_H_
+#define _MESSAGES_MESSAGEEXTENSIONS_H_
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include <Poco/MemoryStream.h>
+
+#include <atomics/binary_stream.h>
+
+#include <messages/serializable_message.h>
+#include <messages/exceptions.h>
+
+// ####################################################################################################
+// optional data sent after a message in the same frame (see OutputTCPDevice::push()), each tagged with the ID() of the message it holds:
+//
+//   EXTENSIONS_MAGIC (uint32), number of extensions (uint16), then for each: tag (uint32), size (uint32), the packed message
+//
+// a reader that predates extensions stops at the end of the message and never sees them, and one that finds no magic after the message
+// (eg: from an older server) just has none; extensions a reader doesn't know are skipped by size
+class MessageExtensions
+{
+public:
+    // "KEXT"
+    static uint32_t const EXTENSIONS_MAGIC = 0x4B455854;
+
+protected:
+    std::vector<std::pair<uint32_t, std::string> > extensions_;
+
+public:
+    // ====================================================================================================
+    // add the message as an extension, replacing any earlier one of the same type
+    template<class __Message>
+    void set( __Message const & message )
+    {
+        std::stringstream archive;
+        atomics::BinaryOutputStream encoder( archive, atomics::BinaryOutputStream::NETWORK_BYTE_ORDER );
+        message.pack( encoder );
+        encoder.flush();
+
+        uint32_t const tag = extensionTag<__Message>();
+
+        for( auto extension_it = extensions_.begin(); extension_it != extensions_.end(); ++extension_it )
+        {
+            if( extension_it->first != tag ) continue;
+            extension_it->second = archive.str();
+            return;
+        }
+
+        extensions_.emplace_back( tag, archive.str() );
+    }
+
+    // ====================================================================================================
+    // unpack the extension of the message's type into it; false (and the message untouched) if there isn't one
+    template<class __Message>
+    bool get( __Message & message ) const
+    {
+        uint32_t const tag = extensionTag<__Message>();
+
+        for( auto extension_it = extensions_.begin(); extension_it != extensions_.end(); ++extension_it )
+        {
+            if( extension_it->first != tag ) continue;
+
+            Poco::MemoryInputStream archive( extension_it->second.data(), extension_it->second.size() );
+            atomics::BinaryInputStream decoder( archive, atomics::BinaryInputStream::NETWORK_BYTE_ORDER );
+            message.unpack( decoder );
+            return true;
+        }
+
+        return false;
+    }
+
+    // ====================================================================================================
+    bool empty() const
+    {
+        return extensions_.empty();
+    }
+
+    // ====================================================================================================
+    void clear()
+    {
+        extensions_.clear();
+    }
+
+    // ====================================================================================================
+    // nothing at all is written when there are no extensions, so the frame is exactly what it was before extensions existed
+    template<class __Archive>
+    void pack( __Archive & archive ) const
+    {
+        if( extensions_.empty() ) return;
+
+        archive << EXTENSIONS_MAGIC;
+        archive << static_cast<uint16_t>( extensions_.size() );
+
+        for( auto extension_it = extensions_.begin(); extension_it != extensions_.end(); ++extension_it )
+        {
+            archive << extension_it->first;
+            archive << static_cast<uint32_t>( extension_it->second.size() );
+            archive.writeRaw( extension_it->second.data(), extension_it->second.size() );
+        }
+    }
+
+    // ====================================================================================================
+    // reads whatever extensions follow the message; a frame that ends with the message has none
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        extensions_.clear();
+
+        uint32_t magic = 0;
+        archive >> magic;
+        if( !archive.good() || magic != EXTENSIONS_MAGIC ) return;
+
+        uint16_t num_extensions = 0;
+        archive >> num_extensions;
+
+        for( uint16_t extension_idx = 0; extension_idx < num_extensions && archive.good(); ++extension_idx )
+        {
+            uint32_t tag = 0;
+            uint32_t size = 0;
+            archive >> tag;
+            archive >> size;
+
+            std::string bytes;
+            archive.readRaw( size, bytes );
+            if( !archive.good() || bytes.size() != size ) throw messages::MessageException( "message extension cut short" );
+
+            extensions_.emplace_back( tag, std::move( bytes ) );
+        }
+    }
+
+protected:
+    // computing a message ID hashes its name, so do it once per type
+    template<class __Message>
+    static uint32_t extensionTag()
+    {
+        static uint32_t const tag = __Message::ID();
+        return tag;
+    }
+};
+
+// ####################################################################################################
+// a message followed by its extensions; packs, unpacks, and identifies itself exactly like __Message when there are none, so it can be
+// pulled in place of __Message from a server that may or may not send extensions
+template<class __Message>
+class ExtendedMessage : public __Message
+{
+public:
+    typedef __Message _Message;
+
+    MessageExtensions extensions_;
+
+    template<class... __Args>
+    ExtendedMessage( __Args&&... args )
+    :
+        __Message( std::forward<__Args>( args )... )
+    {
+        //
+    }
+
+    template<class __Archive>
+    void pack( __Archive & archive )
+    {
+        __Message::pack( archive );
+        extensions_.pack( archive );
+    }
+
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        __Message::unpack( archive );
+        extensions_.unpack( archive );
+    }
+};
+
+// ####################################################################################################
+// the same for a message owned elsewhere, so it can be sent with extensions without being copied; only for packing
+template<class __Message>
+class ExtendedMessageRef
+{
+public:
+    __Message & message_;
+    MessageExtensions const & extensions_;
+
+    ExtendedMessageRef( __Message & message, MessageExtensions const & extensions )
+    :
+        message_( message ),
+        extensions_( extensions )
+    {
+        //
+    }
+
+    static uint32_t ID()
+    {
+        return __Message::ID();
+    }
+
+    template<class __Archive>
+    void pack( __Archive & archive )
+    {
+        message_.pack( archive );
+        extensions_.pack( archive );
+    }
+};
+
+#endif // _MESSAGES_MESSAGEEXTENSIONS_H_
@@ -0,0 +1,148 @@
+#ifndef _MESSAGES_OUTPUTLOGDEVICE_H_
+#define _MESSAGES_OUTPUTLOGDEVICE_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <atomics/binary_stream.h>
+#include <atomics/async_file_writer.h>
+
+#include <messages/codec.h>
+#include <messages/exceptions.h>
+#include <messages/log_format.h>
+
+// writes CodedMessages to a seekable log (see log_format.h); the index is kept in memory and written out by close()
+// a log that's never closed (eg: the process was killed) can still be read from start to finish, just not seeked in
+//
+// the file itself is written by an AsyncFileWriter, so push() only has to copy the message into memory
+class OutputLogDevice
+{
+public:
+    typedef atomics::AsyncFileWriter _FileWriter;
+    typedef std::ostream _OutputStream;
+    typedef atomics::BinaryOutputStream _BinaryWriter;
+
+protected:
+    std::string output_path_;
+    _FileWriter file_writer_;
+    _OutputStream output_stream_;
+    _BinaryWriter binary_writer_;
+
+    uint32_t sync_interval_;
+    uint32_t index_interval_;
+
+    std::vector<LogIndexEntry> index_;
+
+    uint64_t num_messages_;
+    uint64_t num_bytes_;
+    bool closed_;
+
+public:
+    // a sync marker goes in front of every sync_interval'th message and an index entry is kept for every index_interval'th
+    OutputLogDevice( std::string const & output_path, uint32_t sync_interval = 64, uint32_t index_interval = 1, _FileWriter::Settings const & writer_settings = _FileWriter::Settings() )
+    :
+        output_path_( output_path ),
+        file_writer_( output_path, writer_settings ),
+        output_stream_( &file_writer_ ),
+        binary_writer_( output_stream_, _BinaryWriter::NETWORK_BYTE_ORDER ),
+        sync_interval_( sync_interval > 0 ? sync_interval : 1 ),
+        index_interval_( index_interval > 0 ? index_interval : 1 ),
+        num_messages_( 0 ),
+        num_bytes_( 0 ),
+        closed_( false )
+    {
+        if( !file_writer_.isOpen() ) throw messages::MessageException( "Failed to open log " + output_path + ": " + file_writer_.error() );
+
+        binary_writer_ << log_format::FILE_MAGIC;
+        binary_writer_ << log_format::VERSION;
+        binary_writer_ << sync_interval_;
+        binary_writer_ << index_interval_;
+    }
+
+    ~OutputLogDevice()
+    {
+        try
+        {
+            close();
+        }
+        catch( std::exception & e )
+        {
+            //
+        }
+    }
+
+    // append a message; stamp is only recorded in the index (0 if unknown)
+    // throws MessageException if the write fails
+    template<class __Allocator>
+    void push( CodedMessage<__Allocator> & coded_message, uint64_t stamp = 0 )
+    {
+        if( closed_ ) throw messages::MessageException( "Failed to write to log " + output_path_ + "; already closed" );
+
+        if( num_messages_ % sync_interval_ == 0 )
+        {
+            binary_writer_ << log_format::RECORD_SYNC;
+            binary_writer_ << log_format::SYNC_MAGIC;
+            binary_writer_ << num_messages_;
+        }
+
+        uint64_t const offset = static_cast<uint64_t>( output_stream_.tellp() );
+
+        if( num_messages_ % index_interval_ == 0 ) index_.push_back( LogIndexEntry( num_messages_, offset, coded_message.header_.payload_id_, stamp, coded_message.payload_.size_ ) );
+
+        binary_writer_ << log_format::RECORD_MESSAGE;
+        coded_message.pack( binary_writer_ );
+
+        if( !output_stream_ ) throw messages::MessageException( file_writer_.error().empty() ? "Failed to write to log " + output_path_ : file_writer_.error() );
+
+        ++num_messages_;
+        num_bytes_ += coded_message.payload_.size_;
+    }
+
+    // write the index and trailer and close the file; further pushes throw
+    void close()
+    {
+        if( closed_ ) return;
+        closed_ = true;
+
+        uint64_t const index_offset = static_cast<uint64_t>( output_stream_.tellp() );
+
+        binary_writer_ << log_format::RECORD_INDEX;
+        binary_writer_ << static_cast<uint64_t>( index_.size() );
+        for( auto entry_it = index_.begin(); entry_it != index_.end(); ++entry_it )
+        {
+            entry_it->pack( binary_writer_ );
+        }
+
+        binary_writer_ << index_offset;
+        binary_writer_ << log_format::TRAILER_MAGIC;
+
+        binary_writer_.flush();
+
+        if( !file_writer_.close() || !output_stream_ ) throw messages::MessageException( file_writer_.error().empty() ? "Failed to finish log " + output_path_ : file_writer_.error() );
+    }
+
+    std::string const & outputPath() const
+    {
+        return output_path_;
+    }
+
+    uint64_t numMessages() const
+    {
+        return num_messages_;
+    }
+
+    // payload bytes written so far
+    uint64_t numBytes() const
+    {
+        return num_bytes_;
+    }
+
+    // throughput and stalls; see AsyncFileWriter::printMetrics()
+    _FileWriter const & fileWriter() const
+    {
+        return file_writer_;
+    }
+};
+
+#endif // _MESSAGES_OUTPUTLOGDEVICE_H_
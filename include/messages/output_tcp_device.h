@@ -10,12 +10,15 @@
 #include <Poco/Net/StreamSocket.h>
 #include <Poco/Net/SocketStream.h>
 
+#include <atomics/trace.h>
+
 #include <messages/container_messages.h>
 #include <messages/binary_message.h>
 #include <messages/exceptions.h>
 
 #include <messages/message_coder.h>
 #include <messages/binary_codec.h>
+#include <messages/message_extensions.h>
 
 // analagous to server; will start up at the given address:port and wait for a client it can stream data to
 
@@ -205,6 +208,14 @@ public:
         }
     }
 
+    // the same, with the given extensions (see message_extensions.h) after the message in the same frame
+    template<class __Serializable>
+    void push( __Serializable & serializable, MessageExtensions const & extensions )
+    {
+        ExtendedMessageRef<__Serializable> extended_message( serializable, extensions );
+        push( extended_message );
+    }
+
     void establishClientConnection()
     {
         // check whether the output socket is ready
@@ -244,6 +255,8 @@ public:
 
     void sendBytes( char const * bytes, uint32_t length )
     {
+        ATOMICS_TRACE_SCOPE( "OutputTCPDevice::sendBytes" );
+
         if( !output_socket_.impl()->initialized() ) throw messages::MessageException( "Failed to send data; socket not initialized" );
         uint32_t bytes_sent = 0;
         while( bytes_sent < length )
@@ -0,0 +1,42 @@
+#ifndef _MESSAGES_PEEKTIMESTAMP_H_
+#define _MESSAGES_PEEKTIMESTAMP_H_
+
+#include <cstdint>
+
+#include <messages/codec.h>
+#include <messages/binary_codec.h>
+#include <messages/gzip_codec.h>
+
+// every Kinect message ends with its TimeStampMessage, so the stamp is the last 8 bytes of the decoded message (network byte order);
+// images don't have to be decoded to get at it. returns 0 if the message carries no stamp we can read
+template<class __Allocator>
+uint64_t peekTimeStamp( CodedMessage<__Allocator> const & coded_message )
+{
+    BinaryMessage<__Allocator> decoded_message;
+    BinaryMessage<__Allocator> const * decoded_message_ptr = &coded_message.payload_;
+
+    // the binary codec stores the message as-is after a BOM; anything else has to be decoded first
+    if( coded_message.header_.encoding_ == GZipCodec<__Allocator>::ID() )
+    {
+        decoded_message = GZipCodec<__Allocator>().decode( coded_message );
+        decoded_message_ptr = &decoded_message;
+    }
+    else if( coded_message.header_.encoding_ != BinaryCodec<__Allocator>::ID() )
+    {
+        return 0;
+    }
+
+    if( decoded_message_ptr->size_ < sizeof( uint64_t ) ) return 0;
+
+    auto const stamp_bytes = reinterpret_cast<unsigned char const *>( decoded_message_ptr->data_ + decoded_message_ptr->size_ - sizeof( uint64_t ) );
+
+    uint64_t stamp = 0;
+    for( size_t i = 0; i < sizeof( uint64_t ); ++i )
+    {
+        stamp = ( stamp << 8 ) | stamp_bytes[i];
+    }
+
+    return stamp;
+}
+
+#endif // _MESSAGES_PEEKTIMESTAMP_H_
@@ -2,6 +2,7 @@
 #define _MESSAGES_PNGIMAGEMESSAGE_H_
 
 #include <messages/image_message.h>
+#include <atomics/trace.h>
 #include <png.h>
 #include <vector>
 
@@ -161,6 +162,8 @@ public:
     template<class __Archive>
     void pack( __Archive & archive )
     {
+        ATOMICS_TRACE_SCOPE( "PNGImageMessage::pack" );
+
 //        std::cout << "PNGImageMessage packing into archive" << std::endl;
 
         PNGStructAllocator png_struct_allocator( PNGStructAllocator::StructType::WRITE, PNG_LIBPNG_VER_STRING, static_cast<png_voidp>( NULL ), static_cast<png_error_ptr>( NULL ), static_cast<png_error_ptr>( NULL ) );
@@ -237,7 +240,7 @@ public:
     template<class __Archive>
     void unpack( __Archive & archive )
     {
-        std::cout << "PNGImageMessage unpacking from archive" << std::endl;
+//        std::cout << "PNGImageMessage unpacking from archive" << std::endl;
 
         char png_signature[8];
         archive.read( png_signature, 8 );
@@ -290,7 +293,7 @@ public:
         png_read_image( png_struct_ptr, &rows_map.front() );
         png_read_end( png_struct_ptr, png_end_ptr );
 
-        std::cout << "PNGImageMessage done unpacking from archive" << std::endl;
+//        std::cout << "PNGImageMessage done unpacking from archive" << std::endl;
     }
 
     DECLARE_MESSAGE_INFO( PNGImageMessage )
@@ -0,0 +1,254 @@
+#ifndef _MESSAGES_SEGMENTEDLOGDEVICE_H_
+#define _MESSAGES_SEGMENTEDLOGDEVICE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/DirectoryIterator.h>
+
+#include <messages/output_log_device.h>
+#include <messages/log_recovery.h>
+
+// writes a recording as a series of logs ("segments") in one directory, starting a new one whenever the current one reaches a size or age
+// limit, so a long session never produces one enormous file and finished segments can be moved or processed while recording goes on
+//
+// every segment is a complete log in its own right (see log_format.h), named <prefix>-<segment number>.pak and indexed when it's closed.
+// until then it's named <prefix>-<segment number>.pak.partial, so anything watching the directory only ever sees finished segments. a
+// .partial file left behind by a crash can be repaired with recoverSegments()
+class SegmentedLogDevice
+{
+public:
+    typedef OutputLogDevice::_FileWriter _FileWriter;
+    typedef std::chrono::steady_clock _Clock;
+
+    static std::string const & segmentExtension()
+    {
+        static std::string const extension( ".pak" );
+        return extension;
+    }
+
+    static std::string const & partialExtension()
+    {
+        static std::string const extension( ".partial" );
+        return extension;
+    }
+
+protected:
+    std::string output_dir_;
+    std::string prefix_;
+    uint64_t max_segment_size_;
+    _Clock::duration max_segment_duration_;
+
+    uint32_t sync_interval_;
+    uint32_t index_interval_;
+    _FileWriter::Settings writer_settings_;
+
+    std::unique_ptr<OutputLogDevice> segment_ptr_;
+    // held while segment_ptr_ changes, so printMetrics() can be called from another thread
+    mutable std::mutex segment_mutex_;
+    _Clock::time_point segment_start_time_;
+    uint32_t num_segments_;
+    std::vector<std::string> finished_segments_;
+
+    uint64_t num_messages_;
+    uint64_t num_bytes_;
+
+public:
+    // a segment is finished once it holds max_segment_size bytes or has been open for max_segment_duration seconds (0 for no limit); the
+    // remaining arguments are as for OutputLogDevice. creates output_dir if need be; throws MessageException if that fails
+    SegmentedLogDevice( std::string const & output_dir, std::string const & prefix, uint64_t max_segment_size = 0, double max_segment_duration = 0, uint32_t sync_interval = 64, uint32_t index_interval = 1, _FileWriter::Settings const & writer_settings = _FileWriter::Settings() )
+    :
+        output_dir_( output_dir ),
+        prefix_( prefix ),
+        max_segment_size_( max_segment_size ),
+        max_segment_duration_( std::chrono::duration_cast<_Clock::duration>( std::chrono::duration<double>( max_segment_duration ) ) ),
+        sync_interval_( sync_interval ),
+        index_interval_( index_interval ),
+        writer_settings_( writer_settings ),
+        num_segments_( 0 ),
+        num_messages_( 0 ),
+        num_bytes_( 0 )
+    {
+        try
+        {
+            Poco::File( output_dir_ ).createDirectories();
+        }
+        catch( Poco::Exception & e )
+        {
+            throw messages::MessageException( "Failed to create log directory " + output_dir_ + ": " + e.displayText() );
+        }
+    }
+
+    ~SegmentedLogDevice()
+    {
+        try
+        {
+            close();
+        }
+        catch( std::exception & e )
+        {
+            //
+        }
+    }
+
+    // append a message to the current segment, first starting a new one if the current one is full
+    // throws MessageException if a segment can't be opened, written, or finished
+    template<class __Allocator>
+    void push( CodedMessage<__Allocator> & coded_message, uint64_t stamp = 0 )
+    {
+        if( !segment_ptr_ || segmentFull() )
+        {
+            finishSegment();
+            startSegment();
+        }
+
+        segment_ptr_->push( coded_message, stamp );
+
+        ++num_messages_;
+        num_bytes_ += coded_message.payload_.size_;
+    }
+
+    // finish the current segment, if any
+    void close()
+    {
+        finishSegment();
+    }
+
+    std::string const & outputDir() const
+    {
+        return output_dir_;
+    }
+
+    // the segment being written, empty before the first push()
+    std::string currentSegmentPath() const
+    {
+        return segment_ptr_ ? segment_ptr_->outputPath() : std::string();
+    }
+
+    // finished segments, oldest first
+    std::vector<std::string> const & finishedSegments() const
+    {
+        return finished_segments_;
+    }
+
+    uint32_t numSegments() const
+    {
+        return num_segments_;
+    }
+
+    uint64_t numMessages() const
+    {
+        return num_messages_;
+    }
+
+    // payload bytes written so far, across all segments
+    uint64_t numBytes() const
+    {
+        return num_bytes_;
+    }
+
+    // the current segment's writer's metrics (see AsyncFileWriter::printMetrics()); safe to call while another thread pushes
+    void printMetrics( std::ostream & out ) const
+    {
+        std::lock_guard<std::mutex> lock( segment_mutex_ );
+        if( !segment_ptr_ ) return;
+
+        out << "segment " << num_segments_ - 1 << ": " << segment_ptr_->outputPath() << std::endl;
+        segment_ptr_->fileWriter().printMetrics( out );
+    }
+
+    // repair and rename any .partial segments in the given directory, eg: left there when the logger crashed; see LogRecovery
+    // returns the paths of the recovered segments. segments that can't be recovered are reported to out and left alone
+    static std::vector<std::string> recoverSegments( std::string const & output_dir, std::ostream & out )
+    {
+        std::vector<std::string> recovered_paths;
+
+        if( !Poco::File( output_dir ).exists() ) return recovered_paths;
+
+        std::string const extension = segmentExtension() + partialExtension();
+
+        std::vector<std::string> partial_paths;
+        for( Poco::DirectoryIterator file_it( output_dir ), end_it; file_it != end_it; ++file_it )
+        {
+            std::string const & name = file_it.name();
+            if( name.size() > extension.size() && name.compare( name.size() - extension.size(), extension.size(), extension ) == 0 ) partial_paths.push_back( file_it.path().toString() );
+        }
+
+        for( auto partial_path_it = partial_paths.begin(); partial_path_it != partial_paths.end(); ++partial_path_it )
+        {
+            try
+            {
+                LogRecovery const recovery = LogRecovery::recover( *partial_path_it );
+                std::string const recovered_path = partial_path_it->substr( 0, partial_path_it->size() - partialExtension().size() );
+                Poco::File( *partial_path_it ).renameTo( recovered_path );
+
+                out << "recovered " << recovered_path << ": " << recovery.num_messages_ << " messages, " << recovery.truncatedSize() << " bytes of torn record removed" << std::endl;
+                recovered_paths.push_back( recovered_path );
+            }
+            catch( std::exception & e )
+            {
+                out << "failed to recover " << *partial_path_it << ": " << e.what() << std::endl;
+            }
+        }
+
+        return recovered_paths;
+    }
+
+protected:
+    bool segmentFull() const
+    {
+        if( max_segment_size_ > 0 && segment_ptr_->fileWriter().position() >= max_segment_size_ ) return true;
+        if( max_segment_duration_ > _Clock::duration::zero() && _Clock::now() - segment_start_time_ >= max_segment_duration_ ) return true;
+        return false;
+    }
+
+    void startSegment()
+    {
+        std::stringstream name;
+        name << prefix_ << "-" << std::setw( 4 ) << std::setfill( '0' ) << num_segments_ << segmentExtension() << partialExtension();
+
+        std::unique_ptr<OutputLogDevice> segment_ptr( new OutputLogDevice( Poco::Path( Poco::Path::forDirectory( output_dir_ ), name.str() ).toString(), sync_interval_, index_interval_, writer_settings_ ) );
+
+        std::lock_guard<std::mutex> lock( segment_mutex_ );
+        segment_ptr_ = std::move( segment_ptr );
+        segment_start_time_ = _Clock::now();
+        ++num_segments_;
+    }
+
+    // close the current segment and give it its final name
+    void finishSegment()
+    {
+        if( !segment_ptr_ ) return;
+
+        std::unique_ptr<OutputLogDevice> segment_ptr;
+        {
+            std::lock_guard<std::mutex> lock( segment_mutex_ );
+            segment_ptr = std::move( segment_ptr_ );
+        }
+
+        segment_ptr->close();
+
+        std::string const & partial_path = segment_ptr->outputPath();
+        std::string const finished_path = partial_path.substr( 0, partial_path.size() - partialExtension().size() );
+
+        try
+        {
+            Poco::File( partial_path ).renameTo( finished_path );
+        }
+        catch( Poco::Exception & e )
+        {
+            throw messages::MessageException( "Failed to rename log " + partial_path + ": " + e.displayText() );
+        }
+
+        finished_segments_.push_back( finished_path );
+    }
+};
+
+#endif // _MESSAGES_SEGMENTEDLOGDEVICE_H_
@@ -0,0 +1,50 @@
+#ifndef _MESSAGES_SENSORTAGMESSAGE_H_
+#define _MESSAGES_SENSORTAGMESSAGE_H_
+
+#include <cstdint>
+
+#include <Poco/MD5Engine.h>
+
+#include <messages/serializable_message.h>
+
+// ####################################################################################################
+// which sensor a message relayed by kinect_hub came from; sent as an extension alongside whatever extensions the sensor's server sent
+//
+// if the hub aligns clocks, aligned_stamp_ is the message's sensor stamp moved onto the hub's clock (100 ns ticks, like every sensor
+// stamp), so messages from different sensors can be compared by it; otherwise it's 0
+class SensorTagMessage : public SerializableInterface
+{
+public:
+    uint32_t sensor_id_;
+    uint64_t aligned_stamp_;
+
+    // ====================================================================================================
+    SensorTagMessage( uint32_t sensor_id = 0, uint64_t aligned_stamp = 0 )
+    :
+        sensor_id_( sensor_id ),
+        aligned_stamp_( aligned_stamp )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void pack( __Archive & archive ) const
+    {
+        archive << sensor_id_;
+        archive << aligned_stamp_;
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        archive >> sensor_id_;
+        archive >> aligned_stamp_;
+    }
+
+    // ====================================================================================================
+    DECLARE_MESSAGE_INFO( SensorTagMessage )
+};
+
+#endif // _MESSAGES_SENSORTAGMESSAGE_H_
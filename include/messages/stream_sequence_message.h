@@ -0,0 +1,44 @@
+#ifndef _MESSAGES_STREAMSEQUENCEMESSAGE_H_
+#define _MESSAGES_STREAMSEQUENCEMESSAGE_H_
+
+#include <cstdint>
+
+#include <Poco/MD5Engine.h>
+
+#include <messages/serializable_message.h>
+
+// ####################################################################################################
+// a message's position in its stream, as assigned at capture (see TrackedMessage::sequence_); sent as an extension alongside the
+// message's LatencyTraceMessage, so a client can count how many messages of each stream never reached it
+class StreamSequenceMessage : public SerializableInterface
+{
+public:
+    uint64_t sequence_;
+
+    // ====================================================================================================
+    StreamSequenceMessage( uint64_t sequence = 0 )
+    :
+        sequence_( sequence )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void pack( __Archive & archive ) const
+    {
+        archive << sequence_;
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        archive >> sequence_;
+    }
+
+    // ====================================================================================================
+    DECLARE_MESSAGE_INFO( StreamSequenceMessage )
+};
+
+#endif // _MESSAGES_STREAMSEQUENCEMESSAGE_H_
@@ -0,0 +1,100 @@
+#ifndef _MESSAGES_SUBSCRIPTIONMESSAGE_H_
+#define _MESSAGES_SUBSCRIPTIONMESSAGE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <Poco/MD5Engine.h>
+
+#include <messages/serializable_message.h>
+#include <messages/exceptions.h>
+
+// ####################################################################################################
+// which streams (by payload id) a client wants from a server, and at most how often; the client sends it back up its own connection (see
+// InputTCPDevice::push()) whenever it likes, and each one replaces the last. a client that never sends one gets every stream at full rate
+class SubscriptionMessage : public SerializableInterface
+{
+public:
+    struct Stream
+    {
+        uint32_t payload_id_;
+        // messages per second; 0 for as many as the stream has
+        float max_rate_;
+    };
+
+    // bytes each stream takes packed: payload id and max rate
+    static uint32_t const PACKED_STREAM_SIZE = 4 + 4;
+
+    std::vector<Stream> streams_;
+
+    // ====================================================================================================
+    SubscriptionMessage()
+    {
+        //
+    }
+
+    // ====================================================================================================
+    // add the stream, or change its rate if it's already there
+    void subscribe( uint32_t payload_id, float max_rate = 0 )
+    {
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            if( stream_it->payload_id_ != payload_id ) continue;
+
+            stream_it->max_rate_ = max_rate;
+            return;
+        }
+
+        Stream const stream = { payload_id, max_rate };
+        streams_.push_back( stream );
+    }
+
+    // ====================================================================================================
+    // the subscription to the stream with the given payload id, or NULL if there isn't one
+    Stream const * find( uint32_t payload_id ) const
+    {
+        for( auto stream_it = streams_.cbegin(); stream_it != streams_.cend(); ++stream_it )
+        {
+            if( stream_it->payload_id_ == payload_id ) return &*stream_it;
+        }
+
+        return NULL;
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void pack( __Archive & archive ) const
+    {
+        archive << static_cast<uint32_t>( streams_.size() );
+        for( auto stream_it = streams_.cbegin(); stream_it != streams_.cend(); ++stream_it )
+        {
+            archive << stream_it->payload_id_;
+            archive << stream_it->max_rate_;
+        }
+    }
+
+    // ====================================================================================================
+    template<class __Archive>
+    void unpack( __Archive & archive )
+    {
+        uint32_t num_streams = 0;
+        archive >> num_streams;
+
+        // the count comes from whoever sent us the message; never allocate for more streams than the bytes left could hold
+        std::streamsize const bytes_left = archive.stream().rdbuf()->in_avail();
+        if( bytes_left < 0 || num_streams > static_cast<uint64_t>( bytes_left ) / PACKED_STREAM_SIZE ) throw messages::MessageException( "SubscriptionMessage holds fewer streams than it claims" );
+
+        streams_.clear();
+        streams_.resize( num_streams );
+        for( auto stream_it = streams_.begin(); stream_it != streams_.end(); ++stream_it )
+        {
+            archive >> stream_it->payload_id_;
+            archive >> stream_it->max_rate_;
+        }
+    }
+
+    // ====================================================================================================
+    DECLARE_MESSAGE_INFO( SubscriptionMessage )
+};
+
+#endif // _MESSAGES_SUBSCRIPTIONMESSAGE_H_
@@ -0,0 +1,52 @@
+#ifndef _MESSAGES_TRACKEDMESSAGE_H_
+#define _MESSAGES_TRACKEDMESSAGE_H_
+
+#include <cstdint>
+#include <utility>
+
+#include <messages/latency_trace_message.h>
+
+// ####################################################################################################
+// wraps any message with bookkeeping that only lives inside this process while the message moves through a pipeline
+// none of it is packed with the message; the message packs, unpacks, and identifies itself exactly like __Message
+template<class __Message>
+class TrackedMessage : public __Message
+{
+public:
+    typedef __Message _UntrackedMessage;
+
+    // per-stream position assigned at capture, carried through every stage so the output can be put back in capture order
+    uint64_t sequence_;
+
+    // when the message reached each stage so far; only sent on when the server is asked to (see MessageExtensions)
+    LatencyTraceMessage trace_;
+
+    // ====================================================================================================
+    TrackedMessage()
+    :
+        __Message(),
+        sequence_( 0 )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    explicit TrackedMessage( __Message && message, uint64_t sequence = 0 )
+    :
+        __Message( std::move( message ) ),
+        sequence_( sequence )
+    {
+        //
+    }
+
+    // ====================================================================================================
+    // copy our bookkeeping onto another tracked message, e.g. when encoding a raw message into a coded one
+    template<class __OtherMessage>
+    void copyTrackingTo( TrackedMessage<__OtherMessage> & other ) const
+    {
+        other.sequence_ = sequence_;
+        other.trace_ = trace_;
+    }
+};
+
+#endif // _MESSAGES_TRACKEDMESSAGE_H_
@@ -0,0 +1 @@
+#include <atomics/async_file_writer.h>
@@ -0,0 +1 @@
+#include <atomics/byte_budget.h>
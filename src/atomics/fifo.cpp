@@ -0,0 +1 @@
+#include <atomics/fifo.h>
@@ -0,0 +1 @@
+#include <atomics/histogram.h>
@@ -0,0 +1 @@
+#include <atomics/lock_stats.h>
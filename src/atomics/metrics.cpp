@@ -0,0 +1 @@
+#include <atomics/metrics.h>
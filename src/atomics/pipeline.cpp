@@ -0,0 +1 @@
+#include <atomics/pipeline.h>
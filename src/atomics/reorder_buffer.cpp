@@ -0,0 +1 @@
+#include <atomics/reorder_buffer.h>
@@ -0,0 +1 @@
+#include <atomics/stage.h>
@@ -0,0 +1 @@
+#include <atomics/sync_buffer.h>
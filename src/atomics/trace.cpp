@@ -0,0 +1 @@
+#include <atomics/trace.h>
@@ -0,0 +1 @@
+#include <atomics/work_stealing_pool.h>
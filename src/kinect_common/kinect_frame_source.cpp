@@ -0,0 +1 @@
+#include <kinect_common/kinect_frame_source.h>
@@ -0,0 +1 @@
+#include <kinect_common/synthetic_frame_source.h>
@@ -0,0 +1 @@
+#include <messages/column_file.h>
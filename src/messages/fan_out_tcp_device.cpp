@@ -0,0 +1 @@
+#include <messages/fan_out_tcp_device.h>
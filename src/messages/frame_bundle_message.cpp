@@ -0,0 +1 @@
+#include <messages/frame_bundle_message.h>
@@ -0,0 +1 @@
+#include <messages/input_log_device.h>
@@ -0,0 +1 @@
+#include <messages/kinect_columns.h>
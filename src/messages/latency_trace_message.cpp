@@ -0,0 +1 @@
+#include <messages/latency_trace_message.h>
@@ -0,0 +1 @@
+#include <messages/log_recovery.h>
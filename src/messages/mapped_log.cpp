@@ -0,0 +1 @@
+#include <messages/mapped_log.h>
@@ -0,0 +1 @@
+#include <messages/message_extensions.h>
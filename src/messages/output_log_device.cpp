@@ -0,0 +1 @@
+#include <messages/output_log_device.h>
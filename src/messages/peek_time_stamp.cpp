@@ -0,0 +1 @@
+#include <messages/peek_time_stamp.h>
@@ -0,0 +1 @@
+#include <messages/segmented_log_device.h>
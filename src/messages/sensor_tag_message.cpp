@@ -0,0 +1 @@
+#include <messages/sensor_tag_message.h>
@@ -0,0 +1 @@
+#include <messages/stream_sequence_message.h>
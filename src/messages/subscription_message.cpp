@@ -0,0 +1 @@
+#include <messages/subscription_message.h>
@@ -0,0 +1 @@
+#include <messages/tracked_message.h>